@@ -0,0 +1,183 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif /* !_WIN32 */
+
+#include "buffer.h"
+
+static buffer_t *
+_buffer_alloc(uint8_t *data, size_t size, buffer_t *parent, bool mapped)
+{
+        buffer_t * const buffer = malloc(sizeof(buffer_t));
+        assert(buffer != NULL);
+
+        *buffer = (buffer_t) {
+                .ref_count = 1,
+                .data      = data,
+                .size      = size,
+                .parent    = parent,
+                .mapped    = mapped
+        };
+
+        return buffer;
+}
+
+buffer_t *
+buffer_new(size_t size)
+{
+        /* Even an empty buffer has somewhere to point to */
+        uint8_t * const data = malloc((size > 0) ? size : 1);
+
+        if (data == NULL) {
+                return NULL;
+        }
+
+        return _buffer_alloc(data, size, NULL, false);
+}
+
+buffer_t *
+buffer_file_read(const char *path)
+{
+        assert(path != NULL);
+
+        FILE * const fp = fopen(path, "rb");
+
+        if (fp == NULL) {
+                return NULL;
+        }
+
+        long size;
+
+        if (((fseek(fp, 0, SEEK_END)) != 0) || ((size = ftell(fp)) < 0)) {
+                (void)fclose(fp);
+
+                return NULL;
+        }
+
+        /* Nothing to read, but an empty buffer still has a byte to point to,
+         * so it doesn't pass for running out of memory */
+        if (size == 0) {
+                (void)fclose(fp);
+
+                return buffer_new(0);
+        }
+
+        rewind(fp);
+
+        buffer_t * const buffer = buffer_new(size);
+
+        if ((buffer == NULL) || ((fread(buffer->data, 1, size, fp)) != (size_t)size)) {
+                buffer_unref(buffer);
+                (void)fclose(fp);
+
+                return NULL;
+        }
+
+        (void)fclose(fp);
+
+        return buffer;
+}
+
+#if !defined(_WIN32)
+buffer_t *
+buffer_file_map(const char *path)
+{
+        assert(path != NULL);
+
+        const int fd = open(path, O_RDONLY);
+
+        if (fd < 0) {
+                return NULL;
+        }
+
+        struct stat stat_buffer;
+
+        if (((fstat(fd, &stat_buffer)) != 0) || !S_ISREG(stat_buffer.st_mode)) {
+                (void)close(fd);
+
+                return NULL;
+        }
+
+        /* Empty files can't be mapped */
+        if (stat_buffer.st_size == 0) {
+                (void)close(fd);
+
+                return buffer_new(0);
+        }
+
+        void * const data =
+            mmap(NULL, stat_buffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        (void)close(fd);
+
+        if (data == MAP_FAILED) {
+                return NULL;
+        }
+
+        return _buffer_alloc(data, stat_buffer.st_size, NULL, true);
+}
+#else
+buffer_t *
+buffer_file_map(const char *path)
+{
+        return buffer_file_read(path);
+}
+#endif /* !_WIN32 */
+
+buffer_t *
+buffer_slice_new(buffer_t *buffer, size_t offset, size_t size)
+{
+        assert(buffer != NULL);
+        assert(offset <= buffer->size);
+        assert(size <= (buffer->size - offset));
+
+        /* Slices of slices share the bytes of the buffer at the bottom */
+        buffer_t * const parent = (buffer->parent != NULL) ? buffer->parent : buffer;
+
+        return _buffer_alloc(&buffer->data[offset], size, buffer_ref(parent), false);
+}
+
+buffer_t *
+buffer_ref(buffer_t *buffer)
+{
+        assert(buffer != NULL);
+
+        buffer->ref_count++;
+
+        return buffer;
+}
+
+void
+buffer_unref(buffer_t *buffer)
+{
+        if (buffer == NULL) {
+                return;
+        }
+
+        assert(buffer->ref_count > 0);
+
+        buffer->ref_count--;
+
+        if (buffer->ref_count > 0) {
+                return;
+        }
+
+        if (buffer->parent != NULL) {
+                buffer_unref(buffer->parent);
+        } else if (buffer->mapped) {
+#if !defined(_WIN32)
+                (void)munmap(buffer->data, buffer->size);
+#endif /* !_WIN32 */
+        } else {
+                free(buffer->data);
+        }
+
+        free(buffer);
+}
@@ -0,0 +1,42 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "types.h"
+
+/* Bytes passed from one command to another without being copied. Buffers
+ * are reference counted, and every object holding one holds a reference.
+ *
+ * A slice shares the bytes of the buffer it was cut from, and holds a
+ * reference to it, so the bytes stay around for as long as any slice does.
+ * A buffer can also map a file, in which case its bytes are read-only */
+
+struct buffer {
+        uint32_t ref_count;
+
+        uint8_t *data;
+        size_t size;
+
+        /* Slices only */
+        buffer_t *parent;
+
+        bool mapped;
+};
+
+buffer_t *buffer_new(size_t size);
+/* Both return NULL if the file can't be read, and an empty buffer for an
+ * empty file. A mapped file that's
+ * truncated while it's mapped raises SIGBUS once the bytes past the end are
+ * touched, so a file that's used for longer than a command runs, like a
+ * transfer in the background, has to be read */
+buffer_t *buffer_file_read(const char *path);
+buffer_t *buffer_file_map(const char *path);
+buffer_t *buffer_slice_new(buffer_t *buffer, size_t offset, size_t size);
+
+buffer_t *buffer_ref(buffer_t *buffer);
+void buffer_unref(buffer_t *buffer);
+
+#endif /* BUFFER_H */
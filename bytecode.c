@@ -0,0 +1,495 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bytecode.h"
+#include "commands.h"
+#include "env.h"
+#include "parser.h"
+
+#define BYTECODE_MAGIC   "SSBC"
+#define BYTECODE_VERSION 1
+
+/* The file is the header, then the operations, the objects, and the
+ * strings. Everything is in host byte order, as it's only ever read back on
+ * the machine that wrote it */
+typedef struct {
+        char magic[4];
+        uint32_t version;
+        uint64_t hash;
+        uint32_t op_count;
+        uint32_t object_count;
+        uint32_t strings_size;
+} bytecode_header_t;
+
+typedef struct {
+        uint32_t name_offset;
+        uint32_t arg_index;
+        uint32_t argc;
+} bytecode_file_op_t;
+
+static uint32_t _string_add(bytecode_t *bytecode, const char *string);
+static bool _bytecode_read(bytecode_t *bytecode, FILE *fp);
+
+/* FNV-1a */
+uint64_t
+bytecode_hash(const void *data, size_t size)
+{
+        const uint8_t *p;
+        p = data;
+
+        uint64_t hash;
+        hash = UINT64_C(0xCBF29CE484222325);
+
+        for (size_t i = 0; i < size; i++) {
+                hash = (hash ^ p[i]) * UINT64_C(0x00000100000001B3);
+        }
+
+        return hash;
+}
+
+bytecode_t *
+bytecode_new(uint64_t hash)
+{
+        bytecode_t * const bytecode = calloc(1, sizeof(bytecode_t));
+        assert(bytecode != NULL);
+
+        bytecode->hash = hash;
+
+        return bytecode;
+}
+
+void
+bytecode_delete(bytecode_t *bytecode)
+{
+        if (bytecode == NULL) {
+                return;
+        }
+
+        free(bytecode->ops);
+        free(bytecode->serialized_objects);
+        free(bytecode->strings);
+        free(bytecode->string_slots);
+        free(bytecode->objects);
+
+        free(bytecode);
+}
+
+void
+bytecode_op_add(bytecode_t *bytecode, const command_t *command,
+    object_t * const *args_obj, uint32_t argc)
+{
+        assert(bytecode != NULL);
+        assert(command != NULL);
+
+        if (bytecode->op_count == bytecode->op_capacity) {
+                bytecode->op_capacity = (bytecode->op_capacity == 0) ? 64 : (bytecode->op_capacity * 2);
+                bytecode->ops = realloc(bytecode->ops,
+                    bytecode->op_capacity * sizeof(bytecode_op_t));
+                assert(bytecode->ops != NULL);
+        }
+
+        if ((bytecode->object_count + argc) > bytecode->object_capacity) {
+                while ((bytecode->object_count + argc) > bytecode->object_capacity) {
+                        bytecode->object_capacity = (bytecode->object_capacity == 0) ?
+                            256 : (bytecode->object_capacity * 2);
+                }
+
+                bytecode->serialized_objects = realloc(bytecode->serialized_objects,
+                    bytecode->object_capacity * sizeof(bytecode_object_t));
+                assert(bytecode->serialized_objects != NULL);
+        }
+
+        bytecode_op_t * const op = &bytecode->ops[bytecode->op_count];
+
+        op->command = command;
+        op->name_offset = _string_add(bytecode, command->name);
+        op->arg_index = bytecode->object_count;
+        op->argc = argc;
+
+        bytecode->op_count++;
+
+        for (uint32_t i = 0; i < argc; i++) {
+                const object_t * const object = args_obj[i];
+
+                bytecode_object_t * const serialized_object =
+                    &bytecode->serialized_objects[bytecode->object_count];
+
+                serialized_object->type = object->type;
+
+                switch (object->type) {
+                case OBJECT_TYPE_SYMBOL:
+                        serialized_object->value = _string_add(bytecode, object->as.symbol);
+                        break;
+                case OBJECT_TYPE_STRING:
+                        serialized_object->value = _string_add(bytecode, object->as.string);
+                        break;
+                case OBJECT_TYPE_INTEGER:
+                        serialized_object->value = (uint32_t)object->as.integer;
+                        break;
+                default:
+                        assert(false);
+                }
+
+                bytecode->object_count++;
+        }
+}
+
+void
+bytecode_link(bytecode_t *bytecode)
+{
+        assert(bytecode != NULL);
+
+        free(bytecode->objects);
+
+        bytecode->objects = malloc((bytecode->object_count + 1) * sizeof(object_t));
+        assert(bytecode->objects != NULL);
+
+        for (uint32_t i = 0; i < bytecode->object_count; i++) {
+                const bytecode_object_t * const serialized_object =
+                    &bytecode->serialized_objects[i];
+
+                object_t * const object = &bytecode->objects[i];
+
+                object->type = serialized_object->type;
+
+                switch (object->type) {
+                case OBJECT_TYPE_SYMBOL:
+                        /* As the parser does */
+                        object->as.symbol = (char *)env_intern(&bytecode->strings[serialized_object->value]);
+                        break;
+                case OBJECT_TYPE_STRING:
+                        object->as.string = &bytecode->strings[serialized_object->value];
+                        break;
+                default:
+                        object->as.integer = (int)serialized_object->value;
+                        break;
+                }
+        }
+}
+
+bytecode_t *
+bytecode_load(const char *path, uint64_t hash)
+{
+        assert(path != NULL);
+
+        FILE * const fp = fopen(path, "rb");
+
+        if (fp == NULL) {
+                return NULL;
+        }
+
+        bytecode_t * const bytecode = bytecode_new(hash);
+
+        const bool read = _bytecode_read(bytecode, fp);
+
+        (void)fclose(fp);
+
+        if (!read) {
+                bytecode_delete(bytecode);
+
+                return NULL;
+        }
+
+        bytecode_link(bytecode);
+
+        return bytecode;
+}
+
+bool
+bytecode_save(const bytecode_t *bytecode, const char *path)
+{
+        assert(bytecode != NULL);
+        assert(path != NULL);
+
+        /* Written to the side first, so that a script that's run twice at
+         * once never sees half a file. Each run has a file of its own to
+         * write to */
+        const size_t tmp_path_size = strlen(path) + sizeof(".XXXXXX");
+        char * const tmp_path = malloc(tmp_path_size);
+        assert(tmp_path != NULL);
+
+        (void)snprintf(tmp_path, tmp_path_size, "%s.XXXXXX", path);
+
+        const int fd = mkstemp(tmp_path);
+
+        if (fd < 0) {
+                free(tmp_path);
+
+                return false;
+        }
+
+        FILE * const fp = fdopen(fd, "wb");
+
+        if (fp == NULL) {
+                (void)close(fd);
+                (void)remove(tmp_path);
+                free(tmp_path);
+
+                return false;
+        }
+
+        const bytecode_header_t header = {
+                .magic        = BYTECODE_MAGIC,
+                .version      = BYTECODE_VERSION,
+                .hash         = bytecode->hash,
+                .op_count     = bytecode->op_count,
+                .object_count = bytecode->object_count,
+                .strings_size = bytecode->strings_size
+        };
+
+        bool written;
+        written = ((fwrite(&header, sizeof(header), 1, fp)) == 1);
+
+        for (uint32_t i = 0; written && (i < bytecode->op_count); i++) {
+                const bytecode_op_t * const op = &bytecode->ops[i];
+
+                const bytecode_file_op_t file_op = {
+                        .name_offset = op->name_offset,
+                        .arg_index   = op->arg_index,
+                        .argc        = op->argc
+                };
+
+                written = ((fwrite(&file_op, sizeof(file_op), 1, fp)) == 1);
+        }
+
+        if (written && (bytecode->object_count > 0)) {
+                written = ((fwrite(bytecode->serialized_objects,
+                                sizeof(bytecode_object_t),
+                                bytecode->object_count, fp)) == bytecode->object_count);
+        }
+
+        if (written && (bytecode->strings_size > 0)) {
+                written = ((fwrite(bytecode->strings, bytecode->strings_size, 1, fp)) == 1);
+        }
+
+        written = ((fclose(fp)) == 0) && written;
+
+        if (written) {
+                written = ((rename(tmp_path, path)) == 0);
+        }
+
+        if (!written) {
+                (void)remove(tmp_path);
+        }
+
+        free(tmp_path);
+
+        return written;
+}
+
+static uint32_t
+_string_hash(const char *string)
+{
+        return (uint32_t)bytecode_hash(string, strlen(string));
+}
+
+static void
+_string_slots_grow(bytecode_t *bytecode)
+{
+        const uint32_t slot_count = (bytecode->string_slots == NULL) ?
+            256 : ((bytecode->string_slot_mask + 1) * 2);
+
+        uint32_t * const slots = calloc(slot_count, sizeof(uint32_t));
+        assert(slots != NULL);
+
+        if (bytecode->string_slots != NULL) {
+                for (uint32_t i = 0; i <= bytecode->string_slot_mask; i++) {
+                        const uint32_t slot_value = bytecode->string_slots[i];
+
+                        if (slot_value == 0) {
+                                continue;
+                        }
+
+                        uint32_t slot;
+                        slot = _string_hash(&bytecode->strings[slot_value - 1]) & (slot_count - 1);
+
+                        while (slots[slot] != 0) {
+                                slot = (slot + 1) & (slot_count - 1);
+                        }
+
+                        slots[slot] = slot_value;
+                }
+
+                free(bytecode->string_slots);
+        }
+
+        bytecode->string_slots = slots;
+        bytecode->string_slot_mask = slot_count - 1;
+}
+
+static uint32_t
+_string_add(bytecode_t *bytecode, const char *string)
+{
+        if ((bytecode->string_slots == NULL) ||
+            (((bytecode->string_count + 1) * 2) > (bytecode->string_slot_mask + 1))) {
+                _string_slots_grow(bytecode);
+        }
+
+        uint32_t slot;
+        slot = _string_hash(string) & bytecode->string_slot_mask;
+
+        for (; bytecode->string_slots[slot] != 0; slot = (slot + 1) & bytecode->string_slot_mask) {
+                const uint32_t offset = bytecode->string_slots[slot] - 1;
+
+                if ((strcmp(&bytecode->strings[offset], string)) == 0) {
+                        return offset;
+                }
+        }
+
+        const uint32_t size = strlen(string) + 1;
+
+        if ((bytecode->strings_size + size) > bytecode->strings_capacity) {
+                while ((bytecode->strings_size + size) > bytecode->strings_capacity) {
+                        bytecode->strings_capacity = (bytecode->strings_capacity == 0) ?
+                            4096 : (bytecode->strings_capacity * 2);
+                }
+
+                bytecode->strings = realloc(bytecode->strings, bytecode->strings_capacity);
+                assert(bytecode->strings != NULL);
+        }
+
+        const uint32_t offset = bytecode->strings_size;
+
+        (void)memcpy(&bytecode->strings[offset], string, size);
+
+        bytecode->strings_size += size;
+
+        bytecode->string_slots[slot] = offset + 1;
+        bytecode->string_count++;
+
+        return offset;
+}
+
+static bool
+_bytecode_string_valid(const bytecode_t *bytecode, uint32_t offset)
+{
+        /* The strings end with a NUL, so any offset into them is a string */
+        return (offset < bytecode->strings_size);
+}
+
+static bool
+_bytecode_read(bytecode_t *bytecode, FILE *fp)
+{
+        bytecode_header_t header;
+
+        if ((fread(&header, sizeof(header), 1, fp)) != 1) {
+                return false;
+        }
+
+        if (((memcmp(header.magic, BYTECODE_MAGIC, sizeof(header.magic))) != 0) ||
+            (header.version != BYTECODE_VERSION) ||
+            (header.hash != bytecode->hash)) {
+                return false;
+        }
+
+        /* The counts have to add up to exactly what's left of the file,
+         * before anything is allocated from them */
+        const long start = ftell(fp);
+
+        if ((start < 0) || ((fseek(fp, 0, SEEK_END)) != 0)) {
+                return false;
+        }
+
+        const long end = ftell(fp);
+
+        if ((end < start) || ((fseek(fp, start, SEEK_SET)) != 0)) {
+                return false;
+        }
+
+        const uint64_t expected_size =
+            ((uint64_t)header.op_count * sizeof(bytecode_file_op_t)) +
+            ((uint64_t)header.object_count * sizeof(bytecode_object_t)) +
+            (uint64_t)header.strings_size;
+
+        if (expected_size != (uint64_t)(end - start)) {
+                return false;
+        }
+
+        bytecode->op_count = header.op_count;
+        bytecode->op_capacity = header.op_count;
+        bytecode->object_count = header.object_count;
+        bytecode->object_capacity = header.object_count;
+        bytecode->strings_size = header.strings_size;
+        bytecode->strings_capacity = header.strings_size;
+
+        bytecode->ops = malloc(((size_t)header.op_count + 1) * sizeof(bytecode_op_t));
+        bytecode->serialized_objects =
+            malloc(((size_t)header.object_count + 1) * sizeof(bytecode_object_t));
+        bytecode->strings = malloc((size_t)header.strings_size + 1);
+
+        if ((bytecode->ops == NULL) ||
+            (bytecode->serialized_objects == NULL) ||
+            (bytecode->strings == NULL)) {
+                return false;
+        }
+
+        for (uint32_t i = 0; i < header.op_count; i++) {
+                bytecode_file_op_t file_op;
+
+                if ((fread(&file_op, sizeof(file_op), 1, fp)) != 1) {
+                        return false;
+                }
+
+                bytecode_op_t * const op = &bytecode->ops[i];
+
+                op->name_offset = file_op.name_offset;
+                op->arg_index = file_op.arg_index;
+                op->argc = file_op.argc;
+        }
+
+        if ((fread(bytecode->serialized_objects, sizeof(bytecode_object_t),
+                    header.object_count, fp)) != header.object_count) {
+                return false;
+        }
+
+        if ((fread(bytecode->strings, 1, header.strings_size, fp)) != header.strings_size) {
+                return false;
+        }
+
+        if ((header.strings_size > 0) &&
+            (bytecode->strings[header.strings_size - 1] != '\0')) {
+                return false;
+        }
+
+        for (uint32_t i = 0; i < header.object_count; i++) {
+                const bytecode_object_t * const object = &bytecode->serialized_objects[i];
+
+                switch (object->type) {
+                case OBJECT_TYPE_SYMBOL:
+                case OBJECT_TYPE_STRING:
+                        if (!(_bytecode_string_valid(bytecode, object->value))) {
+                                return false;
+                        }
+                        break;
+                case OBJECT_TYPE_INTEGER:
+                        break;
+                default:
+                        return false;
+                }
+        }
+
+        for (uint32_t i = 0; i < header.op_count; i++) {
+                bytecode_op_t * const op = &bytecode->ops[i];
+
+                if ((op->argc > COMMANDS_ARGS_MAX) ||
+                    (op->arg_index > header.object_count) ||
+                    (op->argc > (header.object_count - op->arg_index))) {
+                        return false;
+                }
+
+                if (!(_bytecode_string_valid(bytecode, op->name_offset))) {
+                        return false;
+                }
+
+                /* A command that's since been renamed or removed makes the
+                 * whole thing stale */
+                if ((op->command = commands_find(&bytecode->strings[op->name_offset])) == NULL) {
+                        return false;
+                }
+        }
+
+        return true;
+}
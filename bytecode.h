@@ -0,0 +1,75 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "object.h"
+
+/* A script compiled down to the commands it runs and their arguments, so
+ * that running it again doesn't lex or parse anything.
+ *
+ * Only what the parser produces is kept, so the bytecode can be written out
+ * and read back in. Commands are stored by name and looked up again when the
+ * bytecode is loaded. Once linked, every operation has its command and
+ * ready-made argument objects */
+
+typedef struct {
+        const command_t *command;
+        /* Offset of the command's name in the strings */
+        uint32_t name_offset;
+
+        /* Index of the first argument in objects[] */
+        uint32_t arg_index;
+        uint32_t argc;
+} bytecode_op_t;
+
+typedef struct {
+        /* Any of OBJECT_TYPE_SYMBOL, OBJECT_TYPE_STRING, OBJECT_TYPE_INTEGER.
+         * For the first two, the value is an offset into the strings */
+        uint32_t type;
+        uint32_t value;
+} bytecode_object_t;
+
+typedef struct {
+        /* Of the source the bytecode was compiled from */
+        uint64_t hash;
+
+        bytecode_op_t *ops;
+        uint32_t op_count;
+        uint32_t op_capacity;
+
+        bytecode_object_t *serialized_objects;
+        uint32_t object_count;
+        uint32_t object_capacity;
+
+        char *strings;
+        uint32_t strings_size;
+        uint32_t strings_capacity;
+
+        /* While compiling, every string is only stored once. Slots hold an
+         * offset plus one, zero being empty */
+        uint32_t *string_slots;
+        uint32_t string_slot_mask;
+        uint32_t string_count;
+
+        /* Filled in by bytecode_link() */
+        object_t *objects;
+} bytecode_t;
+
+uint64_t bytecode_hash(const void *data, size_t size);
+
+bytecode_t *bytecode_new(uint64_t hash);
+void bytecode_delete(bytecode_t *bytecode);
+
+void bytecode_op_add(bytecode_t *bytecode, const command_t *command,
+    object_t * const *args_obj, uint32_t argc);
+void bytecode_link(bytecode_t *bytecode);
+
+/* Returns NULL if there is no bytecode at the path, or it's stale */
+bytecode_t *bytecode_load(const char *path, uint64_t hash);
+bool bytecode_save(const bytecode_t *bytecode, const char *path);
+
+#endif /* BYTECODE_H */
@@ -4,19 +4,25 @@
 #include <stdarg.h>
 #include <stdlib.h>
 
+#include "buffer.h"
 #include "env.h"
 #include "commands.h"
+#include "symbols.h"
 
-extern const command_t command_help;
-extern const command_t command_quit;
-extern const command_t command_clear;
-extern const command_t command_dseld;
-extern const command_t command_upload;
-extern const command_t command_download;
-extern const command_t command_xxd;
-extern const command_t command_exec;
-extern const command_t command_echo;
-extern const command_t command_env;
+typedef struct {
+        const char *name;
+        const object_t object;
+} commands_entry_t;
+
+/* Declares every command, and _commands_table[] */
+#include "commands-table.h"
+
+static struct {
+        bool failed;
+
+        object_t value;
+        bool has_value;
+} _state;
 
 static const char *_command_status_convert(commands_status_t status);
 
@@ -29,72 +35,85 @@ const command_t *commands[SHELL_COMMAND_COUNT] = {
         &command_exec,
         &command_upload,
         &command_download,
+        &command_slice,
+        &command_compare,
         &command_xxd,
+        &command_dev,
+        &command_jobs,
+        &command_wait,
+        &command_kill,
+        &command_log,
+        &command_serve,
+        &command_call,
+        &command_batch,
+        &command_bench_run,
+        &command_fuzz,
+        &command_coverage,
+        &command_gdbserver,
+        &command_disasm,
+        &command_symbols,
+        &command_print,
+        &command_set,
+        &command_repeat,
+        &command_for,
+        &command_defmacro,
         &command_quit,
         NULL
 };
 
+static void
+_object_buffer_destructor(object_t *object)
+{
+        buffer_unref(object->as.buffer);
+}
+
 void
 commands_init(void)
 {
-        const command_t **command;
-        command = &commands[0];
-
-        while (*command != NULL) {
-                object_t * const command_obj = object_new(OBJECT_TYPE_COMMAND);
-
-                command_obj->as.command = *command;
-
-                env_put((*command)->name, command_obj);
-
-                const char * const alias = (*command)->alias;
+        object_destructor_set(OBJECT_TYPE_COMMAND, NULL);
+        object_destructor_set(OBJECT_TYPE_BUFFER, _object_buffer_destructor);
+}
 
-                if ((alias != NULL) && (*alias != '\0')) {
-                        env_put(alias, command_obj);
-                }
+static uint32_t
+_commands_hash(const char *name)
+{
+        /* FNV-1a, seeded to match tools/commands-table.py */
+        uint32_t hash;
+        hash = 0x811C9DC5 ^ COMMANDS_HASH_SEED;
 
-                command++;
+        for (; *name != '\0'; name++) {
+                hash = (hash ^ (uint8_t)*name) * 0x01000193;
         }
 
-        object_destructor_set(OBJECT_TYPE_COMMAND, NULL);
+        return hash;
 }
 
-void
-commands_deinit(void)
+const object_t *
+commands_object_find(const char *name)
 {
-        const command_t **command;
-        command = &commands[0];
-
-        while (*command != NULL) {
-                env_pair_t pair;
-
-                if (env_get((*command)->name, &pair)) {
-                        object_t * const command_obj = pair.value;
+        assert(name != NULL);
 
-                        object_delete(command_obj);
-                }
+        /* The hash is perfect, so there is only one slot to look at */
+        const commands_entry_t * const entry =
+            &_commands_table[_commands_hash(name) & (COMMANDS_HASH_SIZE - 1)];
 
-                command++;
+        if ((entry->name == NULL) || ((strcmp(entry->name, name)) != 0)) {
+                return NULL;
         }
+
+        return &entry->object;
 }
 
 const command_t *
 commands_find(const char *name)
 {
-        assert(name != NULL);
-
-        const command_t **command;
-        command = &commands[0];
-
-        while (*command != NULL) {
-                if ((strcmp(name, (*command)->name)) == 0) {
-                        return *command;
-                }
+        const object_t * const command_obj = commands_object_find(name);
 
-                command++;
+        if (command_obj == NULL) {
+                return NULL;
         }
 
-        return NULL;
+        return command_obj->as.command;
 }
 
 void
@@ -110,9 +129,100 @@ commands_printf(const char *format, ...)
 void
 commands_status_set(commands_status_t status)
 {
+        _state.failed = true;
+
         (void)printf("%s\n", _command_status_convert(status));
 }
 
+void
+commands_status_clear(void)
+{
+        _state.failed = false;
+
+        if (_state.has_value) {
+                eval_value_release(&_state.value);
+
+                _state.has_value = false;
+        }
+}
+
+bool
+commands_status_failed(void)
+{
+        return _state.failed;
+}
+
+void
+commands_value_set(const object_t *value)
+{
+        assert(value != NULL);
+
+        if (_state.has_value) {
+                eval_value_release(&_state.value);
+        }
+
+        _state.value = *value;
+        _state.has_value = true;
+}
+
+bool
+commands_value_take(object_t *value)
+{
+        assert(value != NULL);
+
+        if (!_state.has_value) {
+                return false;
+        }
+
+        *value = _state.value;
+        _state.has_value = false;
+
+        return true;
+}
+
+bool
+commands_address_get(const object_t *object, uint32_t *address)
+{
+        assert(object != NULL);
+        assert(address != NULL);
+
+        if (object->type == OBJECT_TYPE_INTEGER) {
+                *address = object->as.integer;
+
+                return true;
+        }
+
+        if (object->type != OBJECT_TYPE_SYMBOL) {
+                commands_status_set(COMMANDS_STATUS_EXPECTED_INTEGER);
+
+                return false;
+        }
+
+        const char * const name = object->as.symbol;
+        const symbols_t * const symbols = symbols_loaded_get();
+
+        const symbol_t *symbol;
+
+        if ((symbols != NULL) && ((symbol = symbols_name_find(symbols, name)) != NULL)) {
+                *address = symbol->address;
+
+                return true;
+        }
+
+        /* Then variables, like *hwram* */
+        const object_t * const value_obj = env_interned_value_get(name);
+
+        if ((value_obj != NULL) && (value_obj->type == OBJECT_TYPE_INTEGER)) {
+                *address = value_obj->as.integer;
+
+                return true;
+        }
+
+        commands_status_set(COMMANDS_STATUS_UNDEFINED_SYMBOL);
+
+        return false;
+}
+
 static const char *
 _command_status_convert(commands_status_t status)
 {
@@ -123,6 +233,12 @@ _command_status_convert(commands_status_t status)
                 return "Invalid type. Expected type String";
         case COMMANDS_STATUS_EXPECTED_INTEGER:
                 return "Invalid type. Expected type Integer";
+        case COMMANDS_STATUS_EXPECTED_BUFFER:
+                return "Invalid type. Expected type Buffer";
+        case COMMANDS_STATUS_UNDEFINED_SYMBOL:
+                return "Undefined symbol";
+        case COMMANDS_STATUS_DIVISION_BY_ZERO:
+                return "Division by zero";
         case COMMANDS_STATUS_ARGC_MISMATCH:
                 return "Mismatch in argument count";
         case COMMANDS_STATUS_INSUFFICIENT_MEMORY:
@@ -1,11 +1,13 @@
 #ifndef COMMANDS_H
 #define COMMANDS_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "object.h"
 #include "shell.h"
 #include "parser.h"
+#include "eval.h"
 
 #define SHELL_COMMAND_COUNT 256
 
@@ -16,6 +18,13 @@
 
 typedef void (*command_func_t)(const parser_t *parser);
 
+/* Takes the form as it was parsed, with its arguments unevaluated */
+typedef eval_ret_t (*command_form_func_t)(const parser_t *parser, const ast_node_t *form);
+
+/* Takes the same arguments as func, and returns a job that runs them in the
+ * background. Returns NULL with the status set on failure */
+typedef job_t *(*command_job_func_t)(const parser_t *parser);
+
 struct command {
         char *name;
         char *alias;
@@ -23,6 +32,10 @@ struct command {
         char *help;
 
         command_func_t func;
+        /* Called instead of func if set */
+        command_form_func_t form_func;
+        /* Set if the command can run in the background */
+        command_job_func_t job_func;
         int arg_count;
 };
 
@@ -35,6 +48,9 @@ typedef enum {
         COMMANDS_STATUS_EXPECTED_SYMBOL,
         COMMANDS_STATUS_EXPECTED_STRING,
         COMMANDS_STATUS_EXPECTED_INTEGER,
+        COMMANDS_STATUS_EXPECTED_BUFFER,
+        COMMANDS_STATUS_UNDEFINED_SYMBOL,
+        COMMANDS_STATUS_DIVISION_BY_ZERO,
 
         COMMANDS_STATUS_ARGC_MISMATCH,
 
@@ -48,13 +64,31 @@ typedef enum {
 } commands_status_t;
 
 void commands_init(void);
-void commands_deinit(void);
 
+/* Names and aliases both find their command */
 const command_t *commands_find(const char *name);
+const object_t *commands_object_find(const char *name);
 
 void commands_printf(const char *format, ...);
 void commands_status_set(commands_status_t status);
 
+/* Whether a status has been set since it was last cleared, i.e. whether
+ * the command that just ran failed */
+void commands_status_clear(void);
+bool commands_status_failed(void);
+
+/* A command used as an argument, like (download *hwram* 0x100), gives its
+ * result back with this. A buffer's reference is handed over with it.
+ * Clearing the status drops a result that was never taken */
+void commands_value_set(const object_t *value);
+/* Returns false if the command gave nothing back. The value is the
+ * caller's to release with eval_value_release() */
+bool commands_value_take(object_t *value);
+
+/* An address is either an integer or the name of a symbol. On failure, the
+ * status has already been set */
+bool commands_address_get(const object_t *object, uint32_t *address);
+
 extern const command_t *commands[SHELL_COMMAND_COUNT];
 
 #endif /* COMMANDS_H */
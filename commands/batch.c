@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "rpc.h"
+
+static rpc_batch_t *_queue = NULL;
+
+static void
+_batch_list(void)
+{
+        for (uint32_t i = 0; i < _queue->count; i++) {
+                const rpc_call_t * const call = &_queue->calls[i];
+
+                commands_printf("%4u 0x%08X", i, call->address);
+
+                for (uint32_t j = 0; j < call->argc; j++) {
+                        if ((call->block_mask & (1 << j)) != 0) {
+                                commands_printf(" <block+0x%X>", call->args[j]);
+                        } else {
+                                commands_printf(" 0x%X", call->args[j]);
+                        }
+                }
+
+                commands_printf("\n");
+        }
+}
+
+static void
+_batch_run(void)
+{
+        const rpc_ret_t ret = rpc_batch_run(_queue, RPC_TIMEOUT_DEFAULT);
+
+        if (ret != RPC_RET_OK) {
+                commands_printf("%s\n", rpc_ret_string(ret));
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        for (uint32_t i = 0; i < _queue->count; i++) {
+                const rpc_call_t * const call = &_queue->calls[i];
+
+                commands_printf("%4u 0x%08X -> 0x%08X (%i)\n",
+                    i,
+                    call->address,
+                    (uint32_t)call->result,
+                    call->result);
+        }
+
+        rpc_batch_clear(_queue);
+}
+
+static void
+_batch(const parser_t *parser)
+{
+        object_t * const * const args_obj = parser->stream->args_obj;
+        const int argc = parser->stream->argc;
+
+        if (_queue == NULL) {
+                if ((_queue = rpc_batch_new()) == NULL) {
+                        commands_status_return(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+                }
+        }
+
+        if (argc == 0) {
+                _batch_list();
+
+                return;
+        }
+
+        if (args_obj[0]->type != OBJECT_TYPE_SYMBOL) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_SYMBOL);
+        }
+
+        const char * const action = args_obj[0]->as.symbol;
+
+        if ((strcmp(action, "add")) == 0) {
+                const rpc_ret_t ret = rpc_batch_objects_add(_queue, &args_obj[1], argc - 1);
+
+                if (ret != RPC_RET_OK) {
+                        commands_printf("%s\n", rpc_ret_string(ret));
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+        } else if ((strcmp(action, "run")) == 0) {
+                _batch_run();
+        } else if ((strcmp(action, "clear")) == 0) {
+                rpc_batch_clear(_queue);
+        } else {
+                commands_printf("Unknown action \"%s\"\n", action);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+}
+
+const command_t command_batch = {
+        .name        = "batch",
+        .description = "Queue calls to the target and run them in one go",
+        .help        = "[add <address:int> [arg:int|str|buf ...] | run | clear]",
+        .func        = _batch,
+        .arg_count   = -1
+};
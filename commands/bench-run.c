@@ -0,0 +1,862 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "device.h"
+#include "elf.h"
+#include "rpc.h"
+#include "symbols.h"
+#include "timer.h"
+
+/*
+ * The manifest is a text file, one directive per line. Everything after a '#'
+ * is a comment, and arguments with spaces can be double-quoted:
+ *
+ *   results <address>                 Where each benchmark writes its results
+ *   stub <address>                    Call benchmarks through the stub at this
+ *                                     mailbox instead of executing them
+ *   runs <count>                      Number of runs of each benchmark
+ *   timeout <ms>                      How long a single run may take
+ *   format csv|json
+ *   bench <name> <path> <load-address> [entry-address]
+ *
+ * Paths are relative to the manifest.
+ *
+ * With a stub, only the blocks of a binary that changed since its last upload
+ * go over, and its entry point is called as a function that returns when it's
+ * done. Without one, the binary is executed, which uploads all of it every
+ * run.
+ *
+ * Layout of the results block in target RAM (all fields big-endian):
+ *
+ *   0x00 uint32_t magic         BENCH_MAGIC
+ *   0x04 uint32_t done          Non-zero once the run is over. Cleared by the
+ *                               host before each run
+ *   0x08 uint32_t count         Number of timings
+ *   0x0C uint32_t reserved
+ *   0x10 struct {
+ *           char     name[12]   Not necessarily terminated
+ *           uint32_t value
+ *        } timings[16]
+ *
+ * Timings are collected over all runs, and their minimum, median, and 95th
+ * percentile are reported */
+
+#define BENCH_MAGIC                     0x424E4348 /* "BNCH" */
+
+#define BENCH_HEADER_SIZE               0x10
+#define BENCH_TIMING_SIZE               0x10
+#define BENCH_TIMING_NAME_SIZE          12
+#define BENCH_TIMINGS_MAX               16
+#define BENCH_RESULTS_SIZE                                                     \
+        (BENCH_HEADER_SIZE + (BENCH_TIMINGS_MAX * BENCH_TIMING_SIZE))
+
+#define BENCH_RUNS_DEFAULT              10
+#define BENCH_RUNS_MAX                  10000
+#define BENCH_TIMEOUT_DEFAULT           10000
+
+#define BENCH_POLL_INTERVAL_MIN         (100)
+#define BENCH_POLL_INTERVAL_MAX         (10000)
+
+#define BENCH_LINE_MAX                  1024
+#define BENCH_TOKENS_MAX                8
+
+typedef enum {
+        BENCH_WAIT_OK,
+        BENCH_WAIT_TIMEOUT,
+        BENCH_WAIT_INTERRUPTED,
+        BENCH_WAIT_ERROR,
+} bench_wait_t;
+
+typedef struct {
+        char *name;
+        char *path;
+        uint32_t load_address;
+        uint32_t entry_address;
+
+        uint32_t timing_count;
+        char timing_names[BENCH_TIMINGS_MAX][BENCH_TIMING_NAME_SIZE + 1];
+        /* One row of BENCH_TIMINGS_MAX values per run */
+        uint32_t *values;
+        uint32_t run_count;
+
+        size_t uploaded_size;
+} bench_t;
+
+typedef struct {
+        bool results_set;
+        uint32_t results_address;
+        bool stub_set;
+        uint32_t stub_address;
+        uint32_t runs;
+        uint32_t timeout_ms;
+        bool json;
+
+        bench_t *benches;
+        uint32_t bench_count;
+} bench_manifest_t;
+
+static int
+_tokens_split(char *line, char **tokens)
+{
+        int count;
+        count = 0;
+
+        char *p;
+        p = line;
+
+        while (true) {
+                while (isspace((unsigned char)*p)) {
+                        p++;
+                }
+
+                if ((*p == '\0') || (*p == '#')) {
+                        break;
+                }
+
+                if (count == BENCH_TOKENS_MAX) {
+                        return -1;
+                }
+
+                if (*p == '"') {
+                        p++;
+                        tokens[count] = p;
+
+                        if ((p = strchr(p, '"')) == NULL) {
+                                return -1;
+                        }
+                } else {
+                        tokens[count] = p;
+
+                        while ((*p != '\0') && !isspace((unsigned char)*p)) {
+                                p++;
+                        }
+                }
+
+                count++;
+
+                if (*p == '\0') {
+                        break;
+                }
+
+                *p = '\0';
+                p++;
+        }
+
+        return count;
+}
+
+static bool
+_integer_parse(const char *s, uint32_t *value)
+{
+        char *end;
+
+        const unsigned long n = strtoul(s, &end, 0);
+
+        if ((end == s) || (*end != '\0')) {
+                return false;
+        }
+
+        *value = n;
+
+        return true;
+}
+
+static char *
+_path_resolve(const char *manifest_path, const char *path)
+{
+        const char * const slash = strrchr(manifest_path, '/');
+
+        if ((path[0] == '/') || (slash == NULL)) {
+                return strdup(path);
+        }
+
+        const size_t dir_len = (slash - manifest_path) + 1;
+        char * const resolved = malloc(dir_len + strlen(path) + 1);
+
+        if (resolved == NULL) {
+                return NULL;
+        }
+
+        (void)memcpy(resolved, manifest_path, dir_len);
+        (void)strcpy(&resolved[dir_len], path);
+
+        return resolved;
+}
+
+static void
+_manifest_free(bench_manifest_t *manifest)
+{
+        for (uint32_t i = 0; i < manifest->bench_count; i++) {
+                bench_t * const bench = &manifest->benches[i];
+
+                free(bench->name);
+                free(bench->path);
+                free(bench->values);
+        }
+
+        free(manifest->benches);
+}
+
+static bool
+_manifest_directive(bench_manifest_t *manifest, const char *manifest_path,
+    char **tokens, int count)
+{
+        const char * const directive = tokens[0];
+
+        if ((strcmp(directive, "results")) == 0) {
+                manifest->results_set = true;
+
+                return (count == 2) && _integer_parse(tokens[1], &manifest->results_address);
+        }
+
+        if ((strcmp(directive, "stub")) == 0) {
+                manifest->stub_set = true;
+
+                return (count == 2) && _integer_parse(tokens[1], &manifest->stub_address);
+        }
+
+        if ((strcmp(directive, "runs")) == 0) {
+                return (count == 2) && _integer_parse(tokens[1], &manifest->runs) &&
+                       (manifest->runs > 0) && (manifest->runs <= BENCH_RUNS_MAX);
+        }
+
+        if ((strcmp(directive, "timeout")) == 0) {
+                return (count == 2) && _integer_parse(tokens[1], &manifest->timeout_ms);
+        }
+
+        if ((strcmp(directive, "format")) == 0) {
+                if (count != 2) {
+                        return false;
+                }
+
+                manifest->json = ((strcmp(tokens[1], "json")) == 0);
+
+                return manifest->json || ((strcmp(tokens[1], "csv")) == 0);
+        }
+
+        if ((strcmp(directive, "bench")) == 0) {
+                if ((count != 4) && (count != 5)) {
+                        return false;
+                }
+
+                bench_t bench = {
+                        .name = NULL
+                };
+
+                if (!(_integer_parse(tokens[3], &bench.load_address))) {
+                        return false;
+                }
+
+                bench.entry_address = bench.load_address;
+
+                if ((count == 5) && !(_integer_parse(tokens[4], &bench.entry_address))) {
+                        return false;
+                }
+
+                bench_t * const benches = realloc(manifest->benches,
+                    (manifest->bench_count + 1) * sizeof(bench_t));
+
+                if (benches == NULL) {
+                        return false;
+                }
+
+                manifest->benches = benches;
+
+                bench.name = strdup(tokens[1]);
+                bench.path = _path_resolve(manifest_path, tokens[2]);
+
+                manifest->benches[manifest->bench_count] = bench;
+                manifest->bench_count++;
+
+                return (bench.name != NULL) && (bench.path != NULL);
+        }
+
+        return false;
+}
+
+static bool
+_manifest_load(bench_manifest_t *manifest, const char *path)
+{
+        *manifest = (bench_manifest_t) {
+                .runs       = BENCH_RUNS_DEFAULT,
+                .timeout_ms = BENCH_TIMEOUT_DEFAULT
+        };
+
+        FILE * const fp = fopen(path, "r");
+
+        if (fp == NULL) {
+                commands_printf("Unable to open \"%s\"\n", path);
+
+                return false;
+        }
+
+        char line[BENCH_LINE_MAX];
+
+        uint32_t line_number;
+        line_number = 0;
+
+        bool ok;
+        ok = true;
+
+        while (ok && ((fgets(line, sizeof(line), fp)) != NULL)) {
+                char *tokens[BENCH_TOKENS_MAX];
+
+                line_number++;
+
+                const int count = _tokens_split(line, tokens);
+
+                if (count == 0) {
+                        continue;
+                }
+
+                if ((count < 0) ||
+                    !(_manifest_directive(manifest, path, tokens, count))) {
+                        commands_printf("%s:%u: Invalid directive\n", path, line_number);
+
+                        ok = false;
+                }
+        }
+
+        (void)fclose(fp);
+
+        if (ok && !manifest->results_set) {
+                commands_printf("%s: No results address\n", path);
+
+                ok = false;
+        }
+
+        if (ok && (manifest->bench_count == 0)) {
+                commands_printf("%s: No benchmarks\n", path);
+
+                ok = false;
+        }
+
+        for (uint32_t i = 0; ok && (i < manifest->bench_count); i++) {
+                bench_t * const bench = &manifest->benches[i];
+
+                bench->values =
+                    malloc(manifest->runs * BENCH_TIMINGS_MAX * sizeof(uint32_t));
+
+                if (bench->values == NULL) {
+                        ok = false;
+                }
+        }
+
+        if (!ok) {
+                _manifest_free(manifest);
+        }
+
+        return ok;
+}
+
+static void *
+_file_load(const char *path, size_t *size)
+{
+        FILE * const fp = fopen(path, "rb");
+
+        if (fp == NULL) {
+                return NULL;
+        }
+
+        long file_size;
+
+        if (((fseek(fp, 0, SEEK_END)) != 0) || ((file_size = ftell(fp)) <= 0)) {
+                (void)fclose(fp);
+
+                return NULL;
+        }
+
+        rewind(fp);
+
+        uint8_t * const image = malloc(file_size);
+
+        if ((image == NULL) || ((fread(image, 1, file_size, fp)) != (size_t)file_size)) {
+                free(image);
+                (void)fclose(fp);
+
+                return NULL;
+        }
+
+        (void)fclose(fp);
+
+        *size = file_size;
+
+        return image;
+}
+
+static bench_wait_t
+_results_wait(const bench_manifest_t *manifest, uint8_t *results)
+{
+        const uint64_t start_time = timer_us_get();
+
+        uint32_t interval;
+        interval = BENCH_POLL_INTERVAL_MIN;
+
+        bench_wait_t ret;
+        ret = BENCH_WAIT_TIMEOUT;
+
+        shell_interrupt_begin();
+
+        /* The whole block comes back with every poll, so the last poll is
+         * also the download */
+        while (!(shell_interrupted())) {
+                if ((device_read(results, manifest->results_address, BENCH_RESULTS_SIZE)) != DEVICE_RET_OK) {
+                        ret = BENCH_WAIT_ERROR;
+                        break;
+                }
+
+                if ((device_be32_get(&results[0x04])) != 0) {
+                        ret = BENCH_WAIT_OK;
+                        break;
+                }
+
+                if ((timer_us_get() - start_time) >= ((uint64_t)manifest->timeout_ms * 1000)) {
+                        break;
+                }
+
+                timer_sleep(interval);
+
+                interval = (interval * 2);
+                interval = (interval < BENCH_POLL_INTERVAL_MAX) ? interval : BENCH_POLL_INTERVAL_MAX;
+        }
+
+        if ((ret == BENCH_WAIT_TIMEOUT) && (shell_interrupted())) {
+                ret = BENCH_WAIT_INTERRUPTED;
+        }
+
+        shell_interrupt_end();
+
+        return ret;
+}
+
+static bool
+_results_collect(bench_t *bench, const uint8_t *results)
+{
+        if ((device_be32_get(&results[0x00])) != BENCH_MAGIC) {
+                commands_printf("%s: No results block found\n", bench->name);
+
+                return false;
+        }
+
+        const uint32_t timing_count = device_be32_get(&results[0x08]);
+
+        if ((timing_count == 0) || (timing_count > BENCH_TIMINGS_MAX)) {
+                commands_printf("%s: Invalid number of timings (%u)\n", bench->name, timing_count);
+
+                return false;
+        }
+
+        /* Every run has to report the same timings as the first one */
+        if ((bench->run_count > 0) && (timing_count != bench->timing_count)) {
+                commands_printf("%s: Timings changed between runs\n", bench->name);
+
+                return false;
+        }
+
+        uint32_t * const values = &bench->values[bench->run_count * BENCH_TIMINGS_MAX];
+
+        for (uint32_t i = 0; i < timing_count; i++) {
+                const uint8_t * const timing = &results[BENCH_HEADER_SIZE + (i * BENCH_TIMING_SIZE)];
+
+                char name[BENCH_TIMING_NAME_SIZE + 1];
+
+                (void)memcpy(name, timing, BENCH_TIMING_NAME_SIZE);
+                name[BENCH_TIMING_NAME_SIZE] = '\0';
+
+                if (bench->run_count == 0) {
+                        (void)strcpy(bench->timing_names[i], name);
+                } else if ((strcmp(bench->timing_names[i], name)) != 0) {
+                        commands_printf("%s: Timings changed between runs\n", bench->name);
+
+                        return false;
+                }
+
+                values[i] = device_be32_get(&timing[BENCH_TIMING_NAME_SIZE]);
+        }
+
+        bench->timing_count = timing_count;
+        bench->run_count++;
+
+        return true;
+}
+
+/* Whether the loaded ELF file is the image, going by the bytes of every one
+ * of its sections that lands in it */
+static bool
+_image_elf_matches(const elf_t *elf, const bench_t *bench, const uint8_t *image,
+    size_t image_size)
+{
+        bool overlaps;
+        overlaps = false;
+
+        for (uint32_t i = 0; i < elf->loaded_count; i++) {
+                const elf_section_t * const section = elf->loaded[i];
+
+                if ((section->type != ELF_SHT_PROGBITS) ||
+                    (section->address < bench->load_address) ||
+                    ((section->address - bench->load_address) >= image_size)) {
+                        continue;
+                }
+
+                const size_t offset = section->address - bench->load_address;
+
+                if ((section->size > (image_size - offset)) ||
+                    ((memcmp(&image[offset], section->data, section->size)) != 0)) {
+                        return false;
+                }
+
+                overlaps = true;
+        }
+
+        return overlaps;
+}
+
+/* The program writes to its own .data and .bss as it runs, where the shadow
+ * can't see it. If the loaded ELF file is the image, it says where those
+ * are, and only they are uploaded again on the next run. Otherwise all of
+ * the image is */
+static void
+_image_written_invalidate(const bench_t *bench, const uint8_t *image,
+    size_t image_size)
+{
+        const symbols_t * const symbols = symbols_loaded_get();
+        const elf_t * const elf = (symbols != NULL) ? symbols->elf : NULL;
+
+        if ((elf == NULL) || !(_image_elf_matches(elf, bench, image, image_size))) {
+                device_shadow_invalidate(bench->load_address, image_size);
+
+                return;
+        }
+
+        for (uint32_t i = 0; i < elf->section_count; i++) {
+                const elf_section_t * const section = &elf->sections[i];
+
+                if (((section->flags & ELF_SHF_ALLOC) != 0) &&
+                    ((section->flags & ELF_SHF_WRITE) != 0)) {
+                        device_shadow_invalidate(section->address, section->size);
+                }
+        }
+}
+
+static bool
+_bench_run(const bench_manifest_t *manifest, rpc_batch_t *batch, bench_t *bench)
+{
+        size_t image_size;
+        image_size = 0;
+        uint8_t *image;
+        image = NULL;
+
+        if ((image = _file_load(bench->path, &image_size)) == NULL) {
+                commands_printf("Unable to load \"%s\"\n", bench->path);
+
+                return false;
+        }
+
+        if (batch != NULL) {
+                rpc_batch_clear(batch);
+                (void)rpc_batch_call_add(batch, bench->entry_address);
+        }
+
+        uint8_t results[BENCH_RESULTS_SIZE];
+
+        bool ok;
+        ok = false;
+
+        for (uint32_t run = 0; run < manifest->runs; run++) {
+                (void)memset(results, 0, BENCH_HEADER_SIZE);
+
+                if ((device_write(results, manifest->results_address, BENCH_HEADER_SIZE)) != DEVICE_RET_OK) {
+                        commands_printf("%s: Unable to clear results block\n", bench->name);
+                        goto exit;
+                }
+
+                if (batch != NULL) {
+                        size_t written_size;
+
+                        if ((device_write_delta(image, bench->load_address, image_size, &written_size)) != DEVICE_RET_OK) {
+                                commands_printf("%s: Unable to upload \"%s\"\n", bench->name, bench->path);
+                                goto exit;
+                        }
+
+                        bench->uploaded_size += written_size;
+
+                        const rpc_ret_t ret = rpc_batch_run(batch, manifest->timeout_ms);
+
+                        _image_written_invalidate(bench, image, image_size);
+
+                        if (ret != RPC_RET_OK) {
+                                commands_printf("%s: %s\n", bench->name, rpc_ret_string(ret));
+                                goto exit;
+                        }
+                } else {
+                        if ((device_file_execute(bench->path, bench->load_address)) != DEVICE_RET_OK) {
+                                commands_printf("%s: Unable to execute \"%s\"\n", bench->name, bench->path);
+                                goto exit;
+                        }
+
+                        bench->uploaded_size += image_size;
+                }
+
+                switch (_results_wait(manifest, results)) {
+                case BENCH_WAIT_OK:
+                        break;
+                case BENCH_WAIT_TIMEOUT:
+                        commands_printf("%s: Timed out on run %u\n", bench->name, run + 1);
+                        goto exit;
+                case BENCH_WAIT_INTERRUPTED:
+                        commands_printf("Interrupted\n");
+                        goto exit;
+                default:
+                        commands_printf("%s: Unable to read results block\n", bench->name);
+                        goto exit;
+                }
+
+                if (!(_results_collect(bench, results))) {
+                        goto exit;
+                }
+        }
+
+        ok = true;
+
+exit:
+        free(image);
+
+        return ok;
+}
+
+static int
+_value_compare(const void *a, const void *b)
+{
+        const uint32_t value_a = *(const uint32_t *)a;
+        const uint32_t value_b = *(const uint32_t *)b;
+
+        if (value_a < value_b) {
+                return -1;
+        }
+
+        return (value_a > value_b);
+}
+
+static void
+_stats_calc(const bench_t *bench, uint32_t timing, uint32_t *sorted,
+    uint32_t *min, uint32_t *median, uint32_t *p95)
+{
+        const uint32_t n = bench->run_count;
+
+        for (uint32_t run = 0; run < n; run++) {
+                sorted[run] = bench->values[(run * BENCH_TIMINGS_MAX) + timing];
+        }
+
+        qsort(sorted, n, sizeof(uint32_t), _value_compare);
+
+        *min = sorted[0];
+
+        if ((n & 1) != 0) {
+                *median = sorted[n / 2];
+        } else {
+                *median = ((uint64_t)sorted[(n / 2) - 1] + sorted[n / 2]) / 2;
+        }
+
+        /* Nearest rank */
+        *p95 = sorted[(((95 * n) + 99) / 100) - 1];
+}
+
+static void
+_json_string_write(FILE *fp, const char *s)
+{
+        (void)fputc('"', fp);
+
+        for (; *s != '\0'; s++) {
+                const unsigned char c = *s;
+
+                if ((c == '"') || (c == '\\')) {
+                        (void)fprintf(fp, "\\%c", c);
+                } else if (c < 0x20) {
+                        (void)fprintf(fp, "\\u%04X", c);
+                } else {
+                        (void)fputc(c, fp);
+                }
+        }
+
+        (void)fputc('"', fp);
+}
+
+static void
+_csv_string_write(FILE *fp, const char *s)
+{
+        if ((strpbrk(s, ",\"\r\n")) == NULL) {
+                (void)fputs(s, fp);
+
+                return;
+        }
+
+        (void)fputc('"', fp);
+
+        for (; *s != '\0'; s++) {
+                if (*s == '"') {
+                        (void)fputc('"', fp);
+                }
+
+                (void)fputc(*s, fp);
+        }
+
+        (void)fputc('"', fp);
+}
+
+static bool
+_report_write(const bench_manifest_t *manifest, FILE *fp)
+{
+        uint32_t * const sorted = malloc(manifest->runs * sizeof(uint32_t));
+
+        if (sorted == NULL) {
+                return false;
+        }
+
+        bool first;
+        first = true;
+
+        (void)fputs(manifest->json ? "[\n" : "bench,timing,runs,min,median,p95\n", fp);
+
+        for (uint32_t i = 0; i < manifest->bench_count; i++) {
+                const bench_t * const bench = &manifest->benches[i];
+
+                for (uint32_t timing = 0; timing < bench->timing_count; timing++) {
+                        uint32_t min;
+                        uint32_t median;
+                        uint32_t p95;
+
+                        _stats_calc(bench, timing, sorted, &min, &median, &p95);
+
+                        if (manifest->json) {
+                                (void)fputs(first ? "  {\"bench\": " : ",\n  {\"bench\": ", fp);
+                                _json_string_write(fp, bench->name);
+                                (void)fputs(", \"timing\": ", fp);
+                                _json_string_write(fp, bench->timing_names[timing]);
+                                (void)fprintf(fp, ", \"runs\": %u, \"min\": %u, \"median\": %u, \"p95\": %u}",
+                                    bench->run_count, min, median, p95);
+                        } else {
+                                _csv_string_write(fp, bench->name);
+                                (void)fputc(',', fp);
+                                _csv_string_write(fp, bench->timing_names[timing]);
+                                (void)fprintf(fp, ",%u,%u,%u,%u\n",
+                                    bench->run_count, min, median, p95);
+                        }
+
+                        first = false;
+                }
+        }
+
+        if (manifest->json) {
+                (void)fputs(first ? "]\n" : "\n]\n", fp);
+        }
+
+        free(sorted);
+
+        return true;
+}
+
+static void
+_bench_run_command(const parser_t *parser)
+{
+        object_t * const * const args_obj = parser->stream->args_obj;
+
+        const int argc = parser->stream->argc;
+
+        if ((argc != 1) && (argc != 2)) {
+                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+        }
+
+        for (int i = 0; i < argc; i++) {
+                if (args_obj[i]->type != OBJECT_TYPE_STRING) {
+                        commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+                }
+        }
+
+        bench_manifest_t manifest;
+
+        if (!(_manifest_load(&manifest, args_obj[0]->as.string))) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        rpc_batch_t *batch;
+        batch = NULL;
+
+        if (manifest.stub_set) {
+                const rpc_ret_t ret = rpc_attach(manifest.stub_address);
+
+                if (ret != RPC_RET_OK) {
+                        _manifest_free(&manifest);
+
+                        commands_printf("%s\n", rpc_ret_string(ret));
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+
+                if ((batch = rpc_batch_new()) == NULL) {
+                        _manifest_free(&manifest);
+
+                        commands_status_return(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+                }
+        }
+
+        bool ok;
+        ok = true;
+
+        for (uint32_t i = 0; ok && (i < manifest.bench_count); i++) {
+                bench_t * const bench = &manifest.benches[i];
+
+                ok = _bench_run(&manifest, batch, bench);
+
+                if (ok) {
+                        commands_printf("%s: %u runs, %zuB uploaded\n",
+                            bench->name,
+                            bench->run_count,
+                            bench->uploaded_size);
+                }
+        }
+
+        rpc_batch_delete(batch);
+
+        if (ok) {
+                FILE *fp;
+                fp = stdout;
+
+                if ((argc == 2) && ((fp = fopen(args_obj[1]->as.string, "w")) == NULL)) {
+                        commands_printf("Unable to open \"%s\"\n", args_obj[1]->as.string);
+
+                        ok = false;
+                }
+
+                if (ok) {
+                        ok = _report_write(&manifest, fp);
+
+                        if (fp != stdout) {
+                                (void)fclose(fp);
+                        }
+                }
+        }
+
+        _manifest_free(&manifest);
+
+        if (!ok) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+}
+
+const command_t command_bench_run = {
+        .name        = "bench-run",
+        .description = "Run benchmarks on the target and collect their timings",
+        .help        = "<manifest:str> [output:str]",
+        .func        = _bench_run_command,
+        .arg_count   = -1
+};
@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "rpc.h"
+
+static rpc_batch_t *_batch = NULL;
+
+static void
+_call_stub(const parser_t *parser)
+{
+        if (parser->stream->argc != 2) {
+                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+        }
+
+        const object_t * const address_obj = parser->stream->args_obj[1];
+
+        uint32_t address;
+
+        if (!(commands_address_get(address_obj, &address))) {
+                return;
+        }
+
+        const rpc_ret_t ret = rpc_attach(address);
+
+        if (ret != RPC_RET_OK) {
+                commands_printf("%s\n", rpc_ret_string(ret));
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+}
+
+static void
+_call(const parser_t *parser)
+{
+        object_t * const * const args_obj = parser->stream->args_obj;
+        const int argc = parser->stream->argc;
+
+        if (argc == 0) {
+                uint32_t mailbox_address;
+
+                if (rpc_attached(&mailbox_address)) {
+                        commands_printf("Stub mailbox at 0x%08X\n", mailbox_address);
+                } else {
+                        commands_printf("No stub attached\n");
+                }
+
+                return;
+        }
+
+        if ((args_obj[0]->type == OBJECT_TYPE_SYMBOL) &&
+            ((strcmp(args_obj[0]->as.symbol, "stub")) == 0)) {
+                _call_stub(parser);
+
+                return;
+        }
+
+        if (_batch == NULL) {
+                if ((_batch = rpc_batch_new()) == NULL) {
+                        commands_status_return(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+                }
+        }
+
+        rpc_batch_clear(_batch);
+
+        rpc_ret_t ret;
+
+        if ((ret = rpc_batch_objects_add(_batch, args_obj, argc)) == RPC_RET_OK) {
+                ret = rpc_batch_run(_batch, RPC_TIMEOUT_DEFAULT);
+        }
+
+        if (ret != RPC_RET_OK) {
+                commands_printf("%s\n", rpc_ret_string(ret));
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        const int32_t result = _batch->calls[0].result;
+
+        commands_printf("0x%08X (%i)\n", (uint32_t)result, result);
+}
+
+const command_t command_call = {
+        .name        = "call",
+        .description = "Call a function on the target through the resident stub",
+        .help        = "[<address:int|sym> [arg:int|str|buf|sym ...] | stub <mailbox-address:int|sym>]",
+        .func        = _call,
+        .arg_count   = -1
+};
@@ -0,0 +1,94 @@
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "types.h"
+#include "buffer.h"
+#include "commands.h"
+#include "parser.h"
+
+static void
+_compare_print(const buffer_t *a, const buffer_t *b)
+{
+        const size_t size = (a->size < b->size) ? a->size : b->size;
+
+        if ((a->size == b->size) && ((memcmp(a->data, b->data, size)) == 0)) {
+                commands_printf("Identical, %zuB\n", size);
+
+                return;
+        }
+
+        size_t first;
+        first = size;
+
+        size_t count;
+        count = 0;
+
+        for (size_t i = 0; i < size; i++) {
+                if (a->data[i] == b->data[i]) {
+                        continue;
+                }
+
+                if (count == 0) {
+                        first = i;
+                }
+
+                count++;
+        }
+
+        if (count > 0) {
+                commands_printf("First difference at 0x%08zX: 0x%02X and 0x%02X, %zuB differ\n",
+                    first,
+                    a->data[first],
+                    b->data[first],
+                    count);
+        }
+
+        if (a->size != b->size) {
+                commands_printf("Sizes differ: %zuB and %zuB\n", a->size, b->size);
+        }
+
+        commands_status_set(COMMANDS_STATUS_ERROR);
+}
+
+static void
+_compare(const parser_t *parser)
+{
+        const object_t * const a_obj = parser->stream->args_obj[0];
+        const object_t * const b_obj = parser->stream->args_obj[1];
+
+        if (a_obj->type != OBJECT_TYPE_BUFFER) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_BUFFER);
+        }
+
+        if (b_obj->type == OBJECT_TYPE_BUFFER) {
+                _compare_print(a_obj->as.buffer, b_obj->as.buffer);
+
+                return;
+        }
+
+        if (b_obj->type != OBJECT_TYPE_STRING) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+        }
+
+        /* The file is mapped rather than read */
+        buffer_t * const file_buffer = buffer_file_map(b_obj->as.string);
+
+        if (file_buffer == NULL) {
+                commands_status_return(COMMANDS_STATUS_FILE_NOT_FOUND);
+        }
+
+        _compare_print(a_obj->as.buffer, file_buffer);
+
+        buffer_unref(file_buffer);
+}
+
+const command_t command_compare = {
+        .name        = "compare",
+        .description = "Compares a buffer with another buffer or a file",
+        .help        = "<buffer:buf> <other:buf|str>",
+        .func        = _compare,
+        .arg_count   = 2
+};
@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "device.h"
+
+/*
+ * Layout of the coverage area in target RAM (all fields big-endian):
+ *
+ *   0x00 uint32_t magic         COVERAGE_MAGIC
+ *   0x04 uint32_t size          Size of the bitmap, a multiple of block_size
+ *   0x08 uint32_t block_size    A power of two, at least 64
+ *   0x0C uint32_t reserved
+ *   0x10 uint32_t dirty[]       One bit per block, MSB first, set by the
+ *                               target whenever it writes to the block.
+ *                               Cleared by the host
+ *   ...  uint8_t  bitmap[size]  16-byte aligned, right after dirty[]
+ *
+ * After a run, only the dirty bits come over, then only the dirty blocks,
+ * which are OR'ed into the host's map */
+
+#define COVERAGE_MAGIC                  0x434F5642 /* "COVB" */
+
+#define COVERAGE_HEADER_SIZE            0x10
+#define COVERAGE_BLOCK_SIZE_MIN         64
+
+/* Largest bitmap. This is all of HWRAM */
+#define COVERAGE_SIZE_MAX               0x100000
+
+#define COVERAGE_DIRTY_SIZE_MAX         (COVERAGE_SIZE_MAX / COVERAGE_BLOCK_SIZE_MIN / 8)
+
+/* Without it, every popcount is a call into libgcc */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(__POPCNT__)
+#define COVERAGE_POPCNT_DISPATCH
+#endif
+
+static struct {
+        bool attached;
+        uint32_t address;
+        uint32_t size;
+        uint32_t block_size;
+        uint32_t block_count;
+        uint32_t dirty_address;
+        uint32_t dirty_size;
+        uint32_t bitmap_address;
+
+        /* Every bit seen set so far */
+        uint64_t *map;
+        uint64_t *blocks;
+        uint8_t *dirty;
+
+        uint64_t edge_count;
+        uint32_t collect_count;
+} _state;
+
+static void
+_coverage_detach(void)
+{
+        free(_state.map);
+        free(_state.blocks);
+        free(_state.dirty);
+
+        _state.attached = false;
+        _state.map = NULL;
+        _state.blocks = NULL;
+        _state.dirty = NULL;
+}
+
+/* OR a run of blocks into the map. Returns how many bits were set in the run,
+ * and how many of those are new */
+static inline __attribute__((always_inline)) void
+_map_merge_words(uint64_t * restrict map, const uint64_t * restrict words,
+    size_t word_count, uint64_t *hit_count, uint64_t *new_count)
+{
+        uint64_t hits;
+        hits = 0;
+        uint64_t news;
+        news = 0;
+
+        for (size_t i = 0; i < word_count; i++) {
+                const uint64_t word = words[i];
+
+                hits += __builtin_popcountll(word);
+                news += __builtin_popcountll(word & ~map[i]);
+
+                map[i] |= word;
+        }
+
+        *hit_count += hits;
+        *new_count += news;
+}
+
+#if defined(COVERAGE_POPCNT_DISPATCH)
+/* The same loop, where each popcount is one instruction */
+__attribute__((target("popcnt"))) static void
+_map_merge_popcnt(uint64_t * restrict map, const uint64_t * restrict words,
+    size_t word_count, uint64_t *hit_count, uint64_t *new_count)
+{
+        _map_merge_words(map, words, word_count, hit_count, new_count);
+}
+#endif /* COVERAGE_POPCNT_DISPATCH */
+
+static void
+_map_merge(uint64_t * restrict map, const uint64_t * restrict words,
+    size_t word_count, uint64_t *hit_count, uint64_t *new_count)
+{
+#if defined(COVERAGE_POPCNT_DISPATCH)
+        if (__builtin_cpu_supports("popcnt")) {
+                _map_merge_popcnt(map, words, word_count, hit_count, new_count);
+
+                return;
+        }
+#endif /* COVERAGE_POPCNT_DISPATCH */
+
+        _map_merge_words(map, words, word_count, hit_count, new_count);
+}
+
+static void
+_coverage_attach(const object_t *address_obj)
+{
+        uint32_t address;
+
+        if (!(commands_address_get(address_obj, &address))) {
+                return;
+        }
+
+        uint8_t header[COVERAGE_HEADER_SIZE];
+
+        if ((device_read(header, address, sizeof(header))) != DEVICE_RET_OK) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        if ((device_be32_get(&header[0x00])) != COVERAGE_MAGIC) {
+                commands_printf("No coverage bitmap found at 0x%08X\n", address);
+                commands_status_return(COMMANDS_STATUS_INVALID_ADDRESS);
+        }
+
+        const uint32_t size = device_be32_get(&header[0x04]);
+        const uint32_t block_size = device_be32_get(&header[0x08]);
+
+        if ((block_size < COVERAGE_BLOCK_SIZE_MIN) ||
+            ((block_size & (block_size - 1)) != 0) ||
+            (size == 0) || (size > COVERAGE_SIZE_MAX) ||
+            ((size % block_size) != 0)) {
+                commands_status_return(COMMANDS_STATUS_INVALID_SIZE);
+        }
+
+        _coverage_detach();
+
+        const uint32_t block_count = size / block_size;
+        const uint32_t dirty_size = ((block_count + 31) / 32) * 4;
+
+        _state.map = calloc(size / sizeof(uint64_t), sizeof(uint64_t));
+        _state.blocks = malloc(size);
+        _state.dirty = malloc(dirty_size);
+
+        if ((_state.map == NULL) || (_state.blocks == NULL) || (_state.dirty == NULL)) {
+                _coverage_detach();
+
+                commands_status_return(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+        }
+
+        _state.attached = true;
+        _state.address = address;
+        _state.size = size;
+        _state.block_size = block_size;
+        _state.block_count = block_count;
+        _state.dirty_address = address + COVERAGE_HEADER_SIZE;
+        _state.dirty_size = dirty_size;
+        _state.bitmap_address = (_state.dirty_address + dirty_size + 15) & ~(uint32_t)15;
+        _state.edge_count = 0;
+        _state.collect_count = 0;
+
+        commands_printf("Coverage bitmap at 0x%08X, %uB in %u blocks\n",
+            _state.bitmap_address,
+            size,
+            block_count);
+}
+
+static bool
+_block_dirty(uint32_t block)
+{
+        return (_state.dirty[block / 8] & (0x80 >> (block % 8))) != 0;
+}
+
+/* Only the words of dirty bits that were seen set are cleared, before the
+ * blocks are read. A block the target writes to after that is marked dirty
+ * again, and comes over next time. What the target marks in one of those
+ * words in between the two transfers is still lost */
+static bool
+_dirty_clear(void)
+{
+        static const uint8_t zeros[COVERAGE_DIRTY_SIZE_MAX];
+
+        uint32_t offset;
+        offset = 0;
+
+        while (offset < _state.dirty_size) {
+                if ((device_be32_get(&_state.dirty[offset])) == 0) {
+                        offset += 4;
+
+                        continue;
+                }
+
+                uint32_t end;
+                end = offset + 4;
+
+                while ((end < _state.dirty_size) && ((device_be32_get(&_state.dirty[end])) != 0)) {
+                        end += 4;
+                }
+
+                if ((device_write(zeros, _state.dirty_address + offset, end - offset)) != DEVICE_RET_OK) {
+                        return false;
+                }
+
+                offset = end;
+        }
+
+        return true;
+}
+
+static void
+_coverage_collect(void)
+{
+        if (!_state.attached) {
+                commands_printf("No coverage bitmap. Use \"coverage attach <address>\"\n");
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        if ((device_read(_state.dirty, _state.dirty_address, _state.dirty_size)) != DEVICE_RET_OK) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        if (!(_dirty_clear())) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        uint64_t hit_count;
+        hit_count = 0;
+        uint64_t new_count;
+        new_count = 0;
+
+        uint32_t dirty_count;
+        dirty_count = 0;
+        uint32_t transfer_count;
+        transfer_count = 0;
+
+        uint32_t block;
+        block = 0;
+
+        /* Neighbouring dirty blocks come over in one transfer */
+        while (block < _state.block_count) {
+                if (!(_block_dirty(block))) {
+                        block++;
+
+                        continue;
+                }
+
+                uint32_t end;
+                end = block + 1;
+
+                while ((end < _state.block_count) && _block_dirty(end)) {
+                        end++;
+                }
+
+                const uint32_t offset = block * _state.block_size;
+                const uint32_t size = (end - block) * _state.block_size;
+
+                uint8_t * const buffer = (uint8_t *)_state.blocks + offset;
+
+                if ((device_read(buffer, _state.bitmap_address + offset, size)) != DEVICE_RET_OK) {
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+
+                _map_merge(&_state.map[offset / sizeof(uint64_t)],
+                    &_state.blocks[offset / sizeof(uint64_t)],
+                    size / sizeof(uint64_t), &hit_count, &new_count);
+
+                dirty_count += end - block;
+                transfer_count++;
+
+                block = end;
+        }
+
+        _state.edge_count += new_count;
+        _state.collect_count++;
+
+        commands_printf("%u/%u blocks changed (%u transfers), %llu edges hit, %llu new, %llu total\n",
+            dirty_count,
+            _state.block_count,
+            transfer_count,
+            (unsigned long long)hit_count,
+            (unsigned long long)new_count,
+            (unsigned long long)_state.edge_count);
+}
+
+static void
+_coverage_save(const object_t *path_obj)
+{
+        if (path_obj->type != OBJECT_TYPE_STRING) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+        }
+
+        if (!_state.attached) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        FILE * const fp = fopen(path_obj->as.string, "wb");
+
+        if (fp == NULL) {
+                commands_printf("Unable to open \"%s\"\n", path_obj->as.string);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        const size_t written = fwrite(_state.map, 1, _state.size, fp);
+
+        (void)fclose(fp);
+
+        if (written != _state.size) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+}
+
+static void
+_coverage_status(void)
+{
+        if (!_state.attached) {
+                commands_printf("No coverage bitmap attached\n");
+
+                return;
+        }
+
+        commands_printf("Bitmap at 0x%08X (%uB, %uB blocks), %u collections, %llu edges\n",
+            _state.bitmap_address,
+            _state.size,
+            _state.block_size,
+            _state.collect_count,
+            (unsigned long long)_state.edge_count);
+}
+
+static void
+_coverage(const parser_t *parser)
+{
+        object_t * const * const args_obj = parser->stream->args_obj;
+
+        const int argc = parser->stream->argc;
+
+        if (argc == 0) {
+                _coverage_status();
+
+                return;
+        }
+
+        if (args_obj[0]->type != OBJECT_TYPE_SYMBOL) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_SYMBOL);
+        }
+
+        const char * const mode = args_obj[0]->as.symbol;
+
+        if ((strcmp(mode, "attach")) == 0) {
+                if (argc != 2) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                _coverage_attach(args_obj[1]);
+        } else if ((strcmp(mode, "collect")) == 0) {
+                if (argc != 1) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                _coverage_collect();
+        } else if ((strcmp(mode, "reset")) == 0) {
+                if (argc != 1) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                if (_state.attached) {
+                        (void)memset(_state.map, 0, _state.size);
+
+                        _state.edge_count = 0;
+                        _state.collect_count = 0;
+                }
+        } else if ((strcmp(mode, "save")) == 0) {
+                if (argc != 2) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                _coverage_save(args_obj[1]);
+        } else {
+                commands_printf("Unknown mode \"%s\"\n", mode);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+}
+
+const command_t command_coverage = {
+        .name        = "coverage",
+        .description = "Collect the target's coverage bitmap into a host-side map",
+        .help        = "[attach <address:int|sym> | collect | reset | save <path:str>]",
+        .func        = _coverage,
+        .arg_count   = -1
+};
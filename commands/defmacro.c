@@ -0,0 +1,81 @@
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "types.h"
+#include "commands.h"
+#include "env.h"
+#include "eval.h"
+#include "macro.h"
+#include "parser.h"
+
+static eval_ret_t
+_defmacro(const parser_t *parser, const ast_node_t *form)
+{
+        (void)parser;
+
+        if (form->argc < 3) {
+                commands_status_set(COMMANDS_STATUS_ARGC_MISMATCH);
+
+                return EVAL_RET_FAILED;
+        }
+
+        const ast_node_t * const name_node = form->args;
+        const ast_node_t * const params_node = name_node->next;
+        const ast_node_t * const body = params_node->next;
+
+        if ((name_node->type != AST_NODE_OBJECT) ||
+            (name_node->object->type != OBJECT_TYPE_SYMBOL)) {
+                commands_status_set(COMMANDS_STATUS_EXPECTED_SYMBOL);
+
+                return EVAL_RET_FAILED;
+        }
+
+        const char * const name = name_node->object->as.symbol;
+
+        /* Commands are looked for first, so it could never be called */
+        if ((commands_find(name)) != NULL) {
+                commands_printf("\"%s\" is a command\n", name);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return EVAL_RET_FAILED;
+        }
+
+        object_t *macro_obj;
+        macro_obj = env_interned_value_get(name);
+
+        if ((macro_obj != NULL) && (macro_obj->type != OBJECT_TYPE_MACRO)) {
+                commands_printf("\"%s\" is not a macro\n", name);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return EVAL_RET_FAILED;
+        }
+
+        macro_t * const macro = macro_new(params_node, body);
+
+        if (macro == NULL) {
+                return EVAL_RET_FAILED;
+        }
+
+        /* Anything already calling the macro holds on to its object, so a
+         * redefinition replaces what's in it */
+        if (macro_obj == NULL) {
+                macro_obj = object_new(OBJECT_TYPE_MACRO);
+
+                env_interned_put(name, macro_obj);
+        } else {
+                macro_delete(macro_obj->as.macro);
+        }
+
+        macro_obj->as.macro = macro;
+
+        return EVAL_RET_OK;
+}
+
+const command_t command_defmacro = {
+        .name        = "defmacro",
+        .description = "Defines a macro, called like a command",
+        .help        = "<name:sym> ([param:sym ...]) (<command> ...)...",
+        .form_func   = _defmacro,
+        .arg_count   = -1
+};
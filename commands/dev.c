@@ -0,0 +1,94 @@
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "device.h"
+#include "parser.h"
+
+static void
+_dev_list(void)
+{
+        const device_t * const selected = device_selected_get();
+
+        for (uint32_t i = 0; i < device_count_get(); i++) {
+                const device_t * const device = device_get(i);
+
+                const bool is_selected = device_all_selected() || (device == selected);
+
+                commands_printf("%c %u %s\n", (is_selected ? '*' : ' '), i + 1, device_name_get(device));
+        }
+}
+
+static void
+_dev(const parser_t *parser)
+{
+        object_t * const * const args_obj = parser->stream->args_obj;
+
+        const int argc = parser->stream->argc;
+
+        if (argc == 0) {
+                _dev_list();
+
+                return;
+        }
+
+        if (args_obj[0]->type != OBJECT_TYPE_SYMBOL) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_SYMBOL);
+        }
+
+        const char * const mode = args_obj[0]->as.symbol;
+
+        if ((strcmp(mode, "list")) == 0) {
+                if (argc != 1) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                _dev_list();
+        } else if ((strcmp(mode, "all")) == 0) {
+                if (argc != 1) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                device_select_all();
+        } else if ((strcmp(mode, "forget")) == 0) {
+                if (argc != 1) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                /* For when the target was reset, or its memory changed
+                 * without ssshell knowing */
+                device_shadow_clear();
+        } else if ((strcmp(mode, "use")) == 0) {
+                if (argc != 2) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                if (args_obj[1]->type != OBJECT_TYPE_INTEGER) {
+                        commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+                }
+
+                const int32_t number = args_obj[1]->as.integer;
+
+                if ((number < 1) || ((uint32_t)number > device_count_get())) {
+                        commands_printf("No device %i\n", number);
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+
+                device_select(number - 1);
+        } else {
+                commands_printf("Unknown mode \"%s\"\n", mode);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+}
+
+const command_t command_dev = {
+        .name        = "dev",
+        .description = "List the devices, and select which ones commands talk to",
+        .help        = "[list | use <number:int> | all | forget]",
+        .func        = _dev,
+        .arg_count   = -1
+};
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "device.h"
+#include "sh2.h"
+#include "symbols.h"
+
+/* All of HWRAM */
+#define DISASM_COUNT_MAX        0x80000
+
+/* Output is built up here and written out in one go when it's nearly full */
+#define DISASM_OUTPUT_SIZE      0x40000
+
+/* Symbol names are cut short past this */
+#define DISASM_NAME_MAX         128
+
+#define DISASM_LINE_MAX         (SH2_TEXT_MAX + (DISASM_NAME_MAX * 2) + 64)
+
+static struct {
+        char *buffer;
+        size_t size;
+
+        const symbols_t *symbols;
+        const uint8_t *code;
+        uint32_t address;
+        uint32_t code_size;
+} _state;
+
+static const char _hex_digits[] = "0123456789ABCDEF";
+
+static void
+_output_flush(void)
+{
+        (void)fwrite(_state.buffer, 1, _state.size, stdout);
+
+        _state.size = 0;
+}
+
+static void
+_hex_put(uint32_t value, uint32_t digits)
+{
+        char * const p = &_state.buffer[_state.size];
+
+        for (uint32_t i = 0; i < digits; i++) {
+                p[i] = _hex_digits[(value >> ((digits - 1 - i) * 4)) & 0x0F];
+        }
+
+        _state.size += digits;
+}
+
+static void
+_string_put(const char *s, size_t length)
+{
+        (void)memcpy(&_state.buffer[_state.size], s, length);
+
+        _state.size += length;
+}
+
+static void
+_symbol_put(const symbol_t *symbol, uint32_t address)
+{
+        size_t length;
+        length = strlen(symbol->name);
+        length = (length < DISASM_NAME_MAX) ? length : DISASM_NAME_MAX;
+
+        _string_put("<", 1);
+        _string_put(symbol->name, length);
+
+        const uint32_t offset = address - symbol->address;
+
+        if (offset != 0) {
+                _string_put("+0x", 3);
+                _hex_put(offset, (offset > 0xFFFF) ? 8 : ((offset > 0xFF) ? 4 : 2));
+        }
+
+        _string_put(">", 1);
+}
+
+static bool
+_literal_get(uint32_t address, uint32_t size, uint32_t *value)
+{
+        const uint32_t offset = address - _state.address;
+
+        if ((address < _state.address) || (offset >= _state.code_size) ||
+            (size > (_state.code_size - offset))) {
+                return false;
+        }
+
+        const uint8_t * const p = &_state.code[offset];
+
+        *value = (size == 2) ? (((uint32_t)p[0] << 8) | p[1]) : device_be32_get(p);
+
+        return true;
+}
+
+static void
+_ref_annotate(const sh2_ref_t *ref)
+{
+        const symbol_t *symbol;
+        uint32_t value;
+
+        switch (ref->type) {
+        case SH2_REF_CODE:
+        case SH2_REF_ADDRESS:
+                if ((_state.symbols == NULL) ||
+                    ((symbol = symbols_address_find(_state.symbols, ref->address)) == NULL)) {
+                        break;
+                }
+
+                _string_put(" ; ", 3);
+                _symbol_put(symbol, ref->address);
+                break;
+        case SH2_REF_WORD:
+                if (_literal_get(ref->address, 2, &value)) {
+                        _string_put(" ; 0x", 5);
+                        _hex_put(value, 4);
+                }
+                break;
+        case SH2_REF_LONG:
+                if (!(_literal_get(ref->address, 4, &value))) {
+                        break;
+                }
+
+                _string_put(" ; 0x", 5);
+                _hex_put(value, 8);
+
+                if ((_state.symbols != NULL) &&
+                    ((symbol = symbols_address_find(_state.symbols, value)) != NULL)) {
+                        _string_put(" ", 1);
+                        _symbol_put(symbol, value);
+                }
+                break;
+        default:
+                break;
+        }
+}
+
+static void
+_disasm_output(uint32_t count)
+{
+        const symbols_t * const symbols = _state.symbols;
+
+        /* Labels are found by walking the symbols alongside the code */
+        uint32_t symbol_index;
+        symbol_index = 0;
+
+        if (symbols != NULL) {
+                while ((symbol_index < symbols->count) &&
+                       (symbols->symbols[symbol_index].address < _state.address)) {
+                        symbol_index++;
+                }
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                if ((DISASM_OUTPUT_SIZE - _state.size) < DISASM_LINE_MAX) {
+                        _output_flush();
+                }
+
+                const uint32_t address = _state.address + (i * 2);
+                const uint8_t * const p = &_state.code[i * 2];
+                const uint16_t opcode = ((uint16_t)p[0] << 8) | p[1];
+
+                if ((symbols != NULL) && (symbol_index < symbols->count) &&
+                    (symbols->symbols[symbol_index].address <= address)) {
+                        const symbol_t * const symbol = &symbols->symbols[symbol_index];
+
+                        if (symbol->address == address) {
+                                _string_put("\n", 1);
+                                _symbol_put(symbol, address);
+                                _string_put(":\n", 2);
+                        }
+
+                        while ((symbol_index < symbols->count) &&
+                               (symbols->symbols[symbol_index].address <= address)) {
+                                symbol_index++;
+                        }
+                }
+
+                _string_put("0x", 2);
+                _hex_put(address, 8);
+                _string_put("  ", 2);
+                _hex_put(opcode, 4);
+                _string_put("  ", 2);
+
+                sh2_ref_t ref;
+
+                _state.size += sh2_format(&_state.buffer[_state.size], address, opcode, &ref);
+
+                _ref_annotate(&ref);
+
+                _string_put("\n", 1);
+        }
+
+        _output_flush();
+}
+
+static void
+_disasm(const parser_t *parser)
+{
+        object_t * const * const args_obj = parser->stream->args_obj;
+
+        const int argc = parser->stream->argc;
+
+        if ((argc != 2) && (argc != 3)) {
+                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+        }
+
+        uint32_t address;
+
+        if (!(commands_address_get(args_obj[0], &address))) {
+                return;
+        }
+
+        if (args_obj[1]->type != OBJECT_TYPE_INTEGER) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+        }
+
+        if ((argc == 3) && (args_obj[2]->type != OBJECT_TYPE_STRING)) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+        }
+
+        const int count = args_obj[1]->as.integer;
+
+        if ((address & 1) != 0) {
+                commands_status_return(COMMANDS_STATUS_INVALID_ADDRESS);
+        }
+
+        if ((count <= 0) || (count > DISASM_COUNT_MAX)) {
+                commands_status_return(COMMANDS_STATUS_INVALID_SIZE);
+        }
+
+        symbols_t *symbols;
+        symbols = NULL;
+
+        if (argc == 3) {
+                if ((symbols = symbols_elf_load(args_obj[2]->as.string)) == NULL) {
+                        commands_printf("Unable to load symbols from \"%s\"\n", args_obj[2]->as.string);
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+        }
+
+        const uint32_t code_size = count * 2;
+
+        uint8_t * const code = malloc(code_size);
+        char * const buffer = malloc(DISASM_OUTPUT_SIZE);
+
+        if ((code == NULL) || (buffer == NULL)) {
+                free(code);
+                free(buffer);
+                symbols_delete(symbols);
+
+                commands_status_return(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+        }
+
+        /* The whole range comes over in one transfer */
+        if ((device_read(code, address, code_size)) != DEVICE_RET_OK) {
+                free(code);
+                free(buffer);
+                symbols_delete(symbols);
+
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        _state.buffer = buffer;
+        _state.size = 0;
+        /* Without an ELF file, whatever was loaded with "symbols load" is used */
+        _state.symbols = (symbols != NULL) ? symbols : symbols_loaded_get();
+        _state.code = code;
+        _state.address = address;
+        _state.code_size = code_size;
+
+        _disasm_output(count);
+
+        free(code);
+        free(buffer);
+        symbols_delete(symbols);
+
+        _state.buffer = NULL;
+        _state.symbols = NULL;
+        _state.code = NULL;
+}
+
+const command_t command_disasm = {
+        .name        = "disasm",
+        .description = "Disassemble SH-2 code on the target",
+        .help        = "<address:int|sym> <count:int> [elf:str]",
+        .func        = _disasm,
+        .arg_count   = -1
+};
@@ -1,46 +1,130 @@
 #include <sys/cdefs.h>
 
+#include <stdio.h>
+#include <string.h>
+
 #include "shell.h"
 
 #include "types.h"
+#include "buffer.h"
 #include "commands.h"
+#include "jobs.h"
 #include "parser.h"
 
-#include <ssusb/ssusb.h>
-
-static void
-_download(const parser_t *parser)
+/* Without a path, what's downloaded is given back as a buffer */
+static job_t *
+_download_job_new(const parser_t *parser)
 {
-        if (parser->stream->argc != 3) {
-                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+        const uint32_t argc = parser->stream->argc;
+
+        if ((argc != 2) && (argc != 3)) {
+                commands_status_set(COMMANDS_STATUS_ARGC_MISMATCH);
+
+                return NULL;
         }
 
         const object_t * const address_obj = parser->stream->args_obj[0];
-        const object_t * const path_obj = parser->stream->args_obj[1];
-        const object_t * const size_obj = parser->stream->args_obj[2];
+        const object_t * const path_obj = (argc == 3) ? parser->stream->args_obj[1] : NULL;
+        const object_t * const size_obj = parser->stream->args_obj[argc - 1];
+
+        uint32_t address;
 
-        if (address_obj->type != OBJECT_TYPE_INTEGER) {
-                commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+        if (!(commands_address_get(address_obj, &address))) {
+                return NULL;
         }
 
-        if (path_obj->type != OBJECT_TYPE_STRING) {
-                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+        if ((path_obj != NULL) && (path_obj->type != OBJECT_TYPE_STRING)) {
+                commands_status_set(COMMANDS_STATUS_EXPECTED_STRING);
+
+                return NULL;
         }
 
         if (size_obj->type != OBJECT_TYPE_INTEGER) {
-                commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+                commands_status_set(COMMANDS_STATUS_EXPECTED_INTEGER);
+
+                return NULL;
         }
 
-        const uint32_t address = address_obj->as.integer;
-        const char * const path = path_obj->as.string;
         const uint32_t size = size_obj->as.integer;
 
-        ssusb_ret_t ret;
-        ret = ssusb_file_download(path, address, size);
+        if (size == 0) {
+                commands_status_set(COMMANDS_STATUS_INVALID_SIZE);
+
+                return NULL;
+        }
+
+        buffer_t * const buffer = buffer_new(size);
+
+        if (buffer == NULL) {
+                commands_status_set(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+
+                return NULL;
+        }
+
+        job_t * const job = job_new(JOB_TYPE_DOWNLOAD, address, buffer);
+
+        if (path_obj != NULL) {
+                job->path = strdup(path_obj->as.string);
+
+                (void)snprintf(job->description, sizeof(job->description),
+                    "download 0x%08X \"%s\" %uB", address, job->path, size);
+        } else {
+                (void)snprintf(job->description, sizeof(job->description),
+                    "download 0x%08X %uB", address, size);
+        }
+
+        return job;
+}
+
+/* A buffer downloaded in the background would have nowhere to go */
+static job_t *
+_download_background_job_new(const parser_t *parser)
+{
+        if (parser->stream->argc != 3) {
+                commands_printf("Only a download to a file can run in the background\n");
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return NULL;
+        }
 
-        if (ret != SSUSB_OK) {
-                commands_printf("Unable download from 0x%08X of size %iB to \"%s\"\n", address, size, path);
+        return _download_job_new(parser);
+}
+
+static void
+_download(const parser_t *parser)
+{
+        job_t * const job = _download_job_new(parser);
+
+        if (job == NULL) {
+                return;
+        }
+
+        const uint32_t address = job->address;
+        /* The buffer is given back once the job is deleted */
+        buffer_t * const buffer = (job->path == NULL) ? buffer_ref(job->buffer) : NULL;
+
+        switch (jobs_run(job)) {
+        case JOB_STATE_DONE:
+                break;
+        case JOB_STATE_CANCELLED:
+                buffer_unref(buffer);
+
+                commands_printf("Download from 0x%08X cancelled\n", address);
                 commands_status_return(COMMANDS_STATUS_ERROR);
+        default:
+                buffer_unref(buffer);
+
+                commands_printf("Unable download from 0x%08X\n", address);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        if (buffer != NULL) {
+                const object_t value = {
+                        .type      = OBJECT_TYPE_BUFFER,
+                        .as.buffer = buffer
+                };
+
+                commands_value_set(&value);
         }
 }
 
@@ -48,7 +132,8 @@ const command_t command_download = {
         .name        = "download",
         .alias       = "<",
         .description = "Download a binary at a valid Saturn address",
-        .help        = "<address:int> <path:str> <size:int>",
+        .help        = "<address:int|sym> [path:str] <size:int>",
         .func        = _download,
-        .arg_count   = 3
+        .job_func    = _download_background_job_new,
+        .arg_count   = -1
 };
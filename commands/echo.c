@@ -3,6 +3,7 @@
 #include <ssshell.h>
 
 #include "types.h"
+#include "buffer.h"
 #include "commands.h"
 #include "parser.h"
 
@@ -25,6 +26,9 @@ _echo(const parser_t *parser)
                 case OBJECT_TYPE_INTEGER:
                         commands_printf("%i", object->as.integer);
                         break;
+                case OBJECT_TYPE_BUFFER:
+                        commands_printf("<%zuB:buffer>", object->as.buffer->size);
+                        break;
                 default:
                         commands_status_return(COMMANDS_STATUS_ERROR);
                 }
@@ -1,20 +1,25 @@
 #include <sys/cdefs.h>
 
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "shell.h"
 
 #include "types.h"
+#include "buffer.h"
 #include "commands.h"
+#include "jobs.h"
 #include "parser.h"
 
-#include <ssusb/ssusb.h>
-
-static void
-_exec(const parser_t *parser)
+static job_t *
+_exec_job_new(const parser_t *parser)
 {
-        (void)parser;
-
         if (parser->stream->argc != 2) {
-                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                commands_status_set(COMMANDS_STATUS_ARGC_MISMATCH);
+
+                return NULL;
         }
 
         const object_t * const address_obj =
@@ -22,22 +27,60 @@ _exec(const parser_t *parser)
         const object_t * const path_obj =
             parser->stream->args_obj[1];
 
-        if (address_obj->type != OBJECT_TYPE_INTEGER) {
-                commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+        uint32_t address;
+
+        if (!(commands_address_get(address_obj, &address))) {
+                return NULL;
         }
 
         if (path_obj->type != OBJECT_TYPE_STRING) {
-                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+                commands_status_set(COMMANDS_STATUS_EXPECTED_STRING);
+
+                return NULL;
         }
 
-        const uint32_t address = address_obj->as.integer;
         const char * const path = path_obj->as.string;
 
-        ssusb_ret_t ret;
-        ret = ssusb_file_execute(path, address);
+        /* Only to know which bytes executing the file writes to */
+        buffer_t * const buffer = buffer_file_read(path);
 
-        if (ret != SSUSB_OK) {
+        if (buffer == NULL) {
                 commands_printf("Unable execute file \"%s\" to 0x%08X\n", path, address);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return NULL;
+        }
+
+        job_t * const job = job_new(JOB_TYPE_EXECUTE, address, buffer);
+
+        job->path = strdup(path);
+        assert(job->path != NULL);
+
+        (void)snprintf(job->description, sizeof(job->description),
+            "exec 0x%08X \"%s\"", address, path);
+
+        return job;
+}
+
+static void
+_exec(const parser_t *parser)
+{
+        job_t * const job = _exec_job_new(parser);
+
+        if (job == NULL) {
+                return;
+        }
+
+        const uint32_t address = job->address;
+
+        switch (jobs_run(job)) {
+        case JOB_STATE_DONE:
+                break;
+        case JOB_STATE_CANCELLED:
+                commands_printf("Executing at 0x%08X cancelled\n", address);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        default:
+                commands_printf("Unable execute file to 0x%08X\n", address);
                 commands_status_return(COMMANDS_STATUS_ERROR);
         }
 }
@@ -46,7 +89,8 @@ const command_t command_exec = {
         .name        = "exec",
         .alias       = ".",
         .description = "Execute a binary at a valid Saturn address",
-        .help        = "<address:int> <path:str>",
+        .help        = "<address:int|sym> <path:str>",
         .func        = _exec,
+        .job_func    = _exec_job_new,
         .arg_count   = 2
 };
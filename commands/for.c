@@ -0,0 +1,71 @@
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "types.h"
+#include "commands.h"
+#include "eval.h"
+#include "parser.h"
+
+static eval_ret_t
+_for(const parser_t *parser, const ast_node_t *form)
+{
+        if (form->argc < 4) {
+                commands_status_set(COMMANDS_STATUS_ARGC_MISMATCH);
+
+                return EVAL_RET_FAILED;
+        }
+
+        const ast_node_t * const name_node = form->args;
+        const ast_node_t * const from_node = name_node->next;
+        const ast_node_t * const to_node = from_node->next;
+        const ast_node_t * const body = to_node->next;
+
+        if ((name_node->type != AST_NODE_OBJECT) ||
+            (name_node->object->type != OBJECT_TYPE_SYMBOL)) {
+                commands_status_set(COMMANDS_STATUS_EXPECTED_SYMBOL);
+
+                return EVAL_RET_FAILED;
+        }
+
+        const char * const name = name_node->object->as.symbol;
+
+        int from;
+        int to;
+
+        if (!(eval_integer_get(parser, from_node, &from)) ||
+            !(eval_integer_get(parser, to_node, &to))) {
+                return EVAL_RET_FAILED;
+        }
+
+        object_t value = {
+                .type = OBJECT_TYPE_INTEGER
+        };
+
+        for (int i = from; i < to; i++) {
+                value.as.integer = i;
+
+                if (!(eval_variable_set(name, &value))) {
+                        commands_printf("\"%s\" is not a variable\n", name);
+                        commands_status_set(COMMANDS_STATUS_ERROR);
+
+                        return EVAL_RET_FAILED;
+                }
+
+                const eval_ret_t ret = eval_forms(parser, body);
+
+                if (ret != EVAL_RET_OK) {
+                        return ret;
+                }
+        }
+
+        return EVAL_RET_OK;
+}
+
+const command_t command_for = {
+        .name        = "for",
+        .description = "Runs commands for each integer in [from, to)",
+        .help        = "<name:sym> <from:int|form> <to:int|form> (<command> ...)...",
+        .form_func   = _for,
+        .arg_count   = -1
+};
@@ -0,0 +1,555 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+#include <sys/stat.h>
+
+#include <ssshell.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "device.h"
+#include "mutate.h"
+#include "timer.h"
+
+/*
+ * Layout of the harness mailbox in target RAM (all fields big-endian):
+ *
+ *   0x00           uint32_t magic         FUZZ_MAGIC
+ *   0x04           uint32_t capacity      Size of the input area
+ *   0x08           uint32_t response_seq  Written by the target, last, once
+ *                                         the input has been processed
+ *   0x0C           uint32_t status        Written by the target. Non-zero if
+ *                                         the input crashed the parser
+ *   0x10           uint32_t coverage      Written by the target. Any value
+ *                                         that identifies the path taken, or 0
+ *   0x20           uint8_t  input[]       Packed against the end of the area
+ *   0x20+capacity  uint32_t size
+ *   0x24+capacity  uint32_t request_seq   Written by the host
+ *
+ * The input, its size, and the request sequence number go over in a single
+ * transfer, with the sequence number landing last. The target picks up the
+ * input at (0x20 + capacity - size) */
+
+#define FUZZ_MAGIC                      0x46555A5A /* "FUZZ" */
+
+#define FUZZ_STATUS_OFFSET              0x08
+#define FUZZ_STATUS_SIZE                0x0C
+#define FUZZ_INPUT_OFFSET               0x20
+#define FUZZ_TRAILER_SIZE               0x08
+
+/* Largest input area. This is all of LWRAM */
+#define FUZZ_CAPACITY_MAX               0x100000
+
+#define FUZZ_CORPUS_MAX                 4096
+#define FUZZ_COVERAGE_CAPACITY          65536
+
+/* A run that takes longer than this is a hang. After this many hangs in a
+ * row, the harness is assumed gone */
+#define FUZZ_HANG_TIMEOUT               (1000000)
+#define FUZZ_HANG_COUNT_MAX             3
+
+/* The status block is polled back to back at first, since most inputs are
+ * done by the time the transfer turns around */
+#define FUZZ_POLL_SPIN_COUNT            8
+#define FUZZ_POLL_INTERVAL_MIN          (20)
+#define FUZZ_POLL_INTERVAL_MAX          (1000)
+
+#define FUZZ_STATS_INTERVAL             (1000000)
+
+#define FUZZ_PATH_MAX                   1024
+
+typedef struct {
+        uint8_t *data;
+        size_t size;
+} fuzz_input_t;
+
+typedef enum {
+        FUZZ_RUN_OK,
+        FUZZ_RUN_CRASH,
+        FUZZ_RUN_HANG,
+        FUZZ_RUN_INTERRUPTED,
+        FUZZ_RUN_ERROR,
+} fuzz_run_t;
+
+static struct {
+        uint32_t mailbox_address;
+        uint32_t capacity;
+        uint32_t seq;
+
+        const char *corpus_dir;
+        const char *crash_dir;
+
+        fuzz_input_t corpus[FUZZ_CORPUS_MAX];
+        uint32_t corpus_count;
+
+        /* Coverage values seen so far. Zero marks an empty slot */
+        uint32_t *coverage;
+        uint32_t coverage_count;
+
+        mutate_t mutate;
+
+        /* The input area followed by the trailer, so that the tail of it is
+         * the transfer */
+        uint8_t *transfer;
+        uint8_t *input;
+
+        uint64_t exec_count;
+        uint32_t crash_count;
+        uint32_t hang_count;
+} _state;
+
+static uint32_t
+_hash_calc(const uint8_t *data, size_t size)
+{
+        uint32_t hash;
+        hash = 2166136261u;
+
+        for (size_t i = 0; i < size; i++) {
+                hash ^= data[i];
+                hash *= 16777619u;
+        }
+
+        return hash;
+}
+
+static bool
+_coverage_add(uint32_t coverage)
+{
+        if ((coverage == 0) || (_state.coverage_count >= (FUZZ_COVERAGE_CAPACITY / 2))) {
+                return false;
+        }
+
+        const uint32_t mask = FUZZ_COVERAGE_CAPACITY - 1;
+
+        uint32_t i;
+        i = (coverage * 2654435761u) & mask;
+
+        while (_state.coverage[i] != 0) {
+                if (_state.coverage[i] == coverage) {
+                        return false;
+                }
+
+                i = (i + 1) & mask;
+        }
+
+        _state.coverage[i] = coverage;
+        _state.coverage_count++;
+
+        return true;
+}
+
+static bool
+_corpus_add(const uint8_t *data, size_t size)
+{
+        if ((_state.corpus_count == FUZZ_CORPUS_MAX) || (size == 0)) {
+                return false;
+        }
+
+        uint8_t * const copy = malloc(size);
+
+        if (copy == NULL) {
+                return false;
+        }
+
+        (void)memcpy(copy, data, size);
+
+        _state.corpus[_state.corpus_count].data = copy;
+        _state.corpus[_state.corpus_count].size = size;
+        _state.corpus_count++;
+
+        return true;
+}
+
+static void
+_input_save(const char *dir, const char *prefix, const uint8_t *data, size_t size)
+{
+        char path[FUZZ_PATH_MAX];
+
+        (void)snprintf(path, sizeof(path), "%s/%s-%08x.bin",
+            dir, prefix, _hash_calc(data, size));
+
+        FILE * const fp = fopen(path, "wb");
+
+        if (fp == NULL) {
+                return;
+        }
+
+        (void)fwrite(data, 1, size, fp);
+        (void)fclose(fp);
+}
+
+static bool
+_corpus_load(void)
+{
+        DIR * const dir = opendir(_state.corpus_dir);
+
+        if (dir == NULL) {
+                return false;
+        }
+
+        const struct dirent *entry;
+
+        while ((entry = readdir(dir)) != NULL) {
+                const char * const name = entry->d_name;
+
+                /* Findings saved next to the corpus don't belong in it */
+                if ((name[0] == '.') ||
+                    ((strncmp(name, "crash-", 6)) == 0) ||
+                    ((strncmp(name, "hang-", 5)) == 0)) {
+                        continue;
+                }
+
+                char path[FUZZ_PATH_MAX];
+
+                (void)snprintf(path, sizeof(path), "%s/%s", _state.corpus_dir, name);
+
+                struct stat stat_buffer;
+
+                if (((stat(path, &stat_buffer)) != 0) || !S_ISREG(stat_buffer.st_mode) ||
+                    (stat_buffer.st_size == 0) || ((uint32_t)stat_buffer.st_size > _state.capacity)) {
+                        continue;
+                }
+
+                FILE * const fp = fopen(path, "rb");
+
+                if (fp == NULL) {
+                        continue;
+                }
+
+                const size_t size = fread(_state.input, 1, _state.capacity, fp);
+
+                (void)fclose(fp);
+
+                if (!(_corpus_add(_state.input, size))) {
+                        break;
+                }
+        }
+
+        (void)closedir(dir);
+
+        /* Something to start from */
+        if (_state.corpus_count == 0) {
+                static const uint8_t seed[] = { 0x00 };
+
+                (void)_corpus_add(seed, sizeof(seed));
+        }
+
+        return true;
+}
+
+static void
+_corpus_free(void)
+{
+        for (uint32_t i = 0; i < _state.corpus_count; i++) {
+                free(_state.corpus[i].data);
+        }
+
+        _state.corpus_count = 0;
+}
+
+static size_t
+_input_mutate(void)
+{
+        const fuzz_input_t * const parent =
+            &_state.corpus[mutate_random(&_state.mutate, _state.corpus_count)];
+
+        uint8_t * const buffer = _state.input;
+
+        (void)memcpy(buffer, parent->data, parent->size);
+
+        switch (mutate_random(&_state.mutate, 4)) {
+        case 0:
+                return mutate_bitflip(&_state.mutate, buffer, parent->size);
+        case 1:
+                if (_state.corpus_count > 1) {
+                        const fuzz_input_t * const other =
+                            &_state.corpus[mutate_random(&_state.mutate, _state.corpus_count)];
+
+                        return mutate_splice(&_state.mutate, buffer, parent->size,
+                            other->data, other->size, _state.capacity);
+                }
+                /* Fall through */
+        default:
+                return mutate_havoc(&_state.mutate, buffer, parent->size, _state.capacity);
+        }
+}
+
+static fuzz_run_t
+_input_run(size_t size, uint32_t *coverage)
+{
+        /* Put the input right against the trailer */
+        const uint32_t offset = _state.capacity - size;
+
+        (void)memcpy(&_state.transfer[offset], _state.input, size);
+
+        _state.seq++;
+
+        device_be32_put(&_state.transfer[_state.capacity + 0], size);
+        device_be32_put(&_state.transfer[_state.capacity + 4], _state.seq);
+
+        const uint32_t input_address =
+            _state.mailbox_address + FUZZ_INPUT_OFFSET + offset;
+
+        if ((device_write(&_state.transfer[offset], input_address, size + FUZZ_TRAILER_SIZE)) != DEVICE_RET_OK) {
+                return FUZZ_RUN_ERROR;
+        }
+
+        _state.exec_count++;
+
+        const uint64_t start_time = timer_us_get();
+
+        uint32_t spin_count;
+        spin_count = 0;
+
+        uint32_t interval;
+        interval = FUZZ_POLL_INTERVAL_MIN;
+
+        while (!(shell_interrupted())) {
+                uint8_t status[FUZZ_STATUS_SIZE];
+
+                if ((device_read(status, _state.mailbox_address + FUZZ_STATUS_OFFSET, sizeof(status))) != DEVICE_RET_OK) {
+                        return FUZZ_RUN_ERROR;
+                }
+
+                if ((device_be32_get(&status[0x00])) == _state.seq) {
+                        *coverage = device_be32_get(&status[0x08]);
+
+                        return ((device_be32_get(&status[0x04])) != 0) ? FUZZ_RUN_CRASH : FUZZ_RUN_OK;
+                }
+
+                if ((timer_us_get() - start_time) >= FUZZ_HANG_TIMEOUT) {
+                        return FUZZ_RUN_HANG;
+                }
+
+                if (spin_count < FUZZ_POLL_SPIN_COUNT) {
+                        spin_count++;
+
+                        continue;
+                }
+
+                timer_sleep(interval);
+
+                interval = (interval * 2);
+                interval = (interval < FUZZ_POLL_INTERVAL_MAX) ? interval : FUZZ_POLL_INTERVAL_MAX;
+        }
+
+        return FUZZ_RUN_INTERRUPTED;
+}
+
+static void
+_stats_print(uint64_t elapsed_time, const char *end)
+{
+        const uint64_t rate =
+            (elapsed_time > 0) ? ((_state.exec_count * 1000000) / elapsed_time) : 0;
+
+        commands_printf("\r%llu execs (%llu/s), corpus %u, paths %u, crashes %u, hangs %u%s",
+            (unsigned long long)_state.exec_count,
+            (unsigned long long)rate,
+            _state.corpus_count,
+            _state.coverage_count,
+            _state.crash_count,
+            _state.hang_count,
+            end);
+
+        (void)fflush(stdout);
+}
+
+static void
+_fuzz_loop(void)
+{
+        const uint64_t start_time = timer_us_get();
+
+        uint64_t stats_time;
+        stats_time = start_time;
+
+        uint32_t hangs_in_row;
+        hangs_in_row = 0;
+
+        commands_printf("Fuzzing through 0x%08X, %u inputs in corpus. Press Ctrl-C to stop\n",
+            _state.mailbox_address,
+            _state.corpus_count);
+
+        shell_interrupt_begin();
+
+        while (!(shell_interrupted())) {
+                const size_t size = _input_mutate();
+
+                uint32_t coverage;
+                coverage = 0;
+
+                const fuzz_run_t ret = _input_run(size, &coverage);
+
+                /* The input was moved against the trailer */
+                const uint8_t * const input = &_state.transfer[_state.capacity - size];
+
+                if (ret == FUZZ_RUN_ERROR) {
+                        commands_printf("\nUnable to reach the harness\n");
+                        break;
+                }
+
+                if (ret == FUZZ_RUN_INTERRUPTED) {
+                        break;
+                }
+
+                if (ret == FUZZ_RUN_HANG) {
+                        _state.hang_count++;
+                        hangs_in_row++;
+
+                        _input_save(_state.crash_dir, "hang", input, size);
+
+                        if (hangs_in_row == FUZZ_HANG_COUNT_MAX) {
+                                commands_printf("\nHarness stopped responding\n");
+                                break;
+                        }
+
+                        continue;
+                }
+
+                hangs_in_row = 0;
+
+                if (ret == FUZZ_RUN_CRASH) {
+                        _state.crash_count++;
+
+                        _input_save(_state.crash_dir, "crash", input, size);
+                } else if (_coverage_add(coverage)) {
+                        /* A new path is worth keeping */
+                        if (_corpus_add(input, size)) {
+                                _input_save(_state.corpus_dir, "cov", input, size);
+                        }
+                }
+
+                const uint64_t time = timer_us_get();
+
+                if ((time - stats_time) >= FUZZ_STATS_INTERVAL) {
+                        _stats_print(time - start_time, "");
+
+                        stats_time = time;
+                }
+        }
+
+        shell_interrupt_end();
+
+        _stats_print(timer_us_get() - start_time, "\n");
+}
+
+static bool
+_harness_attach(uint32_t mailbox_address)
+{
+        uint8_t header[FUZZ_STATUS_OFFSET + FUZZ_STATUS_SIZE];
+
+        if ((device_read(header, mailbox_address, sizeof(header))) != DEVICE_RET_OK) {
+                commands_printf("Unable to read mailbox\n");
+
+                return false;
+        }
+
+        if ((device_be32_get(&header[0x00])) != FUZZ_MAGIC) {
+                commands_printf("No harness found at 0x%08X\n", mailbox_address);
+
+                return false;
+        }
+
+        const uint32_t capacity = device_be32_get(&header[0x04]);
+
+        if ((capacity == 0) || (capacity > FUZZ_CAPACITY_MAX)) {
+                commands_printf("Invalid input capacity (%uB)\n", capacity);
+
+                return false;
+        }
+
+        _state.mailbox_address = mailbox_address;
+        _state.capacity = capacity;
+        /* Pick up where the harness left off */
+        _state.seq = device_be32_get(&header[0x08]);
+
+        return true;
+}
+
+static void
+_fuzz(const parser_t *parser)
+{
+        object_t * const * const args_obj = parser->stream->args_obj;
+
+        const int argc = parser->stream->argc;
+
+        if ((argc != 2) && (argc != 3)) {
+                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+        }
+
+        uint32_t address;
+
+        if (!(commands_address_get(args_obj[0], &address))) {
+                return;
+        }
+
+        for (int i = 1; i < argc; i++) {
+                if (args_obj[i]->type != OBJECT_TYPE_STRING) {
+                        commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+                }
+        }
+
+        _state.corpus_dir = args_obj[1]->as.string;
+        _state.crash_dir = (argc == 3) ? args_obj[2]->as.string : _state.corpus_dir;
+
+        struct stat stat_buffer;
+
+        for (int i = 1; i < argc; i++) {
+                const char * const dir = args_obj[i]->as.string;
+
+                if ((stat(dir, &stat_buffer)) != 0) {
+                        commands_status_return(COMMANDS_STATUS_FILE_NOT_FOUND);
+                }
+
+                if (!S_ISDIR(stat_buffer.st_mode)) {
+                        commands_printf("\"%s\" is not a directory\n", dir);
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+        }
+
+        if (!(_harness_attach(address))) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        _state.transfer = malloc(_state.capacity + FUZZ_TRAILER_SIZE);
+        _state.input = malloc(_state.capacity);
+        _state.coverage = calloc(FUZZ_COVERAGE_CAPACITY, sizeof(uint32_t));
+        _state.coverage_count = 0;
+        _state.exec_count = 0;
+        _state.crash_count = 0;
+        _state.hang_count = 0;
+
+        mutate_seed(&_state.mutate, timer_us_get());
+
+        if ((_state.transfer == NULL) || (_state.input == NULL) || (_state.coverage == NULL)) {
+                commands_status_set(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+        } else if (!(_corpus_load())) {
+                commands_printf("Unable to read \"%s\"\n", _state.corpus_dir);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+        } else {
+                _fuzz_loop();
+        }
+
+        _corpus_free();
+
+        free(_state.transfer);
+        free(_state.input);
+        free(_state.coverage);
+
+        _state.transfer = NULL;
+        _state.input = NULL;
+        _state.coverage = NULL;
+}
+
+const command_t command_fuzz = {
+        .name        = "fuzz",
+        .description = "Fuzz a resident harness on the target",
+        .help        = "<mailbox-address:int|sym> <corpus-dir:str> [crash-dir:str]",
+        .func        = _fuzz,
+        .arg_count   = -1
+};
@@ -0,0 +1,663 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#endif /* !_WIN32 */
+
+#include <ssshell.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "memcache.h"
+#include "timer.h"
+
+#if !defined(_WIN32)
+/*
+ * Only memory is available. There is no way to stop the CPU or to read its
+ * registers over USB, so registers are reported as unavailable, and resuming
+ * or stepping reports a stop right away.
+ *
+ * The target keeps running while gdb looks at it, so cached pages only live
+ * as long as a burst of packets. Once gdb has been quiet for
+ * GDB_CACHE_LIFETIME, pending writes are flushed and the cache is dropped */
+
+#define GDB_PACKET_SIZE                 0x4000
+#define GDB_RECEIVE_BUFFER_SIZE         0x1000
+
+#define GDB_PAGE_SIZE                   0x400
+#define GDB_PAGE_COUNT                  1024
+#define GDB_READAHEAD_MAX               16
+
+#define GDB_CACHE_LIFETIME              (100000)
+#define GDB_POLL_TIMEOUT                (20)
+
+#define GDB_REGISTER_UNAVAILABLE        "xxxxxxxx"
+
+typedef enum {
+        GDB_RECEIVE_OK,
+        GDB_RECEIVE_INTERRUPT,
+        GDB_RECEIVE_CLOSED,
+        GDB_RECEIVE_STOP,
+} gdb_receive_t;
+
+static struct {
+        int listen_fd;
+        int fd;
+        bool no_ack;
+        bool cache_valid;
+
+        memcache_t *cache;
+        uint64_t last_packet_time;
+
+        uint8_t receive[GDB_RECEIVE_BUFFER_SIZE];
+        size_t receive_start;
+        size_t receive_end;
+
+        char packet[GDB_PACKET_SIZE + 1];
+        size_t packet_size;
+
+        char reply[GDB_PACKET_SIZE];
+        size_t reply_size;
+
+        uint8_t memory[GDB_PACKET_SIZE];
+
+        uint64_t packet_count;
+} _state;
+
+static const char _hex_digits[] = "0123456789abcdef";
+
+static int
+_hex_value(char c)
+{
+        if ((c >= '0') && (c <= '9')) {
+                return c - '0';
+        }
+
+        if ((c >= 'a') && (c <= 'f')) {
+                return c - 'a' + 10;
+        }
+
+        if ((c >= 'A') && (c <= 'F')) {
+                return c - 'A' + 10;
+        }
+
+        return -1;
+}
+
+static const char *
+_hex_parse(const char *p, uint32_t *value)
+{
+        const char * const start = p;
+
+        *value = 0;
+
+        int digit;
+
+        while ((digit = _hex_value(*p)) >= 0) {
+                *value = (*value << 4) | digit;
+
+                p++;
+        }
+
+        return (p != start) ? p : NULL;
+}
+
+static bool
+_send_all(const void *buffer, size_t size)
+{
+        const uint8_t *p;
+        p = buffer;
+
+        while (size > 0) {
+#if defined(MSG_NOSIGNAL)
+                const ssize_t sent = send(_state.fd, p, size, MSG_NOSIGNAL);
+#else
+                const ssize_t sent = send(_state.fd, p, size, 0);
+#endif /* MSG_NOSIGNAL */
+
+                if (sent <= 0) {
+                        return false;
+                }
+
+                p += sent;
+                size -= sent;
+        }
+
+        return true;
+}
+
+static bool
+_reply_send(void)
+{
+        uint8_t checksum;
+        checksum = 0;
+
+        for (size_t i = 0; i < _state.reply_size; i++) {
+                checksum += (uint8_t)_state.reply[i];
+        }
+
+        char trailer[3] = {
+                '#', _hex_digits[checksum >> 4], _hex_digits[checksum & 0x0F]
+        };
+
+        static const char start = '$';
+
+        return _send_all(&start, 1) &&
+               _send_all(_state.reply, _state.reply_size) &&
+               _send_all(trailer, sizeof(trailer));
+}
+
+static void
+_reply_set(const char *reply)
+{
+        _state.reply_size = strlen(reply);
+
+        (void)memcpy(_state.reply, reply, _state.reply_size);
+}
+
+static void
+_cache_expire(void)
+{
+        if (!_state.cache_valid) {
+                return;
+        }
+
+        /* A failed flush can't be reported to anyone by now */
+        (void)memcache_flush(_state.cache);
+        memcache_invalidate(_state.cache);
+
+        _state.cache_valid = false;
+}
+
+static gdb_receive_t
+_byte_receive(uint8_t *byte)
+{
+        while (_state.receive_start == _state.receive_end) {
+                if (shell_interrupted()) {
+                        return GDB_RECEIVE_STOP;
+                }
+
+                struct pollfd pollfd = {
+                        .fd     = _state.fd,
+                        .events = POLLIN
+                };
+
+                const int ret = poll(&pollfd, 1, GDB_POLL_TIMEOUT);
+
+                if (ret == 0) {
+                        if ((timer_us_get() - _state.last_packet_time) >= GDB_CACHE_LIFETIME) {
+                                _cache_expire();
+                        }
+
+                        continue;
+                }
+
+                if (ret < 0) {
+                        continue;
+                }
+
+                const ssize_t size = recv(_state.fd, _state.receive, sizeof(_state.receive), 0);
+
+                if (size <= 0) {
+                        return GDB_RECEIVE_CLOSED;
+                }
+
+                _state.receive_start = 0;
+                _state.receive_end = size;
+        }
+
+        *byte = _state.receive[_state.receive_start];
+        _state.receive_start++;
+
+        return GDB_RECEIVE_OK;
+}
+
+static gdb_receive_t
+_packet_receive(void)
+{
+        uint8_t byte;
+        gdb_receive_t ret;
+
+        while (true) {
+                /* Skip acks, and anything else between packets */
+                do {
+                        if ((ret = _byte_receive(&byte)) != GDB_RECEIVE_OK) {
+                                return ret;
+                        }
+
+                        if (byte == 0x03) {
+                                return GDB_RECEIVE_INTERRUPT;
+                        }
+
+                        if ((byte == '-') && (_state.reply_size > 0)) {
+                                if (!(_reply_send())) {
+                                        return GDB_RECEIVE_CLOSED;
+                                }
+                        }
+                } while (byte != '$');
+
+                uint8_t checksum;
+                checksum = 0;
+
+                _state.packet_size = 0;
+
+                while (true) {
+                        if ((ret = _byte_receive(&byte)) != GDB_RECEIVE_OK) {
+                                return ret;
+                        }
+
+                        if (byte == '#') {
+                                break;
+                        }
+
+                        if (_state.packet_size < GDB_PACKET_SIZE) {
+                                _state.packet[_state.packet_size] = byte;
+                                _state.packet_size++;
+                        }
+
+                        checksum += byte;
+                }
+
+                _state.packet[_state.packet_size] = '\0';
+
+                uint8_t digits[2];
+
+                for (uint32_t i = 0; i < 2; i++) {
+                        if ((ret = _byte_receive(&digits[i])) != GDB_RECEIVE_OK) {
+                                return ret;
+                        }
+                }
+
+                const int high = _hex_value(digits[0]);
+                const int low = _hex_value(digits[1]);
+
+                const bool valid = (high >= 0) && (low >= 0) &&
+                                   (((high << 4) | low) == checksum);
+
+                if (!_state.no_ack) {
+                        const char ack = valid ? '+' : '-';
+
+                        if (!(_send_all(&ack, 1))) {
+                                return GDB_RECEIVE_CLOSED;
+                        }
+                }
+
+                if (valid) {
+                        return GDB_RECEIVE_OK;
+                }
+        }
+}
+
+static void
+_memory_read(const char *args)
+{
+        uint32_t address;
+        uint32_t size;
+
+        if (((args = _hex_parse(args, &address)) == NULL) || (*args != ',') ||
+            ((_hex_parse(args + 1, &size)) == NULL)) {
+                _reply_set("E01");
+
+                return;
+        }
+
+        /* Each byte takes two characters */
+        size = (size < (GDB_PACKET_SIZE / 2)) ? size : (GDB_PACKET_SIZE / 2);
+
+        if ((memcache_read(_state.cache, _state.memory, address, size)) != DEVICE_RET_OK) {
+                _reply_set("E03");
+
+                return;
+        }
+
+        _state.cache_valid = true;
+
+        for (uint32_t i = 0; i < size; i++) {
+                _state.reply[(i * 2) + 0] = _hex_digits[_state.memory[i] >> 4];
+                _state.reply[(i * 2) + 1] = _hex_digits[_state.memory[i] & 0x0F];
+        }
+
+        _state.reply_size = size * 2;
+}
+
+static void
+_memory_write(const char *args, bool binary)
+{
+        uint32_t address;
+        uint32_t size;
+
+        if (((args = _hex_parse(args, &address)) == NULL) || (*args != ',') ||
+            ((args = _hex_parse(args + 1, &size)) == NULL) || (*args != ':') ||
+            (size > sizeof(_state.memory))) {
+                _reply_set("E01");
+
+                return;
+        }
+
+        args++;
+
+        const char * const end = &_state.packet[_state.packet_size];
+
+        for (uint32_t i = 0; i < size; i++) {
+                if (binary) {
+                        if (args >= end) {
+                                _reply_set("E01");
+
+                                return;
+                        }
+
+                        /* '}' escapes the next byte */
+                        if ((*args == '}') && ((args + 1) < end)) {
+                                args++;
+                                _state.memory[i] = *args ^ 0x20;
+                        } else {
+                                _state.memory[i] = *args;
+                        }
+
+                        args++;
+                } else {
+                        const int high = ((args + 1) < end) ? _hex_value(args[0]) : -1;
+                        const int low = ((args + 1) < end) ? _hex_value(args[1]) : -1;
+
+                        if ((high < 0) || (low < 0)) {
+                                _reply_set("E01");
+
+                                return;
+                        }
+
+                        _state.memory[i] = (high << 4) | low;
+
+                        args += 2;
+                }
+        }
+
+        if ((memcache_write(_state.cache, _state.memory, address, size)) != DEVICE_RET_OK) {
+                _reply_set("E03");
+
+                return;
+        }
+
+        _state.cache_valid = true;
+
+        _reply_set("OK");
+}
+
+static void
+_query(const char *packet)
+{
+        if ((strncmp(packet, "qSupported", 10)) == 0) {
+                (void)snprintf(_state.reply, sizeof(_state.reply),
+                    "PacketSize=%x;QStartNoAckMode+", GDB_PACKET_SIZE);
+
+                _state.reply_size = strlen(_state.reply);
+        } else if ((strcmp(packet, "qAttached")) == 0) {
+                _reply_set("1");
+        } else if ((strcmp(packet, "qC")) == 0) {
+                _reply_set("QC1");
+        } else if ((strcmp(packet, "qfThreadInfo")) == 0) {
+                _reply_set("m1");
+        } else if ((strcmp(packet, "qsThreadInfo")) == 0) {
+                _reply_set("l");
+        } else {
+                _reply_set("");
+        }
+}
+
+/* Returns false once the session is over */
+static bool
+_packet_handle(void)
+{
+        const char * const packet = _state.packet;
+
+        _state.packet_count++;
+        _state.last_packet_time = timer_us_get();
+
+        bool running;
+        running = true;
+
+        switch (packet[0]) {
+        case '?':
+                _reply_set("S05");
+                break;
+        case 'q':
+                _query(packet);
+                break;
+        case 'Q':
+                if ((strcmp(packet, "QStartNoAckMode")) == 0) {
+                        _reply_set("OK");
+
+                        /* The reply itself is still acknowledged */
+                        if (!(_reply_send())) {
+                                return false;
+                        }
+
+                        _state.no_ack = true;
+
+                        return true;
+                }
+
+                _reply_set("");
+                break;
+        case 'H':
+        case 'T':
+                _reply_set("OK");
+                break;
+        case 'g':
+        case 'p':
+                _reply_set(GDB_REGISTER_UNAVAILABLE);
+                break;
+        case 'm':
+                _memory_read(&packet[1]);
+                break;
+        case 'M':
+                _memory_write(&packet[1], false);
+                break;
+        case 'X':
+                _memory_write(&packet[1], true);
+                break;
+        case 'c':
+        case 'C':
+        case 's':
+        case 'S':
+                /* The target never stopped, so whatever it did meanwhile has
+                 * to be read again */
+                _cache_expire();
+                _reply_set("S05");
+                break;
+        case 'D':
+                _cache_expire();
+                _reply_set("OK");
+
+                running = false;
+                break;
+        case 'k':
+                _cache_expire();
+
+                return false;
+        default:
+                _reply_set("");
+                break;
+        }
+
+        if (!(_reply_send())) {
+                return false;
+        }
+
+        return running;
+}
+
+static void
+_session(void)
+{
+        _state.no_ack = false;
+        _state.cache_valid = false;
+        _state.receive_start = 0;
+        _state.receive_end = 0;
+        _state.reply_size = 0;
+        _state.packet_count = 0;
+        _state.last_packet_time = timer_us_get();
+
+        const uint64_t hits = _state.cache->lru->hits;
+        const uint64_t misses = _state.cache->lru->misses;
+        const uint64_t fetch_count = _state.cache->fetch_count;
+        const uint64_t flush_count = _state.cache->flush_count;
+
+        const int nodelay = 1;
+
+        (void)setsockopt(_state.fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        commands_printf("gdb connected\n");
+
+        while (true) {
+                const gdb_receive_t ret = _packet_receive();
+
+                if (ret == GDB_RECEIVE_INTERRUPT) {
+                        _reply_set("S02");
+
+                        if (!(_reply_send())) {
+                                break;
+                        }
+
+                        continue;
+                }
+
+                if ((ret != GDB_RECEIVE_OK) || !(_packet_handle())) {
+                        break;
+                }
+        }
+
+        _cache_expire();
+
+        (void)close(_state.fd);
+        _state.fd = -1;
+
+        commands_printf("gdb disconnected. %llu packets, %llu page hits, %llu misses, %llu fetches, %llu flushes\n",
+            (unsigned long long)_state.packet_count,
+            (unsigned long long)(_state.cache->lru->hits - hits),
+            (unsigned long long)(_state.cache->lru->misses - misses),
+            (unsigned long long)(_state.cache->fetch_count - fetch_count),
+            (unsigned long long)(_state.cache->flush_count - flush_count));
+}
+
+static bool
+_listen(uint16_t port)
+{
+        if ((_state.listen_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+                return false;
+        }
+
+        const int reuse = 1;
+
+        (void)setsockopt(_state.listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in address = {
+                .sin_family = AF_INET,
+                .sin_port   = htons(port),
+                .sin_addr   = {
+                        .s_addr = htonl(INADDR_LOOPBACK)
+                }
+        };
+
+        if (((bind(_state.listen_fd, (const struct sockaddr *)&address, sizeof(address))) != 0) ||
+            ((listen(_state.listen_fd, 1)) != 0)) {
+                (void)close(_state.listen_fd);
+                _state.listen_fd = -1;
+
+                return false;
+        }
+
+        return true;
+}
+
+static void
+_gdbserver(const parser_t *parser)
+{
+        if (parser->stream->argc != 1) {
+                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+        }
+
+        const object_t * const port_obj = parser->stream->args_obj[0];
+
+        if (port_obj->type != OBJECT_TYPE_INTEGER) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+        }
+
+        if ((port_obj->as.integer <= 0) || (port_obj->as.integer > 0xFFFF)) {
+                commands_printf("Invalid port\n");
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        const uint16_t port = port_obj->as.integer;
+
+        if ((_state.cache = memcache_new(GDB_PAGE_SIZE, GDB_PAGE_COUNT, GDB_READAHEAD_MAX)) == NULL) {
+                commands_status_return(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+        }
+
+        if (!(_listen(port))) {
+                memcache_delete(_state.cache);
+                _state.cache = NULL;
+
+                commands_printf("Unable to listen on localhost:%u\n", port);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        commands_printf("Listening on localhost:%u. Press Ctrl-C to stop\n", port);
+
+        shell_interrupt_begin();
+
+        while (!(shell_interrupted())) {
+                struct pollfd pollfd = {
+                        .fd     = _state.listen_fd,
+                        .events = POLLIN
+                };
+
+                if ((poll(&pollfd, 1, GDB_POLL_TIMEOUT)) <= 0) {
+                        continue;
+                }
+
+                if ((_state.fd = accept(_state.listen_fd, NULL, NULL)) < 0) {
+                        continue;
+                }
+
+                _session();
+        }
+
+        shell_interrupt_end();
+
+        (void)close(_state.listen_fd);
+        _state.listen_fd = -1;
+
+        memcache_delete(_state.cache);
+        _state.cache = NULL;
+}
+#else
+static void
+_gdbserver(const parser_t *parser)
+{
+        (void)parser;
+
+        commands_printf("Not supported on Windows\n");
+        commands_status_return(COMMANDS_STATUS_ERROR);
+}
+#endif /* !_WIN32 */
+
+const command_t command_gdbserver = {
+        .name        = "gdbserver",
+        .description = "Serve target memory to gdb over the remote serial protocol",
+        .help        = "<port:int>",
+        .func        = _gdbserver,
+        .arg_count   = 1
+};
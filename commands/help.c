@@ -73,24 +73,11 @@ _help_arg1(const parser_t *parser)
         const char * const command_name =
             parser->stream->args_obj[0]->as.symbol;
 
-        const command_t *command;
-        command = commands_find(command_name);
+        const command_t * const command = commands_find(command_name);
 
         if (command == NULL) {
-                /* It might be an alias */
-                env_pair_t pair;
-                if (!(env_get(command_name, &pair))) {
-                        commands_printf("Command \"%s\" not found\n", command_name);
-                        commands_status_return(COMMANDS_STATUS_ERROR);
-                }
-
-                const object_t * const command_obj = pair.value;
-
-                if (command_obj->type != OBJECT_TYPE_COMMAND) {
-                        commands_status_return(COMMANDS_STATUS_EXPECTED_SYMBOL);
-                }
-
-                command = command_obj->as.command;
+                commands_printf("Command \"%s\" not found\n", command_name);
+                commands_status_return(COMMANDS_STATUS_ERROR);
         }
 
         commands_printf("Usage: %s", command_name);
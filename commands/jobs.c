@@ -0,0 +1,24 @@
+#include <sys/cdefs.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "jobs.h"
+#include "parser.h"
+
+static void
+_jobs(const parser_t *parser)
+{
+        (void)parser;
+
+        jobs_list();
+}
+
+const command_t command_jobs = {
+        .name        = "jobs",
+        .description = "Lists the jobs running in the background",
+        .help        = "",
+        .func        = _jobs,
+        .arg_count   = 0
+};
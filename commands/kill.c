@@ -0,0 +1,30 @@
+#include <sys/cdefs.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "jobs.h"
+#include "parser.h"
+
+static void
+_kill(const parser_t *parser)
+{
+        const object_t * const id_obj = parser->stream->args_obj[0];
+
+        if (id_obj->type != OBJECT_TYPE_INTEGER) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+        }
+
+        if (!(jobs_kill(id_obj->as.integer))) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+}
+
+const command_t command_kill = {
+        .name        = "kill",
+        .description = "Cancels a background job once its current chunk is transferred",
+        .help        = "<id:int>",
+        .func        = _kill,
+        .arg_count   = 1
+};
@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "ring.h"
+#include "logfmt.h"
+#include "timer.h"
+
+/* Poll interval when the ring buffer is idle. It doubles on every empty poll
+ * until it reaches the maximum, and drops back to the minimum as soon as
+ * there's data */
+#define LOG_POLL_INTERVAL_MIN   (1000)
+#define LOG_POLL_INTERVAL_MAX   (250000)
+
+/* How long a burst is drained before control goes back to the prompt */
+#define LOG_DRAIN_BUDGET        (20000)
+
+/* A partial line is held back at most this long (in bytes) */
+#define LOG_LINE_MAX            (4096)
+
+/* Largest record the 16-bit size field can describe */
+#define LOG_RECORD_MAX          (0xFFFF)
+
+static struct {
+        bool running;
+        ring_t ring;
+        FILE *fp;
+        char *path;
+        char *buffer;
+        size_t buffer_size;
+        size_t pending_size;
+        uint32_t interval;
+
+        /* Only in deferred-format mode */
+        logfmt_t *logfmt;
+        uint8_t *records;
+        size_t records_buffer_size;
+        size_t records_size;
+} _state;
+
+static void
+_log_output(const char *buffer, size_t size)
+{
+        if (size == 0) {
+                return;
+        }
+
+        if (_state.fp != NULL) {
+                (void)fwrite(buffer, 1, size, _state.fp);
+                (void)fflush(_state.fp);
+        } else {
+                shell_async_write(buffer, size);
+        }
+}
+
+static void
+_log_flush(bool partial)
+{
+        if (_state.fp != NULL) {
+                partial = true;
+        }
+
+        size_t size;
+        size = _state.pending_size;
+
+        if (!partial) {
+                /* Only complete lines go above the prompt */
+                while ((size > 0) && (_state.buffer[size - 1] != '\n')) {
+                        size--;
+                }
+
+                if ((_state.pending_size - size) >= LOG_LINE_MAX) {
+                        size = _state.pending_size;
+                }
+        }
+
+        _log_output(_state.buffer, size);
+
+        _state.pending_size -= size;
+
+        (void)memmove(_state.buffer, &_state.buffer[size], _state.pending_size);
+}
+
+static void
+_log_stop(void)
+{
+        if (!_state.running) {
+                return;
+        }
+
+        shell_idle_set(NULL);
+
+        _log_flush(true);
+
+        if (_state.fp != NULL) {
+                (void)fclose(_state.fp);
+        }
+
+        free(_state.path);
+        free(_state.buffer);
+        free(_state.records);
+        logfmt_delete(_state.logfmt);
+
+        _state.running = false;
+        _state.fp = NULL;
+        _state.path = NULL;
+        _state.buffer = NULL;
+        _state.records = NULL;
+        _state.logfmt = NULL;
+}
+
+static void
+_log_records_expand(void)
+{
+        size_t offset;
+        offset = 0;
+
+        while (offset < _state.records_size) {
+                size_t record_size;
+                size_t text_len;
+
+                /* After a flush, there's always room for one more record */
+                char * const text = &_state.buffer[_state.pending_size];
+
+                const logfmt_ret_t ret = logfmt_record_expand(_state.logfmt,
+                    &_state.records[offset], _state.records_size - offset,
+                    &record_size, text, &text_len);
+
+                if (ret == LOGFMT_RET_INCOMPLETE) {
+                        break;
+                }
+
+                if (ret == LOGFMT_RET_CORRUPT) {
+                        _log_flush(true);
+
+                        char message[64];
+                        const int len = snprintf(message, sizeof(message),
+                            "<log stream corrupt, %zuB dropped>\n",
+                            _state.records_size - offset);
+
+                        _log_output(message, len);
+
+                        offset = _state.records_size;
+
+                        break;
+                }
+
+                _state.pending_size += text_len;
+                offset += record_size;
+
+                _log_flush(false);
+        }
+
+        _state.records_size -= offset;
+
+        (void)memmove(_state.records, &_state.records[offset], _state.records_size);
+}
+
+static ring_ret_t
+_log_read(void)
+{
+        size_t read_size;
+
+        if (_state.logfmt == NULL) {
+                char * const buffer = &_state.buffer[_state.pending_size];
+                const size_t size = _state.buffer_size - _state.pending_size;
+
+                const ring_ret_t ret = ring_read(&_state.ring, buffer, size, &read_size);
+
+                if (ret != RING_RET_OK) {
+                        return ret;
+                }
+
+                _state.pending_size += read_size;
+
+                _log_flush(false);
+
+                return RING_RET_OK;
+        }
+
+        uint8_t * const buffer = &_state.records[_state.records_size];
+        const size_t size = _state.records_buffer_size - _state.records_size;
+
+        const ring_ret_t ret = ring_read(&_state.ring, buffer, size, &read_size);
+
+        if (ret != RING_RET_OK) {
+                return ret;
+        }
+
+        _state.records_size += read_size;
+
+        _log_records_expand();
+
+        return RING_RET_OK;
+}
+
+static uint32_t
+_log_idle(void)
+{
+        const uint64_t start_time = timer_us_get();
+
+        bool drained;
+        drained = false;
+
+        do {
+                bool pending;
+
+                if ((ring_poll(&_state.ring, &pending)) != RING_RET_OK) {
+                        goto error;
+                }
+
+                if (!pending) {
+                        break;
+                }
+
+                if ((_log_read()) != RING_RET_OK) {
+                        goto error;
+                }
+
+                drained = true;
+        } while ((timer_us_get() - start_time) < LOG_DRAIN_BUDGET);
+
+        if (drained) {
+                _state.interval = LOG_POLL_INTERVAL_MIN;
+        } else if (_state.interval < LOG_POLL_INTERVAL_MAX) {
+                _state.interval *= 2;
+
+                if (_state.interval > LOG_POLL_INTERVAL_MAX) {
+                        _state.interval = LOG_POLL_INTERVAL_MAX;
+                }
+        }
+
+        return _state.interval;
+
+error:
+        _log_stop();
+
+        static const char message[] = "Log stopped: unable to read ring buffer\n";
+
+        shell_async_write(message, sizeof(message) - 1);
+
+        return LOG_POLL_INTERVAL_MAX;
+}
+
+static void
+_log_status(void)
+{
+        if (!_state.running) {
+                commands_printf("Not logging\n");
+
+                return;
+        }
+
+        commands_printf("Logging from 0x%08X (%uB) to %s, %u bytes lost\n",
+            _state.ring.address,
+            _state.ring.size,
+            (_state.path != NULL) ? _state.path : "terminal",
+            _state.ring.lost);
+
+        if (_state.logfmt != NULL) {
+                commands_printf("Formats from \"%s\", %u in use\n",
+                    _state.logfmt->elf->path,
+                    _state.logfmt->count);
+        }
+}
+
+static void
+_log_start(const object_t *address_obj, const object_t *elf_obj,
+    const object_t *path_obj)
+{
+        uint32_t address;
+
+        if (!(commands_address_get(address_obj, &address))) {
+                return;
+        }
+
+        if ((elf_obj != NULL) && (elf_obj->type != OBJECT_TYPE_STRING)) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+        }
+
+        if ((path_obj != NULL) && (path_obj->type != OBJECT_TYPE_STRING)) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+        }
+
+        _log_stop();
+
+        ring_t ring;
+
+        switch (ring_attach(&ring, address)) {
+        case RING_RET_OK:
+                break;
+        case RING_RET_INVALID_MAGIC:
+                commands_printf("No ring buffer found at 0x%08X\n", address);
+                commands_status_return(COMMANDS_STATUS_INVALID_ADDRESS);
+        case RING_RET_INVALID_SIZE:
+                commands_status_return(COMMANDS_STATUS_INVALID_SIZE);
+        default:
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        /* The format strings are indexed once, here */
+        logfmt_t *logfmt;
+        logfmt = NULL;
+
+        if (elf_obj != NULL) {
+                if ((logfmt = logfmt_new(elf_obj->as.string)) == NULL) {
+                        commands_printf("Unable to load ELF \"%s\"\n", elf_obj->as.string);
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+        }
+
+        FILE *fp;
+        fp = NULL;
+
+        if (path_obj != NULL) {
+                if ((fp = fopen(path_obj->as.string, "a")) == NULL) {
+                        logfmt_delete(logfmt);
+
+                        commands_printf("Unable to open \"%s\"\n", path_obj->as.string);
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+        }
+
+        const size_t buffer_size = ring.size + LOG_LINE_MAX + LOGFMT_TEXT_MAX;
+        char * const buffer = malloc(buffer_size);
+
+        const size_t records_buffer_size =
+            (logfmt != NULL) ? (ring.size + LOG_RECORD_MAX) : 0;
+        uint8_t * const records =
+            (logfmt != NULL) ? malloc(records_buffer_size) : NULL;
+
+        if ((buffer == NULL) || ((logfmt != NULL) && (records == NULL))) {
+                if (fp != NULL) {
+                        (void)fclose(fp);
+                }
+
+                free(buffer);
+                free(records);
+                logfmt_delete(logfmt);
+
+                commands_status_return(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+        }
+
+        _state.running = true;
+        _state.ring = ring;
+        _state.fp = fp;
+        _state.path = (path_obj != NULL) ? strdup(path_obj->as.string) : NULL;
+        _state.buffer = buffer;
+        _state.buffer_size = buffer_size;
+        _state.pending_size = 0;
+        _state.interval = LOG_POLL_INTERVAL_MIN;
+        _state.logfmt = logfmt;
+        _state.records = records;
+        _state.records_buffer_size = records_buffer_size;
+        _state.records_size = 0;
+
+        shell_idle_set(_log_idle);
+}
+
+static void
+_log(const parser_t *parser)
+{
+        object_t * const * const args_obj = parser->stream->args_obj;
+
+        const int argc = parser->stream->argc;
+
+        if (argc == 0) {
+                _log_status();
+
+                return;
+        }
+
+        /* Any other symbol is taken to be the ring's address */
+        if ((args_obj[0]->type != OBJECT_TYPE_SYMBOL) ||
+            (((strcmp(args_obj[0]->as.symbol, "stop")) != 0) &&
+             ((strcmp(args_obj[0]->as.symbol, "fmt")) != 0))) {
+                switch (argc) {
+                case 1:
+                        _log_start(args_obj[0], NULL, NULL);
+                        break;
+                case 2:
+                        _log_start(args_obj[0], NULL, args_obj[1]);
+                        break;
+                default:
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                return;
+        }
+
+        const char * const mode = args_obj[0]->as.symbol;
+
+        if ((strcmp(mode, "stop")) == 0) {
+                if (argc != 1) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                _log_stop();
+        } else if ((strcmp(mode, "fmt")) == 0) {
+                switch (argc) {
+                case 3:
+                        _log_start(args_obj[1], args_obj[2], NULL);
+                        break;
+                case 4:
+                        _log_start(args_obj[1], args_obj[2], args_obj[3]);
+                        break;
+                default:
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+        }
+}
+
+const command_t command_log = {
+        .name        = "log",
+        .alias       = ">>",
+        .description = "Stream the target's log ring buffer",
+        .help        = "[<address:int|sym> [path:str] | fmt <address:int|sym> <elf:str> [path:str] | stop]",
+        .func        = _log,
+        .arg_count   = -1
+};
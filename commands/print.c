@@ -0,0 +1,509 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "device.h"
+#include "dwarf.h"
+#include "symbols.h"
+
+/* Largest object that is downloaded */
+#define PRINT_SIZE_MAX          0x100000
+
+/* Longer arrays are cut short, though all of it is downloaded */
+#define PRINT_ELEMENTS_MAX      64
+
+static void _value_print(const dwarf_t *dwarf, const dwarf_type_t *type,
+    const uint8_t *data, uint32_t depth);
+
+static int64_t
+_sign_extend(uint64_t value, uint32_t bit_size)
+{
+        if ((bit_size == 0) || (bit_size >= 64)) {
+                return (int64_t)value;
+        }
+
+        const uint64_t sign = (uint64_t)1 << (bit_size - 1);
+
+        return (int64_t)((value ^ sign) - sign);
+}
+
+static bool
+_encoding_is_signed(uint32_t encoding)
+{
+        return ((encoding == DWARF_ENCODING_SIGNED) ||
+                (encoding == DWARF_ENCODING_SIGNED_CHAR));
+}
+
+static void
+_indent_print(uint32_t depth)
+{
+        commands_printf("%*s", depth * 2, "");
+}
+
+static void
+_char_print(uint8_t c)
+{
+        switch (c) {
+        case '\0':
+                commands_printf("\\0");
+                break;
+        case '\n':
+                commands_printf("\\n");
+                break;
+        case '\r':
+                commands_printf("\\r");
+                break;
+        case '\t':
+                commands_printf("\\t");
+                break;
+        case '\"':
+        case '\'':
+        case '\\':
+                commands_printf("\\%c", c);
+                break;
+        default:
+                if (isprint(c)) {
+                        commands_printf("%c", c);
+                } else {
+                        commands_printf("\\x%02X", c);
+                }
+                break;
+        }
+}
+
+static void
+_integer_print(uint64_t value, uint32_t bit_size, uint32_t encoding)
+{
+        switch (encoding) {
+        case DWARF_ENCODING_BOOLEAN:
+                commands_printf("%s", (value != 0) ? "true" : "false");
+                break;
+        case DWARF_ENCODING_SIGNED_CHAR:
+        case DWARF_ENCODING_UNSIGNED_CHAR:
+                if (_encoding_is_signed(encoding)) {
+                        commands_printf("%lli '", (long long)_sign_extend(value, bit_size));
+                } else {
+                        commands_printf("%llu '", (unsigned long long)value);
+                }
+
+                _char_print(value);
+
+                commands_printf("'");
+                break;
+        default:
+                if (_encoding_is_signed(encoding)) {
+                        commands_printf("%lli", (long long)_sign_extend(value, bit_size));
+                } else {
+                        commands_printf("%llu", (unsigned long long)value);
+                }
+                break;
+        }
+}
+
+static void
+_base_print(const dwarf_t *dwarf, const dwarf_type_t *type, const uint8_t *data)
+{
+        const uint64_t value = dwarf_unsigned_get(dwarf, data, type->size);
+
+        if (type->encoding == DWARF_ENCODING_FLOAT) {
+                if (type->size == sizeof(float)) {
+                        const uint32_t bits = value;
+                        float f;
+
+                        (void)memcpy(&f, &bits, sizeof(f));
+
+                        commands_printf("%g", f);
+
+                        return;
+                }
+
+                if (type->size == sizeof(double)) {
+                        double d;
+
+                        (void)memcpy(&d, &value, sizeof(d));
+
+                        commands_printf("%g", d);
+
+                        return;
+                }
+        }
+
+        _integer_print(value, type->size * 8, type->encoding);
+}
+
+static void
+_pointer_print(const dwarf_t *dwarf, const dwarf_type_t *type, const uint8_t *data)
+{
+        const uint32_t address = dwarf_unsigned_get(dwarf, data, type->size);
+
+        commands_printf("0x%08X", address);
+
+        const symbols_t * const symbols = symbols_loaded_get();
+
+        const symbol_t *symbol;
+
+        if ((address == 0) || (symbols == NULL) ||
+            ((symbol = symbols_address_find(symbols, address)) == NULL)) {
+                return;
+        }
+
+        if (symbol->address == address) {
+                commands_printf(" <%s>", symbol->name);
+        } else {
+                commands_printf(" <%s+0x%X>", symbol->name, address - symbol->address);
+        }
+}
+
+static void
+_enum_value_print(const dwarf_type_t *type, uint64_t value, uint32_t bit_size)
+{
+        const int64_t signed_value = _encoding_is_signed(type->encoding) ?
+            _sign_extend(value, bit_size) : (int64_t)value;
+
+        for (uint32_t i = 0; i < type->enumerator_count; i++) {
+                if (type->enumerators[i].value == signed_value) {
+                        commands_printf("%s (%lli)", type->enumerators[i].name, (long long)signed_value);
+
+                        return;
+                }
+        }
+
+        commands_printf("%lli", (long long)signed_value);
+}
+
+static bool
+_type_is_char(const dwarf_type_t *type)
+{
+        return (type != NULL) && (type->kind == DWARF_TYPE_BASE) && (type->size == 1) &&
+               ((type->encoding == DWARF_ENCODING_SIGNED_CHAR) ||
+                (type->encoding == DWARF_ENCODING_UNSIGNED_CHAR));
+}
+
+static bool
+_type_is_scalar(const dwarf_type_t *type)
+{
+        return (type != NULL) && ((type->kind == DWARF_TYPE_BASE) ||
+                                  (type->kind == DWARF_TYPE_POINTER) ||
+                                  (type->kind == DWARF_TYPE_ENUM));
+}
+
+static void
+_array_print(const dwarf_t *dwarf, const dwarf_type_t *type, const uint8_t *data,
+    uint32_t depth)
+{
+        const dwarf_type_t * const element = type->element;
+
+        /* Character arrays read best as strings */
+        if (_type_is_char(element)) {
+                uint32_t length;
+                length = 0;
+
+                while ((length < type->count) && (data[length] != '\0')) {
+                        length++;
+                }
+
+                commands_printf("\"");
+
+                for (uint32_t i = 0; i < length; i++) {
+                        _char_print(data[i]);
+                }
+
+                commands_printf("\"");
+
+                return;
+        }
+
+        const uint32_t count = (type->count < PRINT_ELEMENTS_MAX) ? type->count : PRINT_ELEMENTS_MAX;
+
+        if (_type_is_scalar(element)) {
+                commands_printf("{");
+
+                for (uint32_t i = 0; i < count; i++) {
+                        commands_printf((i == 0) ? "" : ", ");
+
+                        _value_print(dwarf, element, &data[i * element->size], depth);
+                }
+
+                if (count < type->count) {
+                        commands_printf(", ... %u more", type->count - count);
+                }
+
+                commands_printf("}");
+
+                return;
+        }
+
+        commands_printf("{\n");
+
+        for (uint32_t i = 0; i < count; i++) {
+                _indent_print(depth + 1);
+                commands_printf("[%u] = ", i);
+
+                _value_print(dwarf, element, &data[i * element->size], depth + 1);
+
+                commands_printf("\n");
+        }
+
+        if (count < type->count) {
+                _indent_print(depth + 1);
+                commands_printf("... %u more\n", type->count - count);
+        }
+
+        _indent_print(depth);
+        commands_printf("}");
+}
+
+static void
+_member_print(const dwarf_t *dwarf, const dwarf_member_t *member, const uint8_t *data,
+    uint32_t depth)
+{
+        const dwarf_type_t * const type = member->type;
+
+        if (member->bit_size == 0) {
+                _value_print(dwarf, type, &data[member->offset], depth);
+
+                return;
+        }
+
+        const uint64_t value = dwarf_bits_get(dwarf, data, member->bit_offset, member->bit_size);
+
+        if ((type != NULL) && (type->kind == DWARF_TYPE_ENUM)) {
+                _enum_value_print(type, value, member->bit_size);
+        } else {
+                _integer_print(value, member->bit_size, (type != NULL) ? type->encoding : DWARF_ENCODING_UNSIGNED);
+        }
+}
+
+static void
+_struct_print(const dwarf_t *dwarf, const dwarf_type_t *type, const uint8_t *data,
+    uint32_t depth)
+{
+        commands_printf("{\n");
+
+        for (uint32_t i = 0; i < type->member_count; i++) {
+                const dwarf_member_t * const member = &type->members[i];
+
+                _indent_print(depth + 1);
+                commands_printf("%s = ", (member->name != NULL) ? member->name : "<anonymous>");
+
+                _member_print(dwarf, member, data, depth + 1);
+
+                commands_printf("\n");
+        }
+
+        _indent_print(depth);
+        commands_printf("}");
+}
+
+static void
+_value_print(const dwarf_t *dwarf, const dwarf_type_t *type, const uint8_t *data,
+    uint32_t depth)
+{
+        if (type == NULL) {
+                commands_printf("?");
+
+                return;
+        }
+
+        switch (type->kind) {
+        case DWARF_TYPE_BASE:
+                _base_print(dwarf, type, data);
+                break;
+        case DWARF_TYPE_POINTER:
+                _pointer_print(dwarf, type, data);
+                break;
+        case DWARF_TYPE_ENUM:
+                _enum_value_print(type, dwarf_unsigned_get(dwarf, data, type->size), type->size * 8);
+                break;
+        case DWARF_TYPE_STRUCT:
+        case DWARF_TYPE_UNION:
+                _struct_print(dwarf, type, data, depth);
+                break;
+        case DWARF_TYPE_ARRAY:
+                _array_print(dwarf, type, data, depth);
+                break;
+        default:
+                commands_printf("<%uB>", type->size);
+                break;
+        }
+}
+
+/* Anonymous structures and unions are looked into, as C does */
+static const dwarf_member_t *
+_member_find(const dwarf_type_t *type, const char *name, uint32_t *offset)
+{
+        if ((type == NULL) || ((type->kind != DWARF_TYPE_STRUCT) && (type->kind != DWARF_TYPE_UNION))) {
+                return NULL;
+        }
+
+        for (uint32_t i = 0; i < type->member_count; i++) {
+                const dwarf_member_t * const member = &type->members[i];
+
+                if (member->name == NULL) {
+                        const dwarf_member_t * const inner = _member_find(member->type, name, offset);
+
+                        if (inner != NULL) {
+                                *offset += member->offset;
+
+                                return inner;
+                        }
+
+                        continue;
+                }
+
+                if ((strcmp(member->name, name)) == 0) {
+                        return member;
+                }
+        }
+
+        return NULL;
+}
+
+static void
+_print(const parser_t *parser)
+{
+        const object_t * const name_obj = parser->stream->args_obj[0];
+
+        if (name_obj->type != OBJECT_TYPE_SYMBOL) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_SYMBOL);
+        }
+
+        if (symbols_loaded_get() == NULL) {
+                commands_printf("No symbols loaded. Use \"symbols load <elf>\"\n");
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        dwarf_t * const dwarf = symbols_loaded_dwarf_get();
+
+        if (dwarf == NULL) {
+                commands_printf("No debug information in \"%s\"\n", symbols_loaded_get()->path);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        /* A variable, then any number of ".member" */
+        char path[256];
+
+        (void)snprintf(path, sizeof(path), "%s", name_obj->as.symbol);
+
+        char *member_name;
+
+        if ((member_name = strchr(path, '.')) != NULL) {
+                *member_name++ = '\0';
+        }
+
+        const dwarf_variable_t * const variable = dwarf_variable_find(dwarf, path);
+
+        if ((variable == NULL) || !variable->has_address) {
+                commands_status_return(COMMANDS_STATUS_UNDEFINED_SYMBOL);
+        }
+
+        uint32_t address;
+        address = variable->address;
+
+        const dwarf_type_t *type;
+        type = variable->type;
+
+        const dwarf_member_t *member;
+        member = NULL;
+
+        while (member_name != NULL) {
+                char * const next_name = strchr(member_name, '.');
+
+                if (next_name != NULL) {
+                        *next_name = '\0';
+                }
+
+                /* Nothing can be taken out of a bit field */
+                if ((member != NULL) && (member->bit_size != 0)) {
+                        member = NULL;
+                } else {
+                        uint32_t offset;
+                        offset = 0;
+
+                        member = _member_find(type, member_name, &offset);
+
+                        /* Bit fields are read from their structure */
+                        if ((member != NULL) && (member->bit_size == 0)) {
+                                address += offset + member->offset;
+                        } else if (member != NULL) {
+                                address += offset;
+                        }
+                }
+
+                if (member == NULL) {
+                        commands_printf("No member \"%s\"\n", member_name);
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+
+                type = member->type;
+                member_name = (next_name != NULL) ? (next_name + 1) : NULL;
+        }
+
+        /* Only the bytes of the object itself come over */
+        uint32_t size;
+        uint32_t data_offset;
+        data_offset = 0;
+
+        if ((member != NULL) && (member->bit_size != 0)) {
+                data_offset = member->bit_offset / 8;
+                size = (((member->bit_offset % 8) + member->bit_size + 7) / 8);
+        } else {
+                size = (type != NULL) ? type->size : 0;
+        }
+
+        if ((size == 0) || (size > PRINT_SIZE_MAX)) {
+                commands_status_return(COMMANDS_STATUS_INVALID_SIZE);
+        }
+
+        uint8_t * const buffer = malloc(data_offset + size);
+
+        if (buffer == NULL) {
+                commands_status_return(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+        }
+
+        if ((device_read(&buffer[data_offset], address + data_offset, size)) != DEVICE_RET_OK) {
+                free(buffer);
+
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        commands_printf("%s %s @ 0x%08X (%uB) = ",
+            (type != NULL) ? type->name : "?",
+            name_obj->as.symbol,
+            address + data_offset,
+            size);
+
+        if ((member != NULL) && (member->bit_size != 0)) {
+                const dwarf_member_t bits = {
+                        .bit_offset = member->bit_offset,
+                        .bit_size   = member->bit_size,
+                        .type       = member->type
+                };
+
+                _member_print(dwarf, &bits, buffer, 0);
+        } else {
+                _value_print(dwarf, type, buffer, 0);
+        }
+
+        commands_printf("\n");
+
+        free(buffer);
+}
+
+const command_t command_print = {
+        .name        = "print",
+        .description = "Print a variable on the target, decoded with its type from the ELF's debug information",
+        .help        = "<name[.member...]:sym>",
+        .func        = _print,
+        .arg_count   = 1
+};
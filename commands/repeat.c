@@ -0,0 +1,43 @@
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "types.h"
+#include "commands.h"
+#include "eval.h"
+#include "parser.h"
+
+static eval_ret_t
+_repeat(const parser_t *parser, const ast_node_t *form)
+{
+        if (form->argc < 2) {
+                commands_status_set(COMMANDS_STATUS_ARGC_MISMATCH);
+
+                return EVAL_RET_FAILED;
+        }
+
+        int count;
+
+        if (!(eval_integer_get(parser, form->args, &count))) {
+                return EVAL_RET_FAILED;
+        }
+
+        /* The body was parsed once, along with the line */
+        for (int i = 0; i < count; i++) {
+                const eval_ret_t ret = eval_forms(parser, form->args->next);
+
+                if (ret != EVAL_RET_OK) {
+                        return ret;
+                }
+        }
+
+        return EVAL_RET_OK;
+}
+
+const command_t command_repeat = {
+        .name        = "repeat",
+        .description = "Runs commands a number of times",
+        .help        = "<count:int|form> (<command> ...)...",
+        .form_func   = _repeat,
+        .arg_count   = -1
+};
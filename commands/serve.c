@@ -0,0 +1,649 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+#include <sys/stat.h>
+
+#include <ssshell.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "device.h"
+#include "lru.h"
+#include "timer.h"
+
+/*
+ * Layout of the mailbox in target RAM (all fields big-endian):
+ *
+ *   0x00 uint32_t magic         SERVE_MAGIC
+ *   0x04 uint32_t request_seq   Incremented by the target to post a request
+ *   0x08 uint32_t op            SERVE_OP_*
+ *   0x0C uint32_t handle
+ *   0x10 int32_t  offset        SEEK: offset, relative to whence
+ *   0x14 uint32_t size          READ: number of bytes requested
+ *   0x18 uint32_t buffer        READ: where in target RAM to put the data
+ *   0x1C uint32_t whence        SEEK: 0 (set), 1 (current), 2 (end)
+ *   0x20 int32_t  result        Written by the host. Negative on error
+ *   0x24 uint32_t response_seq  Written by the host, last
+ *   0x40 char     path[192]     OPEN: path relative to the served directory
+ *
+ * The target waits for response_seq to be equal to request_seq, then reads
+ * result. For READ, the data is in place by then */
+
+#define SERVE_MAGIC                     0x46535256 /* "FSRV" */
+
+#define SERVE_REQUEST_OFFSET            0x04
+#define SERVE_REQUEST_SIZE              0x1C
+#define SERVE_RESPONSE_OFFSET           0x20
+#define SERVE_RESPONSE_SIZE             0x08
+#define SERVE_PATH_OFFSET               0x40
+#define SERVE_PATH_SIZE                 192
+
+#define SERVE_OP_OPEN                   1
+#define SERVE_OP_CLOSE                  2
+#define SERVE_OP_READ                   3
+#define SERVE_OP_SEEK                   4
+#define SERVE_OP_SIZE                   5
+
+#define SERVE_ERROR_NOT_FOUND           (-1)
+#define SERVE_ERROR_INVALID_HANDLE      (-2)
+#define SERVE_ERROR_TOO_MANY_OPEN       (-3)
+#define SERVE_ERROR_IO                  (-4)
+#define SERVE_ERROR_INVALID_REQUEST     (-5)
+
+#define SERVE_HANDLE_COUNT              16
+
+#define SERVE_BLOCK_SIZE                0x8000
+#define SERVE_CACHE_BLOCK_COUNT         512
+
+/* Largest single read. This is all of HWRAM */
+#define SERVE_TRANSFER_MAX              0x100000
+
+/* Read-ahead window in blocks. It starts at the minimum on the first
+ * sequential read and doubles on every one after that */
+#define SERVE_READAHEAD_MIN             2
+#define SERVE_READAHEAD_MAX             32
+
+/* Files the cache can hold blocks of at once */
+#define SERVE_FILE_COUNT                64
+
+#define SERVE_POLL_INTERVAL_MIN         (200)
+#define SERVE_POLL_INTERVAL_MAX         (20000)
+
+typedef struct {
+        bool used;
+        FILE *fp;
+        uint32_t id;
+        uint32_t size;
+        uint32_t position;
+
+        /* Where the next read starts if the target reads sequentially */
+        uint32_t sequential_position;
+        uint32_t readahead;
+} serve_handle_t;
+
+/* What the cache knows a file by. A file keeps its ID for as long as it's
+ * unchanged, so opening it again finds its blocks */
+typedef struct {
+        bool used;
+        dev_t dev;
+        ino_t ino;
+        time_t mtime;
+        off_t size;
+        uint32_t id;
+} serve_file_t;
+
+static struct {
+        char *root;
+
+        serve_handle_t handles[SERVE_HANDLE_COUNT];
+
+        serve_file_t files[SERVE_FILE_COUNT];
+        /* Replaced in turn once they're all used */
+        uint32_t file_next;
+        uint32_t file_id_next;
+
+        lru_t *cache;
+        uint8_t *transfer;
+
+        uint32_t request_count;
+        uint64_t bytes_served;
+} _state;
+
+/* IDs are never reused, so the blocks of a file that was replaced are
+ * never served, and only age out of the cache */
+static uint32_t
+_file_id_get(const struct stat *stat_buffer)
+{
+        for (uint32_t i = 0; i < SERVE_FILE_COUNT; i++) {
+                const serve_file_t * const file = &_state.files[i];
+
+                if (file->used &&
+                    (file->dev == stat_buffer->st_dev) &&
+                    (file->ino == stat_buffer->st_ino) &&
+                    (file->mtime == stat_buffer->st_mtime) &&
+                    (file->size == stat_buffer->st_size)) {
+                        return file->id;
+                }
+        }
+
+        serve_file_t * const file = &_state.files[_state.file_next];
+
+        _state.file_next = (_state.file_next + 1) % SERVE_FILE_COUNT;
+
+        *file = (serve_file_t) {
+                .used  = true,
+                .dev   = stat_buffer->st_dev,
+                .ino   = stat_buffer->st_ino,
+                .mtime = stat_buffer->st_mtime,
+                .size  = stat_buffer->st_size,
+                .id    = _state.file_id_next++
+        };
+
+        return file->id;
+}
+
+static bool
+_path_valid(const char *path)
+{
+        if ((*path == '\0') || (*path == '/') || (*path == '\\')) {
+                return false;
+        }
+
+        /* Don't let the target escape the served directory */
+        const char *component;
+        component = path;
+
+        while (component != NULL) {
+                if ((strncmp(component, "..", 2) == 0) &&
+                    ((component[2] == '/') || (component[2] == '\0'))) {
+                        return false;
+                }
+
+                component = strchr(component, '/');
+
+                if (component != NULL) {
+                        component++;
+                }
+        }
+
+        return (strchr(path, '\\') == NULL) && (strchr(path, ':') == NULL);
+}
+
+/* Follows symbolic links. Returns NULL if the path doesn't exist, or a
+ * string to free otherwise */
+static char *
+_path_resolve(const char *path)
+{
+#if defined(_WIN32)
+        return _fullpath(NULL, path, 0);
+#else
+        return realpath(path, NULL);
+#endif /* _WIN32 */
+}
+
+/* A symbolic link inside the served directory can still point outside of
+ * it, so it's where the path leads that's checked. The root is resolved */
+static bool
+_path_inside_root(const char *resolved_path)
+{
+        const size_t root_size = strlen(_state.root);
+
+        if ((strncmp(resolved_path, _state.root, root_size)) != 0) {
+                return false;
+        }
+
+        const bool root_separated = (root_size > 0) &&
+                                    ((_state.root[root_size - 1] == '/') ||
+                                     (_state.root[root_size - 1] == '\\'));
+
+        return root_separated ||
+               (resolved_path[root_size] == '/') ||
+               (resolved_path[root_size] == '\\');
+}
+
+static serve_handle_t *
+_handle_get(uint32_t handle)
+{
+        if ((handle >= SERVE_HANDLE_COUNT) || !_state.handles[handle].used) {
+                return NULL;
+        }
+
+        return &_state.handles[handle];
+}
+
+static void
+_handle_close(serve_handle_t *handle)
+{
+        if (handle->fp != NULL) {
+                (void)fclose(handle->fp);
+        }
+
+        *handle = (serve_handle_t) {
+                .used = false
+        };
+}
+
+static const lru_block_t *
+_block_get(serve_handle_t *handle, uint32_t index, bool prefetch)
+{
+        const uint64_t key = ((uint64_t)handle->id << 32) | index;
+
+        const lru_block_t *cached;
+
+        if (prefetch) {
+                cached = lru_peek(_state.cache, key);
+        } else {
+                cached = lru_get(_state.cache, key);
+        }
+
+        if (cached != NULL) {
+                return cached;
+        }
+
+        const uint32_t offset = index * SERVE_BLOCK_SIZE;
+
+        if (offset >= handle->size) {
+                return NULL;
+        }
+
+        lru_block_t * const block = lru_put(_state.cache, key);
+
+        if ((fseek(handle->fp, offset, SEEK_SET)) != 0) {
+                lru_invalidate(_state.cache, key);
+
+                return NULL;
+        }
+
+        block->size = fread(block->data, 1, SERVE_BLOCK_SIZE, handle->fp);
+
+        if (block->size == 0) {
+                lru_invalidate(_state.cache, key);
+
+                return NULL;
+        }
+
+        return block;
+}
+
+static int32_t
+_op_open(uint32_t mailbox_address)
+{
+        char path[SERVE_PATH_SIZE + 1];
+
+        if ((device_read(path, mailbox_address + SERVE_PATH_OFFSET, SERVE_PATH_SIZE)) != DEVICE_RET_OK) {
+                return SERVE_ERROR_IO;
+        }
+
+        path[SERVE_PATH_SIZE] = '\0';
+
+        if (!(_path_valid(path))) {
+                return SERVE_ERROR_INVALID_REQUEST;
+        }
+
+        uint32_t i;
+
+        for (i = 0; i < SERVE_HANDLE_COUNT; i++) {
+                if (!_state.handles[i].used) {
+                        break;
+                }
+        }
+
+        if (i == SERVE_HANDLE_COUNT) {
+                return SERVE_ERROR_TOO_MANY_OPEN;
+        }
+
+        char full_path[4096];
+
+        (void)snprintf(full_path, sizeof(full_path), "%s/%s", _state.root, path);
+
+        char * const resolved_path = _path_resolve(full_path);
+
+        if (resolved_path == NULL) {
+                return SERVE_ERROR_NOT_FOUND;
+        }
+
+        if (!(_path_inside_root(resolved_path))) {
+                free(resolved_path);
+
+                return SERVE_ERROR_INVALID_REQUEST;
+        }
+
+        FILE * const fp = fopen(resolved_path, "rb");
+
+        free(resolved_path);
+
+        if (fp == NULL) {
+                return SERVE_ERROR_NOT_FOUND;
+        }
+
+        /* Only regular files are served */
+        struct stat stat_buffer;
+
+        if (((fstat(fileno(fp), &stat_buffer)) != 0) || !S_ISREG(stat_buffer.st_mode)) {
+                (void)fclose(fp);
+
+                return SERVE_ERROR_NOT_FOUND;
+        }
+
+        _state.handles[i] = (serve_handle_t) {
+                .used                = true,
+                .fp                  = fp,
+                .id                  = _file_id_get(&stat_buffer),
+                .size                = stat_buffer.st_size,
+                .position            = 0,
+                .sequential_position = 0,
+                .readahead           = 0
+        };
+
+        return i;
+}
+
+static int32_t
+_op_read(serve_handle_t *handle, uint32_t size, uint32_t buffer_address)
+{
+        if (handle->position >= handle->size) {
+                return 0;
+        }
+
+        const uint32_t remaining = handle->size - handle->position;
+
+        size = (size < remaining) ? size : remaining;
+        size = (size < SERVE_TRANSFER_MAX) ? size : SERVE_TRANSFER_MAX;
+
+        /* Gather the blocks so the data goes over in a single transfer */
+        uint32_t position;
+        position = handle->position;
+
+        uint32_t copied;
+        copied = 0;
+
+        while (copied < size) {
+                const lru_block_t * const block =
+                    _block_get(handle, position / SERVE_BLOCK_SIZE, false);
+
+                if (block == NULL) {
+                        return SERVE_ERROR_IO;
+                }
+
+                const uint32_t block_offset = position % SERVE_BLOCK_SIZE;
+
+                if (block_offset >= block->size) {
+                        return SERVE_ERROR_IO;
+                }
+
+                uint32_t count;
+                count = block->size - block_offset;
+                count = (count < (size - copied)) ? count : (size - copied);
+
+                (void)memcpy(&_state.transfer[copied], &block->data[block_offset], count);
+
+                copied += count;
+                position += count;
+        }
+
+        if ((device_write(_state.transfer, buffer_address, size)) != DEVICE_RET_OK) {
+                return SERVE_ERROR_IO;
+        }
+
+        if (handle->position == handle->sequential_position) {
+                handle->readahead = (handle->readahead == 0)
+                    ? SERVE_READAHEAD_MIN
+                    : handle->readahead * 2;
+
+                if (handle->readahead > SERVE_READAHEAD_MAX) {
+                        handle->readahead = SERVE_READAHEAD_MAX;
+                }
+        } else {
+                handle->readahead = 0;
+        }
+
+        handle->position += size;
+        handle->sequential_position = handle->position;
+
+        _state.bytes_served += size;
+
+        return size;
+}
+
+static int32_t
+_op_seek(serve_handle_t *handle, int32_t offset, uint32_t whence)
+{
+        int64_t position;
+
+        switch (whence) {
+        case 0:
+                position = offset;
+                break;
+        case 1:
+                position = (int64_t)handle->position + offset;
+                break;
+        case 2:
+                position = (int64_t)handle->size + offset;
+                break;
+        default:
+                return SERVE_ERROR_INVALID_REQUEST;
+        }
+
+        if ((position < 0) || (position > handle->size)) {
+                return SERVE_ERROR_INVALID_REQUEST;
+        }
+
+        handle->position = position;
+
+        return position;
+}
+
+static void
+_readahead(serve_handle_t *handle)
+{
+        /* Runs after the response went out, while the target is busy
+         * consuming what it just got */
+        const uint32_t first = (handle->position / SERVE_BLOCK_SIZE);
+
+        for (uint32_t i = 0; i <= handle->readahead; i++) {
+                if (_block_get(handle, first + i, true) == NULL) {
+                        break;
+                }
+        }
+}
+
+static bool
+_request_handle(uint32_t mailbox_address, const uint8_t *request, uint32_t seq)
+{
+        const uint32_t op = device_be32_get(&request[0x08 - SERVE_REQUEST_OFFSET]);
+        const uint32_t handle_index = device_be32_get(&request[0x0C - SERVE_REQUEST_OFFSET]);
+        const int32_t offset = device_be32_get(&request[0x10 - SERVE_REQUEST_OFFSET]);
+        const uint32_t size = device_be32_get(&request[0x14 - SERVE_REQUEST_OFFSET]);
+        const uint32_t buffer_address = device_be32_get(&request[0x18 - SERVE_REQUEST_OFFSET]);
+        const uint32_t whence = device_be32_get(&request[0x1C - SERVE_REQUEST_OFFSET]);
+
+        serve_handle_t * const handle = _handle_get(handle_index);
+
+        int32_t result;
+
+        if ((op != SERVE_OP_OPEN) && (handle == NULL)) {
+                result = SERVE_ERROR_INVALID_HANDLE;
+        } else {
+                switch (op) {
+                case SERVE_OP_OPEN:
+                        result = _op_open(mailbox_address);
+                        break;
+                case SERVE_OP_CLOSE:
+                        _handle_close(handle);
+                        result = 0;
+                        break;
+                case SERVE_OP_READ:
+                        result = _op_read(handle, size, buffer_address);
+                        break;
+                case SERVE_OP_SEEK:
+                        result = _op_seek(handle, offset, whence);
+                        break;
+                case SERVE_OP_SIZE:
+                        result = handle->size;
+                        break;
+                default:
+                        result = SERVE_ERROR_INVALID_REQUEST;
+                        break;
+                }
+        }
+
+        /* The sequence number is written after the result, in the same
+         * transfer */
+        uint8_t response[SERVE_RESPONSE_SIZE];
+
+        device_be32_put(&response[0], result);
+        device_be32_put(&response[4], seq);
+
+        if ((device_write(response, mailbox_address + SERVE_RESPONSE_OFFSET, sizeof(response))) != DEVICE_RET_OK) {
+                return false;
+        }
+
+        _state.request_count++;
+
+        if ((op == SERVE_OP_READ) && (result > 0) && (handle->readahead > 0)) {
+                _readahead(handle);
+        }
+
+        return true;
+}
+
+static void
+_serve_loop(uint32_t mailbox_address)
+{
+        uint8_t header[SERVE_RESPONSE_OFFSET + SERVE_RESPONSE_SIZE];
+
+        if ((device_read(header, mailbox_address, sizeof(header))) != DEVICE_RET_OK) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        if ((device_be32_get(&header[0x00])) != SERVE_MAGIC) {
+                commands_printf("No mailbox found at 0x%08X\n", mailbox_address);
+                commands_status_return(COMMANDS_STATUS_INVALID_ADDRESS);
+        }
+
+        /* Anything posted before we got here is still answered */
+        uint32_t last_seq;
+        last_seq = device_be32_get(&header[0x24]);
+
+        uint32_t interval;
+        interval = SERVE_POLL_INTERVAL_MIN;
+
+        commands_printf("Serving \"%s\" at 0x%08X. Press Ctrl-C to stop\n", _state.root, mailbox_address);
+
+        shell_interrupt_begin();
+
+        while (!(shell_interrupted())) {
+                /* The sequence number and the request arguments come in one
+                 * transfer */
+                uint8_t request[SERVE_REQUEST_SIZE];
+
+                if ((device_read(request, mailbox_address + SERVE_REQUEST_OFFSET, sizeof(request))) != DEVICE_RET_OK) {
+                        commands_printf("Unable to read mailbox\n");
+                        break;
+                }
+
+                const uint32_t seq = device_be32_get(&request[0]);
+
+                if (seq == last_seq) {
+                        timer_sleep(interval);
+
+                        interval = (interval * 2);
+                        interval = (interval < SERVE_POLL_INTERVAL_MAX) ? interval : SERVE_POLL_INTERVAL_MAX;
+
+                        continue;
+                }
+
+                if (!(_request_handle(mailbox_address, request, seq))) {
+                        commands_printf("Unable to respond to request\n");
+                        break;
+                }
+
+                last_seq = seq;
+                interval = SERVE_POLL_INTERVAL_MIN;
+        }
+
+        shell_interrupt_end();
+
+        commands_printf("Served %u requests, %lluB. Cache: %llu hits, %llu misses\n",
+            _state.request_count,
+            (unsigned long long)_state.bytes_served,
+            (unsigned long long)_state.cache->hits,
+            (unsigned long long)_state.cache->misses);
+}
+
+static void
+_serve(const parser_t *parser)
+{
+        if (parser->stream->argc != 2) {
+                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+        }
+
+        const object_t * const address_obj = parser->stream->args_obj[0];
+        const object_t * const root_obj = parser->stream->args_obj[1];
+
+        uint32_t address;
+
+        if (!(commands_address_get(address_obj, &address))) {
+                return;
+        }
+
+        if (root_obj->type != OBJECT_TYPE_STRING) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+        }
+
+        const char * const root = root_obj->as.string;
+
+        struct stat stat_buffer;
+
+        if ((stat(root, &stat_buffer)) != 0) {
+                commands_status_return(COMMANDS_STATUS_FILE_NOT_FOUND);
+        }
+
+        if (!S_ISDIR(stat_buffer.st_mode)) {
+                commands_printf("\"%s\" is not a directory\n", root);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        _state.root = _path_resolve(root);
+        _state.cache = lru_new(SERVE_BLOCK_SIZE, SERVE_CACHE_BLOCK_COUNT);
+        _state.transfer = malloc(SERVE_TRANSFER_MAX);
+        _state.request_count = 0;
+        _state.file_next = 0;
+        _state.file_id_next = 0;
+
+        (void)memset(_state.files, 0, sizeof(_state.files));
+        _state.bytes_served = 0;
+
+        if ((_state.root != NULL) && (_state.cache != NULL) && (_state.transfer != NULL)) {
+                _serve_loop(address);
+        } else {
+                commands_status_set(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+        }
+
+        for (uint32_t i = 0; i < SERVE_HANDLE_COUNT; i++) {
+                if (_state.handles[i].used) {
+                        _handle_close(&_state.handles[i]);
+                }
+        }
+
+        free(_state.root);
+        free(_state.transfer);
+        lru_delete(_state.cache);
+
+        _state.root = NULL;
+        _state.transfer = NULL;
+        _state.cache = NULL;
+}
+
+const command_t command_serve = {
+        .name        = "serve",
+        .description = "Serve files to the target through a RAM mailbox",
+        .help        = "<mailbox-address:int|sym> <root-dir:str>",
+        .func        = _serve,
+        .arg_count   = 2
+};
@@ -0,0 +1,51 @@
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "types.h"
+#include "commands.h"
+#include "eval.h"
+#include "parser.h"
+
+static eval_ret_t
+_set(const parser_t *parser, const ast_node_t *form)
+{
+        const ast_node_t * const name_node = form->args;
+        const ast_node_t * const value_node = name_node->next;
+
+        if ((name_node->type != AST_NODE_OBJECT) ||
+            (name_node->object->type != OBJECT_TYPE_SYMBOL)) {
+                commands_status_set(COMMANDS_STATUS_EXPECTED_SYMBOL);
+
+                return EVAL_RET_FAILED;
+        }
+
+        const char * const name = name_node->object->as.symbol;
+
+        object_t value;
+
+        if (!(eval_value_get(parser, value_node, &value))) {
+                return EVAL_RET_FAILED;
+        }
+
+        const bool set = eval_variable_set(name, &value);
+
+        eval_value_release(&value);
+
+        if (!set) {
+                commands_printf("\"%s\" is not a variable\n", name);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return EVAL_RET_FAILED;
+        }
+
+        return EVAL_RET_OK;
+}
+
+const command_t command_set = {
+        .name        = "set",
+        .description = "Sets a variable",
+        .help        = "<name:sym> <value:int|str|buf|form>",
+        .form_func   = _set,
+        .arg_count   = 2
+};
@@ -0,0 +1,53 @@
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "types.h"
+#include "buffer.h"
+#include "commands.h"
+#include "parser.h"
+
+static void
+_slice(const parser_t *parser)
+{
+        const object_t * const buffer_obj = parser->stream->args_obj[0];
+        const object_t * const offset_obj = parser->stream->args_obj[1];
+        const object_t * const size_obj = parser->stream->args_obj[2];
+
+        if (buffer_obj->type != OBJECT_TYPE_BUFFER) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_BUFFER);
+        }
+
+        if ((offset_obj->type != OBJECT_TYPE_INTEGER) ||
+            (size_obj->type != OBJECT_TYPE_INTEGER)) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+        }
+
+        buffer_t * const buffer = buffer_obj->as.buffer;
+
+        const uint32_t offset = offset_obj->as.integer;
+        const uint32_t size = size_obj->as.integer;
+
+        if ((offset > buffer->size) || (size > (buffer->size - offset))) {
+                commands_printf("Slice 0x%X+0x%X is out of a buffer of size 0x%zX\n",
+                    offset,
+                    size,
+                    buffer->size);
+                commands_status_return(COMMANDS_STATUS_INVALID_SIZE);
+        }
+
+        const object_t value = {
+                .type      = OBJECT_TYPE_BUFFER,
+                .as.buffer = buffer_slice_new(buffer, offset, size)
+        };
+
+        commands_value_set(&value);
+}
+
+const command_t command_slice = {
+        .name        = "slice",
+        .description = "Gives back part of a buffer, sharing its bytes",
+        .help        = "<buffer:buf> <offset:int> <size:int>",
+        .func        = _slice,
+        .arg_count   = 3
+};
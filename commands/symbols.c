@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <ssshell.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "parser.h"
+#include "symbols.h"
+#include "timer.h"
+
+static void
+_symbols_status(void)
+{
+        const symbols_t * const symbols = symbols_loaded_get();
+
+        if (symbols == NULL) {
+                commands_printf("No symbols loaded\n");
+
+                return;
+        }
+
+        commands_printf("%u symbols from \"%s\"\n", symbols->count, symbols->path);
+}
+
+static void
+_symbols_load(const object_t *path_obj)
+{
+        if (path_obj->type != OBJECT_TYPE_STRING) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+        }
+
+        const char * const path = path_obj->as.string;
+
+        const uint64_t start_time = timer_us_get();
+
+        symbols_t * const symbols = symbols_load(path);
+
+        if (symbols == NULL) {
+                commands_printf("Unable to load symbols from \"%s\"\n", path);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        const uint64_t elapsed_time = timer_us_get() - start_time;
+
+        symbols_loaded_set(symbols);
+
+        commands_printf("Loaded %u symbols in %llums\n",
+            symbols->count,
+            (unsigned long long)(elapsed_time / 1000));
+}
+
+static void
+_symbols_find(const object_t *obj)
+{
+        const symbols_t * const symbols = symbols_loaded_get();
+
+        if (symbols == NULL) {
+                commands_printf("No symbols loaded\n");
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
+        const symbol_t *symbol;
+
+        if (obj->type == OBJECT_TYPE_INTEGER) {
+                const uint32_t address = obj->as.integer;
+
+                if ((symbol = symbols_address_find(symbols, address)) == NULL) {
+                        commands_printf("No symbol at 0x%08X\n", address);
+
+                        return;
+                }
+
+                commands_printf("0x%08X %s+0x%X\n",
+                    address,
+                    symbol->name,
+                    address - symbol->address);
+
+                return;
+        }
+
+        if (obj->type != OBJECT_TYPE_SYMBOL) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_SYMBOL);
+        }
+
+        if ((symbol = symbols_name_find(symbols, obj->as.symbol)) == NULL) {
+                commands_status_return(COMMANDS_STATUS_UNDEFINED_SYMBOL);
+        }
+
+        commands_printf("0x%08X %s (%uB)\n", symbol->address, symbol->name, symbol->size);
+}
+
+static void
+_symbols(const parser_t *parser)
+{
+        object_t * const * const args_obj = parser->stream->args_obj;
+
+        const int argc = parser->stream->argc;
+
+        if (argc == 0) {
+                _symbols_status();
+
+                return;
+        }
+
+        if (args_obj[0]->type != OBJECT_TYPE_SYMBOL) {
+                commands_status_return(COMMANDS_STATUS_EXPECTED_SYMBOL);
+        }
+
+        const char * const mode = args_obj[0]->as.symbol;
+
+        if ((strcmp(mode, "load")) == 0) {
+                if (argc != 2) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                _symbols_load(args_obj[1]);
+        } else if ((strcmp(mode, "find")) == 0) {
+                if (argc != 2) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                _symbols_find(args_obj[1]);
+        } else if ((strcmp(mode, "clear")) == 0) {
+                if (argc != 1) {
+                        commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                }
+
+                symbols_loaded_set(NULL);
+        } else {
+                commands_printf("Unknown mode \"%s\"\n", mode);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+}
+
+const command_t command_symbols = {
+        .name        = "symbols",
+        .description = "Load symbols from an ELF or map file, so addresses can be given by name",
+        .help        = "[load <path:str> | find <name:sym|address:int> | clear]",
+        .func        = _symbols,
+        .arg_count   = -1
+};
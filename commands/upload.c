@@ -1,20 +1,22 @@
 #include <sys/cdefs.h>
 
+#include <stdio.h>
+
 #include "shell.h"
 
 #include "types.h"
+#include "buffer.h"
 #include "commands.h"
+#include "jobs.h"
 #include "parser.h"
 
-#include <ssusb/ssusb.h>
-
-static void
-_upload(const parser_t *parser)
+static job_t *
+_upload_job_new(const parser_t *parser)
 {
-        (void)parser;
-
         if (parser->stream->argc != 2) {
-                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+                commands_status_set(COMMANDS_STATUS_ARGC_MISMATCH);
+
+                return NULL;
         }
 
         const object_t * const address_obj =
@@ -22,22 +24,67 @@ _upload(const parser_t *parser)
         const object_t * const path_obj =
             parser->stream->args_obj[1];
 
-        if (address_obj->type != OBJECT_TYPE_INTEGER) {
-                commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+        uint32_t address;
+
+        if (!(commands_address_get(address_obj, &address))) {
+                return NULL;
+        }
+
+        if (path_obj->type == OBJECT_TYPE_BUFFER) {
+                buffer_t * const buffer = path_obj->as.buffer;
+
+                job_t * const job = job_new(JOB_TYPE_UPLOAD, address, buffer_ref(buffer));
+
+                (void)snprintf(job->description, sizeof(job->description),
+                    "upload 0x%08X <%zuB:buffer>", address, buffer->size);
+
+                return job;
         }
 
         if (path_obj->type != OBJECT_TYPE_STRING) {
-                commands_status_return(COMMANDS_STATUS_EXPECTED_STRING);
+                commands_status_set(COMMANDS_STATUS_EXPECTED_STRING);
+
+                return NULL;
         }
 
-        const uint32_t address = address_obj->as.integer;
         const char * const path = path_obj->as.string;
 
-        ssusb_ret_t ret;
-        ret = ssusb_file_upload(path, address);
+        buffer_t * const buffer = buffer_file_read(path);
 
-        if (ret != SSUSB_OK) {
+        if (buffer == NULL) {
                 commands_printf("Unable upload file \"%s\" to 0x%08X\n", path, address);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return NULL;
+        }
+
+        job_t * const job = job_new(JOB_TYPE_UPLOAD, address, buffer);
+
+        (void)snprintf(job->description, sizeof(job->description),
+            "upload 0x%08X \"%s\"", address, path);
+
+        return job;
+}
+
+static void
+_upload(const parser_t *parser)
+{
+        job_t * const job = _upload_job_new(parser);
+
+        if (job == NULL) {
+                return;
+        }
+
+        const uint32_t address = job->address;
+
+        switch (jobs_run(job)) {
+        case JOB_STATE_DONE:
+                break;
+        case JOB_STATE_CANCELLED:
+                commands_printf("Upload to 0x%08X cancelled\n", address);
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        default:
+                commands_printf("Unable upload to 0x%08X\n", address);
                 commands_status_return(COMMANDS_STATUS_ERROR);
         }
 }
@@ -46,7 +93,8 @@ const command_t command_upload = {
         .name        = "upload",
         .alias       = ">",
         .description = "Upload a binary at a valid Saturn address",
-        .help        = "<address:int> <path:str>",
+        .help        = "<address:int|sym> <path:str|buf>",
         .func        = _upload,
+        .job_func    = _upload_job_new,
         .arg_count   = 2
 };
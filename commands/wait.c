@@ -0,0 +1,46 @@
+#include <sys/cdefs.h>
+
+#include "shell.h"
+
+#include "types.h"
+#include "commands.h"
+#include "jobs.h"
+#include "parser.h"
+
+static void
+_wait(const parser_t *parser)
+{
+        uint32_t id;
+        id = 0;
+
+        if (parser->stream->argc > 1) {
+                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+        }
+
+        if (parser->stream->argc == 1) {
+                const object_t * const id_obj = parser->stream->args_obj[0];
+
+                if (id_obj->type != OBJECT_TYPE_INTEGER) {
+                        commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+                }
+
+                id = id_obj->as.integer;
+
+                if (id == 0) {
+                        commands_printf("No job 0\n");
+                        commands_status_return(COMMANDS_STATUS_ERROR);
+                }
+        }
+
+        if (!(jobs_wait(id))) {
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+}
+
+const command_t command_wait = {
+        .name        = "wait",
+        .description = "Waits for a background job, or all of them",
+        .help        = "[id:int]",
+        .func        = _wait,
+        .arg_count   = -1
+};
@@ -5,20 +5,26 @@
 
 #include <ssshell.h>
 
-#include <ssusb/ssusb.h>
-
 #include "types.h"
+#include "buffer.h"
 #include "commands.h"
+#include "device.h"
+#include "jobs.h"
 #include "parser.h"
 
 #define MAX_WIDTH 16
 
 static void
-_xxd_printable_print(const char *buffer)
+_xxd_printable_print(const char *buffer, size_t count)
 {
         commands_printf("|");
 
-        for (uint32_t j = 0; j < MAX_WIDTH; j++) {
+        /* The last line can be short */
+        if (count > MAX_WIDTH) {
+                count = MAX_WIDTH;
+        }
+
+        for (uint32_t j = 0; j < count; j++) {
                 char c;
                 c = buffer[j];
 
@@ -51,7 +57,7 @@ _xxd_print(const char *buffer, size_t size)
 
                 if (eol && !last_byte) {
                         if (fold > 0) {
-                                _xxd_printable_print(&buffer[MAX_WIDTH * (lines - 1)]);
+                                _xxd_printable_print(&buffer[MAX_WIDTH * (lines - 1)], MAX_WIDTH);
                         }
 
                         commands_printf("\n[1;35m%08X[m %02X", i, (uint8_t)buffer[i]);
@@ -61,7 +67,9 @@ _xxd_print(const char *buffer, size_t size)
                         commands_printf(" %02X", (uint8_t)buffer[i]);
 
                         if (last_byte) {
-                                _xxd_printable_print(&buffer[MAX_WIDTH * lines]);
+                                const size_t line_start = i - (i % MAX_WIDTH);
+
+                                _xxd_printable_print(&buffer[line_start], size - line_start);
                         }
                 }
 
@@ -74,18 +82,37 @@ _xxd_print(const char *buffer, size_t size)
 static void
 _xxd(const parser_t *parser)
 {
+        if (parser->stream->argc == 1) {
+                const object_t * const buffer_obj = parser->stream->args_obj[0];
+
+                if (buffer_obj->type != OBJECT_TYPE_BUFFER) {
+                        commands_status_return(COMMANDS_STATUS_EXPECTED_BUFFER);
+                }
+
+                const buffer_t * const buffer = buffer_obj->as.buffer;
+
+                _xxd_print((const char *)buffer->data, buffer->size);
+
+                return;
+        }
+
+        if (parser->stream->argc != 2) {
+                commands_status_return(COMMANDS_STATUS_ARGC_MISMATCH);
+        }
+
         const object_t * const address_obj = parser->stream->args_obj[0];
         const object_t * const size_obj = parser->stream->args_obj[1];
 
-        if (address_obj->type != OBJECT_TYPE_INTEGER) {
-                commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
+        uint32_t address;
+
+        if (!(commands_address_get(address_obj, &address))) {
+                return;
         }
 
         if (size_obj->type != OBJECT_TYPE_INTEGER) {
                 commands_status_return(COMMANDS_STATUS_EXPECTED_INTEGER);
         }
 
-        const uint32_t address = address_obj->as.integer;
         const uint32_t size = size_obj->as.integer;
 
         /* XXX: Write a function that validates address */
@@ -97,25 +124,33 @@ _xxd(const parser_t *parser)
                 commands_status_return(COMMANDS_STATUS_INVALID_SIZE);
         }
 
+        /* Only what's being uploaded to the range is waited for */
+        if (!(jobs_fence(address, size, false))) {
+                commands_printf("Interrupted\n");
+                commands_status_return(COMMANDS_STATUS_ERROR);
+        }
+
         void *buffer;
         if ((buffer = malloc(size)) == NULL) {
                 commands_status_return(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
         }
 
-        ssusb_ret_t ret = ssusb_download(buffer, address, size);
+        if ((device_read(buffer, address, size)) != DEVICE_RET_OK) {
+                free(buffer);
 
-        if (ret != SSUSB_OK) {
                 commands_status_return(COMMANDS_STATUS_ERROR);
         }
 
         _xxd_print(buffer, size);
+
+        free(buffer);
 }
 
 const command_t command_xxd = {
         .name        = "xxd",
         .alias       = "^",
-        .description = "Creates a hex dump of address and size",
-        .help        = "<address:int> <size:int>",
+        .description = "Creates a hex dump of address and size, or of a buffer",
+        .help        = "<address:int|sym> <size:int> | <buffer:buf>",
         .func        = _xxd,
-        .arg_count   = 2
+        .arg_count   = -1
 };
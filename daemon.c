@@ -0,0 +1,755 @@
+/* For struct ucred */
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif /* __linux__ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif /* !_WIN32 */
+
+#include "daemon.h"
+#include "shell.h"
+
+#if !defined(_WIN32)
+/*
+ * A client sends a request, with its standard output, standard error and
+ * working directory passed along as SCM_RIGHTS, followed by the commands:
+ *
+ *   uint32_t magic  DAEMON_MAGIC
+ *   uint32_t size   Size of the commands that follow
+ *
+ * The daemon answers with the exit code as an int32_t once the commands have
+ * run, and closes the connection. Both ends are on the same host, so nothing
+ * is byte-swapped */
+
+#define DAEMON_MAGIC                    0x53534844 /* "SSHD" */
+
+#define DAEMON_FD_STDOUT                0
+#define DAEMON_FD_STDERR                1
+#define DAEMON_FD_CWD                   2
+#define DAEMON_FD_COUNT                 3
+
+#define DAEMON_COMMANDS_SIZE_MAX        (16 * 1024 * 1024)
+
+/* How often serving looks for Ctrl-C */
+#define DAEMON_POLL_TIMEOUT             250
+
+/* A client that takes longer than this to send any part of its request is
+ * dropped, so that it can't hold up the clients behind it */
+#define DAEMON_RECEIVE_TIMEOUT          5000
+
+/* Commands are read from a file descriptor this much at a time */
+#define DAEMON_BLOCK_SIZE               (64 * 1024)
+
+typedef struct {
+        uint32_t magic;
+        uint32_t size;
+} request_t;
+
+/* Watches a client while its commands run */
+typedef struct {
+        pthread_t thread;
+        int fd;
+        /* Written to once the commands are done */
+        int stop_fds[2];
+} hangup_watch_t;
+
+static bool
+_all_read(int fd, void *buffer, size_t size)
+{
+        uint8_t *p;
+        p = buffer;
+
+        while (size > 0) {
+                const ssize_t read_size = read(fd, p, size);
+
+                if ((read_size < 0) && (errno == EINTR)) {
+                        continue;
+                }
+
+                if (read_size <= 0) {
+                        return false;
+                }
+
+                p += read_size;
+                size -= read_size;
+        }
+
+        return true;
+}
+
+static bool
+_all_write(int fd, const void *buffer, size_t size)
+{
+        const uint8_t *p;
+        p = buffer;
+
+        while (size > 0) {
+                const ssize_t written_size = write(fd, p, size);
+
+                if ((written_size < 0) && (errno == EINTR)) {
+                        continue;
+                }
+
+                if (written_size <= 0) {
+                        return false;
+                }
+
+                p += written_size;
+                size -= written_size;
+        }
+
+        return true;
+}
+
+static bool
+_address_set(const char *path, struct sockaddr_un *address)
+{
+        (void)memset(address, 0, sizeof(*address));
+
+        if ((strlen(path)) >= sizeof(address->sun_path)) {
+                errno = ENAMETOOLONG;
+
+                return false;
+        }
+
+        address->sun_family = AF_UNIX;
+        (void)strcpy(address->sun_path, path);
+
+        return true;
+}
+
+/* Returns -1 with errno set if no one is listening */
+static int
+_connect(const char *path)
+{
+        struct sockaddr_un address;
+
+        if (!(_address_set(path, &address))) {
+                return -1;
+        }
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if (fd < 0) {
+                return -1;
+        }
+
+        if ((connect(fd, (const struct sockaddr *)&address, sizeof(address))) != 0) {
+                const int connect_errno = errno;
+
+                (void)close(fd);
+
+                errno = connect_errno;
+
+                return -1;
+        }
+
+        return fd;
+}
+
+/* A socket left behind by a daemon that's gone is taken over */
+static int
+_listen(const char *path)
+{
+        int fd;
+
+        if ((fd = _connect(path)) >= 0) {
+                (void)close(fd);
+
+                errno = EADDRINUSE;
+
+                return -1;
+        }
+
+        struct stat stat_buffer;
+
+        if (((lstat(path, &stat_buffer)) == 0) && S_ISSOCK(stat_buffer.st_mode)) {
+                (void)unlink(path);
+        }
+
+        struct sockaddr_un address;
+
+        if (!(_address_set(path, &address))) {
+                return -1;
+        }
+
+        if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+                return -1;
+        }
+
+        /* Only the user who started the daemon gets to talk to the device */
+        const mode_t mask = umask(0077);
+
+        const int bind_ret = bind(fd, (const struct sockaddr *)&address, sizeof(address));
+
+        (void)umask(mask);
+
+        if ((bind_ret != 0) || ((listen(fd, SOMAXCONN)) != 0)) {
+                const int listen_errno = errno;
+
+                (void)close(fd);
+
+                errno = listen_errno;
+
+                return -1;
+        }
+
+        return fd;
+}
+
+/* Returns false, with none of the file descriptors open, unless the request
+ * came with all of them */
+static bool
+_request_receive(int fd, request_t *request, int fds[DAEMON_FD_COUNT])
+{
+        struct iovec iov = {
+                .iov_base = request,
+                .iov_len  = sizeof(*request)
+        };
+
+        union {
+                char buffer[CMSG_SPACE(sizeof(int) * DAEMON_FD_COUNT)];
+                struct cmsghdr align;
+        } control;
+
+        struct msghdr msg = {
+                .msg_iov        = &iov,
+                .msg_iovlen     = 1,
+                .msg_control    = control.buffer,
+                .msg_controllen = sizeof(control.buffer)
+        };
+
+        ssize_t received_size;
+
+        do {
+                received_size = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+        } while ((received_size < 0) && (errno == EINTR));
+
+        uint32_t fd_count;
+        fd_count = 0;
+
+        struct cmsghdr * const cmsg = (received_size > 0) ? CMSG_FIRSTHDR(&msg) : NULL;
+
+        if ((cmsg != NULL) &&
+            (cmsg->cmsg_level == SOL_SOCKET) &&
+            (cmsg->cmsg_type == SCM_RIGHTS)) {
+                fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+                (void)memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * fd_count);
+        }
+
+        if ((fd_count != DAEMON_FD_COUNT) ||
+            (received_size != sizeof(*request)) ||
+            ((msg.msg_flags & MSG_CTRUNC) != 0)) {
+                for (uint32_t i = 0; i < fd_count; i++) {
+                        (void)close(fds[i]);
+                }
+
+                return false;
+        }
+
+        return true;
+}
+
+/* Runs the commands as if from the client, with its output and working
+ * directory, and then puts the daemon's own back */
+static int
+_commands_run(const char *commands, const int fds[DAEMON_FD_COUNT],
+    daemon_run_func_t func, void *arg)
+{
+        (void)fflush(stdout);
+        (void)fflush(stderr);
+
+        const int saved_stdout = dup(STDOUT_FILENO);
+        const int saved_stderr = dup(STDERR_FILENO);
+        const int saved_cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        int exit_code;
+        exit_code = 1;
+
+        if ((saved_stdout >= 0) && (saved_stderr >= 0) && (saved_cwd >= 0) &&
+            ((dup2(fds[DAEMON_FD_STDOUT], STDOUT_FILENO)) >= 0) &&
+            ((dup2(fds[DAEMON_FD_STDERR], STDERR_FILENO)) >= 0)) {
+                if ((fchdir(fds[DAEMON_FD_CWD])) == 0) {
+                        exit_code = func(arg, commands);
+                } else {
+                        (void)fprintf(stderr, "Unable to change directory: %s\n", strerror(errno));
+                }
+
+                (void)fflush(stdout);
+                (void)fflush(stderr);
+        }
+
+        if (saved_stdout >= 0) {
+                (void)dup2(saved_stdout, STDOUT_FILENO);
+                (void)close(saved_stdout);
+        }
+
+        if (saved_stderr >= 0) {
+                (void)dup2(saved_stderr, STDERR_FILENO);
+                (void)close(saved_stderr);
+        }
+
+        if (saved_cwd >= 0) {
+                (void)fchdir(saved_cwd);
+                (void)close(saved_cwd);
+        }
+
+        return exit_code;
+}
+
+/* Every read from the client gives up after the timeout */
+static bool
+_receive_deadline_set(int fd)
+{
+        const struct timeval timeout = {
+                .tv_sec  = DAEMON_RECEIVE_TIMEOUT / 1000,
+                .tv_usec = (DAEMON_RECEIVE_TIMEOUT % 1000) * 1000
+        };
+
+        if ((setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) != 0) {
+                return false;
+        }
+
+        struct pollfd pollfd = {
+                .fd     = fd,
+                .events = POLLIN
+        };
+
+        int poll_ret;
+
+        do {
+                poll_ret = poll(&pollfd, 1, DAEMON_RECEIVE_TIMEOUT);
+        } while ((poll_ret < 0) && (errno == EINTR));
+
+        return (poll_ret > 0);
+}
+
+/* The client sends nothing after its request, so the socket only becomes
+ * readable once the client is gone, like when it's stopped with Ctrl-C. Its
+ * commands are then interrupted */
+static void *
+_hangup_watch(void *arg)
+{
+        hangup_watch_t * const watch = arg;
+
+        struct pollfd pollfds[2] = {
+                {
+                        .fd     = watch->fd,
+                        .events = POLLIN
+                },
+                {
+                        .fd     = watch->stop_fds[0],
+                        .events = POLLIN
+                }
+        };
+
+        while (true) {
+                const int poll_ret = poll(pollfds, 2, -1);
+
+                if ((poll_ret < 0) && (errno == EINTR)) {
+                        continue;
+                }
+
+                if ((poll_ret < 0) || (pollfds[1].revents != 0)) {
+                        break;
+                }
+
+                if (pollfds[0].revents != 0) {
+                        shell_interrupt_raise();
+
+                        break;
+                }
+        }
+
+        return NULL;
+}
+
+static bool
+_hangup_watch_start(hangup_watch_t *watch, int fd)
+{
+        watch->fd = fd;
+
+        if ((pipe(watch->stop_fds)) != 0) {
+                return false;
+        }
+
+        if ((pthread_create(&watch->thread, NULL, _hangup_watch, watch)) != 0) {
+                (void)close(watch->stop_fds[0]);
+                (void)close(watch->stop_fds[1]);
+
+                return false;
+        }
+
+        return true;
+}
+
+static void
+_hangup_watch_stop(hangup_watch_t *watch)
+{
+        const char stop = 0;
+
+        (void)_all_write(watch->stop_fds[1], &stop, sizeof(stop));
+        (void)pthread_join(watch->thread, NULL);
+
+        (void)close(watch->stop_fds[0]);
+        (void)close(watch->stop_fds[1]);
+
+        /* A client that went away while its commands finished doesn't get
+         * to interrupt the next one */
+        shell_interrupt_clear();
+}
+
+static void
+_session(int fd, daemon_run_func_t func, void *arg)
+{
+        request_t request;
+        int fds[DAEMON_FD_COUNT];
+
+        if (!(_receive_deadline_set(fd)) ||
+            !(_request_receive(fd, &request, fds))) {
+                return;
+        }
+
+        char *commands;
+        commands = NULL;
+
+        if ((request.magic == DAEMON_MAGIC) &&
+            (request.size <= DAEMON_COMMANDS_SIZE_MAX) &&
+            ((commands = malloc(request.size + 1)) != NULL) &&
+            (_all_read(fd, commands, request.size))) {
+                commands[request.size] = '\0';
+
+                hangup_watch_t watch;
+
+                const bool watching = _hangup_watch_start(&watch, fd);
+
+                const int32_t exit_code = _commands_run(commands, fds, func, arg);
+
+                if (watching) {
+                        _hangup_watch_stop(&watch);
+                }
+
+                (void)_all_write(fd, &exit_code, sizeof(exit_code));
+        }
+
+        free(commands);
+
+        for (uint32_t i = 0; i < DAEMON_FD_COUNT; i++) {
+                (void)close(fds[i]);
+        }
+}
+
+const char *
+daemon_socket_path_get(void)
+{
+        static char path[sizeof(((struct sockaddr_un *)NULL)->sun_path)];
+
+        const char * const runtime_dir = getenv("XDG_RUNTIME_DIR");
+
+        if ((runtime_dir != NULL) && (*runtime_dir != '\0')) {
+                (void)snprintf(path, sizeof(path), "%s/ssshell.sock", runtime_dir);
+        } else {
+                (void)snprintf(path, sizeof(path), "/tmp/ssshell-%u.sock", (unsigned int)getuid());
+        }
+
+        return path;
+}
+
+bool
+daemon_serve(const char *path, daemon_run_func_t func, void *arg)
+{
+        const int listen_fd = _listen(path);
+
+        if (listen_fd < 0) {
+                return false;
+        }
+
+        /* A client that goes away while its commands run shouldn't take the
+         * daemon with it */
+        (void)signal(SIGPIPE, SIG_IGN);
+
+        (void)printf("Listening on %s. Press Ctrl-C to stop\n", path);
+        (void)fflush(stdout);
+
+        while (true) {
+                struct pollfd pollfd = {
+                        .fd     = listen_fd,
+                        .events = POLLIN
+                };
+
+                shell_interrupt_begin();
+
+                const int poll_ret = poll(&pollfd, 1, DAEMON_POLL_TIMEOUT);
+                const bool interrupted = shell_interrupted();
+
+                shell_interrupt_end();
+
+                if (interrupted) {
+                        break;
+                }
+
+                if (poll_ret <= 0) {
+                        continue;
+                }
+
+                /* Connections are accepted in the order they were made, and
+                 * a client has the device to itself until it's done */
+                const int fd = accept(listen_fd, NULL, NULL);
+
+                if (fd < 0) {
+                        continue;
+                }
+
+                (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+                _session(fd, func, arg);
+
+                (void)close(fd);
+        }
+
+        (void)close(listen_fd);
+        (void)unlink(path);
+
+        return true;
+}
+
+/* Reads until the end, and returns NULL if reading fails */
+static char *
+_fd_read(int fd, size_t *size)
+{
+        char *buffer;
+        buffer = NULL;
+
+        size_t capacity;
+        capacity = 0;
+
+        *size = 0;
+
+        while (true) {
+                if ((capacity - *size) < DAEMON_BLOCK_SIZE) {
+                        capacity += DAEMON_BLOCK_SIZE;
+
+                        char * const resized = realloc(buffer, capacity);
+
+                        if (resized == NULL) {
+                                free(buffer);
+
+                                return NULL;
+                        }
+
+                        buffer = resized;
+                }
+
+                const ssize_t read_size = read(fd, &buffer[*size], capacity - *size);
+
+                if ((read_size < 0) && (errno == EINTR)) {
+                        continue;
+                }
+
+                if (read_size < 0) {
+                        free(buffer);
+
+                        return NULL;
+                }
+
+                if (read_size == 0) {
+                        return buffer;
+                }
+
+                *size += read_size;
+        }
+}
+
+/* Anyone who can write to where the socket is expected could put their own
+ * there, and be handed the client's output and working directory. The
+ * daemon has to be run by the same user as the client */
+static bool
+_owner_check(int fd, const char *path)
+{
+#if defined(SO_PEERCRED)
+        struct ucred credentials;
+        socklen_t credentials_size;
+        credentials_size = sizeof(credentials);
+
+        if ((getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &credentials_size)) == 0) {
+                return (credentials.uid == getuid());
+        }
+#else
+        (void)fd;
+#endif /* SO_PEERCRED */
+
+        struct stat stat_buffer;
+
+        return ((lstat(path, &stat_buffer)) == 0) &&
+               S_ISSOCK(stat_buffer.st_mode) &&
+               (stat_buffer.st_uid == getuid());
+}
+
+static bool
+_request_send(int fd, const char *commands, size_t size)
+{
+        const int cwd_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        if (cwd_fd < 0) {
+                return false;
+        }
+
+        const int fds[DAEMON_FD_COUNT] = {
+                [DAEMON_FD_STDOUT] = STDOUT_FILENO,
+                [DAEMON_FD_STDERR] = STDERR_FILENO,
+                [DAEMON_FD_CWD]    = cwd_fd
+        };
+
+        request_t request = {
+                .magic = DAEMON_MAGIC,
+                .size  = size
+        };
+
+        struct iovec iov = {
+                .iov_base = &request,
+                .iov_len  = sizeof(request)
+        };
+
+        union {
+                char buffer[CMSG_SPACE(sizeof(fds))];
+                struct cmsghdr align;
+        } control;
+
+        (void)memset(&control, 0, sizeof(control));
+
+        struct msghdr msg = {
+                .msg_iov        = &iov,
+                .msg_iovlen     = 1,
+                .msg_control    = control.buffer,
+                .msg_controllen = sizeof(control.buffer)
+        };
+
+        struct cmsghdr * const cmsg = CMSG_FIRSTHDR(&msg);
+
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+
+        (void)memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+        ssize_t sent_size;
+
+        do {
+                sent_size = sendmsg(fd, &msg, 0);
+        } while ((sent_size < 0) && (errno == EINTR));
+
+        (void)close(cwd_fd);
+
+        return (sent_size == sizeof(request)) && _all_write(fd, commands, size);
+}
+
+bool
+daemon_connect(const char *path, const char *commands, int fd,
+    int *exit_code)
+{
+        char *read_commands;
+        read_commands = NULL;
+
+        size_t size;
+
+        if (commands != NULL) {
+                size = strlen(commands);
+        } else if ((read_commands = _fd_read(fd, &size)) != NULL) {
+                commands = read_commands;
+        } else {
+                return false;
+        }
+
+        if (size > DAEMON_COMMANDS_SIZE_MAX) {
+                free(read_commands);
+
+                errno = EFBIG;
+
+                return false;
+        }
+
+        /* Only the exit code tells whether the daemon was done */
+        (void)signal(SIGPIPE, SIG_IGN);
+
+        const int socket_fd = _connect(path);
+
+        bool answered;
+        answered = false;
+
+        int32_t daemon_exit_code;
+
+        if ((socket_fd >= 0) && !(_owner_check(socket_fd, path))) {
+                (void)close(socket_fd);
+
+                errno = EPERM;
+        } else if (socket_fd >= 0) {
+                errno = 0;
+
+                answered = _request_send(socket_fd, commands, size) &&
+                           _all_read(socket_fd, &daemon_exit_code, sizeof(daemon_exit_code));
+
+                if (!answered && (errno == 0)) {
+                        errno = ECONNRESET;
+                }
+
+                (void)close(socket_fd);
+        }
+
+        free(read_commands);
+
+        if (answered) {
+                *exit_code = daemon_exit_code;
+        }
+
+        return answered;
+}
+#else
+const char *
+daemon_socket_path_get(void)
+{
+        return "ssshell.sock";
+}
+
+bool
+daemon_serve(const char *path, daemon_run_func_t func, void *arg)
+{
+        (void)path;
+        (void)func;
+        (void)arg;
+
+        errno = ENOSYS;
+
+        return false;
+}
+
+bool
+daemon_connect(const char *path, const char *commands, int fd,
+    int *exit_code)
+{
+        (void)path;
+        (void)commands;
+        (void)fd;
+        (void)exit_code;
+
+        errno = ENOSYS;
+
+        return false;
+}
+#endif /* !_WIN32 */
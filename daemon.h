@@ -0,0 +1,32 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdbool.h>
+
+/* A daemon keeps the device open, and runs the commands that clients send it
+ * over a Unix socket. Clients are served one at a time, in the order they
+ * connected, so no client's commands are interleaved with another's. A
+ * client that stalls while sending its commands is dropped, and one that
+ * goes away while they run has them interrupted. A client hands the daemon
+ * its standard output, standard error and working directory, so output and
+ * relative paths are the same as if it had run the commands itself.
+ * Everything else, like variables and what the shadow knows, carries over
+ * from one client to the next */
+
+/* Runs the commands of one client, and returns the exit code */
+typedef int (*daemon_run_func_t)(void *arg, const char *commands);
+
+/* Under $XDG_RUNTIME_DIR, or /tmp otherwise. The string is static */
+const char *daemon_socket_path_get(void);
+
+/* Serves clients until Ctrl-C. Returns false if the socket can't be
+ * listened on, or if another daemon already is */
+bool daemon_serve(const char *path, daemon_run_func_t func, void *arg);
+
+/* Sends the commands, or everything read from the file descriptor if they're
+ * NULL, to the daemon. Returns false if the daemon can't be reached, or if
+ * it went away before it was done */
+bool daemon_connect(const char *path, const char *commands, int fd,
+    int *exit_code);
+
+#endif /* DAEMON_H */
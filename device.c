@@ -0,0 +1,639 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ssusb/ssusb.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "shadow.h"
+#include "timer.h"
+
+#define DEVICE_NAME_SIZE 16
+
+/* A simulated device has the Saturn's work RAM, and transfers at about the
+ * rate a USB cart does */
+#define DEVICE_SIM_LWRAM_ADDRESS        0x00200000
+#define DEVICE_SIM_HWRAM_ADDRESS        0x06000000
+#define DEVICE_SIM_RAM_SIZE             0x100000
+#define DEVICE_SIM_BYTES_PER_S          (1024 * 1024)
+
+typedef enum {
+        PRIORITY_HIGH,
+        PRIORITY_LOW
+} priority_t;
+
+typedef struct {
+        device_ret_t (*read)(device_t *device, void *buffer, uint32_t address, size_t size);
+        device_ret_t (*write)(device_t *device, const void *buffer, uint32_t address, size_t size);
+        device_ret_t (*file_execute)(device_t *device, const char *path, uint32_t address);
+} device_ops_t;
+
+/* Jobs talk to a device from their own thread. A device is held for one
+ * transfer at a time. Bulk transfers only get it when no one else is
+ * waiting */
+struct device {
+        char name[DEVICE_NAME_SIZE];
+        const device_ops_t *ops;
+
+        pthread_mutex_t lock;
+        pthread_cond_t released;
+        bool busy;
+        uint32_t high_waiting;
+
+        /* Simulated devices only */
+        uint8_t *lwram;
+        uint8_t *hwram;
+};
+
+static struct {
+        device_t devices[DEVICE_COUNT_MAX];
+        uint32_t count;
+
+        /* The first of them if all are selected */
+        uint32_t selected;
+        bool all_selected;
+
+        /* Devices transfer concurrently, but there's only the one shadow. It
+         * follows the selected device, so the selection is guarded by it
+         * too */
+        pthread_mutex_t shadow_lock;
+} _state = {
+        .shadow_lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static device_ret_t
+_ssusb_read(device_t *device, void *buffer, uint32_t address, size_t size)
+{
+        (void)device;
+
+        if ((ssusb_download(buffer, address, size)) != SSUSB_OK) {
+                return DEVICE_RET_ERROR;
+        }
+
+        return DEVICE_RET_OK;
+}
+
+static device_ret_t
+_ssusb_write(device_t *device, const void *buffer, uint32_t address, size_t size)
+{
+        (void)device;
+
+        if ((ssusb_upload(buffer, address, size)) != SSUSB_OK) {
+                return DEVICE_RET_ERROR;
+        }
+
+        return DEVICE_RET_OK;
+}
+
+static device_ret_t
+_ssusb_file_execute(device_t *device, const char *path, uint32_t address)
+{
+        (void)device;
+
+        if ((ssusb_file_execute(path, address)) != SSUSB_OK) {
+                return DEVICE_RET_ERROR;
+        }
+
+        return DEVICE_RET_OK;
+}
+
+static const device_ops_t _ssusb_ops = {
+        .read         = _ssusb_read,
+        .write        = _ssusb_write,
+        .file_execute = _ssusb_file_execute
+};
+
+/* Returns NULL if the range isn't all in one of the work RAMs. Cache-through
+ * addresses mirror the cached ones */
+static uint8_t *
+_sim_map(device_t *device, uint32_t address, size_t size)
+{
+        address &= 0x0FFFFFFF;
+
+        uint8_t *ram;
+        uint32_t offset;
+
+        if ((address >= DEVICE_SIM_LWRAM_ADDRESS) &&
+            (address < (DEVICE_SIM_LWRAM_ADDRESS + DEVICE_SIM_RAM_SIZE))) {
+                ram = device->lwram;
+                offset = address - DEVICE_SIM_LWRAM_ADDRESS;
+        } else if ((address >= DEVICE_SIM_HWRAM_ADDRESS) &&
+                   (address < (DEVICE_SIM_HWRAM_ADDRESS + DEVICE_SIM_RAM_SIZE))) {
+                ram = device->hwram;
+                offset = address - DEVICE_SIM_HWRAM_ADDRESS;
+        } else {
+                return NULL;
+        }
+
+        if (size > (DEVICE_SIM_RAM_SIZE - offset)) {
+                return NULL;
+        }
+
+        return &ram[offset];
+}
+
+static void
+_sim_transfer_wait(size_t size)
+{
+        timer_sleep((uint32_t)(((uint64_t)size * 1000000) / DEVICE_SIM_BYTES_PER_S));
+}
+
+static device_ret_t
+_sim_read(device_t *device, void *buffer, uint32_t address, size_t size)
+{
+        const uint8_t * const p = _sim_map(device, address, size);
+
+        if (p == NULL) {
+                return DEVICE_RET_ERROR;
+        }
+
+        _sim_transfer_wait(size);
+
+        (void)memcpy(buffer, p, size);
+
+        return DEVICE_RET_OK;
+}
+
+static device_ret_t
+_sim_write(device_t *device, const void *buffer, uint32_t address, size_t size)
+{
+        uint8_t * const p = _sim_map(device, address, size);
+
+        if (p == NULL) {
+                return DEVICE_RET_ERROR;
+        }
+
+        _sim_transfer_wait(size);
+
+        (void)memcpy(p, buffer, size);
+
+        return DEVICE_RET_OK;
+}
+
+/* Nothing runs, so executing is only uploading */
+static device_ret_t
+_sim_file_execute(device_t *device, const char *path, uint32_t address)
+{
+        buffer_t * const buffer = buffer_file_read(path);
+
+        if (buffer == NULL) {
+                return DEVICE_RET_ERROR;
+        }
+
+        const device_ret_t ret = _sim_write(device, buffer->data, address, buffer->size);
+
+        buffer_unref(buffer);
+
+        return ret;
+}
+
+static const device_ops_t _sim_ops = {
+        .read         = _sim_read,
+        .write        = _sim_write,
+        .file_execute = _sim_file_execute
+};
+
+static void
+_acquire(device_t *device, priority_t priority)
+{
+        (void)pthread_mutex_lock(&device->lock);
+
+        if (priority == PRIORITY_HIGH) {
+                device->high_waiting++;
+
+                while (device->busy) {
+                        (void)pthread_cond_wait(&device->released, &device->lock);
+                }
+
+                device->high_waiting--;
+        } else {
+                while (device->busy || (device->high_waiting > 0)) {
+                        (void)pthread_cond_wait(&device->released, &device->lock);
+                }
+        }
+
+        device->busy = true;
+
+        (void)pthread_mutex_unlock(&device->lock);
+}
+
+static void
+_release(device_t *device)
+{
+        (void)pthread_mutex_lock(&device->lock);
+
+        device->busy = false;
+        (void)pthread_cond_broadcast(&device->released);
+
+        (void)pthread_mutex_unlock(&device->lock);
+}
+
+/* Writes to the other devices are left out, as they can't make what the
+ * shadow knows any less true */
+static void
+_shadow_invalidate(const device_t *device, uint32_t address, size_t size)
+{
+        (void)pthread_mutex_lock(&_state.shadow_lock);
+
+        if (device == &_state.devices[_state.selected]) {
+                shadow_invalidate(address, size);
+        }
+
+        (void)pthread_mutex_unlock(&_state.shadow_lock);
+}
+
+static void
+_shadow_clear(const device_t *device)
+{
+        (void)pthread_mutex_lock(&_state.shadow_lock);
+
+        if (device == &_state.devices[_state.selected]) {
+                shadow_clear();
+        }
+
+        (void)pthread_mutex_unlock(&_state.shadow_lock);
+}
+
+static device_ret_t
+_read(device_t *device, void *buffer, uint32_t address, size_t size,
+    priority_t priority)
+{
+        assert(buffer != NULL);
+
+        if (size == 0) {
+                return DEVICE_RET_OK;
+        }
+
+        device_ret_t ret;
+
+        _acquire(device, priority);
+
+        /* A transfer that fails likely means the target was reset, or the
+         * link dropped, and then nothing the shadow knows can be trusted */
+        if ((ret = device->ops->read(device, buffer, address, size)) != DEVICE_RET_OK) {
+                _shadow_clear(device);
+        }
+
+        _release(device);
+
+        return ret;
+}
+
+static device_ret_t
+_upload(device_t *device, const void *buffer, uint32_t address, size_t size)
+{
+        if (size == 0) {
+                return DEVICE_RET_OK;
+        }
+
+        return device->ops->write(device, buffer, address, size);
+}
+
+static device_ret_t
+_write(device_t *device, const void *buffer, uint32_t address, size_t size,
+    priority_t priority)
+{
+        assert(buffer != NULL);
+
+        device_ret_t ret;
+
+        _acquire(device, priority);
+        /* Whatever the shadow knew about this range is stale now */
+        _shadow_invalidate(device, address, size);
+
+        if ((ret = _upload(device, buffer, address, size)) != DEVICE_RET_OK) {
+                _shadow_clear(device);
+        }
+
+        _release(device);
+
+        return ret;
+}
+
+static device_ret_t
+_file_execute(device_t *device, const char *path, uint32_t address,
+    priority_t priority)
+{
+        assert(path != NULL);
+
+        device_ret_t ret;
+
+        _acquire(device, priority);
+
+        /* The file goes over without the shadow seeing it */
+        _shadow_clear(device);
+
+        ret = device->ops->file_execute(device, path, address);
+        _release(device);
+
+        return ret;
+}
+
+void
+device_init(uint32_t simulated_count)
+{
+        assert(simulated_count <= DEVICE_COUNT_MAX);
+
+        _state.count = (simulated_count > 0) ? simulated_count : 1;
+        _state.selected = 0;
+        _state.all_selected = false;
+
+        for (uint32_t i = 0; i < _state.count; i++) {
+                device_t * const device = &_state.devices[i];
+
+                (void)pthread_mutex_init(&device->lock, NULL);
+                (void)pthread_cond_init(&device->released, NULL);
+
+                device->busy = false;
+                device->high_waiting = 0;
+
+                if (simulated_count == 0) {
+                        (void)strcpy(device->name, "usb");
+
+                        device->ops = &_ssusb_ops;
+                        device->lwram = NULL;
+                        device->hwram = NULL;
+
+                        continue;
+                }
+
+                (void)snprintf(device->name, sizeof(device->name), "sim%u", i + 1);
+
+                device->ops = &_sim_ops;
+                device->lwram = calloc(1, DEVICE_SIM_RAM_SIZE);
+                device->hwram = calloc(1, DEVICE_SIM_RAM_SIZE);
+                assert((device->lwram != NULL) && (device->hwram != NULL));
+        }
+}
+
+void
+device_deinit(void)
+{
+        for (uint32_t i = 0; i < _state.count; i++) {
+                device_t * const device = &_state.devices[i];
+
+                free(device->lwram);
+                free(device->hwram);
+
+                (void)pthread_mutex_destroy(&device->lock);
+                (void)pthread_cond_destroy(&device->released);
+        }
+
+        _state.count = 0;
+}
+
+uint32_t
+device_count_get(void)
+{
+        return _state.count;
+}
+
+device_t *
+device_get(uint32_t index)
+{
+        assert(index < _state.count);
+
+        return &_state.devices[index];
+}
+
+const char *
+device_name_get(const device_t *device)
+{
+        assert(device != NULL);
+
+        return device->name;
+}
+
+void
+device_select(uint32_t index)
+{
+        assert(index < _state.count);
+
+        (void)pthread_mutex_lock(&_state.shadow_lock);
+
+        if (index != _state.selected) {
+                shadow_clear();
+        }
+
+        _state.selected = index;
+        _state.all_selected = false;
+
+        (void)pthread_mutex_unlock(&_state.shadow_lock);
+}
+
+void
+device_select_all(void)
+{
+        (void)pthread_mutex_lock(&_state.shadow_lock);
+        _state.all_selected = true;
+        (void)pthread_mutex_unlock(&_state.shadow_lock);
+}
+
+bool
+device_all_selected(void)
+{
+        (void)pthread_mutex_lock(&_state.shadow_lock);
+
+        const bool all_selected = _state.all_selected;
+
+        (void)pthread_mutex_unlock(&_state.shadow_lock);
+
+        return all_selected;
+}
+
+device_t *
+device_selected_get(void)
+{
+        (void)pthread_mutex_lock(&_state.shadow_lock);
+
+        device_t * const device = &_state.devices[_state.selected];
+
+        (void)pthread_mutex_unlock(&_state.shadow_lock);
+
+        return device;
+}
+
+device_ret_t
+device_read(void *buffer, uint32_t address, size_t size)
+{
+        return _read(device_selected_get(), buffer, address, size, PRIORITY_HIGH);
+}
+
+device_ret_t
+device_write(const void *buffer, uint32_t address, size_t size)
+{
+        return _write(device_selected_get(), buffer, address, size, PRIORITY_HIGH);
+}
+
+device_ret_t
+device_bulk_read(device_t *device, void *buffer, uint32_t address, size_t size)
+{
+        assert(device != NULL);
+
+        return _read(device, buffer, address, size, PRIORITY_LOW);
+}
+
+device_ret_t
+device_bulk_write(device_t *device, const void *buffer, uint32_t address,
+    size_t size)
+{
+        assert(device != NULL);
+
+        return _write(device, buffer, address, size, PRIORITY_LOW);
+}
+
+device_ret_t
+device_bulk_file_execute(device_t *device, const char *path, uint32_t address)
+{
+        assert(device != NULL);
+
+        return _file_execute(device, path, address, PRIORITY_LOW);
+}
+
+static device_ret_t
+_write_delta(device_t *device, const void *buffer, uint32_t address,
+    size_t size, size_t *written_size)
+{
+        const uint8_t * const p = buffer;
+
+        size_t written;
+        written = 0;
+
+        /* Changed blocks next to each other go over in a single transfer */
+        size_t run_offset;
+        run_offset = 0;
+        size_t run_size;
+        run_size = 0;
+
+        size_t offset;
+        offset = 0;
+
+        while (offset <= size) {
+                size_t block_size;
+                block_size = 0;
+
+                bool changed;
+                changed = false;
+
+                if (offset < size) {
+                        const uint32_t block_address = address + offset;
+
+                        block_size = SHADOW_BLOCK_SIZE - (block_address % SHADOW_BLOCK_SIZE);
+                        block_size = (block_size < (size - offset)) ? block_size : (size - offset);
+
+                        /* A partial block at either edge only matches the
+                         * same bytes at the same offset */
+                        uint64_t hash;
+                        hash = shadow_hash(&p[offset], block_size);
+                        hash ^= (uint64_t)(block_address % SHADOW_BLOCK_SIZE) << 48;
+
+                        const uint32_t aligned_address = block_address & ~(uint32_t)(SHADOW_BLOCK_SIZE - 1);
+
+                        changed = !(shadow_block_matches(aligned_address, hash));
+
+                        shadow_block_set(aligned_address, hash);
+                }
+
+                if (changed) {
+                        if (run_size == 0) {
+                                run_offset = offset;
+                        }
+
+                        run_size += block_size;
+                } else if (run_size > 0) {
+                        if ((_upload(device, &p[run_offset], address + run_offset, run_size)) != DEVICE_RET_OK) {
+                                shadow_clear();
+
+                                return DEVICE_RET_ERROR;
+                        }
+
+                        written += run_size;
+                        run_size = 0;
+                }
+
+                if (offset == size) {
+                        break;
+                }
+
+                offset += block_size;
+        }
+
+        if (written_size != NULL) {
+                *written_size = written;
+        }
+
+        return DEVICE_RET_OK;
+}
+
+device_ret_t
+device_write_delta(const void *buffer, uint32_t address, size_t size,
+    size_t *written_size)
+{
+        assert(buffer != NULL);
+
+        device_t * const device = device_selected_get();
+
+        device_ret_t ret;
+
+        _acquire(device, PRIORITY_HIGH);
+        (void)pthread_mutex_lock(&_state.shadow_lock);
+
+        ret = _write_delta(device, buffer, address, size, written_size);
+
+        (void)pthread_mutex_unlock(&_state.shadow_lock);
+        _release(device);
+
+        return ret;
+}
+
+void
+device_shadow_invalidate(uint32_t address, size_t size)
+{
+        (void)pthread_mutex_lock(&_state.shadow_lock);
+        shadow_invalidate(address, size);
+        (void)pthread_mutex_unlock(&_state.shadow_lock);
+}
+
+void
+device_shadow_clear(void)
+{
+        (void)pthread_mutex_lock(&_state.shadow_lock);
+        shadow_clear();
+        (void)pthread_mutex_unlock(&_state.shadow_lock);
+}
+
+device_ret_t
+device_file_execute(const char *path, uint32_t address)
+{
+        return _file_execute(device_selected_get(), path, address, PRIORITY_HIGH);
+}
+
+device_ret_t
+device_u32_read(uint32_t address, uint32_t *value)
+{
+        assert(value != NULL);
+
+        uint8_t buffer[4];
+
+        if ((device_read(buffer, address, sizeof(buffer))) != DEVICE_RET_OK) {
+                return DEVICE_RET_ERROR;
+        }
+
+        *value = device_be32_get(buffer);
+
+        return DEVICE_RET_OK;
+}
+
+device_ret_t
+device_u32_write(uint32_t address, uint32_t value)
+{
+        uint8_t buffer[4];
+
+        device_be32_put(buffer, value);
+
+        return device_write(buffer, address, sizeof(buffer));
+}
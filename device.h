@@ -0,0 +1,87 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "types.h"
+
+#define DEVICE_COUNT_MAX 16
+
+typedef enum {
+        DEVICE_RET_OK,
+        DEVICE_RET_ERROR,
+} device_ret_t;
+
+/* With a count of 0, there's the one device on USB. Otherwise, that many
+ * devices are simulated in memory */
+void device_init(uint32_t simulated_count);
+void device_deinit(void);
+
+uint32_t device_count_get(void);
+device_t *device_get(uint32_t index);
+const char *device_name_get(const device_t *device);
+
+/* Commands talk to the selected device. If all of them are selected, uploads
+ * go to every one of them, and everything else to the first one */
+void device_select(uint32_t index);
+void device_select_all(void);
+bool device_all_selected(void);
+device_t *device_selected_get(void);
+
+/* Safe to call from any thread. Each call is one transfer, and is never
+ * interleaved with another one to the same device */
+device_ret_t device_read(void *buffer, uint32_t address, size_t size);
+device_ret_t device_write(const void *buffer, uint32_t address, size_t size);
+
+/* For jobs. Every other transfer waiting for the device goes first */
+device_ret_t device_bulk_read(device_t *device, void *buffer, uint32_t address,
+    size_t size);
+device_ret_t device_bulk_write(device_t *device, const void *buffer,
+    uint32_t address, size_t size);
+device_ret_t device_bulk_file_execute(device_t *device, const char *path,
+    uint32_t address);
+
+/* Upload only the blocks that differ from what was last uploaded with this
+ * function. Anything else written to the range in between (plain writes,
+ * file uploads) drops it from the shadow. What the target itself writes
+ * can't be seen, so the range must not be modified by the program */
+device_ret_t device_write_delta(const void *buffer, uint32_t address,
+    size_t size, size_t *written_size);
+
+/* Drops the range of the selected device from the shadow, for when the
+ * program is known to have written to it */
+void device_shadow_invalidate(uint32_t address, size_t size);
+/* Forgets everything, so the next delta upload sends every block. A failed
+ * transfer does the same on its own */
+void device_shadow_clear(void);
+
+/* Uploads the file, then jumps to it */
+device_ret_t device_file_execute(const char *path, uint32_t address);
+
+device_ret_t device_u32_read(uint32_t address, uint32_t *value);
+device_ret_t device_u32_write(uint32_t address, uint32_t value);
+
+/* The Saturn is big-endian */
+static inline uint32_t
+device_be32_get(const void *p)
+{
+        const uint8_t * const b = p;
+
+        return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+               ((uint32_t)b[2] <<  8) |  (uint32_t)b[3];
+}
+
+static inline void
+device_be32_put(void *p, uint32_t value)
+{
+        uint8_t * const b = p;
+
+        b[0] = value >> 24;
+        b[1] = value >> 16;
+        b[2] = value >>  8;
+        b[3] = value;
+}
+
+#endif /* DEVICE_H */
@@ -0,0 +1,1555 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dwarf.h"
+
+#define DWARF_TAG_ARRAY_TYPE            0x01
+#define DWARF_TAG_CLASS_TYPE            0x02
+#define DWARF_TAG_ENUMERATION_TYPE      0x04
+#define DWARF_TAG_MEMBER                0x0D
+#define DWARF_TAG_POINTER_TYPE          0x0F
+#define DWARF_TAG_REFERENCE_TYPE        0x10
+#define DWARF_TAG_COMPILE_UNIT          0x11
+#define DWARF_TAG_STRUCTURE_TYPE        0x13
+#define DWARF_TAG_SUBROUTINE_TYPE       0x15
+#define DWARF_TAG_TYPEDEF               0x16
+#define DWARF_TAG_UNION_TYPE            0x17
+#define DWARF_TAG_SUBRANGE_TYPE         0x21
+#define DWARF_TAG_BASE_TYPE             0x24
+#define DWARF_TAG_CONST_TYPE            0x26
+#define DWARF_TAG_ENUMERATOR            0x28
+#define DWARF_TAG_VARIABLE              0x34
+#define DWARF_TAG_VOLATILE_TYPE         0x35
+#define DWARF_TAG_RESTRICT_TYPE         0x37
+#define DWARF_TAG_ATOMIC_TYPE           0x47
+
+#define DWARF_AT_LOCATION               0x02
+#define DWARF_AT_NAME                   0x03
+#define DWARF_AT_BYTE_SIZE              0x0B
+#define DWARF_AT_BIT_OFFSET             0x0C
+#define DWARF_AT_BIT_SIZE               0x0D
+#define DWARF_AT_CONST_VALUE            0x1C
+#define DWARF_AT_UPPER_BOUND            0x2F
+#define DWARF_AT_COUNT                  0x37
+#define DWARF_AT_DATA_MEMBER_LOCATION   0x38
+#define DWARF_AT_DECLARATION            0x3C
+#define DWARF_AT_ENCODING               0x3E
+#define DWARF_AT_SPECIFICATION          0x47
+#define DWARF_AT_TYPE                   0x49
+#define DWARF_AT_DATA_BIT_OFFSET        0x6B
+
+#define DWARF_FORM_ADDR                 0x01
+#define DWARF_FORM_BLOCK2               0x03
+#define DWARF_FORM_BLOCK4               0x04
+#define DWARF_FORM_DATA2                0x05
+#define DWARF_FORM_DATA4                0x06
+#define DWARF_FORM_DATA8                0x07
+#define DWARF_FORM_STRING               0x08
+#define DWARF_FORM_BLOCK                0x09
+#define DWARF_FORM_BLOCK1               0x0A
+#define DWARF_FORM_DATA1                0x0B
+#define DWARF_FORM_FLAG                 0x0C
+#define DWARF_FORM_SDATA                0x0D
+#define DWARF_FORM_STRP                 0x0E
+#define DWARF_FORM_UDATA                0x0F
+#define DWARF_FORM_REF_ADDR             0x10
+#define DWARF_FORM_REF1                 0x11
+#define DWARF_FORM_REF2                 0x12
+#define DWARF_FORM_REF4                 0x13
+#define DWARF_FORM_REF8                 0x14
+#define DWARF_FORM_REF_UDATA            0x15
+#define DWARF_FORM_INDIRECT             0x16
+#define DWARF_FORM_SEC_OFFSET           0x17
+#define DWARF_FORM_EXPRLOC              0x18
+#define DWARF_FORM_FLAG_PRESENT         0x19
+#define DWARF_FORM_STRX                 0x1A
+#define DWARF_FORM_ADDRX                0x1B
+#define DWARF_FORM_REF_SUP4             0x1C
+#define DWARF_FORM_STRP_SUP             0x1D
+#define DWARF_FORM_DATA16               0x1E
+#define DWARF_FORM_LINE_STRP            0x1F
+#define DWARF_FORM_REF_SIG8             0x20
+#define DWARF_FORM_IMPLICIT_CONST       0x21
+#define DWARF_FORM_LOCLISTX             0x22
+#define DWARF_FORM_RNGLISTX             0x23
+#define DWARF_FORM_REF_SUP8             0x24
+#define DWARF_FORM_STRX1                0x25
+#define DWARF_FORM_STRX2                0x26
+#define DWARF_FORM_STRX3                0x27
+#define DWARF_FORM_STRX4                0x28
+#define DWARF_FORM_ADDRX1               0x29
+#define DWARF_FORM_ADDRX2               0x2A
+#define DWARF_FORM_ADDRX3               0x2B
+#define DWARF_FORM_ADDRX4               0x2C
+#define DWARF_FORM_GNU_ADDR_INDEX       0x1F01
+#define DWARF_FORM_GNU_STR_INDEX        0x1F02
+#define DWARF_FORM_GNU_REF_ALT          0x1F20
+#define DWARF_FORM_GNU_STRP_ALT         0x1F21
+
+#define DWARF_OP_ADDR                   0x03
+#define DWARF_OP_PLUS_UCONST            0x23
+
+/* Deeper than this, type names are cut short */
+#define DWARF_NAME_DEPTH_MAX            8
+
+/* Which of a DIE's attributes were present */
+#define DWARF_DIE_BYTE_SIZE             (1 << 0)
+#define DWARF_DIE_MEMBER_LOCATION       (1 << 1)
+#define DWARF_DIE_BIT_OFFSET            (1 << 2)
+#define DWARF_DIE_DATA_BIT_OFFSET       (1 << 3)
+#define DWARF_DIE_UPPER_BOUND           (1 << 4)
+#define DWARF_DIE_COUNT                 (1 << 5)
+#define DWARF_DIE_ADDRESS               (1 << 6)
+#define DWARF_DIE_DECLARATION           (1 << 7)
+#define DWARF_DIE_RESOLVING             (1 << 8)
+
+typedef struct {
+        uint32_t name;
+        uint32_t form;
+        int64_t implicit_const;
+} dwarf_attr_spec_t;
+
+typedef struct {
+        uint32_t code;
+        uint32_t tag;
+        bool children;
+
+        /* Index of the first attribute spec in the unit's pool */
+        uint32_t spec_index;
+        uint32_t spec_count;
+} dwarf_abbrev_t;
+
+typedef struct {
+        uint32_t offset;
+        uint32_t tag;
+        uint32_t flags;
+        const char *name;
+
+        /* Absolute offsets in .debug_info, zero when absent */
+        uint32_t type;
+        uint32_t specification;
+
+        uint32_t byte_size;
+        uint32_t member_location;
+        uint32_t bit_offset;
+        uint32_t bit_size;
+        uint32_t data_bit_offset;
+        int64_t upper_bound;
+        uint32_t count;
+        uint32_t encoding;
+        int64_t const_value;
+        uint32_t address;
+
+        /* Indices into the unit's DIEs, zero when absent. Index zero is the
+         * unit's own DIE, which is nobody's child or sibling */
+        uint32_t child;
+        uint32_t sibling;
+
+        const dwarf_type_t *type_cache;
+} dwarf_die_t;
+
+typedef struct {
+        uint32_t offset;
+        uint32_t dies_offset;
+        uint32_t end;
+        uint16_t version;
+        uint8_t address_size;
+        uint32_t abbrev_offset;
+
+        bool parsed;
+        dwarf_die_t *dies;
+        uint32_t die_count;
+} dwarf_cu_t;
+
+typedef struct {
+        const uint8_t *p;
+        const uint8_t *end;
+        bool error;
+} dwarf_reader_t;
+
+typedef struct {
+        uint64_t value;
+        const char *string;
+        const uint8_t *block;
+        uint32_t block_size;
+} dwarf_value_t;
+
+struct dwarf {
+        const elf_t *elf;
+
+        const elf_section_t *info;
+        const elf_section_t *abbrev;
+        const elf_section_t *str;
+        const elf_section_t *line_str;
+
+        dwarf_cu_t *cus;
+        uint32_t cu_count;
+
+        /* Units are parsed in order, as lookups need them */
+        uint32_t next_cu;
+
+        /* Variables of the parsed units, hashed by name */
+        dwarf_variable_t *variables;
+        uint32_t variable_count;
+        uint32_t variable_capacity;
+        uint32_t *index;
+        uint32_t index_mask;
+
+        /* Every decoded type, so they can be freed */
+        dwarf_type_t **types;
+        uint32_t type_count;
+        uint32_t type_capacity;
+};
+
+static bool _cu_parse(dwarf_t *dwarf, dwarf_cu_t *cu);
+static const dwarf_type_t *_type_get(dwarf_t *dwarf, uint32_t offset);
+
+static uint8_t
+_u8_read(dwarf_reader_t *reader)
+{
+        if (reader->p >= reader->end) {
+                reader->error = true;
+
+                return 0;
+        }
+
+        return *reader->p++;
+}
+
+static uint64_t
+_unsigned_read(const dwarf_t *dwarf, dwarf_reader_t *reader, uint32_t size)
+{
+        if ((size_t)(reader->end - reader->p) < size) {
+                reader->error = true;
+                reader->p = reader->end;
+
+                return 0;
+        }
+
+        const uint64_t value = dwarf_unsigned_get(dwarf, reader->p, size);
+
+        reader->p += size;
+
+        return value;
+}
+
+static uint64_t
+_uleb128_read(dwarf_reader_t *reader)
+{
+        uint64_t value;
+        value = 0;
+        uint32_t shift;
+        shift = 0;
+
+        uint8_t byte;
+
+        do {
+                byte = _u8_read(reader);
+
+                if (shift < 64) {
+                        value |= (uint64_t)(byte & 0x7F) << shift;
+                }
+
+                shift += 7;
+        } while (((byte & 0x80) != 0) && !reader->error);
+
+        return value;
+}
+
+static int64_t
+_sleb128_read(dwarf_reader_t *reader)
+{
+        uint64_t value;
+        value = 0;
+        uint32_t shift;
+        shift = 0;
+
+        uint8_t byte;
+
+        do {
+                byte = _u8_read(reader);
+
+                if (shift < 64) {
+                        value |= (uint64_t)(byte & 0x7F) << shift;
+                }
+
+                shift += 7;
+        } while (((byte & 0x80) != 0) && !reader->error);
+
+        if ((shift < 64) && ((byte & 0x40) != 0)) {
+                value |= ~(uint64_t)0 << shift;
+        }
+
+        return (int64_t)value;
+}
+
+static const char *
+_section_string_get(const elf_section_t *section, uint64_t offset)
+{
+        if ((section == NULL) || (section->data == NULL) || (offset >= section->size)) {
+                return NULL;
+        }
+
+        const char * const string = (const char *)&section->data[offset];
+
+        if ((memchr(string, '\0', section->size - offset)) == NULL) {
+                return NULL;
+        }
+
+        return string;
+}
+
+static void
+_block_read(dwarf_reader_t *reader, uint64_t size, dwarf_value_t *value)
+{
+        if ((uint64_t)(reader->end - reader->p) < size) {
+                reader->error = true;
+                reader->p = reader->end;
+
+                return;
+        }
+
+        value->block = reader->p;
+        value->block_size = size;
+
+        reader->p += size;
+}
+
+/* Read one attribute value. References come back as absolute offsets in
+ * .debug_info. Forms that need tables this reader doesn't load (string and
+ * address indices, supplementary files) are skipped over */
+static void
+_form_read(const dwarf_t *dwarf, const dwarf_cu_t *cu, dwarf_reader_t *reader,
+    const dwarf_attr_spec_t *spec, uint32_t form, dwarf_value_t *value)
+{
+        *value = (dwarf_value_t) {
+                .value = 0
+        };
+
+        switch (form) {
+        case DWARF_FORM_ADDR:
+                value->value = _unsigned_read(dwarf, reader, cu->address_size);
+                break;
+        case DWARF_FORM_DATA1:
+        case DWARF_FORM_FLAG:
+        case DWARF_FORM_STRX1:
+        case DWARF_FORM_ADDRX1:
+                value->value = _unsigned_read(dwarf, reader, 1);
+                break;
+        case DWARF_FORM_DATA2:
+        case DWARF_FORM_STRX2:
+        case DWARF_FORM_ADDRX2:
+                value->value = _unsigned_read(dwarf, reader, 2);
+                break;
+        case DWARF_FORM_STRX3:
+        case DWARF_FORM_ADDRX3:
+                value->value = _unsigned_read(dwarf, reader, 3);
+                break;
+        case DWARF_FORM_DATA4:
+        case DWARF_FORM_SEC_OFFSET:
+        case DWARF_FORM_STRX4:
+        case DWARF_FORM_ADDRX4:
+        case DWARF_FORM_REF_SUP4:
+        case DWARF_FORM_STRP_SUP:
+        case DWARF_FORM_GNU_REF_ALT:
+        case DWARF_FORM_GNU_STRP_ALT:
+                value->value = _unsigned_read(dwarf, reader, 4);
+                break;
+        case DWARF_FORM_DATA8:
+        case DWARF_FORM_REF_SIG8:
+        case DWARF_FORM_REF_SUP8:
+                value->value = _unsigned_read(dwarf, reader, 8);
+                break;
+        case DWARF_FORM_DATA16:
+                _block_read(reader, 16, value);
+                break;
+        case DWARF_FORM_SDATA:
+                value->value = _sleb128_read(reader);
+                break;
+        case DWARF_FORM_UDATA:
+        case DWARF_FORM_STRX:
+        case DWARF_FORM_ADDRX:
+        case DWARF_FORM_LOCLISTX:
+        case DWARF_FORM_RNGLISTX:
+        case DWARF_FORM_GNU_ADDR_INDEX:
+        case DWARF_FORM_GNU_STR_INDEX:
+                value->value = _uleb128_read(reader);
+                break;
+        case DWARF_FORM_STRING:
+                if ((memchr(reader->p, '\0', reader->end - reader->p)) == NULL) {
+                        reader->error = true;
+                        reader->p = reader->end;
+
+                        break;
+                }
+
+                value->string = (const char *)reader->p;
+                reader->p += strlen(value->string) + 1;
+                break;
+        case DWARF_FORM_STRP:
+                value->string = _section_string_get(dwarf->str, _unsigned_read(dwarf, reader, 4));
+                break;
+        case DWARF_FORM_LINE_STRP:
+                value->string = _section_string_get(dwarf->line_str, _unsigned_read(dwarf, reader, 4));
+                break;
+        case DWARF_FORM_REF1:
+                value->value = cu->offset + _unsigned_read(dwarf, reader, 1);
+                break;
+        case DWARF_FORM_REF2:
+                value->value = cu->offset + _unsigned_read(dwarf, reader, 2);
+                break;
+        case DWARF_FORM_REF4:
+                value->value = cu->offset + _unsigned_read(dwarf, reader, 4);
+                break;
+        case DWARF_FORM_REF8:
+                value->value = cu->offset + _unsigned_read(dwarf, reader, 8);
+                break;
+        case DWARF_FORM_REF_UDATA:
+                value->value = cu->offset + _uleb128_read(reader);
+                break;
+        case DWARF_FORM_REF_ADDR:
+                /* Version 2 had these the size of an address */
+                value->value = _unsigned_read(dwarf, reader, (cu->version == 2) ? cu->address_size : 4);
+                break;
+        case DWARF_FORM_FLAG_PRESENT:
+                value->value = 1;
+                break;
+        case DWARF_FORM_IMPLICIT_CONST:
+                value->value = spec->implicit_const;
+                break;
+        case DWARF_FORM_BLOCK1:
+                _block_read(reader, _unsigned_read(dwarf, reader, 1), value);
+                break;
+        case DWARF_FORM_BLOCK2:
+                _block_read(reader, _unsigned_read(dwarf, reader, 2), value);
+                break;
+        case DWARF_FORM_BLOCK4:
+                _block_read(reader, _unsigned_read(dwarf, reader, 4), value);
+                break;
+        case DWARF_FORM_BLOCK:
+        case DWARF_FORM_EXPRLOC:
+                _block_read(reader, _uleb128_read(reader), value);
+                break;
+        case DWARF_FORM_INDIRECT:
+                _form_read(dwarf, cu, reader, spec, _uleb128_read(reader), value);
+                break;
+        default:
+                /* Without knowing its size, nothing after it can be read */
+                reader->error = true;
+                break;
+        }
+}
+
+static bool
+_form_is_reference(uint32_t form)
+{
+        return ((form >= DWARF_FORM_REF_ADDR) && (form <= DWARF_FORM_REF_UDATA));
+}
+
+static bool
+_abbrevs_parse(const dwarf_t *dwarf, uint32_t offset, dwarf_abbrev_t **abbrevs,
+    uint32_t *abbrev_count, dwarf_attr_spec_t **specs)
+{
+        const elf_section_t * const section = dwarf->abbrev;
+
+        if (offset >= section->size) {
+                return false;
+        }
+
+        dwarf_reader_t reader = {
+                .p     = &section->data[offset],
+                .end   = &section->data[section->size],
+                .error = false
+        };
+
+        uint32_t abbrev_capacity;
+        abbrev_capacity = 64;
+        uint32_t spec_capacity;
+        spec_capacity = 256;
+        uint32_t spec_count;
+        spec_count = 0;
+
+        *abbrev_count = 0;
+        *abbrevs = malloc(abbrev_capacity * sizeof(dwarf_abbrev_t));
+        *specs = malloc(spec_capacity * sizeof(dwarf_attr_spec_t));
+
+        if ((*abbrevs == NULL) || (*specs == NULL)) {
+                return false;
+        }
+
+        while (!reader.error) {
+                const uint32_t code = _uleb128_read(&reader);
+
+                if (code == 0) {
+                        break;
+                }
+
+                if (*abbrev_count == abbrev_capacity) {
+                        dwarf_abbrev_t * const grown =
+                            realloc(*abbrevs, (abbrev_capacity * 2) * sizeof(dwarf_abbrev_t));
+
+                        if (grown == NULL) {
+                                return false;
+                        }
+
+                        *abbrevs = grown;
+                        abbrev_capacity *= 2;
+                }
+
+                dwarf_abbrev_t * const abbrev = &(*abbrevs)[*abbrev_count];
+
+                abbrev->code = code;
+                abbrev->tag = _uleb128_read(&reader);
+                abbrev->children = (_u8_read(&reader) != 0);
+                abbrev->spec_index = spec_count;
+                abbrev->spec_count = 0;
+
+                while (!reader.error) {
+                        const uint32_t name = _uleb128_read(&reader);
+                        const uint32_t form = _uleb128_read(&reader);
+
+                        if ((name == 0) && (form == 0)) {
+                                break;
+                        }
+
+                        if (spec_count == spec_capacity) {
+                                dwarf_attr_spec_t * const grown =
+                                    realloc(*specs, (spec_capacity * 2) * sizeof(dwarf_attr_spec_t));
+
+                                if (grown == NULL) {
+                                        return false;
+                                }
+
+                                *specs = grown;
+                                spec_capacity *= 2;
+                        }
+
+                        (*specs)[spec_count] = (dwarf_attr_spec_t) {
+                                .name           = name,
+                                .form           = form,
+                                .implicit_const = (form == DWARF_FORM_IMPLICIT_CONST) ? _sleb128_read(&reader) : 0
+                        };
+
+                        spec_count++;
+                        abbrev->spec_count++;
+                }
+
+                (*abbrev_count)++;
+        }
+
+        return !reader.error;
+}
+
+static const dwarf_abbrev_t *
+_abbrev_find(const dwarf_abbrev_t *abbrevs, uint32_t abbrev_count, uint32_t code)
+{
+        /* Codes are almost always handed out in order, starting at one */
+        if ((code <= abbrev_count) && (abbrevs[code - 1].code == code)) {
+                return &abbrevs[code - 1];
+        }
+
+        for (uint32_t i = 0; i < abbrev_count; i++) {
+                if (abbrevs[i].code == code) {
+                        return &abbrevs[i];
+                }
+        }
+
+        return NULL;
+}
+
+static void
+_die_attribute_set(dwarf_die_t *die, uint32_t name, uint32_t form, const dwarf_value_t *value)
+{
+        switch (name) {
+        case DWARF_AT_NAME:
+                die->name = value->string;
+                break;
+        case DWARF_AT_TYPE:
+                if (_form_is_reference(form)) {
+                        die->type = value->value;
+                }
+                break;
+        case DWARF_AT_SPECIFICATION:
+                if (_form_is_reference(form)) {
+                        die->specification = value->value;
+                }
+                break;
+        case DWARF_AT_BYTE_SIZE:
+                die->byte_size = value->value;
+                die->flags |= DWARF_DIE_BYTE_SIZE;
+                break;
+        case DWARF_AT_DATA_MEMBER_LOCATION:
+                if (value->block == NULL) {
+                        die->member_location = value->value;
+                        die->flags |= DWARF_DIE_MEMBER_LOCATION;
+                } else if ((value->block_size > 0) && (value->block[0] == DWARF_OP_PLUS_UCONST)) {
+                        /* Older compilers give the offset as an expression */
+                        dwarf_reader_t reader = {
+                                .p     = &value->block[1],
+                                .end   = &value->block[value->block_size],
+                                .error = false
+                        };
+
+                        die->member_location = _uleb128_read(&reader);
+                        die->flags |= DWARF_DIE_MEMBER_LOCATION;
+                }
+                break;
+        case DWARF_AT_BIT_OFFSET:
+                die->bit_offset = value->value;
+                die->flags |= DWARF_DIE_BIT_OFFSET;
+                break;
+        case DWARF_AT_DATA_BIT_OFFSET:
+                die->data_bit_offset = value->value;
+                die->flags |= DWARF_DIE_DATA_BIT_OFFSET;
+                break;
+        case DWARF_AT_BIT_SIZE:
+                die->bit_size = value->value;
+                break;
+        case DWARF_AT_UPPER_BOUND:
+                if (value->block == NULL) {
+                        die->upper_bound = (int64_t)value->value;
+                        die->flags |= DWARF_DIE_UPPER_BOUND;
+                }
+                break;
+        case DWARF_AT_COUNT:
+                if (value->block == NULL) {
+                        die->count = value->value;
+                        die->flags |= DWARF_DIE_COUNT;
+                }
+                break;
+        case DWARF_AT_ENCODING:
+                die->encoding = value->value;
+                break;
+        case DWARF_AT_CONST_VALUE:
+                die->const_value = (int64_t)value->value;
+                break;
+        case DWARF_AT_DECLARATION:
+                if (value->value != 0) {
+                        die->flags |= DWARF_DIE_DECLARATION;
+                }
+                break;
+        case DWARF_AT_LOCATION:
+                /* Only static storage, which is a lone DW_OP_addr */
+                if ((value->block != NULL) && (value->block_size == 5) &&
+                    (value->block[0] == DWARF_OP_ADDR)) {
+                        die->flags |= DWARF_DIE_ADDRESS;
+                }
+                break;
+        default:
+                break;
+        }
+}
+
+static uint32_t
+_name_hash(const char *name)
+{
+        uint32_t hash;
+        hash = 0x811C9DC5;
+
+        for (; *name != '\0'; name++) {
+                hash = (hash ^ (uint8_t)*name) * 0x01000193;
+        }
+
+        return hash;
+}
+
+static bool
+_index_grow(dwarf_t *dwarf)
+{
+        const uint32_t slot_count = (dwarf->index_mask + 1) * 2;
+
+        uint32_t * const index = calloc(slot_count, sizeof(uint32_t));
+
+        if (index == NULL) {
+                return false;
+        }
+
+        for (uint32_t i = 0; i < dwarf->variable_count; i++) {
+                uint32_t slot;
+                slot = _name_hash(dwarf->variables[i].name) & (slot_count - 1);
+
+                while (index[slot] != 0) {
+                        slot = (slot + 1) & (slot_count - 1);
+                }
+
+                index[slot] = i + 1;
+        }
+
+        free(dwarf->index);
+
+        dwarf->index = index;
+        dwarf->index_mask = slot_count - 1;
+
+        return true;
+}
+
+static uint32_t *
+_index_slot_find(const dwarf_t *dwarf, const char *name)
+{
+        uint32_t slot;
+        slot = _name_hash(name) & dwarf->index_mask;
+
+        while (dwarf->index[slot] != 0) {
+                if ((strcmp(dwarf->variables[dwarf->index[slot] - 1].name, name)) == 0) {
+                        break;
+                }
+
+                slot = (slot + 1) & dwarf->index_mask;
+        }
+
+        return &dwarf->index[slot];
+}
+
+static bool
+_variable_add(dwarf_t *dwarf, const dwarf_variable_t *variable)
+{
+        /* Kept at most half full */
+        if (((dwarf->variable_count + 1) * 2) > (dwarf->index_mask + 1)) {
+                if (!(_index_grow(dwarf))) {
+                        return false;
+                }
+        }
+
+        uint32_t * const slot = _index_slot_find(dwarf, variable->name);
+
+        /* Of variables sharing a name, the first one found wins */
+        if (*slot != 0) {
+                return true;
+        }
+
+        if (dwarf->variable_count == dwarf->variable_capacity) {
+                const uint32_t capacity = (dwarf->variable_capacity == 0) ? 256 : (dwarf->variable_capacity * 2);
+
+                dwarf_variable_t * const grown =
+                    realloc(dwarf->variables, capacity * sizeof(dwarf_variable_t));
+
+                if (grown == NULL) {
+                        return false;
+                }
+
+                dwarf->variables = grown;
+                dwarf->variable_capacity = capacity;
+        }
+
+        dwarf->variables[dwarf->variable_count] = *variable;
+        dwarf->variable_count++;
+
+        *slot = dwarf->variable_count;
+
+        return true;
+}
+
+static dwarf_cu_t *
+_cu_offset_find(const dwarf_t *dwarf, uint32_t offset)
+{
+        uint32_t low;
+        low = 0;
+        uint32_t high;
+        high = dwarf->cu_count;
+
+        while (low < high) {
+                const uint32_t mid = low + ((high - low) / 2);
+                dwarf_cu_t * const cu = &dwarf->cus[mid];
+
+                if (offset < cu->offset) {
+                        high = mid;
+                } else if (offset >= cu->end) {
+                        low = mid + 1;
+                } else {
+                        return cu;
+                }
+        }
+
+        return NULL;
+}
+
+static dwarf_die_t *
+_die_find(dwarf_t *dwarf, uint32_t offset)
+{
+        dwarf_cu_t * const cu = _cu_offset_find(dwarf, offset);
+
+        if ((cu == NULL) || !(_cu_parse(dwarf, cu))) {
+                return NULL;
+        }
+
+        uint32_t low;
+        low = 0;
+        uint32_t high;
+        high = cu->die_count;
+
+        while (low < high) {
+                const uint32_t mid = low + ((high - low) / 2);
+
+                if (cu->dies[mid].offset < offset) {
+                        low = mid + 1;
+                } else {
+                        high = mid;
+                }
+        }
+
+        if ((low == cu->die_count) || (cu->dies[low].offset != offset)) {
+                return NULL;
+        }
+
+        return &cu->dies[low];
+}
+
+/* Variables at the top level of the unit with a static address */
+static bool
+_cu_variables_add(dwarf_t *dwarf, dwarf_cu_t *cu)
+{
+        if (cu->die_count == 0) {
+                return true;
+        }
+
+        for (uint32_t i = cu->dies[0].child; i != 0; i = cu->dies[i].sibling) {
+                const dwarf_die_t * const die = &cu->dies[i];
+
+                if ((die->tag != DWARF_TAG_VARIABLE) || ((die->flags & DWARF_DIE_ADDRESS) == 0)) {
+                        continue;
+                }
+
+                dwarf_variable_t variable = {
+                        .name        = die->name,
+                        .address     = die->address,
+                        .has_address = true,
+                        .type_offset = die->type,
+                        .type        = NULL
+                };
+
+                /* A definition of something declared elsewhere gets its name
+                 * and type from the declaration */
+                if (die->specification != 0) {
+                        const dwarf_die_t * const declaration = _die_find(dwarf, die->specification);
+
+                        if (declaration != NULL) {
+                                if (variable.name == NULL) {
+                                        variable.name = declaration->name;
+                                }
+
+                                if (variable.type_offset == 0) {
+                                        variable.type_offset = declaration->type;
+                                }
+                        }
+                }
+
+                if (variable.name == NULL) {
+                        continue;
+                }
+
+                if (!(_variable_add(dwarf, &variable))) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+static bool
+_cu_dies_parse(dwarf_t *dwarf, dwarf_cu_t *cu, const dwarf_abbrev_t *abbrevs,
+    uint32_t abbrev_count, const dwarf_attr_spec_t *specs)
+{
+        const elf_section_t * const info = dwarf->info;
+
+        dwarf_reader_t reader = {
+                .p     = &info->data[cu->dies_offset],
+                .end   = &info->data[cu->end],
+                .error = false
+        };
+
+        uint32_t capacity;
+        capacity = 256;
+
+        if ((cu->dies = malloc(capacity * sizeof(dwarf_die_t))) == NULL) {
+                return false;
+        }
+
+        /* For each open parent, the last child seen so far */
+        uint32_t parents[64];
+        uint32_t last_children[64];
+        uint32_t depth;
+        depth = 0;
+
+        while ((reader.p < reader.end) && !reader.error) {
+                const uint32_t offset = reader.p - info->data;
+                const uint32_t code = _uleb128_read(&reader);
+
+                if (code == 0) {
+                        if (depth == 0) {
+                                break;
+                        }
+
+                        depth--;
+
+                        continue;
+                }
+
+                const dwarf_abbrev_t * const abbrev = _abbrev_find(abbrevs, abbrev_count, code);
+
+                if (abbrev == NULL) {
+                        return false;
+                }
+
+                if (cu->die_count == capacity) {
+                        dwarf_die_t * const grown = realloc(cu->dies, (capacity * 2) * sizeof(dwarf_die_t));
+
+                        if (grown == NULL) {
+                                return false;
+                        }
+
+                        cu->dies = grown;
+                        capacity *= 2;
+                }
+
+                const uint32_t die_index = cu->die_count;
+                dwarf_die_t * const die = &cu->dies[die_index];
+
+                *die = (dwarf_die_t) {
+                        .offset = offset,
+                        .tag    = abbrev->tag
+                };
+
+                cu->die_count++;
+
+                for (uint32_t i = 0; i < abbrev->spec_count; i++) {
+                        const dwarf_attr_spec_t * const spec = &specs[abbrev->spec_index + i];
+
+                        dwarf_value_t value;
+
+                        _form_read(dwarf, cu, &reader, spec, spec->form, &value);
+
+                        _die_attribute_set(die, spec->name, spec->form, &value);
+
+                        if ((spec->name == DWARF_AT_LOCATION) && ((die->flags & DWARF_DIE_ADDRESS) != 0)) {
+                                die->address = dwarf_unsigned_get(dwarf, &value.block[1], 4);
+                        }
+                }
+
+                if (depth > 0) {
+                        const uint32_t parent = parents[depth - 1];
+
+                        if (last_children[depth - 1] == 0) {
+                                cu->dies[parent].child = die_index;
+                        } else {
+                                cu->dies[last_children[depth - 1]].sibling = die_index;
+                        }
+
+                        last_children[depth - 1] = die_index;
+                }
+
+                if (abbrev->children) {
+                        if (depth == (sizeof(parents) / sizeof(*parents))) {
+                                return false;
+                        }
+
+                        parents[depth] = die_index;
+                        last_children[depth] = 0;
+                        depth++;
+                }
+        }
+
+        return !reader.error;
+}
+
+static bool
+_cu_parse(dwarf_t *dwarf, dwarf_cu_t *cu)
+{
+        if (cu->parsed) {
+                return (cu->dies != NULL);
+        }
+
+        cu->parsed = true;
+
+        dwarf_abbrev_t *abbrevs;
+        abbrevs = NULL;
+        dwarf_attr_spec_t *specs;
+        specs = NULL;
+        uint32_t abbrev_count;
+        abbrev_count = 0;
+
+        bool ok;
+        ok = _abbrevs_parse(dwarf, cu->abbrev_offset, &abbrevs, &abbrev_count, &specs) &&
+             _cu_dies_parse(dwarf, cu, abbrevs, abbrev_count, specs);
+
+        free(abbrevs);
+        free(specs);
+
+        if (ok) {
+                ok = _cu_variables_add(dwarf, cu);
+        }
+
+        if (!ok) {
+                free(cu->dies);
+
+                cu->dies = NULL;
+                cu->die_count = 0;
+        }
+
+        return ok;
+}
+
+static bool
+_cus_scan(dwarf_t *dwarf)
+{
+        const elf_section_t * const info = dwarf->info;
+
+        uint32_t capacity;
+        capacity = 16;
+
+        if ((dwarf->cus = malloc(capacity * sizeof(dwarf_cu_t))) == NULL) {
+                return false;
+        }
+
+        uint32_t offset;
+        offset = 0;
+
+        /* Only the headers. Each unit's length leads to the next one */
+        while ((info->size - offset) >= 11) {
+                dwarf_reader_t reader = {
+                        .p     = &info->data[offset],
+                        .end   = &info->data[info->size],
+                        .error = false
+                };
+
+                const uint32_t length = _unsigned_read(dwarf, &reader, 4);
+
+                /* No 64-bit DWARF */
+                if ((length >= 0xFFFFFFF0) || (length > (info->size - offset - 4))) {
+                        break;
+                }
+
+                dwarf_cu_t cu = {
+                        .offset = offset,
+                        .end    = offset + 4 + length
+                };
+
+                cu.version = _unsigned_read(dwarf, &reader, 2);
+
+                if (cu.version >= 5) {
+                        (void)_u8_read(&reader);
+
+                        cu.address_size = _u8_read(&reader);
+                        cu.abbrev_offset = _unsigned_read(dwarf, &reader, 4);
+                } else {
+                        cu.abbrev_offset = _unsigned_read(dwarf, &reader, 4);
+                        cu.address_size = _u8_read(&reader);
+                }
+
+                cu.dies_offset = reader.p - info->data;
+
+                offset = cu.end;
+
+                if ((cu.version < 2) || (cu.version > 5) || (cu.address_size != 4) ||
+                    (cu.dies_offset > cu.end)) {
+                        continue;
+                }
+
+                if (dwarf->cu_count == capacity) {
+                        dwarf_cu_t * const grown = realloc(dwarf->cus, (capacity * 2) * sizeof(dwarf_cu_t));
+
+                        if (grown == NULL) {
+                                return false;
+                        }
+
+                        dwarf->cus = grown;
+                        capacity *= 2;
+                }
+
+                dwarf->cus[dwarf->cu_count] = cu;
+                dwarf->cu_count++;
+        }
+
+        return true;
+}
+
+dwarf_t *
+dwarf_new(const elf_t *elf)
+{
+        assert(elf != NULL);
+
+        const elf_section_t * const info = elf_section_find(elf, ".debug_info");
+        const elf_section_t * const abbrev = elf_section_find(elf, ".debug_abbrev");
+
+        if ((info == NULL) || (info->data == NULL) ||
+            (abbrev == NULL) || (abbrev->data == NULL)) {
+                return NULL;
+        }
+
+        dwarf_t * const dwarf = calloc(1, sizeof(dwarf_t));
+
+        if (dwarf == NULL) {
+                return NULL;
+        }
+
+        dwarf->elf = elf;
+        dwarf->info = info;
+        dwarf->abbrev = abbrev;
+        dwarf->str = elf_section_find(elf, ".debug_str");
+        dwarf->line_str = elf_section_find(elf, ".debug_line_str");
+        dwarf->index_mask = 15;
+
+        if (((dwarf->index = calloc(dwarf->index_mask + 1, sizeof(uint32_t))) == NULL) ||
+            !(_cus_scan(dwarf))) {
+                dwarf_delete(dwarf);
+
+                return NULL;
+        }
+
+        return dwarf;
+}
+
+void
+dwarf_delete(dwarf_t *dwarf)
+{
+        if (dwarf == NULL) {
+                return;
+        }
+
+        for (uint32_t i = 0; i < dwarf->cu_count; i++) {
+                free(dwarf->cus[i].dies);
+        }
+
+        for (uint32_t i = 0; i < dwarf->type_count; i++) {
+                dwarf_type_t * const type = dwarf->types[i];
+
+                free(type->name);
+                free(type->members);
+                free(type->enumerators);
+                free(type);
+        }
+
+        free(dwarf->cus);
+        free(dwarf->types);
+        free(dwarf->variables);
+        free(dwarf->index);
+        free(dwarf);
+}
+
+static dwarf_type_t *
+_type_new(dwarf_t *dwarf, dwarf_type_kind_t kind)
+{
+        if (dwarf->type_count == dwarf->type_capacity) {
+                const uint32_t capacity = (dwarf->type_capacity == 0) ? 64 : (dwarf->type_capacity * 2);
+
+                dwarf_type_t ** const grown = realloc(dwarf->types, capacity * sizeof(dwarf_type_t *));
+
+                if (grown == NULL) {
+                        return NULL;
+                }
+
+                dwarf->types = grown;
+                dwarf->type_capacity = capacity;
+        }
+
+        dwarf_type_t * const type = calloc(1, sizeof(dwarf_type_t));
+
+        if (type == NULL) {
+                return NULL;
+        }
+
+        type->kind = kind;
+
+        dwarf->types[dwarf->type_count] = type;
+        dwarf->type_count++;
+
+        return type;
+}
+
+static uint32_t
+_array_count_get(const dwarf_die_t *subrange)
+{
+        if ((subrange->flags & DWARF_DIE_COUNT) != 0) {
+                return subrange->count;
+        }
+
+        if (((subrange->flags & DWARF_DIE_UPPER_BOUND) != 0) && (subrange->upper_bound >= 0)) {
+                return subrange->upper_bound + 1;
+        }
+
+        /* Flexible array members */
+        return 0;
+}
+
+/* The type written out the way C would, without resolving anything. This is
+ * what keeps self-referencing structures from recursing forever */
+static size_t
+_type_name_build(dwarf_t *dwarf, uint32_t offset, char *buffer, size_t size, uint32_t depth)
+{
+        if (offset == 0) {
+                return snprintf(buffer, size, "void");
+        }
+
+        const dwarf_die_t * const die = _die_find(dwarf, offset);
+
+        if ((die == NULL) || (depth == DWARF_NAME_DEPTH_MAX)) {
+                return snprintf(buffer, size, "?");
+        }
+
+        const char * const name = (die->name != NULL) ? die->name : "<anonymous>";
+
+        size_t length;
+        length = 0;
+
+        switch (die->tag) {
+        case DWARF_TAG_STRUCTURE_TYPE:
+        case DWARF_TAG_CLASS_TYPE:
+                return snprintf(buffer, size, "struct %s", name);
+        case DWARF_TAG_UNION_TYPE:
+                return snprintf(buffer, size, "union %s", name);
+        case DWARF_TAG_ENUMERATION_TYPE:
+                return snprintf(buffer, size, "enum %s", name);
+        case DWARF_TAG_SUBROUTINE_TYPE:
+                return snprintf(buffer, size, "function");
+        case DWARF_TAG_POINTER_TYPE:
+        case DWARF_TAG_REFERENCE_TYPE:
+                length = _type_name_build(dwarf, die->type, buffer, size, depth + 1);
+
+                if (length < size) {
+                        length += snprintf(&buffer[length], size - length, " *");
+                }
+
+                return length;
+        case DWARF_TAG_CONST_TYPE:
+        case DWARF_TAG_VOLATILE_TYPE:
+                length = snprintf(buffer, size, (die->tag == DWARF_TAG_CONST_TYPE) ? "const " : "volatile ");
+
+                if (length < size) {
+                        length += _type_name_build(dwarf, die->type, &buffer[length], size - length, depth + 1);
+                }
+
+                return length;
+        case DWARF_TAG_RESTRICT_TYPE:
+        case DWARF_TAG_ATOMIC_TYPE:
+                return _type_name_build(dwarf, die->type, buffer, size, depth + 1);
+        case DWARF_TAG_ARRAY_TYPE:
+                length = _type_name_build(dwarf, die->type, buffer, size, depth + 1);
+
+                const dwarf_cu_t * const cu = _cu_offset_find(dwarf, offset);
+
+                for (uint32_t i = die->child; (i != 0) && (length < size); i = cu->dies[i].sibling) {
+                        if (cu->dies[i].tag == DWARF_TAG_SUBRANGE_TYPE) {
+                                length += snprintf(&buffer[length], size - length, "[%u]",
+                                    _array_count_get(&cu->dies[i]));
+                        }
+                }
+
+                return length;
+        default:
+                return snprintf(buffer, size, "%s", name);
+        }
+}
+
+static char *
+_type_name_get(dwarf_t *dwarf, uint32_t offset)
+{
+        char buffer[256];
+
+        (void)_type_name_build(dwarf, offset, buffer, sizeof(buffer), 0);
+
+        return strdup(buffer);
+}
+
+static bool
+_members_build(dwarf_t *dwarf, const dwarf_cu_t *cu, const dwarf_die_t *die, dwarf_type_t *type)
+{
+        uint32_t count;
+        count = 0;
+
+        for (uint32_t i = die->child; i != 0; i = cu->dies[i].sibling) {
+                const uint32_t tag = cu->dies[i].tag;
+
+                if ((tag == DWARF_TAG_MEMBER) || (tag == DWARF_TAG_ENUMERATOR)) {
+                        count++;
+                }
+        }
+
+        if (count == 0) {
+                return true;
+        }
+
+        if (die->tag == DWARF_TAG_ENUMERATION_TYPE) {
+                if ((type->enumerators = malloc(count * sizeof(dwarf_enumerator_t))) == NULL) {
+                        return false;
+                }
+        } else if ((type->members = malloc(count * sizeof(dwarf_member_t))) == NULL) {
+                return false;
+        }
+
+        for (uint32_t i = die->child; i != 0; i = cu->dies[i].sibling) {
+                const dwarf_die_t * const child = &cu->dies[i];
+
+                if (child->tag == DWARF_TAG_ENUMERATOR) {
+                        type->enumerators[type->enumerator_count] = (dwarf_enumerator_t) {
+                                .name  = (child->name != NULL) ? child->name : "?",
+                                .value = child->const_value
+                        };
+
+                        type->enumerator_count++;
+
+                        continue;
+                }
+
+                if (child->tag != DWARF_TAG_MEMBER) {
+                        continue;
+                }
+
+                dwarf_member_t * const member = &type->members[type->member_count];
+
+                *member = (dwarf_member_t) {
+                        .name     = child->name,
+                        .offset   = child->member_location,
+                        .bit_size = child->bit_size,
+                        .type     = _type_get(dwarf, child->type)
+                };
+
+                if (child->bit_size != 0) {
+                        uint32_t bit_offset;
+
+                        if ((child->flags & DWARF_DIE_DATA_BIT_OFFSET) != 0) {
+                                bit_offset = child->data_bit_offset;
+                        } else {
+                                /* Older DWARF counts from the most significant
+                                 * bit of the storage unit */
+                                const uint32_t storage_size =
+                                    ((child->flags & DWARF_DIE_BYTE_SIZE) != 0) ? child->byte_size :
+                                    ((member->type != NULL) ? member->type->size : 4);
+
+                                bit_offset = child->member_location * 8;
+
+                                if (dwarf->elf->big_endian) {
+                                        bit_offset += child->bit_offset;
+                                } else {
+                                        bit_offset += (storage_size * 8) - child->bit_offset - child->bit_size;
+                                }
+                        }
+
+                        member->bit_offset = bit_offset;
+                        member->offset = bit_offset / 8;
+                }
+
+                type->member_count++;
+        }
+
+        return true;
+}
+
+static const dwarf_type_t *
+_type_build(dwarf_t *dwarf, const dwarf_die_t *die)
+{
+        const uint32_t offset = die->offset;
+        const uint32_t tag = die->tag;
+        const uint32_t target = die->type;
+        const uint32_t byte_size = die->byte_size;
+        const uint32_t encoding = die->encoding;
+
+        dwarf_type_t *type;
+
+        switch (tag) {
+        case DWARF_TAG_TYPEDEF:
+        case DWARF_TAG_CONST_TYPE:
+        case DWARF_TAG_VOLATILE_TYPE:
+        case DWARF_TAG_RESTRICT_TYPE:
+        case DWARF_TAG_ATOMIC_TYPE:
+                return _type_get(dwarf, target);
+        case DWARF_TAG_BASE_TYPE:
+                if ((type = _type_new(dwarf, DWARF_TYPE_BASE)) == NULL) {
+                        return NULL;
+                }
+
+                type->size = byte_size;
+                type->encoding = encoding;
+                break;
+        case DWARF_TAG_POINTER_TYPE:
+        case DWARF_TAG_REFERENCE_TYPE:
+                /* What it points to is only ever named, never decoded */
+                if ((type = _type_new(dwarf, DWARF_TYPE_POINTER)) == NULL) {
+                        return NULL;
+                }
+
+                type->size = ((die->flags & DWARF_DIE_BYTE_SIZE) != 0) ? byte_size : 4;
+                break;
+        case DWARF_TAG_STRUCTURE_TYPE:
+        case DWARF_TAG_CLASS_TYPE:
+        case DWARF_TAG_UNION_TYPE:
+        case DWARF_TAG_ENUMERATION_TYPE:
+                if ((type = _type_new(dwarf, (tag == DWARF_TAG_UNION_TYPE) ? DWARF_TYPE_UNION :
+                                             ((tag == DWARF_TAG_ENUMERATION_TYPE) ? DWARF_TYPE_ENUM :
+                                              DWARF_TYPE_STRUCT))) == NULL) {
+                        return NULL;
+                }
+
+                type->size = byte_size;
+                type->encoding = DWARF_ENCODING_SIGNED;
+
+                if (tag == DWARF_TAG_ENUMERATION_TYPE) {
+                        const dwarf_type_t * const underlying = _type_get(dwarf, target);
+
+                        if (underlying != NULL) {
+                                type->encoding = underlying->encoding;
+                        }
+                }
+
+                if (!(_members_build(dwarf, _cu_offset_find(dwarf, offset), die, type))) {
+                        return NULL;
+                }
+                break;
+        case DWARF_TAG_ARRAY_TYPE:
+        {
+                const dwarf_cu_t * const cu = _cu_offset_find(dwarf, offset);
+
+                uint32_t counts[8];
+                uint32_t dimension_count;
+                dimension_count = 0;
+
+                for (uint32_t i = die->child; i != 0; i = cu->dies[i].sibling) {
+                        if ((cu->dies[i].tag == DWARF_TAG_SUBRANGE_TYPE) &&
+                            (dimension_count < (sizeof(counts) / sizeof(*counts)))) {
+                                counts[dimension_count] = _array_count_get(&cu->dies[i]);
+                                dimension_count++;
+                        }
+                }
+
+                const dwarf_type_t *element;
+                element = _type_get(dwarf, target);
+
+                if ((element == NULL) || (dimension_count == 0)) {
+                        return NULL;
+                }
+
+                /* Innermost dimension first */
+                type = NULL;
+
+                for (uint32_t i = dimension_count; i > 0; i--) {
+                        if ((type = _type_new(dwarf, DWARF_TYPE_ARRAY)) == NULL) {
+                                return NULL;
+                        }
+
+                        type->element = element;
+                        type->count = counts[i - 1];
+                        type->size = element->size * type->count;
+
+                        element = type;
+                }
+        }
+                break;
+        default:
+                if ((type = _type_new(dwarf, DWARF_TYPE_OTHER)) == NULL) {
+                        return NULL;
+                }
+
+                type->size = byte_size;
+                break;
+        }
+
+        type->name = _type_name_get(dwarf, offset);
+
+        return type;
+}
+
+static const dwarf_type_t *
+_type_get(dwarf_t *dwarf, uint32_t offset)
+{
+        if (offset == 0) {
+                return NULL;
+        }
+
+        dwarf_die_t * const die = _die_find(dwarf, offset);
+
+        if (die == NULL) {
+                return NULL;
+        }
+
+        if (die->type_cache != NULL) {
+                return die->type_cache;
+        }
+
+        /* Only broken input loops without going through a pointer */
+        if ((die->flags & DWARF_DIE_RESOLVING) != 0) {
+                return NULL;
+        }
+
+        die->flags |= DWARF_DIE_RESOLVING;
+
+        const dwarf_type_t * const type = _type_build(dwarf, die);
+
+        die->flags &= ~DWARF_DIE_RESOLVING;
+        die->type_cache = type;
+
+        return type;
+}
+
+const dwarf_variable_t *
+dwarf_variable_find(dwarf_t *dwarf, const char *name)
+{
+        assert(dwarf != NULL);
+        assert(name != NULL);
+
+        uint32_t *slot;
+
+        /* Parse one more unit at a time until the name turns up */
+        while (*(slot = _index_slot_find(dwarf, name)) == 0) {
+                if (dwarf->next_cu == dwarf->cu_count) {
+                        return NULL;
+                }
+
+                (void)_cu_parse(dwarf, &dwarf->cus[dwarf->next_cu]);
+
+                dwarf->next_cu++;
+        }
+
+        dwarf_variable_t * const variable = &dwarf->variables[*slot - 1];
+
+        if ((variable->type == NULL) && (variable->type_offset != 0)) {
+                const dwarf_type_t * const type = _type_get(dwarf, variable->type_offset);
+
+                /* Resolving may have added variables and moved them */
+                dwarf_variable_t * const moved = &dwarf->variables[*_index_slot_find(dwarf, name) - 1];
+
+                moved->type = type;
+
+                return moved;
+        }
+
+        return variable;
+}
+
+uint64_t
+dwarf_unsigned_get(const dwarf_t *dwarf, const uint8_t *p, uint32_t size)
+{
+        uint64_t value;
+        value = 0;
+
+        if (dwarf->elf->big_endian) {
+                for (uint32_t i = 0; i < size; i++) {
+                        value = (value << 8) | p[i];
+                }
+        } else {
+                for (uint32_t i = size; i > 0; i--) {
+                        value = (value << 8) | p[i - 1];
+                }
+        }
+
+        return value;
+}
+
+uint64_t
+dwarf_bits_get(const dwarf_t *dwarf, const uint8_t *p, uint32_t bit_offset,
+    uint32_t bit_size)
+{
+        const uint32_t shift = bit_offset % 8;
+
+        uint32_t byte_count;
+        byte_count = (shift + bit_size + 7) / 8;
+        byte_count = (byte_count < 8) ? byte_count : 8;
+
+        const uint64_t value = dwarf_unsigned_get(dwarf, &p[bit_offset / 8], byte_count);
+        const uint64_t mask = (bit_size >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << bit_size) - 1);
+
+        if (dwarf->elf->big_endian) {
+                return (value >> ((byte_count * 8) - shift - bit_size)) & mask;
+        }
+
+        return (value >> shift) & mask;
+}
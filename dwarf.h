@@ -0,0 +1,97 @@
+#ifndef DWARF_H
+#define DWARF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "elf.h"
+
+/* Reads variables and their types out of an ELF file's .debug_info. Only
+ * 32-bit DWARF (versions 2 to 5) is understood.
+ *
+ * Nothing is parsed up front beyond the compilation unit headers. A unit is
+ * parsed the first time a lookup has to look inside it, and types are
+ * decoded the first time they're asked for. Both are kept until the reader
+ * is deleted */
+
+#define DWARF_ENCODING_BOOLEAN          0x02
+#define DWARF_ENCODING_FLOAT            0x04
+#define DWARF_ENCODING_SIGNED           0x05
+#define DWARF_ENCODING_SIGNED_CHAR      0x06
+#define DWARF_ENCODING_UNSIGNED         0x07
+#define DWARF_ENCODING_UNSIGNED_CHAR    0x08
+#define DWARF_ENCODING_UTF              0x10
+
+typedef enum {
+        DWARF_TYPE_BASE,
+        DWARF_TYPE_POINTER,
+        DWARF_TYPE_STRUCT,
+        DWARF_TYPE_UNION,
+        DWARF_TYPE_ARRAY,
+        DWARF_TYPE_ENUM,
+        DWARF_TYPE_OTHER
+} dwarf_type_kind_t;
+
+typedef struct dwarf dwarf_t;
+typedef struct dwarf_type dwarf_type_t;
+
+typedef struct {
+        const char *name;
+        uint32_t offset;
+
+        /* Bit fields only. The offset is from the start of the structure, in
+         * the target's bit order */
+        uint32_t bit_offset;
+        uint32_t bit_size;
+
+        const dwarf_type_t *type;
+} dwarf_member_t;
+
+typedef struct {
+        const char *name;
+        int64_t value;
+} dwarf_enumerator_t;
+
+struct dwarf_type {
+        dwarf_type_kind_t kind;
+
+        /* As it would be written in C, e.g. "struct foo" or "char *" */
+        char *name;
+        uint32_t size;
+
+        /* Base and enumeration types */
+        uint32_t encoding;
+
+        /* Arrays. Arrays of arrays are nested */
+        const dwarf_type_t *element;
+        uint32_t count;
+
+        dwarf_member_t *members;
+        uint32_t member_count;
+
+        dwarf_enumerator_t *enumerators;
+        uint32_t enumerator_count;
+};
+
+typedef struct {
+        const char *name;
+        uint32_t address;
+        bool has_address;
+
+        /* Offset of the type's entry in .debug_info, then the type itself
+         * once it's been decoded */
+        uint32_t type_offset;
+        const dwarf_type_t *type;
+} dwarf_variable_t;
+
+dwarf_t *dwarf_new(const elf_t *elf);
+void dwarf_delete(dwarf_t *dwarf);
+
+const dwarf_variable_t *dwarf_variable_find(dwarf_t *dwarf, const char *name);
+
+uint64_t dwarf_unsigned_get(const dwarf_t *dwarf, const uint8_t *p, uint32_t size);
+uint64_t dwarf_bits_get(const dwarf_t *dwarf, const uint8_t *p,
+    uint32_t bit_offset, uint32_t bit_size);
+
+#endif /* DWARF_H */
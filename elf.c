@@ -0,0 +1,374 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif /* !_WIN32 */
+
+#include "elf.h"
+
+#define ELF_HEADER_SIZE         0x34
+#define ELF_SECTION_HEADER_SIZE 0x28
+
+#define ELF_CLASS_32            1
+#define ELF_DATA_LSB            1
+#define ELF_DATA_MSB            2
+
+static bool _image_load(elf_t *elf, const char *path);
+static void _image_unload(elf_t *elf);
+static bool _sections_parse(elf_t *elf);
+static int _loaded_compare(const void *a, const void *b);
+
+elf_t *
+elf_open(const char *path)
+{
+        assert(path != NULL);
+
+        elf_t * const elf = calloc(1, sizeof(elf_t));
+
+        if (elf == NULL) {
+                return NULL;
+        }
+
+        if (!(_image_load(elf, path))) {
+                free(elf);
+
+                return NULL;
+        }
+
+        if (!(_sections_parse(elf))) {
+                elf_close(elf);
+
+                return NULL;
+        }
+
+        elf->path = strdup(path);
+
+        return elf;
+}
+
+void
+elf_close(elf_t *elf)
+{
+        if (elf == NULL) {
+                return;
+        }
+
+        _image_unload(elf);
+
+        free(elf->path);
+        free(elf->sections);
+        free(elf->loaded);
+        free(elf);
+}
+
+const elf_section_t *
+elf_section_find(const elf_t *elf, const char *name)
+{
+        assert(elf != NULL);
+        assert(name != NULL);
+
+        for (uint32_t i = 0; i < elf->section_count; i++) {
+                const elf_section_t * const section = &elf->sections[i];
+
+                if ((strcmp(section->name, name)) == 0) {
+                        return section;
+                }
+        }
+
+        return NULL;
+}
+
+const elf_section_t *
+elf_section_address_find(const elf_t *elf, uint32_t address)
+{
+        assert(elf != NULL);
+
+        uint32_t low;
+        low = 0;
+        uint32_t high;
+        high = elf->loaded_count;
+
+        while (low < high) {
+                const uint32_t mid = low + ((high - low) / 2);
+                const elf_section_t * const section = elf->loaded[mid];
+
+                if (address < section->address) {
+                        high = mid;
+                } else if ((address - section->address) >= section->size) {
+                        low = mid + 1;
+                } else {
+                        return section;
+                }
+        }
+
+        return NULL;
+}
+
+const void *
+elf_address_map(const elf_t *elf, uint32_t address, size_t size)
+{
+        const elf_section_t * const section =
+            elf_section_address_find(elf, address);
+
+        if (section == NULL) {
+                return NULL;
+        }
+
+        const uint32_t offset = address - section->address;
+
+        if (size > (section->size - offset)) {
+                return NULL;
+        }
+
+        return &section->data[offset];
+}
+
+const char *
+elf_string_get(const elf_t *elf, uint32_t address)
+{
+        const elf_section_t * const section =
+            elf_section_address_find(elf, address);
+
+        if (section == NULL) {
+                return NULL;
+        }
+
+        const uint32_t offset = address - section->address;
+        const char * const string = (const char *)&section->data[offset];
+
+        /* Make sure the string is terminated within the section */
+        if ((memchr(string, '\0', section->size - offset)) == NULL) {
+                return NULL;
+        }
+
+        return string;
+}
+
+uint16_t
+elf_u16_get(const elf_t *elf, const void *p)
+{
+        const uint8_t * const b = p;
+
+        if (elf->big_endian) {
+                return ((uint16_t)b[0] << 8) | b[1];
+        }
+
+        return ((uint16_t)b[1] << 8) | b[0];
+}
+
+uint32_t
+elf_u32_get(const elf_t *elf, const void *p)
+{
+        const uint8_t * const b = p;
+
+        if (elf->big_endian) {
+                return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+                       ((uint32_t)b[2] <<  8) |  (uint32_t)b[3];
+        }
+
+        return ((uint32_t)b[3] << 24) | ((uint32_t)b[2] << 16) |
+               ((uint32_t)b[1] <<  8) |  (uint32_t)b[0];
+}
+
+#if !defined(_WIN32)
+static bool
+_image_load(elf_t *elf, const char *path)
+{
+        const int fd = open(path, O_RDONLY);
+
+        if (fd < 0) {
+                return false;
+        }
+
+        struct stat stat_buffer;
+
+        if (((fstat(fd, &stat_buffer)) != 0) || !S_ISREG(stat_buffer.st_mode) ||
+            (stat_buffer.st_size < ELF_HEADER_SIZE)) {
+                (void)close(fd);
+
+                return false;
+        }
+
+        void * const image =
+            mmap(NULL, stat_buffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        (void)close(fd);
+
+        if (image == MAP_FAILED) {
+                return false;
+        }
+
+        elf->image = image;
+        elf->image_size = stat_buffer.st_size;
+        elf->mapped = true;
+
+        return true;
+}
+
+static void
+_image_unload(elf_t *elf)
+{
+        if (elf->mapped) {
+                (void)munmap(elf->image, elf->image_size);
+        } else {
+                free(elf->image);
+        }
+
+        elf->image = NULL;
+}
+#else
+static bool
+_image_load(elf_t *elf, const char *path)
+{
+        FILE * const fp = fopen(path, "rb");
+
+        if (fp == NULL) {
+                return false;
+        }
+
+        long size;
+
+        if (((fseek(fp, 0, SEEK_END)) != 0) || ((size = ftell(fp)) < ELF_HEADER_SIZE)) {
+                (void)fclose(fp);
+
+                return false;
+        }
+
+        rewind(fp);
+
+        uint8_t * const image = malloc(size);
+
+        if ((image == NULL) || ((fread(image, 1, size, fp)) != (size_t)size)) {
+                free(image);
+                (void)fclose(fp);
+
+                return false;
+        }
+
+        (void)fclose(fp);
+
+        elf->image = image;
+        elf->image_size = size;
+        elf->mapped = false;
+
+        return true;
+}
+
+static void
+_image_unload(elf_t *elf)
+{
+        free(elf->image);
+
+        elf->image = NULL;
+}
+#endif /* !_WIN32 */
+
+static bool
+_sections_parse(elf_t *elf)
+{
+        const uint8_t * const image = elf->image;
+
+        if ((memcmp(image, "\177ELF", 4)) != 0) {
+                return false;
+        }
+
+        if (image[4] != ELF_CLASS_32) {
+                return false;
+        }
+
+        if ((image[5] != ELF_DATA_LSB) && (image[5] != ELF_DATA_MSB)) {
+                return false;
+        }
+
+        elf->big_endian = (image[5] == ELF_DATA_MSB);
+        elf->entry = elf_u32_get(elf, &image[0x18]);
+
+        const uint32_t shoff = elf_u32_get(elf, &image[0x20]);
+        const uint16_t shentsize = elf_u16_get(elf, &image[0x2E]);
+        const uint16_t shnum = elf_u16_get(elf, &image[0x30]);
+        const uint16_t shstrndx = elf_u16_get(elf, &image[0x32]);
+
+        if ((shnum == 0) || (shentsize < ELF_SECTION_HEADER_SIZE) ||
+            (shstrndx >= shnum) ||
+            (shoff > elf->image_size) ||
+            (((size_t)shnum * shentsize) > (elf->image_size - shoff))) {
+                return false;
+        }
+
+        elf->sections = calloc(shnum, sizeof(elf_section_t));
+        elf->loaded = calloc(shnum, sizeof(elf_section_t *));
+
+        if ((elf->sections == NULL) || (elf->loaded == NULL)) {
+                return false;
+        }
+
+        elf->section_count = shnum;
+
+        for (uint32_t i = 0; i < shnum; i++) {
+                const uint8_t * const header = &image[shoff + (i * shentsize)];
+                elf_section_t * const section = &elf->sections[i];
+
+                *section = (elf_section_t) {
+                        .name       = "",
+                        .type       = elf_u32_get(elf, &header[0x04]),
+                        .flags      = elf_u32_get(elf, &header[0x08]),
+                        .address    = elf_u32_get(elf, &header[0x0C]),
+                        .offset     = elf_u32_get(elf, &header[0x10]),
+                        .size       = elf_u32_get(elf, &header[0x14]),
+                        .link       = elf_u32_get(elf, &header[0x18]),
+                        .info       = elf_u32_get(elf, &header[0x1C]),
+                        .entry_size = elf_u32_get(elf, &header[0x24]),
+                        .data       = NULL
+                };
+
+                if ((section->type != ELF_SHT_NOBITS) &&
+                    (section->offset <= elf->image_size) &&
+                    (section->size <= (elf->image_size - section->offset))) {
+                        section->data = &image[section->offset];
+                }
+        }
+
+        const elf_section_t * const strtab = &elf->sections[shstrndx];
+
+        for (uint32_t i = 0; i < shnum; i++) {
+                const uint8_t * const header = &image[shoff + (i * shentsize)];
+                elf_section_t * const section = &elf->sections[i];
+
+                const uint32_t name_offset = elf_u32_get(elf, &header[0x00]);
+
+                if ((strtab->data != NULL) && (name_offset < strtab->size) &&
+                    ((memchr(&strtab->data[name_offset], '\0', strtab->size - name_offset)) != NULL)) {
+                        section->name = (const char *)&strtab->data[name_offset];
+                }
+
+                if (((section->flags & ELF_SHF_ALLOC) != 0) &&
+                    (section->data != NULL) && (section->size > 0)) {
+                        elf->loaded[elf->loaded_count] = section;
+                        elf->loaded_count++;
+                }
+        }
+
+        qsort(elf->loaded, elf->loaded_count, sizeof(elf_section_t *), _loaded_compare);
+
+        return true;
+}
+
+static int
+_loaded_compare(const void *a, const void *b)
+{
+        const elf_section_t * const section_a = *(const elf_section_t * const *)a;
+        const elf_section_t * const section_b = *(const elf_section_t * const *)b;
+
+        if (section_a->address < section_b->address) {
+                return -1;
+        }
+
+        return (section_a->address > section_b->address);
+}
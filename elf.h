@@ -0,0 +1,65 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Only 32-bit ELF files are supported, which is all the SH-2 toolchain
+ * produces */
+
+#define ELF_SHT_PROGBITS        1
+#define ELF_SHT_SYMTAB          2
+#define ELF_SHT_STRTAB          3
+#define ELF_SHT_NOBITS          8
+
+#define ELF_SHF_WRITE           (1 << 0)
+#define ELF_SHF_ALLOC           (1 << 1)
+
+typedef struct {
+        const char *name;
+        uint32_t type;
+        uint32_t flags;
+        uint32_t address;
+        uint32_t offset;
+        uint32_t size;
+        uint32_t link;
+        uint32_t info;
+        uint32_t entry_size;
+
+        /* NULL if the section has no data in the file */
+        const uint8_t *data;
+} elf_section_t;
+
+typedef struct {
+        char *path;
+
+        uint8_t *image;
+        size_t image_size;
+        bool mapped;
+
+        bool big_endian;
+        uint32_t entry;
+
+        elf_section_t *sections;
+        uint32_t section_count;
+
+        /* Sections loaded in target memory that have data, sorted by
+         * address */
+        const elf_section_t **loaded;
+        uint32_t loaded_count;
+} elf_t;
+
+elf_t *elf_open(const char *path);
+void elf_close(elf_t *elf);
+
+const elf_section_t *elf_section_find(const elf_t *elf, const char *name);
+const elf_section_t *elf_section_address_find(const elf_t *elf, uint32_t address);
+
+const void *elf_address_map(const elf_t *elf, uint32_t address, size_t size);
+const char *elf_string_get(const elf_t *elf, uint32_t address);
+
+uint16_t elf_u16_get(const elf_t *elf, const void *p);
+uint32_t elf_u32_get(const elf_t *elf, const void *p);
+
+#endif /* ELF_H */
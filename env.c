@@ -1,52 +1,84 @@
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "env.h"
 
-#include <sys/queue.h>
+/* Grown when more than half full */
+#define ENV_SLOT_COUNT_MIN 64
 
-struct env_entry;
-
-typedef TAILQ_HEAD(environment, env_entry) environment_t;
+/* Every symbol is interned here once. Whether or not it's bound to a value,
+ * its name never moves, so a name handed out by env_intern() leads straight
+ * back to its entry, without being hashed or compared */
+typedef struct env_entry {
+        env_pair_t env_pair;
 
-typedef struct env_entry env_entry_t;
+        uint32_t hash;
+        bool bound;
 
-struct env_entry {
-        env_pair_t env_pair;
+        char name[];
+} env_entry_t;
 
-        TAILQ_ENTRY(env_entry) entries;
-};
+static struct {
+        /* Open addressing with linear probing */
+        env_entry_t **slots;
+        uint32_t slot_mask;
+        uint32_t entry_count;
 
-static environment_t _environment;
+        /* Bound entries, in the order they were first put */
+        env_entry_t **order;
+        uint32_t order_count;
+        uint32_t order_capacity;
+} _environment;
 
-static env_entry_t *_env_entry_get(const char *symbol);
+static uint32_t _env_hash(const char *symbol);
+static env_entry_t *_env_entry_get(const char *symbol, uint32_t hash);
+static env_entry_t *_env_entry_intern(const char *symbol);
+static env_entry_t *_env_entry_interned_get(const char *name);
+static void _env_entry_bind(env_entry_t *env_entry, void *value);
+static bool _env_pair_get(const env_entry_t *env_entry, const char *symbol,
+    env_pair_t *pair);
 
 void
 env_init(void)
 {
-        TAILQ_INIT(&_environment);
+        _environment.slots = calloc(ENV_SLOT_COUNT_MIN, sizeof(env_entry_t *));
+        assert(_environment.slots != NULL);
+
+        _environment.slot_mask = ENV_SLOT_COUNT_MIN - 1;
+        _environment.entry_count = 0;
+
+        _environment.order = NULL;
+        _environment.order_count = 0;
+        _environment.order_capacity = 0;
 }
 
 void
 env_deinit(void)
 {
-        env_entry_t *env_np;
-        env_np = TAILQ_FIRST(&_environment);
+        for (uint32_t i = 0; i <= _environment.slot_mask; i++) {
+                free(_environment.slots[i]);
+        }
 
-        while (env_np != NULL) {
-                env_entry_t * const next =
-                    TAILQ_NEXT(env_np, entries);
+        free(_environment.slots);
+        free(_environment.order);
 
-                if (env_np->env_pair.symbol != NULL) {
-                        free((void *)env_np->env_pair.symbol);
-                }
+        _environment.slots = NULL;
+        _environment.order = NULL;
+        _environment.entry_count = 0;
+        _environment.order_count = 0;
+        _environment.order_capacity = 0;
+}
 
-                free(env_np);
+const char *
+env_intern(const char *symbol)
+{
+        assert(symbol != NULL);
 
-                env_np = next;
-        }
+        return _env_entry_intern(symbol)->name;
 }
 
 void
@@ -54,20 +86,39 @@ env_put(const char *symbol, void *value)
 {
         assert(symbol != NULL);
 
-        env_entry_t *env_entry;
+        _env_entry_bind(_env_entry_intern(symbol), value);
+}
+
+void
+env_interned_put(const char *name, void *value)
+{
+        assert(name != NULL);
 
-        env_entry = _env_entry_get(symbol);
-        if (env_entry != NULL) {
-                env_entry->env_pair.value = value;
-        } else {
-                env_entry = malloc(sizeof(env_entry_t));
-                assert(env_entry != NULL);
+        _env_entry_bind(_env_entry_interned_get(name), value);
+}
 
-                env_entry->env_pair.symbol = strdup(symbol);
-                env_entry->env_pair.value = value;
+static void
+_env_entry_bind(env_entry_t *env_entry, void *value)
+{
+        if (!env_entry->bound) {
+                if (_environment.order_count == _environment.order_capacity) {
+                        const uint32_t capacity = (_environment.order_capacity == 0) ?
+                            ENV_SLOT_COUNT_MIN : (_environment.order_capacity * 2);
 
-                TAILQ_INSERT_TAIL(&_environment, env_entry, entries);
+                        _environment.order =
+                            realloc(_environment.order, capacity * sizeof(env_entry_t *));
+                        assert(_environment.order != NULL);
+
+                        _environment.order_capacity = capacity;
+                }
+
+                _environment.order[_environment.order_count] = env_entry;
+                _environment.order_count++;
+
+                env_entry->bound = true;
         }
+
+        env_entry->env_pair.value = value;
 }
 
 bool
@@ -76,12 +127,26 @@ env_get(const char *symbol, env_pair_t *pair)
         assert(symbol != NULL);
         assert(pair != NULL);
 
-        env_entry_t * const env_entry = _env_entry_get(symbol);
+        return _env_pair_get(_env_entry_get(symbol, _env_hash(symbol)), symbol, pair);
+}
+
+bool
+env_interned_get(const char *name, env_pair_t *pair)
+{
+        assert(name != NULL);
+        assert(pair != NULL);
 
+        return _env_pair_get(_env_entry_interned_get(name), name, pair);
+}
+
+static bool
+_env_pair_get(const env_entry_t *env_entry, const char *symbol,
+    env_pair_t *pair)
+{
         pair->symbol = symbol;
         pair->value = NULL;
 
-        if (env_entry == NULL) {
+        if ((env_entry == NULL) || !env_entry->bound) {
                 return false;
         }
 
@@ -102,26 +167,143 @@ env_value_get(const char *symbol)
         return pair.value;
 }
 
+void *
+env_interned_value_get(const char *name)
+{
+        env_pair_t pair;
+
+        if (!(env_interned_get(name, &pair))) {
+                return NULL;
+        }
+
+        return pair.value;
+}
+
 void
 env_traverse(env_traverse_func_t func)
 {
         assert(func != NULL);
 
-        env_entry_t *env_np;
-        TAILQ_FOREACH (env_np, &_environment, entries) {
-                func(&env_np->env_pair);
+        for (uint32_t i = 0; i < _environment.order_count; i++) {
+                func(&_environment.order[i]->env_pair);
+        }
+}
+
+/* FNV-1a */
+static uint32_t
+_env_hash(const char *symbol)
+{
+        uint32_t hash;
+        hash = 0x811C9DC5;
+
+        for (; *symbol != '\0'; symbol++) {
+                hash = (hash ^ (uint8_t)*symbol) * 0x01000193;
         }
+
+        return hash;
+}
+
+/* The name is the entry's own, so the entry is right before it */
+static env_entry_t *
+_env_entry_interned_get(const char *name)
+{
+        env_entry_t * const env_entry =
+            (env_entry_t *)(void *)(name - offsetof(env_entry_t, name));
+
+        assert(env_entry->name == name);
+
+        return env_entry;
 }
 
 static env_entry_t *
-_env_entry_get(const char *symbol)
+_env_entry_get(const char *symbol, uint32_t hash)
 {
-        env_entry_t *env_np;
-        TAILQ_FOREACH (env_np, &_environment, entries) {
-                if ((strcmp(symbol, env_np->env_pair.symbol)) == 0) {
-                        return env_np;
+        uint32_t slot;
+        slot = hash & _environment.slot_mask;
+
+        env_entry_t *env_entry;
+
+        while ((env_entry = _environment.slots[slot]) != NULL) {
+                /* Interned names match by pointer. Anything else only needs
+                 * comparing when the hashes agree */
+                if ((env_entry->name == symbol) ||
+                    ((env_entry->hash == hash) && ((strcmp(env_entry->name, symbol)) == 0))) {
+                        return env_entry;
                 }
+
+                slot = (slot + 1) & _environment.slot_mask;
         }
 
         return NULL;
 }
+
+static void
+_env_slots_grow(void)
+{
+        const uint32_t slot_count = (_environment.slot_mask + 1) * 2;
+
+        env_entry_t ** const slots = calloc(slot_count, sizeof(env_entry_t *));
+        assert(slots != NULL);
+
+        for (uint32_t i = 0; i <= _environment.slot_mask; i++) {
+                env_entry_t * const env_entry = _environment.slots[i];
+
+                if (env_entry == NULL) {
+                        continue;
+                }
+
+                uint32_t slot;
+                slot = env_entry->hash & (slot_count - 1);
+
+                while (slots[slot] != NULL) {
+                        slot = (slot + 1) & (slot_count - 1);
+                }
+
+                slots[slot] = env_entry;
+        }
+
+        free(_environment.slots);
+
+        _environment.slots = slots;
+        _environment.slot_mask = slot_count - 1;
+}
+
+static env_entry_t *
+_env_entry_intern(const char *symbol)
+{
+        const uint32_t hash = _env_hash(symbol);
+
+        env_entry_t *env_entry;
+
+        if ((env_entry = _env_entry_get(symbol, hash)) != NULL) {
+                return env_entry;
+        }
+
+        if (((_environment.entry_count + 1) * 2) > (_environment.slot_mask + 1)) {
+                _env_slots_grow();
+        }
+
+        const size_t length = strlen(symbol);
+
+        env_entry = malloc(sizeof(env_entry_t) + length + 1);
+        assert(env_entry != NULL);
+
+        (void)memcpy(env_entry->name, symbol, length + 1);
+
+        env_entry->env_pair.symbol = env_entry->name;
+        env_entry->env_pair.value = NULL;
+        env_entry->hash = hash;
+        env_entry->bound = false;
+
+        uint32_t slot;
+        slot = hash & _environment.slot_mask;
+
+        while (_environment.slots[slot] != NULL) {
+                slot = (slot + 1) & _environment.slot_mask;
+        }
+
+        _environment.slots[slot] = env_entry;
+        _environment.entry_count++;
+
+        return env_entry;
+}
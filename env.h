@@ -16,9 +16,20 @@ typedef void (*env_traverse_func_t)(const env_pair_t *pair);
 void env_init(void);
 void env_deinit(void);
 
+/* Returns the environment's own copy of the symbol. It stays valid until
+ * env_deinit() */
+const char *env_intern(const char *symbol);
+
 void env_put(const char *symbol, void *value);
 void *env_value_get(const char *symbol);
 bool env_get(const char *symbol, env_pair_t *pair);
+
+/* The same, for a name returned by env_intern(), which leads straight to its
+ * entry without being hashed or compared. Any other name is undefined
+ * behavior. The parser interns every symbol and form name */
+void env_interned_put(const char *name, void *value);
+void *env_interned_value_get(const char *name);
+bool env_interned_get(const char *name, env_pair_t *pair);
 void env_traverse(env_traverse_func_t func);
 
 #endif /* ENV_H */
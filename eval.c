@@ -0,0 +1,625 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "commands.h"
+#include "env.h"
+#include "eval.h"
+#include "jobs.h"
+#include "macro.h"
+#include "object.h"
+#include "parser.h"
+
+/* How deep macros can call each other */
+#define EVAL_MACRO_DEPTH_MAX 64
+
+/* Initial number of values in the stack. It grows as needed */
+#define EVAL_STACK_SIZE 256
+
+static struct {
+        /* The arguments of the macro being called */
+        object_t *frame;
+        uint32_t depth;
+
+        /* Values of the forms in a command's arguments. Each command being
+         * evaluated has its arguments' slots, and anything its arguments
+         * run goes above them */
+        object_t *stack;
+        uint32_t stack_top;
+        uint32_t stack_size;
+} _state;
+
+static uint32_t
+_stack_push(uint32_t count)
+{
+        const uint32_t base = _state.stack_top;
+
+        if ((base + count) > _state.stack_size) {
+                uint32_t size;
+                size = (_state.stack_size == 0) ? EVAL_STACK_SIZE : _state.stack_size;
+
+                while ((base + count) > size) {
+                        size *= 2;
+                }
+
+                _state.stack = realloc(_state.stack, size * sizeof(object_t));
+                assert(_state.stack != NULL);
+
+                _state.stack_size = size;
+        }
+
+        _state.stack_top += count;
+
+        return base;
+}
+
+static void
+_stack_pop(uint32_t base)
+{
+        for (uint32_t i = base; i < _state.stack_top; i++) {
+                eval_value_release(&_state.stack[i]);
+        }
+
+        _state.stack_top = base;
+}
+
+static bool
+_node_is_call(const ast_node_t *node)
+{
+        return ((node->type == AST_NODE_FORM) &&
+                (node->operator == AST_OPERATOR_NONE));
+}
+
+/* Runs the command or macro in the form, and takes the value it gives
+ * back */
+static bool
+_call_value_get(const parser_t *parser, const ast_node_t *node, object_t *value)
+{
+        if ((node->name != NULL) && (node->head == NULL)) {
+                commands_status_set(COMMANDS_STATUS_UNDEFINED_SYMBOL);
+
+                return false;
+        }
+
+        if ((eval_form(parser, node)) != EVAL_RET_OK) {
+                if (!(commands_status_failed())) {
+                        commands_status_set(COMMANDS_STATUS_ERROR);
+                }
+
+                return false;
+        }
+
+        if (!(commands_value_take(value))) {
+                commands_printf("\"%s\" gives nothing back\n", node->name);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return false;
+        }
+
+        return true;
+}
+
+/* Returns NULL if the node is a form */
+static const object_t *
+_node_object_get(const ast_node_t *node)
+{
+        switch (node->type) {
+        case AST_NODE_OBJECT:
+                return eval_object_get(node->object);
+        case AST_NODE_PARAM:
+                assert(_state.frame != NULL);
+
+                return &_state.frame[node->index];
+        default:
+                return NULL;
+        }
+}
+
+/* Arguments are evaluated into the frame before it's in use, as they may
+ * refer to the caller's own parameters. Strings are copied, and buffers
+ * referenced, as the variable they came from can be set while the body
+ * runs */
+static eval_ret_t
+_macro_call(const parser_t *parser, const ast_node_t *form)
+{
+        const macro_t * const macro = form->head->as.macro;
+
+        if (form->argc != macro->param_count) {
+                (void)printf("Mismatch in arguments passed to \"%s\". Expected %u, got %u\n",
+                    form->name,
+                    macro->param_count,
+                    form->argc);
+
+                return EVAL_RET_ARGC_MISMATCH;
+        }
+
+        if (_state.depth == EVAL_MACRO_DEPTH_MAX) {
+                commands_printf("Macros nested too deeply\n");
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return EVAL_RET_FAILED;
+        }
+
+        object_t frame[MACRO_PARAMS_MAX];
+        uint32_t count;
+        count = 0;
+
+        eval_ret_t ret;
+        ret = EVAL_RET_OK;
+
+        for (const ast_node_t *arg = form->args; arg != NULL; arg = arg->next) {
+                const object_t * const object = _node_object_get(arg);
+
+                if (object == NULL) {
+                        if (!(eval_value_get(parser, arg, &frame[count]))) {
+                                ret = EVAL_RET_FAILED;
+
+                                break;
+                        }
+                } else if (object->type == OBJECT_TYPE_STRING) {
+                        frame[count].type = OBJECT_TYPE_STRING;
+                        frame[count].as.string = strdup(object->as.string);
+                        assert(frame[count].as.string != NULL);
+                } else {
+                        frame[count] = *object;
+
+                        if (object->type == OBJECT_TYPE_BUFFER) {
+                                buffer_ref(object->as.buffer);
+                        }
+                }
+
+                count++;
+        }
+
+        if (ret == EVAL_RET_OK) {
+                object_t * const caller_frame = _state.frame;
+
+                _state.frame = frame;
+                _state.depth++;
+
+                ret = eval_forms(parser, macro->body);
+
+                _state.frame = caller_frame;
+                _state.depth--;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                if (frame[i].type == OBJECT_TYPE_STRING) {
+                        free(frame[i].as.string);
+                } else {
+                        eval_value_release(&frame[i]);
+                }
+        }
+
+        return ret;
+}
+
+static eval_ret_t
+_command_run(const parser_t *parser, const command_t *command, bool background)
+{
+        /* If the argument count is -1, it's variadic */
+        if ((command->arg_count >= 0) &&
+            (command->arg_count != parser->stream->argc)) {
+                (void)printf("Mismatch in arguments passed to \"%s\". Expected %i, got %i\n",
+                    command->name,
+                    command->arg_count,
+                    parser->stream->argc);
+
+                return EVAL_RET_ARGC_MISMATCH;
+        }
+
+        commands_status_clear();
+
+        if (!background) {
+                command->func(parser);
+        } else {
+                job_t * const job = command->job_func(parser);
+
+                if (job != NULL) {
+                        jobs_submit(job);
+                }
+        }
+
+        return (commands_status_failed()) ? EVAL_RET_FAILED : EVAL_RET_OK;
+}
+
+static eval_ret_t
+_command_form_eval(const parser_t *parser, const ast_node_t *form, bool background)
+{
+        const command_t * const command = form->head->as.command;
+
+        parser_stream_t * const stream = parser->stream;
+
+        /* Forms in the arguments can run commands of their own, which
+         * fill the stream in, so they're all evaluated before it is */
+        const uint32_t base = _stack_push(form->argc);
+
+        uint32_t i;
+        i = 0;
+
+        for (const ast_node_t *arg = form->args; arg != NULL; arg = arg->next, i++) {
+                object_t value = {
+                        .type = OBJECT_TYPE_INTEGER
+                };
+
+                if (arg->type == AST_NODE_FORM) {
+                        if (!(eval_value_get(parser, arg, &value))) {
+                                _stack_pop(base);
+
+                                return EVAL_RET_FAILED;
+                        }
+                }
+
+                /* The stack may have moved */
+                _state.stack[base + i] = value;
+        }
+
+        i = 0;
+
+        for (const ast_node_t *arg = form->args; arg != NULL; arg = arg->next, i++) {
+                const object_t * const object = _node_object_get(arg);
+
+                stream->args_obj[i] =
+                    (object_t *)((object != NULL) ? object : &_state.stack[base + i]);
+        }
+
+        stream->command_value = (env_pair_t) {
+                .symbol = command->name,
+                .value  = (void *)form->head
+        };
+
+        stream->argc = form->argc;
+
+        const eval_ret_t ret = _command_run(parser, command, background);
+
+        _stack_pop(base);
+
+        return ret;
+}
+
+eval_ret_t
+eval_form(const parser_t *parser, const ast_node_t *form)
+{
+        assert(parser != NULL);
+        assert(form != NULL);
+
+        if ((form->type == AST_NODE_FORM) &&
+            (form->operator == AST_OPERATOR_NONE) &&
+            (form->name != NULL) &&
+            (form->head == NULL)) {
+                printf("Command not found\n");
+
+                return EVAL_RET_NOT_FOUND;
+        }
+
+        if ((form->type == AST_NODE_FORM) &&
+            (form->head != NULL) &&
+            (form->head->type == OBJECT_TYPE_MACRO)) {
+                return _macro_call(parser, form);
+        }
+
+        if ((form->type != AST_NODE_FORM) ||
+            (form->head == NULL) ||
+            (form->head->type != OBJECT_TYPE_COMMAND)) {
+                printf("Expected a command\n");
+
+                return EVAL_RET_EXPECTED_COMMAND;
+        }
+
+        const command_t * const command = form->head->as.command;
+
+        if (command->form_func != NULL) {
+                if ((command->arg_count >= 0) && ((uint32_t)command->arg_count != form->argc)) {
+                        (void)printf("Mismatch in arguments passed to \"%s\". Expected %i, got %u\n",
+                            command->name,
+                            command->arg_count,
+                            form->argc);
+
+                        return EVAL_RET_ARGC_MISMATCH;
+                }
+
+                return command->form_func(parser, form);
+        }
+
+        return _command_form_eval(parser, form, false);
+}
+
+eval_ret_t
+eval_form_background(const parser_t *parser, const ast_node_t *form)
+{
+        assert(parser != NULL);
+        assert(form != NULL);
+
+        if ((form->type != AST_NODE_FORM) ||
+            (form->head == NULL) ||
+            (form->head->type != OBJECT_TYPE_COMMAND) ||
+            (form->head->as.command->job_func == NULL)) {
+                commands_status_clear();
+                commands_printf("Only transfers can run in the background\n");
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return EVAL_RET_FAILED;
+        }
+
+        return _command_form_eval(parser, form, true);
+}
+
+eval_ret_t
+eval_forms(const parser_t *parser, const ast_node_t *forms)
+{
+        for (const ast_node_t *form = forms; form != NULL; form = form->next) {
+                const eval_ret_t ret = (form->type == AST_NODE_TRANSFERS) ?
+                    macro_transfers_run(parser, form) : eval_form(parser, form);
+
+                if (ret != EVAL_RET_OK) {
+                        return ret;
+                }
+        }
+
+        return EVAL_RET_OK;
+}
+
+eval_ret_t
+eval_command_run(const parser_t *parser, const command_t *command)
+{
+        assert(parser != NULL);
+        assert(command != NULL);
+
+        return _command_run(parser, command, false);
+}
+
+bool
+eval_integer_get(const parser_t *parser, const ast_node_t *node, int *value)
+{
+        assert(node != NULL);
+        assert(value != NULL);
+
+        const object_t * const object = _node_object_get(node);
+
+        /* Symbols that aren't variables can still name an address in the
+         * loaded symbols */
+        if (object != NULL) {
+                uint32_t address;
+
+                if (!(commands_address_get(object, &address))) {
+                        return false;
+                }
+
+                *value = (int)address;
+
+                return true;
+        }
+
+        if (_node_is_call(node)) {
+                object_t result;
+
+                if (!(_call_value_get(parser, node, &result))) {
+                        return false;
+                }
+
+                if (result.type != OBJECT_TYPE_INTEGER) {
+                        eval_value_release(&result);
+
+                        commands_status_set(COMMANDS_STATUS_EXPECTED_INTEGER);
+
+                        return false;
+                }
+
+                *value = result.as.integer;
+
+                return true;
+        }
+
+        uint32_t values[COMMANDS_ARGS_MAX];
+        uint32_t count;
+        count = 0;
+
+        for (const ast_node_t *arg = node->args; arg != NULL; arg = arg->next) {
+                int arg_value;
+
+                if (!(eval_integer_get(parser, arg, &arg_value))) {
+                        return false;
+                }
+
+                values[count] = arg_value;
+                count++;
+        }
+
+        uint32_t result;
+
+        if (!(eval_operator_apply(node->operator, values, count, &result))) {
+                commands_status_set(COMMANDS_STATUS_DIVISION_BY_ZERO);
+
+                return false;
+        }
+
+        *value = (int)result;
+
+        return true;
+}
+
+bool
+eval_value_get(const parser_t *parser, const ast_node_t *node, object_t *value)
+{
+        assert(node != NULL);
+        assert(value != NULL);
+
+        if (_node_is_call(node)) {
+                return _call_value_get(parser, node, value);
+        }
+
+        const object_t * const object = _node_object_get(node);
+
+        if ((object != NULL) && (object->type != OBJECT_TYPE_INTEGER)) {
+                if (object->type == OBJECT_TYPE_SYMBOL) {
+                        commands_status_set(COMMANDS_STATUS_UNDEFINED_SYMBOL);
+
+                        return false;
+                }
+
+                *value = *object;
+
+                if (object->type == OBJECT_TYPE_BUFFER) {
+                        buffer_ref(object->as.buffer);
+                }
+
+                return true;
+        }
+
+        value->type = OBJECT_TYPE_INTEGER;
+
+        return eval_integer_get(parser, node, &value->as.integer);
+}
+
+void
+eval_value_release(object_t *value)
+{
+        assert(value != NULL);
+
+        if (value->type == OBJECT_TYPE_BUFFER) {
+                buffer_unref(value->as.buffer);
+
+                value->type = OBJECT_TYPE_INTEGER;
+                value->as.integer = 0;
+        }
+}
+
+const object_t *
+eval_object_get(const object_t *object)
+{
+        assert(object != NULL);
+
+        if (object->type != OBJECT_TYPE_SYMBOL) {
+                return object;
+        }
+
+        const object_t * const value = env_interned_value_get(object->as.symbol);
+
+        if ((value != NULL) &&
+            ((value->type == OBJECT_TYPE_INTEGER) ||
+             (value->type == OBJECT_TYPE_STRING) ||
+             (value->type == OBJECT_TYPE_BUFFER))) {
+                return value;
+        }
+
+        return object;
+}
+
+bool
+eval_variable_set(const char *name, const object_t *value)
+{
+        assert(name != NULL);
+        assert(value != NULL);
+        assert((value->type == OBJECT_TYPE_INTEGER) ||
+               (value->type == OBJECT_TYPE_STRING) ||
+               (value->type == OBJECT_TYPE_BUFFER));
+
+        object_t * const old_value = env_interned_value_get(name);
+
+        if ((old_value != NULL) &&
+            (old_value->type != OBJECT_TYPE_INTEGER) &&
+            (old_value->type != OBJECT_TYPE_STRING) &&
+            (old_value->type != OBJECT_TYPE_BUFFER)) {
+                return false;
+        }
+
+        /* Loops set their variable over and over, so integers are updated
+         * in place */
+        if ((old_value != NULL) &&
+            (old_value->type == OBJECT_TYPE_INTEGER) &&
+            (value->type == OBJECT_TYPE_INTEGER)) {
+                old_value->as.integer = value->as.integer;
+
+                return true;
+        }
+
+        object_t *new_value;
+
+        if (value->type == OBJECT_TYPE_INTEGER) {
+                new_value = object_integer_new(value->as.integer);
+        } else if (value->type == OBJECT_TYPE_BUFFER) {
+                new_value = object_buffer_new(value->as.buffer);
+        } else {
+                char * const string = strdup(value->as.string);
+                assert(string != NULL);
+
+                new_value = object_string_new(string);
+        }
+
+        env_interned_put(name, new_value);
+
+        object_delete(old_value);
+
+        return true;
+}
+
+bool
+eval_operator_apply(ast_operator_t operator, const uint32_t *values,
+    uint32_t count, uint32_t *result)
+{
+        assert(values != NULL);
+        assert(count > 0);
+
+        uint32_t value;
+        value = values[0];
+
+        /* Negation */
+        if ((operator == AST_OPERATOR_SUB) && (count == 1)) {
+                *result = -value;
+
+                return true;
+        }
+
+        for (uint32_t i = 1; i < count; i++) {
+                const uint32_t operand = values[i];
+
+                switch (operator) {
+                case AST_OPERATOR_ADD:
+                        value += operand;
+                        break;
+                case AST_OPERATOR_SUB:
+                        value -= operand;
+                        break;
+                case AST_OPERATOR_MUL:
+                        value *= operand;
+                        break;
+                case AST_OPERATOR_DIV:
+                        if (operand == 0) {
+                                return false;
+                        }
+
+                        value /= operand;
+                        break;
+                case AST_OPERATOR_MOD:
+                        if (operand == 0) {
+                                return false;
+                        }
+
+                        value %= operand;
+                        break;
+                case AST_OPERATOR_AND:
+                        value &= operand;
+                        break;
+                case AST_OPERATOR_OR:
+                        value |= operand;
+                        break;
+                case AST_OPERATOR_XOR:
+                        value ^= operand;
+                        break;
+                case AST_OPERATOR_SHL:
+                        value = (operand < 32) ? (value << operand) : 0;
+                        break;
+                case AST_OPERATOR_SHR:
+                        value = (operand < 32) ? (value >> operand) : 0;
+                        break;
+                default:
+                        assert(false);
+                }
+        }
+
+        *result = value;
+
+        return true;
+}
@@ -0,0 +1,58 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types.h"
+#include "ast.h"
+
+/* Runs parsed lines. A form's arguments are evaluated every time the form
+ * is: symbols bound to a variable become its value, and operator forms
+ * become integers. Commands that take forms instead (set, repeat, for) get
+ * their arguments as they were parsed.
+ *
+ * Calling a macro evaluates its arguments once, and its parameters take
+ * their values for as long as its body runs.
+ *
+ * Arithmetic is on 32-bit values that wrap around. Division and shifts are
+ * unsigned, as they're mostly done on addresses */
+
+typedef enum {
+        EVAL_RET_OK,
+        /* A command set a status */
+        EVAL_RET_FAILED,
+        EVAL_RET_ARGC_MISMATCH,
+        EVAL_RET_EXPECTED_COMMAND,
+        EVAL_RET_NOT_FOUND
+} eval_ret_t;
+
+eval_ret_t eval_form(const parser_t *parser, const ast_node_t *form);
+eval_ret_t eval_forms(const parser_t *parser, const ast_node_t *forms);
+/* Only commands with a job function can run in the background */
+eval_ret_t eval_form_background(const parser_t *parser, const ast_node_t *form);
+
+/* Calls the command with the arguments already in the parser's stream */
+eval_ret_t eval_command_run(const parser_t *parser, const command_t *command);
+
+/* On failure, the status has already been set. A form that isn't an
+ * operator runs its command, and takes the value the command gives back */
+bool eval_integer_get(const parser_t *parser, const ast_node_t *node, int *value);
+/* A buffer in the value is referenced, and released along with the value.
+ * Strings aren't copied */
+bool eval_value_get(const parser_t *parser, const ast_node_t *node, object_t *value);
+void eval_value_release(object_t *value);
+
+/* Returns the value of the variable a symbol names, or the object itself */
+const object_t *eval_object_get(const object_t *object);
+
+/* Only integers, strings, and buffers can be put in a variable, and only
+ * variables that hold one of them, or don't exist yet, can be set. The name
+ * is a symbol from a parsed form, so it's interned */
+bool eval_variable_set(const char *name, const object_t *value);
+
+/* Returns false on division by zero */
+bool eval_operator_apply(ast_operator_t operator, const uint32_t *values,
+    uint32_t count, uint32_t *result);
+
+#endif /* EVAL_H */
@@ -0,0 +1,806 @@
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffer.h"
+#include "commands.h"
+#include "device.h"
+#include "jobs.h"
+#include "shell.h"
+#include "timer.h"
+
+/* How often waiting for a job looks for Ctrl-C */
+#define JOBS_WAIT_POLL_MS 50
+
+/* Slices are sized to take about this long, which is as long as anything
+ * else waits for the target */
+#define JOBS_SLICE_US 2000
+
+#define JOBS_SLICE_SIZE_MIN 0x200
+#define JOBS_SLICE_SIZE_MAX 0x40000
+
+/* Each device has a thread of its own, so transfers to different devices
+ * go on at the same time */
+typedef struct {
+        pthread_t thread;
+        device_t *device;
+
+        /* Follows how fast the device has been going */
+        size_t slice_size;
+} worker_t;
+
+static struct {
+        worker_t workers[DEVICE_COUNT_MAX];
+        uint32_t worker_count;
+        bool stopping;
+
+        /* Guards the queue, and the state of every job in it */
+        pthread_mutex_t lock;
+        /* Signaled when a job is queued, or when the threads should stop */
+        pthread_cond_t queued;
+        /* Signaled when a job has finished */
+        pthread_cond_t finished;
+
+        /* In the order they were queued */
+        job_t *jobs;
+        uint32_t next_id;
+} _state = {
+        .lock     = PTHREAD_MUTEX_INITIALIZER,
+        .queued   = PTHREAD_COND_INITIALIZER,
+        .finished = PTHREAD_COND_INITIALIZER
+};
+
+static const char *_state_strings[] = {
+        [JOB_STATE_QUEUED]    = "Queued",
+        [JOB_STATE_RUNNING]   = "Running",
+        [JOB_STATE_DONE]      = "Done",
+        [JOB_STATE_FAILED]    = "Failed",
+        [JOB_STATE_CANCELLED] = "Cancelled"
+};
+
+static bool
+_job_finished(const job_t *job)
+{
+        return (job->state != JOB_STATE_QUEUED) && (job->state != JOB_STATE_RUNNING);
+}
+
+static job_t *
+_job_find(uint32_t id)
+{
+        for (job_t *job = _state.jobs; job != NULL; job = job->next) {
+                if (job->background && (job->id == id)) {
+                        return job;
+                }
+        }
+
+        return NULL;
+}
+
+static void
+_job_append(job_t *job)
+{
+        job_t **link;
+
+        for (link = &_state.jobs; *link != NULL; link = &(*link)->next) {
+        }
+
+        job->next = NULL;
+
+        *link = job;
+}
+
+static void
+_job_remove(job_t *job)
+{
+        for (job_t **link = &_state.jobs; *link != NULL; link = &(*link)->next) {
+                if (*link == job) {
+                        *link = job->next;
+
+                        return;
+                }
+        }
+}
+
+static bool
+_job_writes(const job_t *job)
+{
+        return (job->type != JOB_TYPE_DOWNLOAD);
+}
+
+/* Whether a job that hasn't finished touches any of the bytes of the
+ * device. Reads don't get in each other's way */
+static bool
+_job_overlaps(const job_t *job, const device_t *device, uint32_t address,
+    size_t size, bool write)
+{
+        if (_job_finished(job) || (job->device != device)) {
+                return false;
+        }
+
+        if (!write && !(_job_writes(job))) {
+                return false;
+        }
+
+        const uint64_t start = job->address;
+        const uint64_t end = start + job->buffer->size;
+
+        return (address < end) && (start < ((uint64_t)address + size));
+}
+
+/* Has to be called with the lock held. Looks at the jobs queued before the
+ * one given, or all of them if it's NULL */
+static bool
+_range_busy(const device_t *device, uint32_t address, size_t size, bool write,
+    const job_t *before)
+{
+        for (const job_t *job = _state.jobs; job != before; job = job->next) {
+                if (_job_overlaps(job, device, address, size, write)) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+/* Has to be called with the lock held. Picks out of the device's jobs. A
+ * job waits for the jobs queued before it that touch the same bytes. Out of
+ * the rest, the ones run in the foreground go first, and then the ones
+ * queued first */
+static job_t *
+_job_next(const device_t *device)
+{
+        job_t *next;
+        next = NULL;
+
+        for (job_t *job = _state.jobs; job != NULL; job = job->next) {
+                if ((job->device != device) || _job_finished(job) ||
+                    _range_busy(device, job->address, job->buffer->size, _job_writes(job), job)) {
+                        continue;
+                }
+
+                if (!job->background) {
+                        return job;
+                }
+
+                if (next == NULL) {
+                        next = job;
+                }
+        }
+
+        return next;
+}
+
+/* Has to be called with the lock held. A background job is reported right
+ * away if a line is being read */
+static void
+_job_finish(job_t *job, job_state_t state)
+{
+        job->state = state;
+
+        (void)pthread_cond_broadcast(&_state.finished);
+
+        if (job->background) {
+                shell_post(jobs_report);
+        }
+}
+
+/* Has to be called with the lock held. A job that hasn't started yet never
+ * will */
+static void
+_job_cancel(job_t *job)
+{
+        if (job->state == JOB_STATE_QUEUED) {
+                _job_finish(job, JOB_STATE_CANCELLED);
+        }
+
+        job->cancel = true;
+}
+
+/* Has to be called with the lock held */
+static void
+_finished_wait(void)
+{
+        struct timespec deadline;
+
+        (void)clock_gettime(CLOCK_REALTIME, &deadline);
+
+        deadline.tv_nsec += JOBS_WAIT_POLL_MS * 1000000L;
+
+        if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+        }
+
+        (void)pthread_cond_timedwait(&_state.finished, &_state.lock, &deadline);
+}
+
+static bool
+_file_write(const char *path, const buffer_t *buffer)
+{
+        FILE * const fp = fopen(path, "wb");
+
+        if (fp == NULL) {
+                return false;
+        }
+
+        const bool written = ((fwrite(buffer->data, 1, buffer->size, fp)) == buffer->size);
+
+        return ((fclose(fp)) == 0) && written;
+}
+
+/* Runs without the lock held. Returns JOB_STATE_RUNNING if there's more
+ * left to transfer */
+static job_state_t
+_job_slice_run(job_t *job, size_t offset, size_t size)
+{
+        buffer_t * const buffer = job->buffer;
+
+        device_ret_t ret;
+
+        switch (job->type) {
+        case JOB_TYPE_UPLOAD:
+                ret = device_bulk_write(job->device, &buffer->data[offset], job->address + offset, size);
+                break;
+        case JOB_TYPE_DOWNLOAD:
+                ret = device_bulk_read(job->device, &buffer->data[offset], job->address + offset, size);
+                break;
+        default:
+                ret = device_bulk_file_execute(job->device, job->path, job->address);
+                break;
+        }
+
+        if (ret != DEVICE_RET_OK) {
+                return JOB_STATE_FAILED;
+        }
+
+        if ((offset + size) < buffer->size) {
+                return JOB_STATE_RUNNING;
+        }
+
+        if ((job->type == JOB_TYPE_DOWNLOAD) && (job->path != NULL) &&
+            !(_file_write(job->path, buffer))) {
+                return JOB_STATE_FAILED;
+        }
+
+        return JOB_STATE_DONE;
+}
+
+/* Has to be called with the lock held. Moves halfway to the size that would
+ * have taken as long as a slice should, so one slow transfer doesn't throw
+ * it off */
+static void
+_slice_size_update(worker_t *worker, size_t size, uint64_t elapsed_us)
+{
+        elapsed_us = (elapsed_us > 0) ? elapsed_us : 1;
+
+        uint64_t slice_size;
+        slice_size = ((uint64_t)size * JOBS_SLICE_US) / elapsed_us;
+        slice_size = (worker->slice_size + slice_size) / 2;
+
+        slice_size = (slice_size > JOBS_SLICE_SIZE_MIN) ? slice_size : JOBS_SLICE_SIZE_MIN;
+        slice_size = (slice_size < JOBS_SLICE_SIZE_MAX) ? slice_size : JOBS_SLICE_SIZE_MAX;
+
+        worker->slice_size = slice_size;
+}
+
+/* Jobs take turns a slice at a time, so one queued in the foreground, or
+ * anything else that talks to the device, never waits for a whole job. A
+ * file is executed in one go */
+static void *
+_thread(void *arg)
+{
+        worker_t * const worker = arg;
+
+        (void)pthread_mutex_lock(&_state.lock);
+
+        while (true) {
+                job_t * const job = _job_next(worker->device);
+
+                if (job == NULL) {
+                        if (_state.stopping) {
+                                break;
+                        }
+
+                        (void)pthread_cond_wait(&_state.queued, &_state.lock);
+
+                        continue;
+                }
+
+                if (job->cancel) {
+                        _job_finish(job, JOB_STATE_CANCELLED);
+
+                        continue;
+                }
+
+                job->state = JOB_STATE_RUNNING;
+
+                const size_t offset = job->transferred;
+
+                const bool sliced = (job->type != JOB_TYPE_EXECUTE);
+
+                size_t size;
+                size = job->buffer->size - offset;
+
+                if (sliced) {
+                        size = (size < worker->slice_size) ? size : worker->slice_size;
+                }
+
+                (void)pthread_mutex_unlock(&_state.lock);
+
+                const uint64_t start_us = timer_us_get();
+                const job_state_t state = _job_slice_run(job, offset, size);
+                const uint64_t elapsed_us = timer_us_get() - start_us;
+
+                (void)pthread_mutex_lock(&_state.lock);
+
+                /* Only full slices say how fast the device is */
+                if (sliced && (size == worker->slice_size)) {
+                        _slice_size_update(worker, size, elapsed_us);
+                }
+
+                job->transferred = offset + size;
+
+                if (state != JOB_STATE_RUNNING) {
+                        _job_finish(job, state);
+                }
+        }
+
+        (void)pthread_mutex_unlock(&_state.lock);
+
+        return NULL;
+}
+
+/* Has to be called with the lock held. Reports the finished background jobs
+ * matching the ID, or all of them if it's 0, and deletes them. Returns false
+ * if any of them didn't succeed */
+static bool
+_jobs_reap(uint32_t id)
+{
+        bool succeeded;
+        succeeded = true;
+
+        job_t **link = &_state.jobs;
+
+        while (*link != NULL) {
+                job_t * const job = *link;
+
+                if (!job->background || !(_job_finished(job)) ||
+                    ((id != 0) && (job->id != id))) {
+                        link = &job->next;
+
+                        continue;
+                }
+
+                commands_printf("[%u] %-9s %s\n", job->id, _state_strings[job->state], job->description);
+
+                if (job->state != JOB_STATE_DONE) {
+                        succeeded = false;
+                }
+
+                *link = job->next;
+
+                job_delete(job);
+        }
+
+        return succeeded;
+}
+
+/* With more than one device, a job says which one it's for */
+static void
+_job_device_name_prepend(job_t *job)
+{
+        if ((device_count_get()) <= 1) {
+                return;
+        }
+
+        char description[JOB_DESCRIPTION_SIZE];
+
+        (void)snprintf(description, sizeof(description), "%s: ", device_name_get(job->device));
+        (void)strncat(description, job->description, sizeof(description) - strlen(description) - 1);
+        (void)memcpy(job->description, description, sizeof(description));
+}
+
+static job_t *
+_job_clone(const job_t *job, device_t *device)
+{
+        job_t * const clone = job_new(job->type, job->address, buffer_ref(job->buffer));
+
+        if (job->path != NULL) {
+                clone->path = strdup(job->path);
+                assert(clone->path != NULL);
+        }
+
+        (void)memcpy(clone->description, job->description, sizeof(clone->description));
+
+        clone->device = device;
+
+        return clone;
+}
+
+/* Uploads and executing go to every device when all of them are selected,
+ * as a copy of the job for each. The job given stays first. Returns how many
+ * jobs there are */
+static uint32_t
+_job_fan_out(job_t *job, job_t *jobs[DEVICE_COUNT_MAX])
+{
+        uint32_t count;
+        count = 0;
+
+        jobs[count++] = job;
+
+        if (device_all_selected() && _job_writes(job)) {
+                for (uint32_t i = 0; i < device_count_get(); i++) {
+                        device_t * const device = device_get(i);
+
+                        if (device != job->device) {
+                                jobs[count++] = _job_clone(job, device);
+                        }
+                }
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                _job_device_name_prepend(jobs[i]);
+        }
+
+        return count;
+}
+
+void
+jobs_init(void)
+{
+        _state.jobs = NULL;
+        _state.next_id = 1;
+        _state.stopping = false;
+
+#if !defined(_WIN32)
+        /* Ctrl-C is for the prompt's thread to handle, so the job threads
+         * start with every signal blocked */
+        sigset_t signals;
+        sigset_t signals_old;
+
+        (void)sigfillset(&signals);
+        (void)pthread_sigmask(SIG_SETMASK, &signals, &signals_old);
+#endif /* !_WIN32 */
+
+        _state.worker_count = device_count_get();
+
+        for (uint32_t i = 0; i < _state.worker_count; i++) {
+                worker_t * const worker = &_state.workers[i];
+
+                worker->device = device_get(i);
+                worker->slice_size = JOBS_SLICE_SIZE_MIN;
+
+                const int ret = pthread_create(&worker->thread, NULL, _thread, worker);
+                assert(ret == 0);
+                (void)ret;
+        }
+
+#if !defined(_WIN32)
+        (void)pthread_sigmask(SIG_SETMASK, &signals_old, NULL);
+#endif /* !_WIN32 */
+}
+
+void
+jobs_deinit(void)
+{
+        if (_state.worker_count == 0) {
+                return;
+        }
+
+        (void)pthread_mutex_lock(&_state.lock);
+
+        bool pending;
+        pending = false;
+
+        for (const job_t *job = _state.jobs; job != NULL; job = job->next) {
+                pending = pending || !(_job_finished(job));
+        }
+
+        if (pending) {
+                commands_printf("Waiting for jobs. Ctrl-C cancels them\n");
+
+                shell_interrupt_begin();
+
+                while (pending) {
+                        pending = false;
+
+                        for (job_t *job = _state.jobs; job != NULL; job = job->next) {
+                                if (shell_interrupted()) {
+                                        _job_cancel(job);
+                                }
+
+                                pending = pending || !(_job_finished(job));
+                        }
+
+                        if (pending) {
+                                _finished_wait();
+                        }
+                }
+
+                shell_interrupt_end();
+        }
+
+        (void)_jobs_reap(0);
+
+        _state.stopping = true;
+        (void)pthread_cond_broadcast(&_state.queued);
+        (void)pthread_mutex_unlock(&_state.lock);
+
+        for (uint32_t i = 0; i < _state.worker_count; i++) {
+                (void)pthread_join(_state.workers[i].thread, NULL);
+        }
+
+        _state.worker_count = 0;
+}
+
+job_t *
+job_new(job_type_t type, uint32_t address, buffer_t *buffer)
+{
+        assert(buffer != NULL);
+
+        job_t * const job = calloc(1, sizeof(job_t));
+        assert(job != NULL);
+
+        job->type = type;
+        job->address = address;
+        job->buffer = buffer;
+        job->device = device_selected_get();
+        job->state = JOB_STATE_QUEUED;
+
+        return job;
+}
+
+void
+job_delete(job_t *job)
+{
+        if (job == NULL) {
+                return;
+        }
+
+        buffer_unref(job->buffer);
+
+        free(job->path);
+        free(job);
+}
+
+job_state_t
+jobs_run(job_t *job)
+{
+        assert(job != NULL);
+
+        job_t *jobs[DEVICE_COUNT_MAX];
+
+        const uint32_t count = _job_fan_out(job, jobs);
+
+        shell_interrupt_begin();
+
+        (void)pthread_mutex_lock(&_state.lock);
+
+        for (uint32_t i = 0; i < count; i++) {
+                jobs[i]->background = false;
+
+                _job_append(jobs[i]);
+        }
+
+        (void)pthread_cond_broadcast(&_state.queued);
+
+        while (true) {
+                bool pending;
+                pending = false;
+
+                for (uint32_t i = 0; i < count; i++) {
+                        if (shell_interrupted()) {
+                                _job_cancel(jobs[i]);
+                        }
+
+                        pending = pending || !(_job_finished(jobs[i]));
+                }
+
+                if (!pending) {
+                        break;
+                }
+
+                _finished_wait();
+        }
+
+        /* A failure on any of the devices is what's worth knowing */
+        job_state_t state;
+        state = JOB_STATE_DONE;
+
+        for (uint32_t i = 0; i < count; i++) {
+                if (jobs[i]->state == JOB_STATE_FAILED) {
+                        state = JOB_STATE_FAILED;
+                } else if ((jobs[i]->state == JOB_STATE_CANCELLED) && (state == JOB_STATE_DONE)) {
+                        state = JOB_STATE_CANCELLED;
+                }
+
+                _job_remove(jobs[i]);
+        }
+
+        (void)pthread_mutex_unlock(&_state.lock);
+
+        shell_interrupt_end();
+
+        for (uint32_t i = 0; i < count; i++) {
+                job_delete(jobs[i]);
+        }
+
+        return state;
+}
+
+void
+jobs_submit(job_t *job)
+{
+        assert(job != NULL);
+
+        job_t *jobs[DEVICE_COUNT_MAX];
+
+        const uint32_t count = _job_fan_out(job, jobs);
+
+        (void)pthread_mutex_lock(&_state.lock);
+
+        bool listed;
+        listed = false;
+
+        for (const job_t *other = _state.jobs; other != NULL; other = other->next) {
+                listed = listed || other->background;
+        }
+
+        /* IDs start over once every job has been reported */
+        if (!listed) {
+                _state.next_id = 1;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                jobs[i]->id = _state.next_id++;
+                jobs[i]->background = true;
+
+                _job_append(jobs[i]);
+
+                commands_printf("[%u] %s\n", jobs[i]->id, jobs[i]->description);
+        }
+
+        (void)pthread_cond_broadcast(&_state.queued);
+
+        (void)pthread_mutex_unlock(&_state.lock);
+}
+
+void
+jobs_list(void)
+{
+        (void)pthread_mutex_lock(&_state.lock);
+
+        for (const job_t *job = _state.jobs; job != NULL; job = job->next) {
+                if (!job->background) {
+                        continue;
+                }
+
+                const size_t size = job->buffer->size;
+                const uint32_t percent =
+                    (size > 0) ? (uint32_t)(((uint64_t)job->transferred * 100) / size) : 100;
+
+                commands_printf("[%u] %-9s %3u%%  %s\n",
+                    job->id,
+                    _state_strings[job->state],
+                    percent,
+                    job->description);
+        }
+
+        (void)pthread_mutex_unlock(&_state.lock);
+}
+
+bool
+jobs_wait(uint32_t id)
+{
+        (void)pthread_mutex_lock(&_state.lock);
+
+        if ((id != 0) && ((_job_find(id)) == NULL)) {
+                (void)pthread_mutex_unlock(&_state.lock);
+
+                commands_printf("No job %u\n", id);
+
+                return false;
+        }
+
+        bool interrupted;
+        interrupted = false;
+
+        /* Ctrl-C stops waiting, and leaves the jobs running */
+        shell_interrupt_begin();
+
+        while (true) {
+                bool pending;
+                pending = false;
+
+                for (const job_t *job = _state.jobs; job != NULL; job = job->next) {
+                        if (job->background && ((id == 0) || (job->id == id))) {
+                                pending = pending || !(_job_finished(job));
+                        }
+                }
+
+                if (!pending) {
+                        break;
+                }
+
+                if (shell_interrupted()) {
+                        interrupted = true;
+
+                        break;
+                }
+
+                _finished_wait();
+        }
+
+        shell_interrupt_end();
+
+        const bool succeeded = _jobs_reap(id);
+
+        (void)pthread_mutex_unlock(&_state.lock);
+
+        return succeeded && !interrupted;
+}
+
+bool
+jobs_kill(uint32_t id)
+{
+        (void)pthread_mutex_lock(&_state.lock);
+
+        job_t * const job = _job_find(id);
+
+        if (job == NULL) {
+                (void)pthread_mutex_unlock(&_state.lock);
+
+                commands_printf("No job %u\n", id);
+
+                return false;
+        }
+
+        _job_cancel(job);
+
+        (void)pthread_mutex_unlock(&_state.lock);
+
+        return true;
+}
+
+bool
+jobs_fence(uint32_t address, size_t size, bool write)
+{
+        bool interrupted;
+        interrupted = false;
+
+        const device_t * const device = device_selected_get();
+
+        (void)pthread_mutex_lock(&_state.lock);
+
+        if (_range_busy(device, address, size, write, NULL)) {
+                shell_interrupt_begin();
+
+                while (_range_busy(device, address, size, write, NULL)) {
+                        if (shell_interrupted()) {
+                                interrupted = true;
+
+                                break;
+                        }
+
+                        _finished_wait();
+                }
+
+                shell_interrupt_end();
+        }
+
+        (void)pthread_mutex_unlock(&_state.lock);
+
+        return !interrupted;
+}
+
+void
+jobs_report(void)
+{
+        (void)pthread_mutex_lock(&_state.lock);
+        (void)_jobs_reap(0);
+        (void)pthread_mutex_unlock(&_state.lock);
+}
@@ -0,0 +1,100 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "types.h"
+
+/* Uploads, downloads and executing run as jobs, on a thread for each
+ * device. Jobs move their bytes in slices sized to take a couple of
+ * milliseconds, and can be cancelled in between any two slices. Anything
+ * else that talks to the device in the meantime only waits for the slice in
+ * flight.
+ *
+ * A device's jobs take turns a slice at a time, with the ones run in the
+ * foreground first. A job never overtakes one queued before it that touches
+ * the same bytes, unless both only read them.
+ *
+ * A job is for the selected device. If all of them are selected, uploading
+ * and executing are done on every device at the same time, as a job each.
+ *
+ * A job run in the foreground is waited for, and Ctrl-C cancels it. A job
+ * run in the background gets an ID, and is reported as soon as it's
+ * finished */
+
+#define JOB_DESCRIPTION_SIZE 96
+
+typedef enum {
+        JOB_TYPE_UPLOAD,
+        JOB_TYPE_DOWNLOAD,
+        JOB_TYPE_EXECUTE
+} job_type_t;
+
+typedef enum {
+        JOB_STATE_QUEUED,
+        JOB_STATE_RUNNING,
+        JOB_STATE_DONE,
+        JOB_STATE_FAILED,
+        JOB_STATE_CANCELLED
+} job_state_t;
+
+struct job {
+        /* Background jobs only */
+        uint32_t id;
+
+        job_type_t type;
+        char description[JOB_DESCRIPTION_SIZE];
+
+        uint32_t address;
+        /* Uploaded from, or downloaded into. When executing, the file's
+         * bytes, to know which ones it touches */
+        buffer_t *buffer;
+        /* For downloads, if set, the buffer is written to it once it's been
+         * downloaded. When executing, the file to execute */
+        char *path;
+
+        device_t *device;
+
+        /* Only accessed with the jobs lock held */
+        job_state_t state;
+        size_t transferred;
+        bool cancel;
+        bool background;
+
+        job_t *next;
+};
+
+void jobs_init(void);
+/* Waits for the jobs left, and Ctrl-C cancels them */
+void jobs_deinit(void);
+
+/* Takes the buffer's reference over */
+job_t *job_new(job_type_t type, uint32_t address, buffer_t *buffer);
+void job_delete(job_t *job);
+
+/* Runs the job in the foreground, and deletes it. Returns how it ended, or
+ * how the worst of the copies of it ended */
+job_state_t jobs_run(job_t *job);
+/* Queues the job in the background, where it's owned by the queue. Each copy
+ * of it gets its own ID */
+void jobs_submit(job_t *job);
+
+void jobs_list(void);
+/* Waits for a background job, or all of them if the ID is 0, and reports
+ * them. Returns false if any of them failed, was cancelled, or if waiting
+ * was interrupted */
+bool jobs_wait(uint32_t id);
+/* Returns false if there's no such job. Waiting and killing both say so */
+bool jobs_kill(uint32_t id);
+/* Reports the background jobs that finished since the last time. It's
+ * posted to the shell whenever one finishes */
+void jobs_report(void);
+
+/* Waits for the selected device's jobs that touch the range to finish, for
+ * anything that talks to the device without a job. Writes wait for reads too. Returns
+ * false if Ctrl-C stopped the wait */
+bool jobs_fence(uint32_t address, size_t size, bool write);
+
+#endif /* JOBS_H */
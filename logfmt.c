@@ -0,0 +1,574 @@
+#include <assert.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "device.h"
+#include "logfmt.h"
+
+#define LOGFMT_CAPACITY_INIT    64
+
+/* Marks a width or precision that is passed as an argument ("*") */
+#define LOGFMT_STAR             (-2)
+#define LOGFMT_UNSET            (-1)
+
+typedef enum {
+        LOGFMT_ARG_NONE,
+        LOGFMT_ARG_INT,
+        LOGFMT_ARG_UINT,
+        LOGFMT_ARG_INT64,
+        LOGFMT_ARG_UINT64,
+        LOGFMT_ARG_CHAR,
+        LOGFMT_ARG_POINTER,
+        LOGFMT_ARG_DOUBLE,
+        LOGFMT_ARG_STRING,
+} logfmt_arg_t;
+
+struct logfmt_piece {
+        /* Text preceding the conversion */
+        const char *literal;
+        uint32_t literal_len;
+
+        logfmt_arg_t arg;
+        char flags[8];
+        int width;
+        int precision;
+        char conversion;
+};
+
+struct logfmt_entry {
+        uint32_t address;
+
+        /* NULL if the address doesn't point to a string in the ELF */
+        logfmt_piece_t *pieces;
+        uint32_t piece_count;
+};
+
+static logfmt_entry_t *_entry_get(logfmt_t *logfmt, uint32_t address);
+static bool _entries_grow(logfmt_t *logfmt);
+static void _format_parse(logfmt_entry_t *entry, const char *format);
+
+static uint32_t
+_address_hash(uint32_t address)
+{
+        /* Format strings are at least byte aligned and clustered in
+         * .rodata, so mix the bits */
+        return address * 2654435761u;
+}
+
+logfmt_t *
+logfmt_new(const char *elf_path)
+{
+        assert(elf_path != NULL);
+
+        logfmt_t * const logfmt = calloc(1, sizeof(logfmt_t));
+
+        if (logfmt == NULL) {
+                return NULL;
+        }
+
+        logfmt->elf = elf_open(elf_path);
+        logfmt->capacity = LOGFMT_CAPACITY_INIT;
+        logfmt->entries = calloc(logfmt->capacity, sizeof(logfmt_entry_t));
+
+        if ((logfmt->elf == NULL) || (logfmt->entries == NULL)) {
+                logfmt_delete(logfmt);
+
+                return NULL;
+        }
+
+        return logfmt;
+}
+
+void
+logfmt_delete(logfmt_t *logfmt)
+{
+        if (logfmt == NULL) {
+                return;
+        }
+
+        if (logfmt->entries != NULL) {
+                for (uint32_t i = 0; i < logfmt->capacity; i++) {
+                        free(logfmt->entries[i].pieces);
+                }
+        }
+
+        free(logfmt->entries);
+        elf_close(logfmt->elf);
+        free(logfmt);
+}
+
+static size_t
+_text_append(char *text, size_t text_len, const char *format, ...)
+{
+        if (text_len >= (LOGFMT_TEXT_MAX - 1)) {
+                return text_len;
+        }
+
+        va_list args;
+
+        va_start(args, format);
+        const int len =
+            vsnprintf(&text[text_len], LOGFMT_TEXT_MAX - text_len, format, args);
+        va_end(args);
+
+        if (len < 0) {
+                return text_len;
+        }
+
+        text_len += len;
+
+        return (text_len < LOGFMT_TEXT_MAX) ? text_len : (LOGFMT_TEXT_MAX - 1);
+}
+
+static bool
+_arg_u32_get(const uint8_t **args, const uint8_t *args_end, uint32_t *value)
+{
+        if ((args_end - *args) < 4) {
+                return false;
+        }
+
+        *value = device_be32_get(*args);
+        *args += 4;
+
+        return true;
+}
+
+static bool
+_arg_u64_get(const uint8_t **args, const uint8_t *args_end, uint64_t *value)
+{
+        if ((args_end - *args) < 8) {
+                return false;
+        }
+
+        *value = ((uint64_t)device_be32_get(*args) << 32) |
+                 device_be32_get(*args + 4);
+        *args += 8;
+
+        return true;
+}
+
+static bool
+_piece_expand(const logfmt_piece_t *piece, const uint8_t **args,
+    const uint8_t *args_end, char *text, size_t *text_len)
+{
+        uint32_t value;
+
+        int width;
+        width = piece->width;
+
+        if (width == LOGFMT_STAR) {
+                if (!(_arg_u32_get(args, args_end, &value))) {
+                        return false;
+                }
+
+                width = (int32_t)value;
+        }
+
+        int precision;
+        precision = piece->precision;
+
+        if (precision == LOGFMT_STAR) {
+                if (!(_arg_u32_get(args, args_end, &value))) {
+                        return false;
+                }
+
+                precision = (int32_t)value;
+        }
+
+        /* Rebuild the conversion for the host, where the argument is always
+         * passed at its widest */
+        char spec[32];
+        int spec_len;
+        spec_len = snprintf(spec, sizeof(spec), "%%%s", piece->flags);
+
+        if (width != LOGFMT_UNSET) {
+                spec_len += snprintf(&spec[spec_len], sizeof(spec) - spec_len, "%i", width);
+        }
+
+        if (precision != LOGFMT_UNSET) {
+                spec_len += snprintf(&spec[spec_len], sizeof(spec) - spec_len, ".%i", precision);
+        }
+
+        switch (piece->arg) {
+        case LOGFMT_ARG_INT:
+        case LOGFMT_ARG_UINT:
+        case LOGFMT_ARG_INT64:
+        case LOGFMT_ARG_UINT64:
+                (void)snprintf(&spec[spec_len], sizeof(spec) - spec_len, "ll%c", piece->conversion);
+                break;
+        default:
+                (void)snprintf(&spec[spec_len], sizeof(spec) - spec_len, "%c", piece->conversion);
+                break;
+        }
+
+        uint64_t value64;
+
+        switch (piece->arg) {
+        case LOGFMT_ARG_NONE:
+                break;
+        case LOGFMT_ARG_INT:
+                if (!(_arg_u32_get(args, args_end, &value))) {
+                        return false;
+                }
+
+                *text_len = _text_append(text, *text_len, spec, (long long)(int32_t)value);
+                break;
+        case LOGFMT_ARG_UINT:
+                if (!(_arg_u32_get(args, args_end, &value))) {
+                        return false;
+                }
+
+                *text_len = _text_append(text, *text_len, spec, (unsigned long long)value);
+                break;
+        case LOGFMT_ARG_INT64:
+                if (!(_arg_u64_get(args, args_end, &value64))) {
+                        return false;
+                }
+
+                *text_len = _text_append(text, *text_len, spec, (long long)(int64_t)value64);
+                break;
+        case LOGFMT_ARG_UINT64:
+                if (!(_arg_u64_get(args, args_end, &value64))) {
+                        return false;
+                }
+
+                *text_len = _text_append(text, *text_len, spec, (unsigned long long)value64);
+                break;
+        case LOGFMT_ARG_CHAR:
+                if (!(_arg_u32_get(args, args_end, &value))) {
+                        return false;
+                }
+
+                *text_len = _text_append(text, *text_len, spec, (int)(uint8_t)value);
+                break;
+        case LOGFMT_ARG_POINTER:
+                if (!(_arg_u32_get(args, args_end, &value))) {
+                        return false;
+                }
+
+                *text_len = _text_append(text, *text_len, "0x%08X", value);
+                break;
+        case LOGFMT_ARG_DOUBLE:
+                if (!(_arg_u64_get(args, args_end, &value64))) {
+                        return false;
+                }
+
+                double d;
+                (void)memcpy(&d, &value64, sizeof(d));
+
+                *text_len = _text_append(text, *text_len, spec, d);
+                break;
+        case LOGFMT_ARG_STRING:
+                if ((args_end - *args) < 1) {
+                        return false;
+                }
+
+                const uint8_t string_len = **args;
+
+                if ((args_end - *args - 1) < string_len) {
+                        return false;
+                }
+
+                char string[256];
+                (void)memcpy(string, *args + 1, string_len);
+                string[string_len] = '\0';
+
+                *args += 1 + string_len;
+
+                *text_len = _text_append(text, *text_len, spec, string);
+                break;
+        }
+
+        return true;
+}
+
+logfmt_ret_t
+logfmt_record_expand(logfmt_t *logfmt, const uint8_t *buffer, size_t size,
+    size_t *record_size, char *text, size_t *text_len)
+{
+        assert(logfmt != NULL);
+        assert(buffer != NULL);
+        assert(record_size != NULL);
+        assert(text != NULL);
+        assert(text_len != NULL);
+
+        *text_len = 0;
+        text[0] = '\0';
+
+        if (size < LOGFMT_RECORD_HEADER_SIZE) {
+                return LOGFMT_RET_INCOMPLETE;
+        }
+
+        *record_size = ((size_t)buffer[0] << 8) | buffer[1];
+
+        if (*record_size < LOGFMT_RECORD_HEADER_SIZE) {
+                return LOGFMT_RET_CORRUPT;
+        }
+
+        if (*record_size > size) {
+                return LOGFMT_RET_INCOMPLETE;
+        }
+
+        const uint32_t address = device_be32_get(&buffer[2]);
+        const logfmt_entry_t * const entry = _entry_get(logfmt, address);
+
+        if ((entry == NULL) || (entry->pieces == NULL)) {
+                *text_len = _text_append(text, 0, "<unknown format 0x%08X>\n", address);
+
+                return LOGFMT_RET_OK;
+        }
+
+        const uint8_t *args;
+        args = &buffer[LOGFMT_RECORD_HEADER_SIZE];
+        const uint8_t * const args_end = &buffer[*record_size];
+
+        for (uint32_t i = 0; i < entry->piece_count; i++) {
+                const logfmt_piece_t * const piece = &entry->pieces[i];
+
+                if (piece->literal_len > 0) {
+                        *text_len = _text_append(text, *text_len, "%.*s",
+                            (int)piece->literal_len, piece->literal);
+                }
+
+                if (!(_piece_expand(piece, &args, args_end, text, text_len))) {
+                        *text_len = _text_append(text, *text_len, "<truncated record>\n");
+
+                        break;
+                }
+        }
+
+        return LOGFMT_RET_OK;
+}
+
+static logfmt_entry_t *
+_entry_get(logfmt_t *logfmt, uint32_t address)
+{
+        /* Address 0 is never a valid format string, so it marks an empty
+         * slot */
+        if (address == 0) {
+                return NULL;
+        }
+
+        const uint32_t mask = logfmt->capacity - 1;
+
+        uint32_t i;
+        i = _address_hash(address) & mask;
+
+        while (logfmt->entries[i].address != 0) {
+                if (logfmt->entries[i].address == address) {
+                        return &logfmt->entries[i];
+                }
+
+                i = (i + 1) & mask;
+        }
+
+        /* First time we see this format. Keep the load factor under 1/2 */
+        if (((logfmt->count + 1) * 2) > logfmt->capacity) {
+                if (!(_entries_grow(logfmt))) {
+                        return NULL;
+                }
+
+                return _entry_get(logfmt, address);
+        }
+
+        logfmt_entry_t * const entry = &logfmt->entries[i];
+
+        entry->address = address;
+        logfmt->count++;
+
+        const char * const format = elf_string_get(logfmt->elf, address);
+
+        if (format != NULL) {
+                _format_parse(entry, format);
+        }
+
+        return entry;
+}
+
+static bool
+_entries_grow(logfmt_t *logfmt)
+{
+        const uint32_t capacity = logfmt->capacity * 2;
+        logfmt_entry_t * const entries = calloc(capacity, sizeof(logfmt_entry_t));
+
+        if (entries == NULL) {
+                return false;
+        }
+
+        for (uint32_t j = 0; j < logfmt->capacity; j++) {
+                const logfmt_entry_t * const entry = &logfmt->entries[j];
+
+                if (entry->address == 0) {
+                        continue;
+                }
+
+                uint32_t i;
+                i = _address_hash(entry->address) & (capacity - 1);
+
+                while (entries[i].address != 0) {
+                        i = (i + 1) & (capacity - 1);
+                }
+
+                entries[i] = *entry;
+        }
+
+        free(logfmt->entries);
+
+        logfmt->entries = entries;
+        logfmt->capacity = capacity;
+
+        return true;
+}
+
+static const char *
+_spec_parse(logfmt_piece_t *piece, const char *p)
+{
+        size_t flags_len;
+        flags_len = 0;
+
+        while ((*p != '\0') && ((strchr("-+ #0", *p)) != NULL)) {
+                if (flags_len < (sizeof(piece->flags) - 1)) {
+                        piece->flags[flags_len++] = *p;
+                }
+
+                p++;
+        }
+
+        piece->flags[flags_len] = '\0';
+
+        piece->width = LOGFMT_UNSET;
+        piece->precision = LOGFMT_UNSET;
+
+        char *end;
+
+        if (*p == '*') {
+                piece->width = LOGFMT_STAR;
+                p++;
+        } else if ((*p >= '0') && (*p <= '9')) {
+                piece->width = strtol(p, &end, 10);
+                p = end;
+        }
+
+        if (*p == '.') {
+                p++;
+
+                if (*p == '*') {
+                        piece->precision = LOGFMT_STAR;
+                        p++;
+                } else {
+                        piece->precision = strtol(p, &end, 10);
+                        p = end;
+                }
+        }
+
+        int longs;
+        longs = 0;
+
+        while ((*p != '\0') && ((strchr("hlLjzt", *p)) != NULL)) {
+                if ((*p == 'l') || (*p == 'L')) {
+                        longs++;
+                }
+
+                p++;
+        }
+
+        piece->conversion = *p;
+
+        switch (*p) {
+        case 'd':
+        case 'i':
+                piece->arg = (longs >= 2) ? LOGFMT_ARG_INT64 : LOGFMT_ARG_INT;
+                break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+                piece->arg = (longs >= 2) ? LOGFMT_ARG_UINT64 : LOGFMT_ARG_UINT;
+                break;
+        case 'c':
+                piece->arg = LOGFMT_ARG_CHAR;
+                break;
+        case 'p':
+                piece->arg = LOGFMT_ARG_POINTER;
+                break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+                piece->arg = LOGFMT_ARG_DOUBLE;
+                break;
+        case 's':
+                piece->arg = LOGFMT_ARG_STRING;
+                break;
+        case '\0':
+                piece->arg = LOGFMT_ARG_NONE;
+                return p;
+        default:
+                /* Unsupported conversion, such as "%n". Drop it */
+                piece->arg = LOGFMT_ARG_NONE;
+                piece->conversion = '\0';
+                break;
+        }
+
+        return p + 1;
+}
+
+static void
+_format_parse(logfmt_entry_t *entry, const char *format)
+{
+        /* Each piece is at most one conversion, so this bounds the count */
+        uint32_t piece_max;
+        piece_max = 1;
+
+        for (const char *p = format; *p != '\0'; p++) {
+                piece_max += (*p == '%');
+        }
+
+        logfmt_piece_t * const pieces = calloc(piece_max, sizeof(logfmt_piece_t));
+
+        if (pieces == NULL) {
+                return;
+        }
+
+        uint32_t count;
+        count = 0;
+
+        const char *p;
+        p = format;
+
+        while (*p != '\0') {
+                logfmt_piece_t * const piece = &pieces[count++];
+
+                piece->literal = p;
+
+                while ((*p != '\0') && (*p != '%')) {
+                        p++;
+                }
+
+                if ((p[0] == '%') && (p[1] == '%')) {
+                        /* Keep the first '%' as part of the literal */
+                        piece->literal_len = (p + 1) - piece->literal;
+                        piece->arg = LOGFMT_ARG_NONE;
+                        p += 2;
+
+                        continue;
+                }
+
+                piece->literal_len = p - piece->literal;
+                piece->arg = LOGFMT_ARG_NONE;
+
+                if (*p == '%') {
+                        p = _spec_parse(piece, p + 1);
+                }
+        }
+
+        entry->pieces = pieces;
+        entry->piece_count = count;
+}
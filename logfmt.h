@@ -0,0 +1,53 @@
+#ifndef LOGFMT_H
+#define LOGFMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "elf.h"
+
+/*
+ * Deferred-format log records, as written by the target into a ring buffer
+ * (see ring.h). Records are packed back to back and all fields are
+ * big-endian:
+ *
+ *   0x00 uint16_t size     Size of the whole record in bytes
+ *   0x02 uint32_t format   Address of the printf format string in the ELF
+ *   0x06 ...      args     One entry per conversion in the format string
+ *
+ * Arguments are stored the way the SH-2 passes them: 4 bytes for integers,
+ * characters and pointers, 8 bytes for "ll" integers and floating point
+ * values, and for "%s", a uint8_t length followed by the characters. A "*"
+ * width or precision takes a 4 byte integer of its own */
+
+#define LOGFMT_RECORD_HEADER_SIZE       6
+
+/* Maximum length of the text a single record expands to */
+#define LOGFMT_TEXT_MAX                 1024
+
+typedef enum {
+        LOGFMT_RET_OK,
+        LOGFMT_RET_INCOMPLETE,
+        LOGFMT_RET_CORRUPT,
+} logfmt_ret_t;
+
+typedef struct logfmt_piece logfmt_piece_t;
+typedef struct logfmt_entry logfmt_entry_t;
+
+typedef struct {
+        elf_t *elf;
+
+        /* Open addressing hash table of parsed format strings, keyed by
+         * address. Each format string is parsed the first time it's seen */
+        logfmt_entry_t *entries;
+        uint32_t capacity;
+        uint32_t count;
+} logfmt_t;
+
+logfmt_t *logfmt_new(const char *elf_path);
+void logfmt_delete(logfmt_t *logfmt);
+
+logfmt_ret_t logfmt_record_expand(logfmt_t *logfmt, const uint8_t *buffer,
+    size_t size, size_t *record_size, char *text, size_t *text_len);
+
+#endif /* LOGFMT_H */
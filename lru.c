@@ -0,0 +1,191 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "lru.h"
+
+static uint32_t
+_key_hash(const lru_t *lru, uint64_t key)
+{
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDull;
+        key ^= key >> 33;
+
+        return (uint32_t)key & (lru->bucket_count - 1);
+}
+
+static void
+_bucket_remove(lru_t *lru, lru_block_t *block)
+{
+        lru_block_t **link;
+        link = &lru->buckets[_key_hash(lru, block->key)];
+
+        while (*link != NULL) {
+                if (*link == block) {
+                        *link = block->hash_next;
+                        break;
+                }
+
+                link = &(*link)->hash_next;
+        }
+
+        block->hash_next = NULL;
+        block->valid = false;
+}
+
+lru_t *
+lru_new(size_t block_size, uint32_t block_count)
+{
+        assert(block_size > 0);
+        assert(block_count > 0);
+
+        lru_t * const lru = calloc(1, sizeof(lru_t));
+
+        if (lru == NULL) {
+                return NULL;
+        }
+
+        lru->block_size = block_size;
+        lru->block_count = block_count;
+
+        lru->bucket_count = 1;
+
+        while (lru->bucket_count < block_count) {
+                lru->bucket_count <<= 1;
+        }
+
+        lru->blocks = calloc(block_count, sizeof(lru_block_t));
+        lru->data = malloc(block_size * block_count);
+        lru->buckets = calloc(lru->bucket_count, sizeof(lru_block_t *));
+
+        if ((lru->blocks == NULL) || (lru->data == NULL) || (lru->buckets == NULL)) {
+                lru_delete(lru);
+
+                return NULL;
+        }
+
+        TAILQ_INIT(&lru->list);
+
+        for (uint32_t i = 0; i < block_count; i++) {
+                lru_block_t * const block = &lru->blocks[i];
+
+                block->data = &lru->data[i * block_size];
+
+                TAILQ_INSERT_TAIL(&lru->list, block, entries);
+        }
+
+        return lru;
+}
+
+void
+lru_delete(lru_t *lru)
+{
+        if (lru == NULL) {
+                return;
+        }
+
+        free(lru->blocks);
+        free(lru->data);
+        free(lru->buckets);
+        free(lru);
+}
+
+lru_block_t *
+lru_peek(const lru_t *lru, uint64_t key)
+{
+        assert(lru != NULL);
+
+        lru_block_t *block;
+        block = lru->buckets[_key_hash(lru, key)];
+
+        while (block != NULL) {
+                if (block->key == key) {
+                        return block;
+                }
+
+                block = block->hash_next;
+        }
+
+        return NULL;
+}
+
+lru_block_t *
+lru_get(lru_t *lru, uint64_t key)
+{
+        lru_block_t * const block = lru_peek(lru, key);
+
+        if (block == NULL) {
+                lru->misses++;
+
+                return NULL;
+        }
+
+        lru->hits++;
+
+        TAILQ_REMOVE(&lru->list, block, entries);
+        TAILQ_INSERT_HEAD(&lru->list, block, entries);
+
+        return block;
+}
+
+lru_block_t *
+lru_put(lru_t *lru, uint64_t key)
+{
+        assert(lru != NULL);
+
+        lru_block_t *block;
+
+        if ((block = lru_peek(lru, key)) == NULL) {
+                /* Recycle the least recently used block */
+                block = TAILQ_LAST(&lru->list, lru_list);
+
+                if (block->valid) {
+                        _bucket_remove(lru, block);
+                }
+
+                const uint32_t bucket = _key_hash(lru, key);
+
+                block->key = key;
+                block->valid = true;
+                block->hash_next = lru->buckets[bucket];
+
+                lru->buckets[bucket] = block;
+        }
+
+        block->size = 0;
+
+        TAILQ_REMOVE(&lru->list, block, entries);
+        TAILQ_INSERT_HEAD(&lru->list, block, entries);
+
+        return block;
+}
+
+void
+lru_invalidate(lru_t *lru, uint64_t key)
+{
+        lru_block_t * const block = lru_peek(lru, key);
+
+        if (block == NULL) {
+                return;
+        }
+
+        _bucket_remove(lru, block);
+
+        /* Reuse it before anything else */
+        TAILQ_REMOVE(&lru->list, block, entries);
+        TAILQ_INSERT_TAIL(&lru->list, block, entries);
+}
+
+void
+lru_clear(lru_t *lru)
+{
+        assert(lru != NULL);
+
+        for (uint32_t i = 0; i < lru->block_count; i++) {
+                lru->blocks[i].valid = false;
+                lru->blocks[i].hash_next = NULL;
+        }
+
+        for (uint32_t i = 0; i < lru->bucket_count; i++) {
+                lru->buckets[i] = NULL;
+        }
+}
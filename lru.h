@@ -0,0 +1,56 @@
+#ifndef LRU_H
+#define LRU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/queue.h>
+
+/* Fixed-size blocks, keyed by a 64-bit value, evicted least recently used
+ * first */
+
+typedef struct lru_block lru_block_t;
+
+struct lru_block {
+        uint64_t key;
+        bool valid;
+        uint8_t *data;
+
+        /* Size of valid data in the block. It can be less than the block
+         * size, for example at the end of a file */
+        size_t size;
+
+        lru_block_t *hash_next;
+        TAILQ_ENTRY(lru_block) entries;
+};
+
+typedef TAILQ_HEAD(lru_list, lru_block) lru_list_t;
+
+typedef struct {
+        size_t block_size;
+        uint32_t block_count;
+
+        lru_block_t *blocks;
+        uint8_t *data;
+
+        lru_block_t **buckets;
+        uint32_t bucket_count;
+
+        /* Most recently used first */
+        lru_list_t list;
+
+        uint64_t hits;
+        uint64_t misses;
+} lru_t;
+
+lru_t *lru_new(size_t block_size, uint32_t block_count);
+void lru_delete(lru_t *lru);
+
+lru_block_t *lru_get(lru_t *lru, uint64_t key);
+lru_block_t *lru_peek(const lru_t *lru, uint64_t key);
+lru_block_t *lru_put(lru_t *lru, uint64_t key);
+void lru_invalidate(lru_t *lru, uint64_t key);
+void lru_clear(lru_t *lru);
+
+#endif /* LRU_H */
@@ -0,0 +1,615 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "commands.h"
+#include "eval.h"
+#include "jobs.h"
+#include "macro.h"
+#include "object.h"
+#include "parser.h"
+
+/* Initial size of a macro's arena. Bodies are rarely larger */
+#define MACRO_ARENA_SIZE 1024
+
+extern const command_t command_defmacro;
+extern const command_t command_upload;
+
+typedef struct {
+        const char *names[MACRO_PARAMS_MAX];
+        uint32_t count;
+} params_t;
+
+typedef struct {
+        uint32_t address;
+        size_t size;
+        uint8_t *data;
+
+        /* Either the file that was read, or the buffer the data is in */
+        const char *path;
+        buffer_t *buffer;
+} transfer_t;
+
+static bool _forms_copy(macro_t *macro, const params_t *params,
+    const ast_node_t *nodes, ast_node_t **link);
+
+static void
+_object_macro_destructor(object_t *object)
+{
+        macro_delete(object->as.macro);
+}
+
+void
+macro_init(void)
+{
+        object_destructor_set(OBJECT_TYPE_MACRO, _object_macro_destructor);
+}
+
+static char *
+_string_copy(macro_t *macro, const char *string)
+{
+        const size_t length = strlen(string);
+
+        char * const copy = arena_alloc(macro->arena, length + 1);
+
+        (void)memcpy(copy, string, length + 1);
+
+        return copy;
+}
+
+static bool
+_params_read(const ast_node_t *params_form, params_t *params)
+{
+        params->count = 0;
+
+        if ((params_form->type != AST_NODE_FORM) ||
+            (params_form->operator != AST_OPERATOR_NONE)) {
+                commands_status_set(COMMANDS_STATUS_EXPECTED_SYMBOL);
+
+                return false;
+        }
+
+        /* The empty form, for a macro without parameters */
+        if (params_form->name == NULL) {
+                return true;
+        }
+
+        if ((params_form->argc + 1) > MACRO_PARAMS_MAX) {
+                commands_printf("Too many parameters. At most %u are allowed\n",
+                    MACRO_PARAMS_MAX);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return false;
+        }
+
+        params->names[0] = params_form->name;
+        params->count = 1;
+
+        for (const ast_node_t *arg = params_form->args; arg != NULL; arg = arg->next) {
+                if ((arg->type != AST_NODE_OBJECT) ||
+                    (arg->object->type != OBJECT_TYPE_SYMBOL)) {
+                        commands_status_set(COMMANDS_STATUS_EXPECTED_SYMBOL);
+
+                        return false;
+                }
+
+                params->names[params->count] = arg->object->as.symbol;
+                params->count++;
+        }
+
+        for (uint32_t i = 0; i < params->count; i++) {
+                for (uint32_t j = i + 1; j < params->count; j++) {
+                        if (params->names[i] == params->names[j]) {
+                                commands_printf("Parameter \"%s\" is used more than once\n",
+                                    params->names[i]);
+                                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                                return false;
+                        }
+                }
+        }
+
+        return true;
+}
+
+/* Both names are interned symbols */
+static int32_t
+_param_find(const params_t *params, const char *name)
+{
+        for (uint32_t i = 0; i < params->count; i++) {
+                if (params->names[i] == name) {
+                        return i;
+                }
+        }
+
+        return -1;
+}
+
+/* What would only be found out when the macro is called is checked now:
+ * that every form names something that can be called, with the right number
+ * of arguments */
+static bool
+_form_check(const ast_node_t *form)
+{
+        if (form->operator != AST_OPERATOR_NONE) {
+                return true;
+        }
+
+        if (form->name == NULL) {
+                commands_printf("Expected a command\n");
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return false;
+        }
+
+        if (form->head == NULL) {
+                commands_printf("Command \"%s\" not found\n", form->name);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return false;
+        }
+
+        int32_t arg_count;
+
+        switch (form->head->type) {
+        case OBJECT_TYPE_COMMAND:
+                /* The macro could otherwise be redefined while it runs */
+                if (form->head->as.command == &command_defmacro) {
+                        commands_printf("Macros can't be defined in a macro\n");
+                        commands_status_set(COMMANDS_STATUS_ERROR);
+
+                        return false;
+                }
+
+                arg_count = form->head->as.command->arg_count;
+                break;
+        case OBJECT_TYPE_MACRO:
+                arg_count = form->head->as.macro->param_count;
+                break;
+        default:
+                commands_printf("\"%s\" is not a command\n", form->name);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return false;
+        }
+
+        if ((arg_count >= 0) && ((uint32_t)arg_count != form->argc)) {
+                (void)printf("Mismatch in arguments passed to \"%s\". Expected %i, got %u\n",
+                    form->name,
+                    arg_count,
+                    form->argc);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return false;
+        }
+
+        return true;
+}
+
+static ast_node_t *
+_node_copy(macro_t *macro, const params_t *params, const ast_node_t *node)
+{
+        ast_node_t * const copy = arena_alloc(macro->arena, sizeof(ast_node_t));
+
+        *copy = *node;
+        copy->next = NULL;
+
+        if (node->type == AST_NODE_OBJECT) {
+                const object_t * const object = node->object;
+
+                if (object->type == OBJECT_TYPE_SYMBOL) {
+                        const int32_t index = _param_find(params, object->as.symbol);
+
+                        if (index >= 0) {
+                                copy->type = AST_NODE_PARAM;
+                                copy->object = NULL;
+                                copy->index = index;
+
+                                return copy;
+                        }
+                }
+
+                copy->object = arena_alloc(macro->arena, sizeof(object_t));
+                *copy->object = *object;
+
+                /* Symbols are interned, and outlive the macro */
+                if (object->type == OBJECT_TYPE_STRING) {
+                        copy->object->as.string = _string_copy(macro, object->as.string);
+                }
+
+                return copy;
+        }
+
+        if (!(_form_check(node))) {
+                return NULL;
+        }
+
+        if (!(_forms_copy(macro, params, node->args, &copy->args))) {
+                return NULL;
+        }
+
+        return copy;
+}
+
+static bool
+_forms_copy(macro_t *macro, const params_t *params, const ast_node_t *nodes,
+    ast_node_t **link)
+{
+        *link = NULL;
+
+        for (const ast_node_t *node = nodes; node != NULL; node = node->next) {
+                ast_node_t * const copy = _node_copy(macro, params, node);
+
+                if (copy == NULL) {
+                        return false;
+                }
+
+                *link = copy;
+                link = &copy->next;
+        }
+
+        return true;
+}
+
+static bool
+_form_is_upload(const ast_node_t *form)
+{
+        return ((form->type == AST_NODE_FORM) &&
+                (form->head != NULL) &&
+                (form->head->type == OBJECT_TYPE_COMMAND) &&
+                (form->head->as.command == &command_upload));
+}
+
+/* Runs of two uploads or more are replaced by a transfers node, which holds
+ * them as its arguments */
+static void
+_transfers_group(macro_t *macro, ast_node_t **link)
+{
+        while (*link != NULL) {
+                ast_node_t * const first = *link;
+
+                ast_node_t *last;
+                last = NULL;
+
+                uint32_t count;
+                count = 0;
+
+                for (ast_node_t *form = first;
+                     (form != NULL) && _form_is_upload(form) && (count < MACRO_TRANSFERS_MAX);
+                     form = form->next) {
+                        last = form;
+                        count++;
+                }
+
+                if (count < 2) {
+                        link = &first->next;
+
+                        continue;
+                }
+
+                ast_node_t * const transfers = arena_alloc(macro->arena, sizeof(ast_node_t));
+
+                *transfers = (ast_node_t) {
+                        .type     = AST_NODE_TRANSFERS,
+                        .operator = AST_OPERATOR_NONE,
+                        .args     = first,
+                        .argc     = count,
+                        .next     = last->next
+                };
+
+                last->next = NULL;
+
+                *link = transfers;
+                link = &transfers->next;
+        }
+}
+
+macro_t *
+macro_new(const ast_node_t *params_form, const ast_node_t *body)
+{
+        assert(params_form != NULL);
+
+        params_t params;
+
+        if (!(_params_read(params_form, &params))) {
+                return NULL;
+        }
+
+        macro_t * const macro = malloc(sizeof(macro_t));
+        assert(macro != NULL);
+
+        macro->arena = arena_new(MACRO_ARENA_SIZE);
+        macro->param_count = params.count;
+        macro->body = NULL;
+
+        for (const ast_node_t *form = body; form != NULL; form = form->next) {
+                if (form->type != AST_NODE_FORM) {
+                        commands_printf("Expected a command\n");
+                        commands_status_set(COMMANDS_STATUS_ERROR);
+
+                        macro_delete(macro);
+
+                        return NULL;
+                }
+        }
+
+        if (!(_forms_copy(macro, &params, body, &macro->body))) {
+                macro_delete(macro);
+
+                return NULL;
+        }
+
+        _transfers_group(macro, &macro->body);
+
+        return macro;
+}
+
+void
+macro_delete(macro_t *macro)
+{
+        if (macro == NULL) {
+                return;
+        }
+
+        arena_delete(macro->arena);
+
+        free(macro);
+}
+
+static bool
+_file_read(transfer_t *transfer)
+{
+        FILE * const fp = fopen(transfer->path, "rb");
+
+        if (fp == NULL) {
+                return false;
+        }
+
+        long size;
+
+        if (((fseek(fp, 0, SEEK_END)) != 0) || ((size = ftell(fp)) < 0)) {
+                (void)fclose(fp);
+
+                return false;
+        }
+
+        rewind(fp);
+
+        uint8_t * const data = malloc((size > 0) ? size : 1);
+
+        if ((data == NULL) || ((fread(data, 1, size, fp)) != (size_t)size)) {
+                free(data);
+                (void)fclose(fp);
+
+                return false;
+        }
+
+        (void)fclose(fp);
+
+        transfer->data = data;
+        transfer->size = size;
+
+        return true;
+}
+
+static int
+_transfer_compare(const void *a, const void *b)
+{
+        const transfer_t * const transfer_a = *(const transfer_t * const *)a;
+        const transfer_t * const transfer_b = *(const transfer_t * const *)b;
+
+        if (transfer_a->address < transfer_b->address) {
+                return -1;
+        }
+
+        return (transfer_a->address > transfer_b->address) ? 1 : 0;
+}
+
+/* Sorts the transfers by address, leaving the transfers themselves alone.
+ * Returns false if any of them overlap, as they then depend on the order
+ * they were written in */
+static bool
+_transfers_sort(const transfer_t **order, uint32_t count)
+{
+        qsort(order, count, sizeof(*order), _transfer_compare);
+
+        for (uint32_t i = 1; i < count; i++) {
+                const transfer_t * const previous = order[i - 1];
+
+                if (order[i]->address < (previous->address + previous->size)) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/* Transfers, in the order given, that are next to each other go over as
+ * one */
+static bool
+_transfers_write(const transfer_t * const *order, uint32_t count)
+{
+        uint32_t i;
+        i = 0;
+
+        while (i < count) {
+                const transfer_t * const first = order[i];
+
+                size_t size;
+                size = first->size;
+
+                uint32_t j;
+
+                for (j = i + 1; j < count; j++) {
+                        if (order[j]->address != (first->address + size)) {
+                                break;
+                        }
+
+                        size += order[j]->size;
+                }
+
+                buffer_t * const buffer = buffer_new(size);
+
+                if (buffer == NULL) {
+                        commands_status_set(COMMANDS_STATUS_INSUFFICIENT_MEMORY);
+
+                        return false;
+                }
+
+                size_t offset;
+                offset = 0;
+
+                for (uint32_t k = i; k < j; k++) {
+                        (void)memcpy(&buffer->data[offset], order[k]->data, order[k]->size);
+
+                        offset += order[k]->size;
+                }
+
+                /* As a job, it goes to every selected device, and after the
+                 * jobs already writing there */
+                job_t * const job = job_new(JOB_TYPE_UPLOAD, first->address, buffer);
+
+                (void)snprintf(job->description, sizeof(job->description),
+                    "upload 0x%08X <%zuB:macro>", first->address, size);
+
+                const job_state_t state = jobs_run(job);
+
+                if (state == JOB_STATE_CANCELLED) {
+                        commands_printf("Interrupted\n");
+                        commands_status_set(COMMANDS_STATUS_ERROR);
+
+                        return false;
+                }
+
+                if (state != JOB_STATE_DONE) {
+                        if (first->path != NULL) {
+                                commands_printf("Unable upload file \"%s\" to 0x%08X\n",
+                                    first->path,
+                                    first->address);
+                        } else {
+                                commands_printf("Unable upload to 0x%08X\n", first->address);
+                        }
+
+                        commands_status_set(COMMANDS_STATUS_ERROR);
+
+                        return false;
+                }
+
+                i = j;
+        }
+
+        return true;
+}
+
+/* Evaluates the upload's arguments, and reads its file. On failure, the
+ * status has already been set */
+static bool
+_transfer_get(const parser_t *parser, const ast_node_t *upload,
+    transfer_t *transfer)
+{
+        const ast_node_t * const address_node = upload->args;
+        const ast_node_t * const path_node = address_node->next;
+
+        int address;
+        object_t path_obj;
+
+        if (!(eval_integer_get(parser, address_node, &address)) ||
+            !(eval_value_get(parser, path_node, &path_obj))) {
+                return false;
+        }
+
+        transfer->address = address;
+        transfer->path = NULL;
+        transfer->buffer = NULL;
+
+        if (path_obj.type == OBJECT_TYPE_BUFFER) {
+                /* The reference taken is the transfer's */
+                transfer->buffer = path_obj.as.buffer;
+                transfer->data = transfer->buffer->data;
+                transfer->size = transfer->buffer->size;
+
+                return true;
+        }
+
+        if (path_obj.type != OBJECT_TYPE_STRING) {
+                commands_status_set(COMMANDS_STATUS_EXPECTED_STRING);
+
+                return false;
+        }
+
+        transfer->path = path_obj.as.string;
+
+        if (!(_file_read(transfer))) {
+                commands_printf("Unable upload file \"%s\" to 0x%08X\n",
+                    transfer->path,
+                    transfer->address);
+                commands_status_set(COMMANDS_STATUS_ERROR);
+
+                return false;
+        }
+
+        return true;
+}
+
+/* Every upload's arguments are evaluated, and its file read, before anything
+ * is written, so nothing is written if any of them fails. Each is evaluated
+ * once. Uploads that don't overlap are written in order of address, and
+ * ones that do in the order they were given */
+eval_ret_t
+macro_transfers_run(const parser_t *parser, const ast_node_t *transfers)
+{
+        assert(parser != NULL);
+        assert(transfers != NULL);
+        assert(transfers->type == AST_NODE_TRANSFERS);
+
+        transfer_t items[MACRO_TRANSFERS_MAX];
+        uint32_t count;
+        count = 0;
+
+        commands_status_clear();
+
+        eval_ret_t ret;
+        ret = EVAL_RET_OK;
+
+        for (const ast_node_t *upload = transfers->args; upload != NULL; upload = upload->next) {
+                assert(count < MACRO_TRANSFERS_MAX);
+
+                if (!(_transfer_get(parser, upload, &items[count]))) {
+                        ret = EVAL_RET_FAILED;
+                        break;
+                }
+
+                count++;
+        }
+
+        if (ret == EVAL_RET_OK) {
+                const transfer_t *order[MACRO_TRANSFERS_MAX];
+
+                for (uint32_t i = 0; i < count; i++) {
+                        order[i] = &items[i];
+                }
+
+                if (!(_transfers_sort(order, count))) {
+                        for (uint32_t i = 0; i < count; i++) {
+                                order[i] = &items[i];
+                        }
+                }
+
+                if (!(_transfers_write(order, count))) {
+                        ret = EVAL_RET_FAILED;
+                }
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                if (items[i].buffer != NULL) {
+                        buffer_unref(items[i].buffer);
+                } else {
+                        free(items[i].data);
+                }
+        }
+
+        return ret;
+}
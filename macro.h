@@ -0,0 +1,42 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <stdint.h>
+
+#include "types.h"
+#include "arena.h"
+#include "ast.h"
+#include "eval.h"
+
+/* Macros are defined once and called like commands. The body is checked
+ * and copied out of the line it was defined on when it's defined: commands
+ * and macros it calls are already resolved, and its parameters are already
+ * slots in the caller's arguments, so a call never parses anything.
+ *
+ * Consecutive uploads in the body are grouped. When a call finds that none
+ * of them overlap, the files are read first, and those that end up next to
+ * each other in memory go over in a single transfer */
+
+#define MACRO_PARAMS_MAX        16
+
+/* Longest run of uploads grouped together */
+#define MACRO_TRANSFERS_MAX     64
+
+struct macro {
+        arena_t *arena;
+
+        uint32_t param_count;
+        ast_node_t *body;
+};
+
+void macro_init(void);
+
+/* The parameter list is a form whose head and arguments are the parameter
+ * names. Returns NULL if the body is invalid, in which case the status has
+ * already been set */
+macro_t *macro_new(const ast_node_t *params, const ast_node_t *body);
+void macro_delete(macro_t *macro);
+
+eval_ret_t macro_transfers_run(const parser_t *parser, const ast_node_t *transfers);
+
+#endif /* MACRO_H */
@@ -0,0 +1,338 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memcache.h"
+
+/* Pending writes are flushed once they add up to this much */
+#define MEMCACHE_WRITE_SIZE_MAX 0x10000
+
+static uint32_t
+_transfer_page_count(const memcache_t *memcache)
+{
+        /* A request's own pages plus a full read-ahead window */
+        return memcache->readahead_max * 2;
+}
+
+memcache_t *
+memcache_new(uint32_t page_size, uint32_t page_count, uint32_t readahead_max)
+{
+        assert((page_size & (page_size - 1)) == 0);
+        assert(readahead_max > 0);
+
+        memcache_t * const memcache = calloc(1, sizeof(memcache_t));
+
+        if (memcache == NULL) {
+                return NULL;
+        }
+
+        memcache->page_size = page_size;
+        memcache->readahead = 1;
+        memcache->readahead_max = readahead_max;
+
+        /* A single fetch must never evict its own pages */
+        const uint32_t transfer_page_count = _transfer_page_count(memcache);
+
+        if (page_count < transfer_page_count) {
+                page_count = transfer_page_count;
+        }
+
+        memcache->lru = lru_new(page_size, page_count);
+        memcache->transfer = malloc((size_t)transfer_page_count * page_size);
+
+        if ((memcache->lru == NULL) || (memcache->transfer == NULL)) {
+                memcache_delete(memcache);
+
+                return NULL;
+        }
+
+        return memcache;
+}
+
+void
+memcache_delete(memcache_t *memcache)
+{
+        if (memcache == NULL) {
+                return;
+        }
+
+        for (uint32_t i = 0; i < memcache->write_count; i++) {
+                free(memcache->writes[i].data);
+        }
+
+        lru_delete(memcache->lru);
+        free(memcache->transfer);
+        free(memcache);
+}
+
+static bool
+_writes_overlap(const memcache_t *memcache, uint64_t start, uint64_t end)
+{
+        for (uint32_t i = 0; i < memcache->write_count; i++) {
+                const memcache_write_t * const write = &memcache->writes[i];
+
+                if ((write->address < end) && (((uint64_t)write->address + write->size) > start)) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+static device_ret_t
+_pages_fetch(memcache_t *memcache, uint64_t page, uint64_t last_page)
+{
+        const uint32_t page_size = memcache->page_size;
+        const uint64_t page_limit = (UINT64_C(1) << 32) / page_size;
+        const uint32_t transfer_page_count = _transfer_page_count(memcache);
+
+        /* Sequential misses widen the read-ahead window, anything else
+         * closes it */
+        if (page == memcache->next_page) {
+                memcache->readahead *= 2;
+                memcache->readahead =
+                    (memcache->readahead < memcache->readahead_max) ? memcache->readahead : memcache->readahead_max;
+        } else {
+                memcache->readahead = 1;
+        }
+
+        uint64_t needed;
+        needed = (last_page - page) + 1;
+        needed = (needed < transfer_page_count) ? needed : transfer_page_count;
+
+        uint64_t count;
+        count = needed + memcache->readahead;
+        count = (count < transfer_page_count) ? count : transfer_page_count;
+        count = (count < (page_limit - page)) ? count : (page_limit - page);
+
+        const uint64_t start = page * page_size;
+
+        /* The target has to see pending writes before they're read back */
+        if (_writes_overlap(memcache, start, start + (count * page_size))) {
+                if ((memcache_flush(memcache)) != DEVICE_RET_OK) {
+                        return DEVICE_RET_ERROR;
+                }
+        }
+
+        if ((device_read(memcache->transfer, start, count * page_size)) != DEVICE_RET_OK) {
+                /* The read-ahead might have run off the end of RAM */
+                if (count == needed) {
+                        return DEVICE_RET_ERROR;
+                }
+
+                count = needed;
+
+                if ((device_read(memcache->transfer, start, count * page_size)) != DEVICE_RET_OK) {
+                        return DEVICE_RET_ERROR;
+                }
+        }
+
+        for (uint64_t i = 0; i < count; i++) {
+                lru_block_t * const block = lru_put(memcache->lru, page + i);
+
+                (void)memcpy(block->data, &memcache->transfer[i * page_size], page_size);
+
+                block->size = page_size;
+        }
+
+        memcache->next_page = page + count;
+        memcache->fetch_count++;
+
+        return DEVICE_RET_OK;
+}
+
+device_ret_t
+memcache_read(memcache_t *memcache, void *buffer, uint32_t address, size_t size)
+{
+        assert(memcache != NULL);
+        assert(buffer != NULL);
+
+        if (size == 0) {
+                return DEVICE_RET_OK;
+        }
+
+        const uint32_t page_size = memcache->page_size;
+        const uint64_t end = (uint64_t)address + size;
+        const uint64_t last_page = (end - 1) / page_size;
+
+        uint8_t *p;
+        p = buffer;
+
+        uint64_t position;
+        position = address;
+
+        while (position < end) {
+                const uint64_t page = position / page_size;
+
+                const lru_block_t *block;
+
+                if ((block = lru_get(memcache->lru, page)) == NULL) {
+                        if ((_pages_fetch(memcache, page, last_page)) != DEVICE_RET_OK) {
+                                return DEVICE_RET_ERROR;
+                        }
+
+                        block = lru_peek(memcache->lru, page);
+                }
+
+                const uint32_t offset = position % page_size;
+
+                uint64_t length;
+                length = page_size - offset;
+                length = (length < (end - position)) ? length : (end - position);
+
+                (void)memcpy(p, &block->data[offset], length);
+
+                p += length;
+                position += length;
+        }
+
+        return DEVICE_RET_OK;
+}
+
+static device_ret_t
+_write_queue(memcache_t *memcache, const uint8_t *buffer, uint32_t address, size_t size)
+{
+        uint64_t start;
+        start = address;
+        uint64_t end;
+        end = (uint64_t)address + size;
+
+        /* Overlapping and adjacent writes become one */
+        for (uint32_t i = 0; i < memcache->write_count; i++) {
+                const memcache_write_t * const write = &memcache->writes[i];
+                const uint64_t write_end = (uint64_t)write->address + write->size;
+
+                if ((write->address <= end) && (write_end >= start)) {
+                        start = (write->address < start) ? write->address : start;
+                        end = (write_end > end) ? write_end : end;
+                }
+        }
+
+        uint8_t * const data = malloc(end - start);
+
+        if (data == NULL) {
+                return DEVICE_RET_ERROR;
+        }
+
+        uint32_t i;
+        i = 0;
+
+        while (i < memcache->write_count) {
+                memcache_write_t * const write = &memcache->writes[i];
+
+                if ((write->address < start) || (((uint64_t)write->address + write->size) > end)) {
+                        i++;
+
+                        continue;
+                }
+
+                (void)memcpy(&data[write->address - start], write->data, write->size);
+
+                free(write->data);
+
+                memcache->write_size -= write->size;
+                memcache->write_count--;
+                memcache->writes[i] = memcache->writes[memcache->write_count];
+        }
+
+        (void)memcpy(&data[address - start], buffer, size);
+
+        memcache->writes[memcache->write_count] = (memcache_write_t) {
+                .address = start,
+                .size    = end - start,
+                .data    = data
+        };
+
+        memcache->write_count++;
+        memcache->write_size += end - start;
+
+        return DEVICE_RET_OK;
+}
+
+device_ret_t
+memcache_write(memcache_t *memcache, const void *buffer, uint32_t address, size_t size)
+{
+        assert(memcache != NULL);
+        assert(buffer != NULL);
+
+        if (size == 0) {
+                return DEVICE_RET_OK;
+        }
+
+        const uint32_t page_size = memcache->page_size;
+        const uint64_t end = (uint64_t)address + size;
+        const uint8_t * const p = buffer;
+
+        /* Keep cached pages in step, so that reads see the write before it
+         * goes over */
+        for (uint64_t position = address; position < end; ) {
+                const uint32_t offset = position % page_size;
+
+                uint64_t length;
+                length = page_size - offset;
+                length = (length < (end - position)) ? length : (end - position);
+
+                lru_block_t * const block = lru_peek(memcache->lru, position / page_size);
+
+                if (block != NULL) {
+                        (void)memcpy(&block->data[offset], &p[position - address], length);
+                }
+
+                position += length;
+        }
+
+        if (memcache->write_count == MEMCACHE_WRITES_MAX) {
+                if ((memcache_flush(memcache)) != DEVICE_RET_OK) {
+                        return DEVICE_RET_ERROR;
+                }
+        }
+
+        if ((_write_queue(memcache, p, address, size)) != DEVICE_RET_OK) {
+                return DEVICE_RET_ERROR;
+        }
+
+        if (memcache->write_size >= MEMCACHE_WRITE_SIZE_MAX) {
+                return memcache_flush(memcache);
+        }
+
+        return DEVICE_RET_OK;
+}
+
+device_ret_t
+memcache_flush(memcache_t *memcache)
+{
+        assert(memcache != NULL);
+
+        device_ret_t ret;
+        ret = DEVICE_RET_OK;
+
+        for (uint32_t i = 0; i < memcache->write_count; i++) {
+                memcache_write_t * const write = &memcache->writes[i];
+
+                if (ret == DEVICE_RET_OK) {
+                        ret = device_write(write->data, write->address, write->size);
+                }
+
+                free(write->data);
+        }
+
+        if (memcache->write_count > 0) {
+                memcache->flush_count++;
+        }
+
+        memcache->write_count = 0;
+        memcache->write_size = 0;
+
+        return ret;
+}
+
+void
+memcache_invalidate(memcache_t *memcache)
+{
+        assert(memcache != NULL);
+
+        lru_clear(memcache->lru);
+
+        memcache->readahead = 1;
+        memcache->next_page = 0;
+}
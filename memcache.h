@@ -0,0 +1,55 @@
+#ifndef MEMCACHE_H
+#define MEMCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "device.h"
+#include "lru.h"
+
+/* Page cache over target RAM, for clients that make many small accesses.
+ * Reads are served from cached pages, and a miss fetches the missing pages
+ * plus a read-ahead window in one transfer. Writes update the cached pages
+ * and are queued, with overlapping and adjacent writes combined, until the
+ * queue is flushed */
+
+#define MEMCACHE_WRITES_MAX     64
+
+typedef struct {
+        uint32_t address;
+        uint32_t size;
+        uint8_t *data;
+} memcache_write_t;
+
+typedef struct {
+        lru_t *lru;
+        uint32_t page_size;
+
+        /* Read-ahead window in pages. It grows while misses are sequential */
+        uint32_t readahead;
+        uint32_t readahead_max;
+        uint64_t next_page;
+
+        uint8_t *transfer;
+
+        memcache_write_t writes[MEMCACHE_WRITES_MAX];
+        uint32_t write_count;
+        size_t write_size;
+
+        uint64_t fetch_count;
+        uint64_t flush_count;
+} memcache_t;
+
+memcache_t *memcache_new(uint32_t page_size, uint32_t page_count,
+    uint32_t readahead_max);
+void memcache_delete(memcache_t *memcache);
+
+device_ret_t memcache_read(memcache_t *memcache, void *buffer,
+    uint32_t address, size_t size);
+device_ret_t memcache_write(memcache_t *memcache, const void *buffer,
+    uint32_t address, size_t size);
+device_ret_t memcache_flush(memcache_t *memcache);
+void memcache_invalidate(memcache_t *memcache);
+
+#endif /* MEMCACHE_H */
@@ -0,0 +1,198 @@
+#include <assert.h>
+#include <string.h>
+
+#include "mutate.h"
+
+#define MUTATE_HAVOC_STACK_MAX  32
+#define MUTATE_ARITH_MAX        35
+#define MUTATE_BLOCK_MAX        64
+
+/* Values that tend to hit boundary conditions in parsers */
+static const int32_t _interesting_values[] = {
+        -128, -1, 0, 1, 16, 32, 64, 100, 127,
+        -32768, -129, 128, 255, 256, 512, 1000, 1024, 4096, 32767,
+        -2147483647 - 1, -100663046, 32768, 65535, 65536, 100663045, 2147483647
+};
+
+#define INTERESTING_COUNT (sizeof(_interesting_values) / sizeof(_interesting_values[0]))
+
+void
+mutate_seed(mutate_t *mutate, uint64_t seed)
+{
+        assert(mutate != NULL);
+
+        /* Zero would get xorshift stuck */
+        mutate->state = (seed != 0) ? seed : 0x9E3779B97F4A7C15ull;
+}
+
+uint32_t
+mutate_random(mutate_t *mutate, uint32_t bound)
+{
+        /* xorshift64* */
+        mutate->state ^= mutate->state >> 12;
+        mutate->state ^= mutate->state << 25;
+        mutate->state ^= mutate->state >> 27;
+
+        const uint32_t value = (mutate->state * 0x2545F4914F6CDD1Dull) >> 32;
+
+        return (bound != 0) ? (uint32_t)(((uint64_t)value * bound) >> 32) : value;
+}
+
+static void
+_be_put(uint8_t *p, uint32_t value, uint32_t width)
+{
+        for (uint32_t i = 0; i < width; i++) {
+                p[i] = value >> ((width - 1 - i) * 8);
+        }
+}
+
+static uint32_t
+_be_get(const uint8_t *p, uint32_t width)
+{
+        uint32_t value;
+        value = 0;
+
+        for (uint32_t i = 0; i < width; i++) {
+                value = (value << 8) | p[i];
+        }
+
+        return value;
+}
+
+size_t
+mutate_bitflip(mutate_t *mutate, uint8_t *buffer, size_t size)
+{
+        assert(buffer != NULL);
+
+        if (size == 0) {
+                return 0;
+        }
+
+        /* One to four bits, anywhere */
+        const uint32_t count = 1 + mutate_random(mutate, 4);
+
+        for (uint32_t i = 0; i < count; i++) {
+                const uint32_t bit = mutate_random(mutate, size * 8);
+
+                buffer[bit / 8] ^= 0x80 >> (bit % 8);
+        }
+
+        return size;
+}
+
+size_t
+mutate_havoc(mutate_t *mutate, uint8_t *buffer, size_t size, size_t capacity)
+{
+        assert(buffer != NULL);
+        assert(size <= capacity);
+
+        const uint32_t count = 1 << (1 + mutate_random(mutate, 5));
+
+        for (uint32_t i = 0; i < count; i++) {
+                if (size == 0) {
+                        if (capacity == 0) {
+                                break;
+                        }
+
+                        buffer[0] = mutate_random(mutate, 256);
+                        size = 1;
+                }
+
+                /* Targets are big-endian, so multi-byte values are too */
+                const uint32_t width = 1 << mutate_random(mutate, 3);
+
+                switch (mutate_random(mutate, 7)) {
+                case 0:
+                        (void)mutate_bitflip(mutate, buffer, size);
+                        break;
+                case 1:
+                        buffer[mutate_random(mutate, size)] ^= 1 + mutate_random(mutate, 255);
+                        break;
+                case 2:
+                        if (width <= size) {
+                                uint8_t * const p = &buffer[mutate_random(mutate, size - width + 1)];
+
+                                _be_put(p, _interesting_values[mutate_random(mutate, INTERESTING_COUNT)], width);
+                        }
+                        break;
+                case 3:
+                        if (width <= size) {
+                                uint8_t * const p = &buffer[mutate_random(mutate, size - width + 1)];
+                                const uint32_t delta = 1 + mutate_random(mutate, MUTATE_ARITH_MAX);
+
+                                uint32_t value;
+                                value = _be_get(p, width);
+                                value = (mutate_random(mutate, 2) != 0) ? (value + delta) : (value - delta);
+
+                                _be_put(p, value, width);
+                        }
+                        break;
+                case 4:
+                        /* Delete a block */
+                        if (size > 1) {
+                                const uint32_t length = 1 + mutate_random(mutate,
+                                    (size - 1) < MUTATE_BLOCK_MAX ? (size - 1) : MUTATE_BLOCK_MAX);
+                                const uint32_t offset = mutate_random(mutate, size - length + 1);
+
+                                (void)memmove(&buffer[offset], &buffer[offset + length], size - offset - length);
+
+                                size -= length;
+                        }
+                        break;
+                case 5:
+                        /* Clone a block to somewhere else, growing the input */
+                        if (size < capacity) {
+                                const size_t room = capacity - size;
+                                const size_t limit = (size < MUTATE_BLOCK_MAX) ? size : MUTATE_BLOCK_MAX;
+                                const uint32_t length = 1 + mutate_random(mutate, (room < limit) ? room : limit);
+                                const uint32_t from = mutate_random(mutate, size - length + 1);
+                                const uint32_t to = mutate_random(mutate, size + 1);
+
+                                uint8_t block[MUTATE_BLOCK_MAX];
+
+                                (void)memcpy(block, &buffer[from], length);
+                                (void)memmove(&buffer[to + length], &buffer[to], size - to);
+                                (void)memcpy(&buffer[to], block, length);
+
+                                size += length;
+                        }
+                        break;
+                default:
+                        /* Overwrite a block with another part of the input */
+                        if (size > 1) {
+                                const size_t limit = (size < MUTATE_BLOCK_MAX) ? size : MUTATE_BLOCK_MAX;
+                                const uint32_t length = 1 + mutate_random(mutate, limit - 1);
+                                const uint32_t from = mutate_random(mutate, size - length + 1);
+                                const uint32_t to = mutate_random(mutate, size - length + 1);
+
+                                (void)memmove(&buffer[to], &buffer[from], length);
+                        }
+                        break;
+                }
+        }
+
+        return size;
+}
+
+size_t
+mutate_splice(mutate_t *mutate, uint8_t *buffer, size_t size,
+    const uint8_t *other, size_t other_size, size_t capacity)
+{
+        assert(buffer != NULL);
+        assert(other != NULL);
+
+        if ((size < 2) || (other_size < 2)) {
+                return mutate_havoc(mutate, buffer, size, capacity);
+        }
+
+        /* Head of this input, tail of the other one */
+        const uint32_t split = 1 + mutate_random(mutate, ((size < other_size) ? size : other_size) - 1);
+
+        size_t tail_size;
+        tail_size = other_size - split;
+        tail_size = (tail_size < (capacity - split)) ? tail_size : (capacity - split);
+
+        (void)memcpy(&buffer[split], &other[split], tail_size);
+
+        return mutate_havoc(mutate, buffer, split + tail_size, capacity);
+}
@@ -0,0 +1,23 @@
+#ifndef MUTATE_H
+#define MUTATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Input mutators for fuzzing. Each one mutates the buffer in place and
+ * returns the new size, which never exceeds the capacity */
+
+typedef struct {
+        uint64_t state;
+} mutate_t;
+
+void mutate_seed(mutate_t *mutate, uint64_t seed);
+uint32_t mutate_random(mutate_t *mutate, uint32_t bound);
+
+size_t mutate_bitflip(mutate_t *mutate, uint8_t *buffer, size_t size);
+size_t mutate_havoc(mutate_t *mutate, uint8_t *buffer, size_t size,
+    size_t capacity);
+size_t mutate_splice(mutate_t *mutate, uint8_t *buffer, size_t size,
+    const uint8_t *other, size_t other_size, size_t capacity);
+
+#endif /* MUTATE_H */
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "buffer.h"
 #include "object.h"
 
 static object_destructor_func_t _destructor_funcs[OBJECT_TYPE_COUNT];
@@ -81,6 +82,18 @@ object_symbol_copy_new(char *value)
         return object_symbol_new(strdup(value));
 }
 
+object_t *
+object_buffer_new(buffer_t *value)
+{
+        assert(value != NULL);
+
+        object_t * const object = object_new(OBJECT_TYPE_BUFFER);
+
+        object->as.buffer = buffer_ref(value);
+
+        return object;
+}
+
 void
 object_delete(object_t *object)
 {
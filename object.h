@@ -7,12 +7,16 @@
 #include "commands.h"
 
 struct command;
+struct macro;
+struct buffer;
 
 typedef enum {
         OBJECT_TYPE_COMMAND,
         OBJECT_TYPE_SYMBOL,
         OBJECT_TYPE_STRING,
         OBJECT_TYPE_INTEGER,
+        OBJECT_TYPE_MACRO,
+        OBJECT_TYPE_BUFFER,
 
         OBJECT_TYPE_COUNT,
 } object_type_t;
@@ -25,6 +29,8 @@ struct object {
                 char *symbol;
                 char *string;
                 int integer;
+                struct macro *macro;
+                struct buffer *buffer;
                 void *value;
         } as;
 };
@@ -39,6 +45,8 @@ object_t *object_string_new(char *value);
 object_t *object_string_copy_new(char *value);
 object_t *object_symbol_new(char *value);
 object_t *object_symbol_copy_new(char *value);
+/* Takes a reference to the buffer */
+object_t *object_buffer_new(struct buffer *value);
 
 void object_destructor_set(object_type_t type, object_destructor_func_t func);
 
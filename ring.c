@@ -0,0 +1,113 @@
+#include <assert.h>
+#include <string.h>
+
+#include "device.h"
+#include "ring.h"
+
+ring_ret_t
+ring_attach(ring_t *ring, uint32_t address)
+{
+        assert(ring != NULL);
+
+        uint8_t header[RING_HEADER_SIZE];
+
+        if ((device_read(header, address, sizeof(header))) != DEVICE_RET_OK) {
+                return RING_RET_ERROR;
+        }
+
+        if ((device_be32_get(&header[0x00])) != RING_MAGIC) {
+                return RING_RET_INVALID_MAGIC;
+        }
+
+        const uint32_t size = device_be32_get(&header[0x04]);
+
+        if ((size == 0) || (size > RING_SIZE_MAX) || ((size & (size - 1)) != 0)) {
+                return RING_RET_INVALID_SIZE;
+        }
+
+        *ring = (ring_t) {
+                .address = address,
+                .size    = size,
+                .head    = device_be32_get(&header[RING_HEAD_OFFSET]),
+                .tail    = device_be32_get(&header[RING_TAIL_OFFSET]),
+                .lost    = 0
+        };
+
+        return RING_RET_OK;
+}
+
+ring_ret_t
+ring_poll(ring_t *ring, bool *pending)
+{
+        assert(ring != NULL);
+        assert(pending != NULL);
+
+        /* Only the head index is ever polled. The host owns the tail, so the
+         * copy we hold is always current */
+        uint32_t head;
+
+        if ((device_u32_read(ring->address + RING_HEAD_OFFSET, &head)) != DEVICE_RET_OK) {
+                return RING_RET_ERROR;
+        }
+
+        ring->head = head;
+
+        const uint32_t used = ring->head - ring->tail;
+
+        if (used > ring->size) {
+                /* The target overran us. Skip to the oldest byte still intact */
+                ring->lost += used - ring->size;
+                ring->tail = ring->head - ring->size;
+        }
+
+        *pending = (ring->head != ring->tail);
+
+        return RING_RET_OK;
+}
+
+ring_ret_t
+ring_read(ring_t *ring, void *buffer, size_t size, size_t *read_size)
+{
+        assert(ring != NULL);
+        assert(buffer != NULL);
+        assert(read_size != NULL);
+
+        *read_size = 0;
+
+        const uint32_t used = ring->head - ring->tail;
+        const uint32_t count = (used < size) ? used : (uint32_t)size;
+
+        if (count == 0) {
+                return RING_RET_OK;
+        }
+
+        const uint32_t data_address = ring->address + RING_HEADER_SIZE;
+        const uint32_t offset = ring->tail & (ring->size - 1);
+
+        /* At most two transfers: up to the end of the buffer, then the part
+         * that wrapped around */
+        const uint32_t first_count =
+            ((offset + count) > ring->size) ? (ring->size - offset) : count;
+
+        uint8_t * const bytes = buffer;
+
+        if ((device_read(bytes, data_address + offset, first_count)) != DEVICE_RET_OK) {
+                return RING_RET_ERROR;
+        }
+
+        if (first_count < count) {
+                if ((device_read(&bytes[first_count], data_address, count - first_count)) != DEVICE_RET_OK) {
+                        return RING_RET_ERROR;
+                }
+        }
+
+        ring->tail += count;
+
+        if ((device_u32_write(ring->address + RING_TAIL_OFFSET, ring->tail)) != DEVICE_RET_OK) {
+                return RING_RET_ERROR;
+        }
+
+        *read_size = count;
+
+        return RING_RET_OK;
+}
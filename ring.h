@@ -0,0 +1,47 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Layout of a ring buffer in target RAM (all fields big-endian):
+ *
+ *   0x00 uint32_t magic   RING_MAGIC
+ *   0x04 uint32_t size    Capacity of data[] in bytes, a power of two
+ *   0x08 uint32_t head    Written by the target. Free-running byte count
+ *   0x0C uint32_t tail    Written by the host. Free-running byte count
+ *   0x10 uint8_t  data[size]
+ *
+ * The target must never let head run more than size bytes ahead of tail. If
+ * it does anyway, the oldest bytes are counted as lost */
+
+#define RING_MAGIC              0x52494E47 /* "RING" */
+
+#define RING_HEADER_SIZE        0x10
+#define RING_HEAD_OFFSET        0x08
+#define RING_TAIL_OFFSET        0x0C
+
+#define RING_SIZE_MAX           0x00100000
+
+typedef enum {
+        RING_RET_OK,
+        RING_RET_INVALID_MAGIC,
+        RING_RET_INVALID_SIZE,
+        RING_RET_ERROR,
+} ring_ret_t;
+
+typedef struct {
+        uint32_t address;
+        uint32_t size;
+        uint32_t head;
+        uint32_t tail;
+        uint32_t lost;
+} ring_t;
+
+ring_ret_t ring_attach(ring_t *ring, uint32_t address);
+ring_ret_t ring_poll(ring_t *ring, bool *pending);
+ring_ret_t ring_read(ring_t *ring, void *buffer, size_t size, size_t *read_size);
+
+#endif /* RING_H */
@@ -0,0 +1,434 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shell.h"
+
+#include "buffer.h"
+#include "device.h"
+#include "rpc.h"
+#include "symbols.h"
+#include "timer.h"
+
+#define RPC_POLL_INTERVAL_MIN   (50)
+#define RPC_POLL_INTERVAL_MAX   (10000)
+
+#define RPC_TRANSFER_SIZE_MAX                                                  \
+        (RPC_BLOCKS_SIZE_MAX + (RPC_CALLS_MAX * RPC_ENTRY_SIZE) + RPC_TRAILER_SIZE)
+
+static struct {
+        bool attached;
+        uint32_t mailbox_address;
+        uint32_t area_size;
+        uint32_t seq;
+
+        uint8_t transfer[RPC_TRANSFER_SIZE_MAX];
+} _state;
+
+rpc_ret_t
+rpc_attach(uint32_t mailbox_address)
+{
+        uint8_t header[RPC_HEADER_SIZE];
+
+        _state.attached = false;
+
+        if ((device_read(header, mailbox_address, sizeof(header))) != DEVICE_RET_OK) {
+                return RPC_RET_ERROR;
+        }
+
+        if ((device_be32_get(&header[0x00])) != RPC_MAGIC) {
+                return RPC_RET_INVALID_MAGIC;
+        }
+
+        const uint32_t area_size = device_be32_get(&header[0x04]);
+
+        if ((area_size < (RPC_ENTRY_SIZE + RPC_TRAILER_SIZE)) || ((area_size & 3) != 0)) {
+                return RPC_RET_INVALID_MAILBOX;
+        }
+
+        /* Pick up where the stub left off */
+        uint32_t response_seq;
+
+        const uint32_t area_end = mailbox_address + RPC_HEADER_SIZE + area_size;
+
+        if ((device_u32_read(area_end - 4, &response_seq)) != DEVICE_RET_OK) {
+                return RPC_RET_ERROR;
+        }
+
+        _state.attached = true;
+        _state.mailbox_address = mailbox_address;
+        _state.area_size = area_size;
+        _state.seq = response_seq;
+
+        return RPC_RET_OK;
+}
+
+bool
+rpc_attached(uint32_t *mailbox_address)
+{
+        if (mailbox_address != NULL) {
+                *mailbox_address = _state.mailbox_address;
+        }
+
+        return _state.attached;
+}
+
+rpc_batch_t *
+rpc_batch_new(void)
+{
+        rpc_batch_t * const batch = calloc(1, sizeof(rpc_batch_t));
+
+        if (batch == NULL) {
+                return NULL;
+        }
+
+        batch->calls = malloc(RPC_CALLS_MAX * sizeof(rpc_call_t));
+        batch->blocks = malloc(RPC_BLOCKS_SIZE_MAX);
+
+        if ((batch->calls == NULL) || (batch->blocks == NULL)) {
+                rpc_batch_delete(batch);
+
+                return NULL;
+        }
+
+        return batch;
+}
+
+void
+rpc_batch_delete(rpc_batch_t *batch)
+{
+        if (batch == NULL) {
+                return;
+        }
+
+        free(batch->calls);
+        free(batch->blocks);
+        free(batch);
+}
+
+void
+rpc_batch_clear(rpc_batch_t *batch)
+{
+        assert(batch != NULL);
+
+        batch->count = 0;
+        batch->blocks_size = 0;
+}
+
+rpc_ret_t
+rpc_batch_call_add(rpc_batch_t *batch, uint32_t address)
+{
+        assert(batch != NULL);
+
+        if (batch->count == RPC_CALLS_MAX) {
+                return RPC_RET_TOO_LARGE;
+        }
+
+        batch->calls[batch->count] = (rpc_call_t) {
+                .address = address
+        };
+
+        batch->count++;
+
+        return RPC_RET_OK;
+}
+
+rpc_ret_t
+rpc_batch_arg_add(rpc_batch_t *batch, uint32_t value)
+{
+        assert(batch != NULL);
+        assert(batch->count > 0);
+
+        rpc_call_t * const call = &batch->calls[batch->count - 1];
+
+        if (call->argc == RPC_ARGS_MAX) {
+                return RPC_RET_TOO_MANY_ARGS;
+        }
+
+        call->args[call->argc] = value;
+        call->argc++;
+
+        return RPC_RET_OK;
+}
+
+rpc_ret_t
+rpc_batch_arg_block_add(rpc_batch_t *batch, const void *data, size_t size)
+{
+        assert(batch != NULL);
+        assert(batch->count > 0);
+        assert(data != NULL);
+
+        rpc_call_t * const call = &batch->calls[batch->count - 1];
+
+        if (call->argc == RPC_ARGS_MAX) {
+                return RPC_RET_TOO_MANY_ARGS;
+        }
+
+        const size_t aligned_size = (size + 3) & ~(size_t)3;
+
+        if (aligned_size > (RPC_BLOCKS_SIZE_MAX - batch->blocks_size)) {
+                return RPC_RET_TOO_LARGE;
+        }
+
+        (void)memcpy(&batch->blocks[batch->blocks_size], data, size);
+        (void)memset(&batch->blocks[batch->blocks_size + size], 0, aligned_size - size);
+
+        call->args[call->argc] = batch->blocks_size;
+        call->block_mask |= 1 << call->argc;
+        call->argc++;
+
+        batch->blocks_size += aligned_size;
+
+        return RPC_RET_OK;
+}
+
+static rpc_ret_t
+_object_address_get(const object_t *obj, uint32_t *address)
+{
+        if (obj->type == OBJECT_TYPE_INTEGER) {
+                *address = obj->as.integer;
+
+                return RPC_RET_OK;
+        }
+
+        const symbols_t * const symbols = symbols_loaded_get();
+
+        const symbol_t *symbol;
+
+        if ((symbols == NULL) || ((symbol = symbols_name_find(symbols, obj->as.symbol)) == NULL)) {
+                return RPC_RET_UNDEFINED_SYMBOL;
+        }
+
+        *address = symbol->address;
+
+        return RPC_RET_OK;
+}
+
+rpc_ret_t
+rpc_batch_objects_add(rpc_batch_t *batch, object_t * const *objs, int count)
+{
+        assert(batch != NULL);
+        assert(objs != NULL);
+
+        /* The function address, then its arguments. Strings are passed as
+         * pointers to a copy in the mailbox, symbols as their address */
+        if ((count < 1) || ((objs[0]->type != OBJECT_TYPE_INTEGER) &&
+                            (objs[0]->type != OBJECT_TYPE_SYMBOL))) {
+                return RPC_RET_INVALID_ARG;
+        }
+
+        if ((count - 1) > RPC_ARGS_MAX) {
+                return RPC_RET_TOO_MANY_ARGS;
+        }
+
+        rpc_ret_t ret;
+        uint32_t address;
+
+        if ((ret = _object_address_get(objs[0], &address)) != RPC_RET_OK) {
+                return ret;
+        }
+
+        /* Where to roll back to if an argument doesn't fit */
+        const uint32_t blocks_size = batch->blocks_size;
+
+        if ((ret = rpc_batch_call_add(batch, address)) != RPC_RET_OK) {
+                return ret;
+        }
+
+        for (int i = 1; i < count; i++) {
+                const object_t * const obj = objs[i];
+
+                switch (obj->type) {
+                case OBJECT_TYPE_INTEGER:
+                        ret = rpc_batch_arg_add(batch, obj->as.integer);
+                        break;
+                case OBJECT_TYPE_STRING:
+                        ret = rpc_batch_arg_block_add(batch, obj->as.string,
+                            strlen(obj->as.string) + 1);
+                        break;
+                case OBJECT_TYPE_BUFFER:
+                        ret = rpc_batch_arg_block_add(batch, obj->as.buffer->data,
+                            obj->as.buffer->size);
+                        break;
+                case OBJECT_TYPE_SYMBOL:
+                        if ((ret = _object_address_get(obj, &address)) == RPC_RET_OK) {
+                                ret = rpc_batch_arg_add(batch, address);
+                        }
+                        break;
+                default:
+                        ret = RPC_RET_INVALID_ARG;
+                        break;
+                }
+
+                if (ret != RPC_RET_OK) {
+                        /* Don't leave a half-built call behind */
+                        batch->count--;
+                        batch->blocks_size = blocks_size;
+
+                        return ret;
+                }
+        }
+
+        return RPC_RET_OK;
+}
+
+static rpc_ret_t
+_results_wait(rpc_batch_t *batch, uint32_t entries_address, uint32_t timeout_ms)
+{
+        const uint32_t entries_size = batch->count * RPC_ENTRY_SIZE;
+        const uint32_t size = entries_size + RPC_TRAILER_SIZE;
+
+        const uint64_t start_time = timer_us_get();
+
+        uint32_t interval;
+        interval = RPC_POLL_INTERVAL_MIN;
+
+        rpc_ret_t ret;
+        ret = RPC_RET_TIMEOUT;
+
+        shell_interrupt_begin();
+
+        /* The results come along with the response sequence number, so the
+         * last poll is also the download */
+        while (!(shell_interrupted())) {
+                if ((device_read(_state.transfer, entries_address, size)) != DEVICE_RET_OK) {
+                        ret = RPC_RET_ERROR;
+                        break;
+                }
+
+                const uint32_t response_seq =
+                    device_be32_get(&_state.transfer[entries_size + 8]);
+
+                if (response_seq == _state.seq) {
+                        ret = RPC_RET_OK;
+                        break;
+                }
+
+                if ((timer_us_get() - start_time) >= ((uint64_t)timeout_ms * 1000)) {
+                        break;
+                }
+
+                timer_sleep(interval);
+
+                interval = (interval * 2);
+                interval = (interval < RPC_POLL_INTERVAL_MAX) ? interval : RPC_POLL_INTERVAL_MAX;
+        }
+
+        if ((ret == RPC_RET_TIMEOUT) && (shell_interrupted())) {
+                ret = RPC_RET_INTERRUPTED;
+        }
+
+        shell_interrupt_end();
+
+        if (ret != RPC_RET_OK) {
+                return ret;
+        }
+
+        for (uint32_t i = 0; i < batch->count; i++) {
+                const uint8_t * const entry = &_state.transfer[i * RPC_ENTRY_SIZE];
+
+                batch->calls[i].result = device_be32_get(&entry[0x18]);
+        }
+
+        return RPC_RET_OK;
+}
+
+rpc_ret_t
+rpc_batch_run(rpc_batch_t *batch, uint32_t timeout_ms)
+{
+        assert(batch != NULL);
+
+        if (!_state.attached) {
+                return RPC_RET_NOT_ATTACHED;
+        }
+
+        if (batch->count == 0) {
+                return RPC_RET_EMPTY;
+        }
+
+        const uint32_t entries_size = batch->count * RPC_ENTRY_SIZE;
+
+        /* Everything but the response sequence number goes over */
+        const uint32_t size =
+            batch->blocks_size + entries_size + RPC_TRAILER_SIZE - 4;
+
+        if ((size + 4) > _state.area_size) {
+                return RPC_RET_TOO_LARGE;
+        }
+
+        const uint32_t area_end =
+            _state.mailbox_address + RPC_HEADER_SIZE + _state.area_size;
+        const uint32_t entries_address = area_end - RPC_TRAILER_SIZE - entries_size;
+        const uint32_t blocks_address = entries_address - batch->blocks_size;
+
+        uint8_t *p;
+        p = _state.transfer;
+
+        (void)memcpy(p, batch->blocks, batch->blocks_size);
+        p += batch->blocks_size;
+
+        for (uint32_t i = 0; i < batch->count; i++) {
+                const rpc_call_t * const call = &batch->calls[i];
+
+                device_be32_put(&p[0x00], call->address);
+                device_be32_put(&p[0x04], call->argc);
+
+                for (uint32_t j = 0; j < RPC_ARGS_MAX; j++) {
+                        uint32_t arg;
+                        arg = (j < call->argc) ? call->args[j] : 0;
+
+                        if ((call->block_mask & (1 << j)) != 0) {
+                                arg += blocks_address;
+                        }
+
+                        device_be32_put(&p[0x08 + (j * 4)], arg);
+                }
+
+                device_be32_put(&p[0x18], 0);
+                device_be32_put(&p[0x1C], 0);
+
+                p += RPC_ENTRY_SIZE;
+        }
+
+        _state.seq++;
+
+        device_be32_put(&p[0], batch->count);
+        device_be32_put(&p[4], _state.seq);
+
+        if ((device_write(_state.transfer, blocks_address, size)) != DEVICE_RET_OK) {
+                return RPC_RET_ERROR;
+        }
+
+        return _results_wait(batch, entries_address, timeout_ms);
+}
+
+const char *
+rpc_ret_string(rpc_ret_t ret)
+{
+        switch (ret) {
+        case RPC_RET_OK:
+                return "OK";
+        case RPC_RET_NOT_ATTACHED:
+                return "No stub attached. Use \"call stub <mailbox-address>\"";
+        case RPC_RET_INVALID_MAGIC:
+                return "No stub mailbox found";
+        case RPC_RET_INVALID_MAILBOX:
+                return "Stub mailbox is too small, or its size isn't a multiple of 4";
+        case RPC_RET_TOO_MANY_ARGS:
+                return "Too many arguments (4 at most)";
+        case RPC_RET_INVALID_ARG:
+                return "Expected an address followed by integers or strings";
+        case RPC_RET_UNDEFINED_SYMBOL:
+                return "Undefined symbol";
+        case RPC_RET_TOO_LARGE:
+                return "Batch doesn't fit in the stub's mailbox";
+        case RPC_RET_EMPTY:
+                return "Batch is empty";
+        case RPC_RET_TIMEOUT:
+                return "Timed out waiting for the stub";
+        case RPC_RET_INTERRUPTED:
+                return "Interrupted";
+        default:
+                return "Error";
+        }
+}
@@ -0,0 +1,99 @@
+#ifndef RPC_H
+#define RPC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "object.h"
+
+/*
+ * Layout of the resident stub's mailbox in target RAM (all fields
+ * big-endian):
+ *
+ *   0x00 uint32_t magic           RPC_MAGIC, written by the stub
+ *   0x04 uint32_t size            Size of area[], written by the stub
+ *   0x08 uint8_t  area[size]
+ *
+ * The host packs a batch against the end of area[], so that it goes over in
+ * a single transfer that ends with the request sequence number:
+ *
+ *        ...      blocks          Argument blocks, 4-byte aligned
+ *        rpc_entry_t entries[count]
+ *   -12  uint32_t count
+ *    -8  uint32_t request_seq     Written by the host, last
+ *    -4  uint32_t response_seq    Written by the stub once all calls are done
+ *
+ * Each entry is:
+ *
+ *   0x00 uint32_t address         Function to call
+ *   0x04 uint32_t argc
+ *   0x08 uint32_t args[4]         Passed in R4 to R7
+ *   0x18 int32_t  result          R0, written by the stub
+ *   0x1C uint32_t reserved
+ *
+ * The entries, the trailer and the results are read back in one transfer */
+
+#define RPC_MAGIC               0x43414C4C /* "CALL" */
+
+#define RPC_HEADER_SIZE         0x08
+#define RPC_TRAILER_SIZE        0x0C
+#define RPC_ENTRY_SIZE          0x20
+
+#define RPC_ARGS_MAX            4
+
+#define RPC_CALLS_MAX           1024
+#define RPC_BLOCKS_SIZE_MAX     0x10000
+
+#define RPC_TIMEOUT_DEFAULT     5000
+
+typedef enum {
+        RPC_RET_OK,
+        RPC_RET_NOT_ATTACHED,
+        RPC_RET_INVALID_MAGIC,
+        RPC_RET_INVALID_MAILBOX,
+        RPC_RET_TOO_MANY_ARGS,
+        RPC_RET_INVALID_ARG,
+        RPC_RET_UNDEFINED_SYMBOL,
+        RPC_RET_TOO_LARGE,
+        RPC_RET_EMPTY,
+        RPC_RET_TIMEOUT,
+        RPC_RET_INTERRUPTED,
+        RPC_RET_ERROR,
+} rpc_ret_t;
+
+typedef struct {
+        uint32_t address;
+        uint32_t argc;
+        uint32_t args[RPC_ARGS_MAX];
+
+        /* Bit n is set if args[n] is an offset into the argument blocks */
+        uint32_t block_mask;
+
+        int32_t result;
+} rpc_call_t;
+
+typedef struct {
+        rpc_call_t *calls;
+        uint32_t count;
+
+        uint8_t *blocks;
+        uint32_t blocks_size;
+} rpc_batch_t;
+
+rpc_ret_t rpc_attach(uint32_t mailbox_address);
+bool rpc_attached(uint32_t *mailbox_address);
+
+rpc_batch_t *rpc_batch_new(void);
+void rpc_batch_delete(rpc_batch_t *batch);
+
+void rpc_batch_clear(rpc_batch_t *batch);
+rpc_ret_t rpc_batch_call_add(rpc_batch_t *batch, uint32_t address);
+rpc_ret_t rpc_batch_arg_add(rpc_batch_t *batch, uint32_t value);
+rpc_ret_t rpc_batch_arg_block_add(rpc_batch_t *batch, const void *data, size_t size);
+rpc_ret_t rpc_batch_objects_add(rpc_batch_t *batch, object_t * const *objs, int count);
+rpc_ret_t rpc_batch_run(rpc_batch_t *batch, uint32_t timeout_ms);
+
+const char *rpc_ret_string(rpc_ret_t ret);
+
+#endif /* RPC_H */
@@ -0,0 +1,190 @@
+#include <assert.h>
+
+#include "sh2.h"
+
+/* Generated at build time by tools/sh2-table.py */
+#include "sh2-table.h"
+
+#define SH2_MNEMONIC_WIDTH      8
+
+static const char _hex_digits[] = "0123456789ABCDEF";
+
+static char *
+_hex_put(char *p, uint32_t value, uint32_t digits)
+{
+        *p++ = '0';
+        *p++ = 'x';
+
+        for (int32_t shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+                *p++ = _hex_digits[(value >> shift) & 0x0F];
+        }
+
+        return p;
+}
+
+static char *
+_decimal_put(char *p, int32_t value)
+{
+        char digits[12];
+        uint32_t count;
+        count = 0;
+
+        uint32_t magnitude;
+        magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+
+        if (value < 0) {
+                *p++ = '-';
+        }
+
+        do {
+                digits[count] = '0' + (magnitude % 10);
+                count++;
+                magnitude /= 10;
+        } while (magnitude != 0);
+
+        while (count > 0) {
+                count--;
+                *p++ = digits[count];
+        }
+
+        return p;
+}
+
+static char *
+_register_put(char *p, uint32_t n)
+{
+        *p++ = 'r';
+
+        if (n >= 10) {
+                *p++ = '1';
+        }
+
+        *p++ = '0' + (n % 10);
+
+        return p;
+}
+
+static char *
+_literal_put(char *p, uint32_t address)
+{
+        *p++ = '@';
+        *p++ = '(';
+        p = _hex_put(p, address, 8);
+        *p++ = ')';
+
+        return p;
+}
+
+size_t
+sh2_format(char *buffer, uint32_t address, uint16_t opcode, sh2_ref_t *ref)
+{
+        assert(buffer != NULL);
+        assert(ref != NULL);
+
+        const sh2_format_t * const format = &_sh2_formats[_sh2_decode[opcode]];
+
+        const uint32_t n = (opcode >> 8) & 0x0F;
+        const uint32_t m = (opcode >> 4) & 0x0F;
+        const uint32_t d4 = opcode & 0x0F;
+        const uint32_t d8 = opcode & 0xFF;
+        const int32_t i8 = (int8_t)d8;
+        const int32_t d12 = ((int32_t)((opcode & 0xFFF) << 20)) >> 20;
+
+        ref->type = SH2_REF_NONE;
+
+        char *p;
+        p = buffer;
+
+        const char *s;
+
+        for (s = format->mnemonic; *s != '\0'; s++) {
+                *p++ = *s;
+        }
+
+        if (*format->operands == '\0') {
+                *p = '\0';
+
+                return p - buffer;
+        }
+
+        while ((p - buffer) < SH2_MNEMONIC_WIDTH) {
+                *p++ = ' ';
+        }
+
+        for (s = format->operands; *s != '\0'; s++) {
+                if (*s != '%') {
+                        *p++ = *s;
+
+                        continue;
+                }
+
+                s++;
+
+                switch (*s) {
+                case 'n':
+                        p = _register_put(p, n);
+                        break;
+                case 'm':
+                        p = _register_put(p, m);
+                        break;
+                case 'i':
+                        p = _decimal_put(p, i8);
+                        break;
+                case 'u':
+                        p = _hex_put(p, d8, 2);
+                        break;
+                case 'b':
+                        p = _decimal_put(p, d4);
+                        break;
+                case 'w':
+                        p = _decimal_put(p, d4 * 2);
+                        break;
+                case 'l':
+                        p = _decimal_put(p, d4 * 4);
+                        break;
+                case 'B':
+                        p = _decimal_put(p, d8);
+                        break;
+                case 'W':
+                        p = _decimal_put(p, d8 * 2);
+                        break;
+                case 'L':
+                        p = _decimal_put(p, d8 * 4);
+                        break;
+                case 'j':
+                        ref->type = SH2_REF_CODE;
+                        ref->address = address + 4 + (i8 * 2);
+                        p = _hex_put(p, ref->address, 8);
+                        break;
+                case 'J':
+                        ref->type = SH2_REF_CODE;
+                        ref->address = address + 4 + (d12 * 2);
+                        p = _hex_put(p, ref->address, 8);
+                        break;
+                case 'p':
+                        ref->type = SH2_REF_WORD;
+                        ref->address = address + 4 + (d8 * 2);
+                        p = _literal_put(p, ref->address);
+                        break;
+                case 'P':
+                        ref->type = SH2_REF_LONG;
+                        ref->address = (address & ~3u) + 4 + (d8 * 4);
+                        p = _literal_put(p, ref->address);
+                        break;
+                case 'A':
+                        ref->type = SH2_REF_ADDRESS;
+                        ref->address = (address & ~3u) + 4 + (d8 * 4);
+                        p = _literal_put(p, ref->address);
+                        break;
+                case 'o':
+                        p = _hex_put(p, opcode, 4);
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        *p = '\0';
+
+        return p - buffer;
+}
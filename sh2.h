@@ -0,0 +1,34 @@
+#ifndef SH2_H
+#define SH2_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Longest text sh2_format() produces, without the terminator */
+#define SH2_TEXT_MAX            48
+
+typedef enum {
+        SH2_REF_NONE,
+        /* Branch target */
+        SH2_REF_CODE,
+        /* Address of a PC-relative literal */
+        SH2_REF_WORD,
+        SH2_REF_LONG,
+        /* Address computed by mova */
+        SH2_REF_ADDRESS,
+} sh2_ref_type_t;
+
+/* The address an instruction refers to, if it can be known statically */
+typedef struct {
+        sh2_ref_type_t type;
+        uint32_t address;
+} sh2_ref_t;
+
+typedef struct {
+        const char *mnemonic;
+        const char *operands;
+} sh2_format_t;
+
+size_t sh2_format(char *buffer, uint32_t address, uint16_t opcode, sh2_ref_t *ref);
+
+#endif /* SH2_H */
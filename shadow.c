@@ -0,0 +1,233 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shadow.h"
+
+#define SHADOW_CAPACITY_INIT    1024
+
+/* Cache-through and cached mirrors of the same RAM share one entry */
+#define SHADOW_ADDRESS_MASK     0x07FFFFFF
+
+typedef struct {
+        /* Block number plus one, so that zero marks an empty slot */
+        uint32_t key;
+        uint64_t hash;
+} shadow_entry_t;
+
+static struct {
+        shadow_entry_t *entries;
+        uint32_t capacity;
+        uint32_t count;
+} _shadow;
+
+static uint32_t
+_key_get(uint32_t address)
+{
+        return ((address & SHADOW_ADDRESS_MASK) / SHADOW_BLOCK_SIZE) + 1;
+}
+
+static uint32_t
+_key_hash(uint32_t key)
+{
+        return key * 2654435761u;
+}
+
+static shadow_entry_t *
+_entry_find(uint32_t key, bool insert)
+{
+        if (_shadow.entries == NULL) {
+                return NULL;
+        }
+
+        const uint32_t mask = _shadow.capacity - 1;
+
+        uint32_t i;
+        i = _key_hash(key) & mask;
+
+        while (_shadow.entries[i].key != 0) {
+                if (_shadow.entries[i].key == key) {
+                        return &_shadow.entries[i];
+                }
+
+                i = (i + 1) & mask;
+        }
+
+        return insert ? &_shadow.entries[i] : NULL;
+}
+
+static void
+_entry_remove(shadow_entry_t *entry)
+{
+        /* Backward shift deletion, so lookups never need tombstones */
+        const uint32_t mask = _shadow.capacity - 1;
+
+        uint32_t i;
+        i = entry - _shadow.entries;
+
+        uint32_t j;
+        j = i;
+
+        while (true) {
+                j = (j + 1) & mask;
+
+                if (_shadow.entries[j].key == 0) {
+                        break;
+                }
+
+                const uint32_t k = _key_hash(_shadow.entries[j].key) & mask;
+
+                /* Move the entry at j back to i unless its home slot lies
+                 * cyclically within (i, j] */
+                if (((j > i) && ((k <= i) || (k > j))) ||
+                    ((j < i) && ((k <= i) && (k > j)))) {
+                        _shadow.entries[i] = _shadow.entries[j];
+                        i = j;
+                }
+        }
+
+        _shadow.entries[i].key = 0;
+        _shadow.count--;
+}
+
+static bool
+_grow(void)
+{
+        shadow_entry_t * const old_entries = _shadow.entries;
+        const uint32_t old_capacity = _shadow.capacity;
+
+        const uint32_t capacity =
+            (old_capacity == 0) ? SHADOW_CAPACITY_INIT : (old_capacity * 2);
+
+        shadow_entry_t * const entries = calloc(capacity, sizeof(shadow_entry_t));
+
+        if (entries == NULL) {
+                return false;
+        }
+
+        _shadow.entries = entries;
+        _shadow.capacity = capacity;
+
+        for (uint32_t i = 0; i < old_capacity; i++) {
+                if (old_entries[i].key != 0) {
+                        *_entry_find(old_entries[i].key, true) = old_entries[i];
+                }
+        }
+
+        free(old_entries);
+
+        return true;
+}
+
+void
+shadow_init(void)
+{
+        _shadow.entries = NULL;
+        _shadow.capacity = 0;
+        _shadow.count = 0;
+}
+
+void
+shadow_deinit(void)
+{
+        free(_shadow.entries);
+
+        shadow_init();
+}
+
+uint64_t
+shadow_hash(const void *buffer, size_t size)
+{
+        const uint8_t *p;
+        p = buffer;
+
+        uint64_t hash;
+        hash = 0x9E3779B97F4A7C15ull ^ size;
+
+        while (size >= 8) {
+                uint64_t word;
+                (void)memcpy(&word, p, sizeof(word));
+
+                hash ^= word;
+                hash *= 0xFF51AFD7ED558CCDull;
+                hash ^= hash >> 32;
+
+                p += 8;
+                size -= 8;
+        }
+
+        while (size > 0) {
+                hash ^= *p;
+                hash *= 0x100000001B3ull;
+
+                p++;
+                size--;
+        }
+
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 33;
+
+        return hash;
+}
+
+bool
+shadow_block_matches(uint32_t address, uint64_t hash)
+{
+        assert((address % SHADOW_BLOCK_SIZE) == 0);
+
+        const shadow_entry_t * const entry = _entry_find(_key_get(address), false);
+
+        return (entry != NULL) && (entry->hash == hash);
+}
+
+void
+shadow_block_set(uint32_t address, uint64_t hash)
+{
+        assert((address % SHADOW_BLOCK_SIZE) == 0);
+
+        if (((_shadow.count + 1) * 2) > _shadow.capacity) {
+                if (!(_grow())) {
+                        return;
+                }
+        }
+
+        const uint32_t key = _key_get(address);
+        shadow_entry_t * const entry = _entry_find(key, true);
+
+        if (entry->key == 0) {
+                entry->key = key;
+                _shadow.count++;
+        }
+
+        entry->hash = hash;
+}
+
+void
+shadow_invalidate(uint32_t address, size_t size)
+{
+        if ((size == 0) || (_shadow.count == 0)) {
+                return;
+        }
+
+        const uint32_t first = address & ~(uint32_t)(SHADOW_BLOCK_SIZE - 1);
+        const uint64_t end = (uint64_t)address + size;
+
+        for (uint64_t block = first; block < end; block += SHADOW_BLOCK_SIZE) {
+                shadow_entry_t * const entry = _entry_find(_key_get(block), false);
+
+                if (entry != NULL) {
+                        _entry_remove(entry);
+                }
+        }
+}
+
+void
+shadow_clear(void)
+{
+        if (_shadow.entries != NULL) {
+                (void)memset(_shadow.entries, 0, _shadow.capacity * sizeof(shadow_entry_t));
+        }
+
+        _shadow.count = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Host-side record of what was last uploaded to target RAM, one hash per
+ * aligned block. It's used to skip blocks that haven't changed since */
+
+#define SHADOW_BLOCK_SIZE       0x1000
+
+void shadow_init(void);
+void shadow_deinit(void);
+
+uint64_t shadow_hash(const void *buffer, size_t size);
+
+bool shadow_block_matches(uint32_t address, uint64_t hash);
+void shadow_block_set(uint32_t address, uint64_t hash);
+void shadow_invalidate(uint32_t address, size_t size);
+void shadow_clear(void);
+
+#endif /* SHADOW_H */
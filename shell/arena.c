@@ -0,0 +1,106 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+struct arena_chunk {
+        arena_chunk_t *next;
+        size_t size;
+
+        max_align_t data[];
+};
+
+static arena_chunk_t *
+_chunk_new(size_t size, arena_chunk_t *next)
+{
+        arena_chunk_t * const chunk = malloc(sizeof(arena_chunk_t) + size);
+        assert(chunk != NULL);
+
+        chunk->next = next;
+        chunk->size = size;
+
+        return chunk;
+}
+
+static void
+_chunks_free(arena_chunk_t *chunk)
+{
+        while (chunk != NULL) {
+                arena_chunk_t * const next = chunk->next;
+
+                free(chunk);
+
+                chunk = next;
+        }
+}
+
+arena_t *
+arena_new(size_t size)
+{
+        assert(size > 0);
+
+        arena_t * const arena = malloc(sizeof(arena_t));
+        assert(arena != NULL);
+
+        arena->chunk = _chunk_new(size, NULL);
+        arena->offset = 0;
+
+        return arena;
+}
+
+void
+arena_delete(arena_t *arena)
+{
+        if (arena == NULL) {
+                return;
+        }
+
+        _chunks_free(arena->chunk);
+
+        free(arena);
+}
+
+void *
+arena_alloc(arena_t *arena, size_t size)
+{
+        const size_t align = _Alignof(max_align_t);
+
+        size = (size + align - 1) & ~(align - 1);
+
+        if ((arena->offset + size) > arena->chunk->size) {
+                const size_t chunk_size = arena->chunk->size * 2;
+
+                arena->chunk = _chunk_new((size > chunk_size) ? size : chunk_size,
+                    arena->chunk);
+                arena->offset = 0;
+        }
+
+        void * const p = (uint8_t *)arena->chunk->data + arena->offset;
+
+        arena->offset += size;
+
+        return p;
+}
+
+void
+arena_reset(arena_t *arena)
+{
+        arena->offset = 0;
+
+        if (arena->chunk->next == NULL) {
+                return;
+        }
+
+        /* Replace the chain with one chunk that holds as much */
+        size_t size;
+        size = 0;
+
+        for (const arena_chunk_t *chunk = arena->chunk; chunk != NULL; chunk = chunk->next) {
+                size += chunk->size;
+        }
+
+        _chunks_free(arena->chunk);
+
+        arena->chunk = _chunk_new(size, NULL);
+}
@@ -0,0 +1,26 @@
+#ifndef SHELL_ARENA_H
+#define SHELL_ARENA_H
+
+#include <stddef.h>
+
+/* A bump allocator. Allocations are never freed individually; the whole
+ * arena is reset at once.
+ *
+ * When an allocation doesn't fit, another chunk is chained on. The next
+ * reset folds the chunks into one big enough for all of them, so an arena
+ * that's reset regularly settles on a single chunk and stops allocating */
+
+typedef struct arena_chunk arena_chunk_t;
+
+typedef struct {
+        arena_chunk_t *chunk;
+        size_t offset;
+} arena_t;
+
+arena_t *arena_new(size_t size);
+void arena_delete(arena_t *arena);
+
+void *arena_alloc(arena_t *arena, size_t size);
+void arena_reset(arena_t *arena);
+
+#endif /* !SHELL_ARENA_H */
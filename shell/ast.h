@@ -0,0 +1,65 @@
+#ifndef SHELL_AST_H
+#define SHELL_AST_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+/* A parsed line. The line itself is a form: its head names a command, and
+ * the rest are its arguments. An argument is either an object (an integer,
+ * a string, or a symbol), or a form in parentheses. A form's head is either
+ * an operator, a command, or something bound in the environment.
+ *
+ * A macro's body is a copy of the forms it was defined with. Its parameters
+ * are replaced by the index of the argument they stand for, and consecutive
+ * uploads are grouped so they can go over together */
+
+typedef enum {
+        AST_OPERATOR_NONE,
+        AST_OPERATOR_ADD,
+        AST_OPERATOR_SUB,
+        AST_OPERATOR_MUL,
+        AST_OPERATOR_DIV,
+        AST_OPERATOR_MOD,
+        AST_OPERATOR_AND,
+        AST_OPERATOR_OR,
+        AST_OPERATOR_XOR,
+        AST_OPERATOR_SHL,
+        AST_OPERATOR_SHR
+} ast_operator_t;
+
+typedef enum {
+        AST_NODE_OBJECT,
+        AST_NODE_FORM,
+        /* Only in macro bodies */
+        AST_NODE_PARAM,
+        AST_NODE_TRANSFERS
+} ast_node_type_t;
+
+typedef struct ast_node ast_node_t;
+
+struct ast_node {
+        ast_node_type_t type;
+
+        /* Objects only */
+        object_t *object;
+
+        /* Parameters only. Which of the macro's arguments it stands for */
+        uint32_t index;
+
+        /* Forms only. Unless the head is an operator, it's resolved to what
+         * its name is bound to when the line is parsed. If nothing is bound
+         * to it then, it's left NULL. The empty form has no name */
+        const char *name;
+        ast_operator_t operator;
+        const object_t *head;
+
+        /* Transfers hold the uploads they group as arguments */
+        ast_node_t *args;
+        uint32_t argc;
+
+        /* Next argument of the enclosing form */
+        ast_node_t *next;
+};
+
+#endif /* !SHELL_AST_H */
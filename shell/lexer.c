@@ -8,20 +8,83 @@
 
 #include "lexer.h"
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
 const char *token_type_names[] = {
         "LEXER_TOK_ERROR",
         "LEXER_TOK_INTEGER",
         "LEXER_TOK_STRING",
         "LEXER_TOK_SYMBOL",
+        "LEXER_TOK_LPAREN",
+        "LEXER_TOK_RPAREN",
         "LEXER_TOK_EOF"
 };
 
-static const char *_symbol_chars = "!&*+-0123456789<=>?@"
-                                   "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                                   "abcdefghijklmnopqrstuvwxyz";
+#define CLASS_SPACE             0x01
+#define CLASS_DIGIT             0x02
+#define CLASS_HEX               0x04
+#define CLASS_SYMBOL_START      0x08
+#define CLASS_SYMBOL            0x10
+/* Characters that make a leading '-' part of a symbol ("-main") rather than
+ * a symbol of its own */
+#define CLASS_MINUS_SYMBOL      0x20
+/* Parentheses end any token, as whitespace does */
+#define CLASS_PAREN             0x40
+
+#define CLASS_LETTER            (CLASS_SYMBOL_START | CLASS_SYMBOL | CLASS_MINUS_SYMBOL)
+
+/* Consecutive characters of the same class, without GNU range
+ * designators */
+#define CLASS_RANGE_2(c, v)     [(c)] = (v), [(c) + 1] = (v)
+#define CLASS_RANGE_4(c, v)     CLASS_RANGE_2(c, v), CLASS_RANGE_2((c) + 2, v)
+#define CLASS_RANGE_8(c, v)     CLASS_RANGE_4(c, v), CLASS_RANGE_4((c) + 4, v)
+#define CLASS_RANGE_16(c, v)    CLASS_RANGE_8(c, v), CLASS_RANGE_8((c) + 8, v)
+
+static const uint8_t _char_classes[256] = {
+        ['\0']        = CLASS_SPACE,
+        ['\t']        = CLASS_SPACE,
+        ['\n']        = CLASS_SPACE,
+        ['\r']        = CLASS_SPACE,
+        [' ']         = CLASS_SPACE,
+        /* '0' to '9' */
+        CLASS_RANGE_8('0', CLASS_DIGIT | CLASS_HEX | CLASS_SYMBOL),
+        CLASS_RANGE_2('8', CLASS_DIGIT | CLASS_HEX | CLASS_SYMBOL),
+        /* 'A' to 'F', then 'G' to 'Z' */
+        CLASS_RANGE_4('A', CLASS_LETTER | CLASS_HEX),
+        CLASS_RANGE_2('E', CLASS_LETTER | CLASS_HEX),
+        CLASS_RANGE_16('G', CLASS_LETTER),
+        CLASS_RANGE_4('W', CLASS_LETTER),
+        /* 'a' to 'f', then 'g' to 'z' */
+        CLASS_RANGE_4('a', CLASS_LETTER | CLASS_HEX),
+        CLASS_RANGE_2('e', CLASS_LETTER | CLASS_HEX),
+        CLASS_RANGE_16('g', CLASS_LETTER),
+        CLASS_RANGE_4('w', CLASS_LETTER),
+        ['*']         = CLASS_SYMBOL_START | CLASS_SYMBOL | CLASS_MINUS_SYMBOL,
+        ['+']         = CLASS_SYMBOL_START | CLASS_SYMBOL | CLASS_MINUS_SYMBOL,
+        ['<']         = CLASS_SYMBOL_START | CLASS_SYMBOL | CLASS_MINUS_SYMBOL,
+        ['=']         = CLASS_SYMBOL_START | CLASS_SYMBOL | CLASS_MINUS_SYMBOL,
+        ['>']         = CLASS_SYMBOL_START | CLASS_SYMBOL | CLASS_MINUS_SYMBOL,
+        ['/']         = CLASS_SYMBOL_START | CLASS_MINUS_SYMBOL,
+        ['&']         = CLASS_SYMBOL_START | CLASS_SYMBOL,
+        ['.']         = CLASS_SYMBOL_START | CLASS_SYMBOL,
+        ['?']         = CLASS_SYMBOL_START | CLASS_SYMBOL,
+        ['_']         = CLASS_SYMBOL_START | CLASS_SYMBOL,
+        ['%']         = CLASS_SYMBOL_START | CLASS_SYMBOL,
+        ['|']         = CLASS_SYMBOL_START | CLASS_SYMBOL,
+        ['^']         = CLASS_SYMBOL_START,
+        ['(']         = CLASS_PAREN,
+        [')']         = CLASS_PAREN,
+        ['!']         = CLASS_SYMBOL,
+        ['-']         = CLASS_SYMBOL,
+        ['@']         = CLASS_SYMBOL
+};
 
 typedef enum {
         KEY_BEL =  7,
@@ -33,33 +96,269 @@ typedef enum {
         KEY_CR  = 13
 } escape_chars_t;
 
-static int
-_getc(lexer_t *l)
+static inline bool
+_char_is(const lexer_t *l, size_t pos, uint8_t char_class)
+{
+        return ((_char_classes[(uint8_t)l->line.buffer[pos]] & char_class) != 0);
+}
+
+/* End of the line counts as whitespace */
+static inline bool
+_char_is_delimiter(const lexer_t *l, size_t pos)
+{
+        return ((pos >= l->line.size) || (_char_is(l, pos, CLASS_SPACE | CLASS_PAREN)));
+}
+
+static size_t
+_space_skip(const lexer_t *l, size_t pos)
+{
+#if defined(__SSE2__)
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i lf = _mm_set1_epi8('\n');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i nul = _mm_setzero_si128();
+
+        while ((pos + 16) <= l->line.size) {
+                const __m128i chars =
+                    _mm_loadu_si128((const __m128i *)&l->line.buffer[pos]);
+
+                __m128i spaces;
+                spaces = _mm_or_si128(_mm_cmpeq_epi8(chars, space),
+                                      _mm_cmpeq_epi8(chars, tab));
+                spaces = _mm_or_si128(spaces, _mm_cmpeq_epi8(chars, lf));
+                spaces = _mm_or_si128(spaces, _mm_cmpeq_epi8(chars, cr));
+                spaces = _mm_or_si128(spaces, _mm_cmpeq_epi8(chars, nul));
+
+                const uint32_t non_spaces =
+                    ~(uint32_t)_mm_movemask_epi8(spaces) & 0xFFFF;
+
+                if (non_spaces != 0) {
+                        return (pos + __builtin_ctz(non_spaces));
+                }
+
+                pos += 16;
+        }
+#endif /* __SSE2__ */
+
+        while ((pos < l->line.size) && (_char_is(l, pos, CLASS_SPACE))) {
+                pos++;
+        }
+
+        return pos;
+}
+
+static void
+_token_end(lexer_t *l, token_t *token, token_type_t type, size_t pos)
+{
+        token->type = type;
+        token->column = pos;
+
+        if ((type == LEXER_TOK_SYMBOL) || (type == LEXER_TOK_ERROR)) {
+                token->length = pos - token->offset;
+        }
+
+        l->char_no = pos;
+}
+
+/* Consumes the offending character, so that it's part of the error token */
+static void
+_token_error(lexer_t *l, token_t *token, size_t pos)
+{
+        if (pos < l->line.size) {
+                pos++;
+        }
+
+        _token_end(l, token, LEXER_TOK_ERROR, pos);
+}
+
+static void
+_symbol_scan(lexer_t *l, token_t *token, size_t pos)
+{
+        while ((pos < l->line.size) && (_char_is(l, pos, CLASS_SYMBOL))) {
+                pos++;
+        }
+
+        _token_end(l, token, LEXER_TOK_SYMBOL, pos);
+}
+
+static void
+_integer_scan(lexer_t *l, token_t *token, size_t pos, bool negative)
 {
-        if (l->line.size == 0) {
-                return EOF;
+        uint32_t value;
+        value = 0;
+
+        for (; !(_char_is_delimiter(l, pos)); pos++) {
+                if (!(_char_is(l, pos, CLASS_DIGIT))) {
+                        _token_error(l, token, pos);
+                        return;
+                }
+
+                value = (value * 10) + (l->line.buffer[pos] - '0');
+        }
+
+        token->integer = (negative) ? -(int)value : (int)value;
+
+        _token_end(l, token, LEXER_TOK_INTEGER, pos);
+}
+
+/* Takes "0x1F", "#x1F", and "#1F". Without an 'x', a leading zero reads as
+ * decimal ("010" is ten) */
+static void
+_integer_base16_scan(lexer_t *l, token_t *token, size_t pos)
+{
+        const bool prefix_zero = (l->line.buffer[token->offset] == '0');
+
+        bool base16;
+        base16 = !prefix_zero;
+
+        while ((pos < l->line.size) &&
+               ((l->line.buffer[pos] == 'x') || (l->line.buffer[pos] == 'X'))) {
+                base16 = true;
+                pos++;
+        }
+
+        /* A zero on its own is just zero */
+        if (prefix_zero && !base16 && (_char_is_delimiter(l, pos))) {
+                _token_end(l, token, LEXER_TOK_INTEGER, pos);
+                return;
+        }
+
+        /* At least one digit has to follow the prefix */
+        if ((pos >= l->line.size) || !(_char_is(l, pos, CLASS_HEX))) {
+                _token_error(l, token, pos);
+                return;
         }
 
-        if (l->char_no >= l->line.size) {
-                return EOF;
+        uint32_t value;
+        value = 0;
+
+        bool decimal;
+        decimal = true;
+
+        for (; !(_char_is_delimiter(l, pos)); pos++) {
+                const char c = l->line.buffer[pos];
+
+                if (!(_char_is(l, pos, CLASS_HEX))) {
+                        _token_error(l, token, pos);
+                        return;
+                }
+
+                if (base16) {
+                        const uint32_t digit = (c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10);
+
+                        value = (value << 4) | digit;
+                } else if (decimal && (_char_is(l, pos, CLASS_DIGIT))) {
+                        value = (value * 10) + (c - '0');
+                } else {
+                        decimal = false;
+                }
+        }
+
+        token->integer = (int)value;
+
+        _token_end(l, token, LEXER_TOK_INTEGER, pos);
+}
+
+/* Supports all C escape sequences except for hex and octal. Decoding stops
+ * at the closing quote. With no destination, the string is only measured.
+ * Returns the position after the closing quote, or zero if there is none */
+static size_t
+_string_decode(const lexer_t *l, size_t pos, char *dst, size_t *length)
+{
+        const char * const buffer = l->line.buffer;
+
+        size_t dst_pos;
+        dst_pos = 0;
+
+#define DST_PUT(c) do {                                                        \
+        if (dst != NULL) {                                                     \
+                dst[dst_pos] = (c);                                            \
+        }                                                                      \
+        dst_pos++;                                                             \
+} while (false)
+
+        while (pos < l->line.size) {
+                char c;
+                c = buffer[pos++];
+
+                if (c == '\"') {
+                        *length = dst_pos;
+
+                        return pos;
+                }
+
+                if (c != '\\') {
+                        DST_PUT(c);
+                        continue;
+                }
+
+                if (pos >= l->line.size) {
+                        break;
+                }
+
+                c = buffer[pos++];
+
+                switch (c) {
+                case '\n':
+                        /* Ignore escaped line feeds */
+                        break;
+                case '\\':
+                case '"':
+                        DST_PUT(c);
+                        break;
+                case 'a':
+                        DST_PUT(KEY_BEL);
+                        break;
+                case 'b':
+                        DST_PUT(KEY_BS);
+                        break;
+                case 'f':
+                        DST_PUT(KEY_FF);
+                        break;
+                case 'n':
+                        DST_PUT(KEY_LF);
+                        break;
+                case 'r':
+                        DST_PUT(KEY_CR);
+                        break;
+                case 't':
+                        DST_PUT(KEY_HT);
+                        break;
+                case 'v':
+                        DST_PUT(KEY_VT);
+                        break;
+                default:
+                        /* Invalid escape sequence. Keep the sequence as is */
+                        DST_PUT('\\');
+                        pos--;
+                        break;
+                }
         }
 
-        char c = l->line.buffer[l->char_no];
-        l->char_no++;
+#undef DST_PUT
 
-        return c;
+        return 0;
 }
 
-static int
-_ungetc(lexer_t *l, int c)
+static void
+_string_scan(lexer_t *l, token_t *token, size_t pos)
 {
-        if (l->char_no == 0) {
-                return EOF;
+        size_t length;
+        length = 0;
+
+        const size_t end = _string_decode(l, pos, NULL, &length);
+
+        if (end == 0) {
+                /* Unterminated string */
+                _token_end(l, token, LEXER_TOK_ERROR, l->line.size);
+                return;
         }
 
-        l->char_no--;
+        token->offset = pos;
+        token->length = length;
 
-        return c;
+        _token_end(l, token, LEXER_TOK_STRING, end);
 }
 
 lexer_t *
@@ -72,7 +371,6 @@ lexer_new(void)
                         .buffer = NULL,
                         .size   = 0
                 },
-                .state   = LEXER_STATE_ZERO,
                 .char_no = 0
         };
 
@@ -92,325 +390,84 @@ lexer_line_set(lexer_t *lexer, line_t line)
 {
         lexer->line = line;
         lexer->char_no = 0;
-        lexer->state = LEXER_STATE_ZERO;
 }
 
 void
-lexer_token_delete(token_t *t)
+lexer_token_get(lexer_t *l, token_t *token)
 {
-        if (t != NULL) {
-                switch(t->type) {
-                case LEXER_TOK_INTEGER:
-                case LEXER_TOK_EOF:
-                        break;
-                case LEXER_TOK_STRING:
-                case LEXER_TOK_ERROR:
-                case LEXER_TOK_SYMBOL:
-                        free(t->as.string);
-                        break;
-                }
+        const size_t pos = _space_skip(l, l->char_no);
+
+        *token = (token_t) {
+                .type    = LEXER_TOK_EOF,
+                .offset  = pos,
+                .length  = 0,
+                .integer = 0,
+                .column  = pos
+        };
 
-                free(t);
+        if (pos >= l->line.size) {
+                l->char_no = l->line.size;
+                return;
         }
-}
 
-static token_t *
-_token_make(const lexer_t *l, const token_type_t token_type, const char *buf)
-{
-        token_t *tok = (token_t *) malloc(sizeof(token_t));
-
-        if (tok != NULL) {
-                tok->type = token_type;
-                tok->column = l->char_no;
-
-                switch(token_type) {
-                case LEXER_TOK_INTEGER:
-                        if (((strchr(buf, 'x')) == (buf + 1)) ||
-                            ((strchr(buf, 'X')) == (buf + 1))) {
-                                /* Skip '0x','0X','#x','#X' */
-                                tok->as.integer = strtol(buf + 2, NULL, 16);
-                        } else {
-                                tok->as.integer = strtol(buf, NULL, 10);
-                        }
-                        break;
-                case LEXER_TOK_STRING:
-                case LEXER_TOK_ERROR:
-                case LEXER_TOK_SYMBOL:
-                        tok->as.string = strdup(buf);
-                        break;
-                case LEXER_TOK_EOF:
-                        tok->as.string = NULL;
-                        break;
+        const char c = l->line.buffer[pos];
+
+        switch (c) {
+        case '(':
+                _token_end(l, token, LEXER_TOK_LPAREN, pos + 1);
+                break;
+        case ')':
+                _token_end(l, token, LEXER_TOK_RPAREN, pos + 1);
+                break;
+        case '\"':
+                _string_scan(l, token, pos + 1);
+                break;
+        case '0':
+        case '#':
+                _integer_base16_scan(l, token, pos + 1);
+                break;
+        case '-':
+                /* This one is a little finicky since we want to allow for
+                 * symbols that start with a dash ("-main"), negative
+                 * numbers (-1), and the minus symbol itself */
+                if (_char_is_delimiter(l, pos + 1)) {
+                        _token_end(l, token, LEXER_TOK_SYMBOL, pos + 1);
+                } else if (_char_is(l, pos + 1, CLASS_DIGIT)) {
+                        _integer_scan(l, token, pos + 1, true);
+                } else if (_char_is(l, pos + 1, CLASS_MINUS_SYMBOL)) {
+                        _symbol_scan(l, token, pos + 1);
+                } else {
+                        _token_error(l, token, pos + 1);
                 }
+                break;
+        default:
+                /* '0' is taken care of above */
+                if (_char_is(l, pos, CLASS_DIGIT)) {
+                        _integer_scan(l, token, pos, false);
+                } else if (_char_is(l, pos, CLASS_SYMBOL_START)) {
+                        _symbol_scan(l, token, pos + 1);
+                } else {
+                        _token_error(l, token, pos);
+                }
+                break;
         }
-
-        return tok;
 }
 
-token_t *
-lexer_token_get(lexer_t *l)
+size_t
+lexer_token_string_copy(const lexer_t *l, const token_t *token, char *buffer)
 {
-        char buffer[1024] = { 0 };
-        size_t buffer_pos;
-        buffer_pos = 0;
-        int c;
-        char *pos;
-
-        while ((c = _getc(l)) != EOF) {
-                switch (l->state) {
-                case LEXER_STATE_ZERO:
-                        switch(c) {
-                        case '\"':
-                                /* Don't put c in the buffer */
-                                l->state = LEXER_STATE_STRING;
-                                break;
-                                /* Start number */
-                        case '0':
-                                buffer[buffer_pos++] = c;
-                                l->state = LEXER_STATE_NUMBER_PREFIX;
-                                break;
-                        case '1' ... '9':
-                                buffer[buffer_pos++] = c;
-                                l->state = LEXER_STATE_NUMBER;
-                                break;
-                                /* Start a symbol */
-                        case 'a' ... 'z':
-                        case 'A' ... 'Z':
-                        case '+':
-                        case '/':
-                        case '*':
-                        case '<':
-                        case '=':
-                        case '>':
-                        case '&':
-                        case '.':
-                        case '^':
-                        case '?':
-                                buffer[buffer_pos++] = c;
-                                l->state = LEXER_STATE_SYMBOL;
-                                break;
-                        case '-':
-                                buffer[buffer_pos++] = c;
-                                l->state = LEXER_STATE_MINUS;
-                                break;
-                        case '#':
-                                buffer[buffer_pos++] = c;
-                                l->state = LEXER_STATE_INTEGER_BASE16;
-                                break;
-                                /* Eat whitespace */
-                        case ' ':
-                        case '\r':
-                        case '\t':
-                        case '\n':
-                        case '\0':
-                                break;
-                        default:
-                                buffer[buffer_pos++] = c;
-                                return _token_make(l, LEXER_TOK_ERROR, buffer);
-                        }
-                        break;
-
-                case LEXER_STATE_MINUS:
-                        /* This one is a little finicky since we want to allow
-                         * for symbols that start with a dash ("-main"),
-                         * negative numbers (-1) */
-                        switch(c) {
-                        case '0' ... '9':
-                                buffer[buffer_pos++] = c;
-                                l->state = LEXER_STATE_NUMBER;
-                                break;
-                        case 'a' ... 'z':
-                        case 'A' ... 'Z':
-                        case '+':
-                        case '/':
-                        case '*':
-                        case '<':
-                        case '=':
-                        case '>':
-                                _ungetc(l, c);
-                                l->state = LEXER_STATE_SYMBOL;
-                                break;
-                                /* Minus symbol */
-                        case ' ':
-                        case '\r':
-                        case '\t':
-                                l->state = LEXER_STATE_ZERO;
-                                return _token_make(l, LEXER_TOK_SYMBOL, buffer);
-                        case '\n':
-                                l->state = LEXER_STATE_ZERO;
-                                return _token_make(l, LEXER_TOK_SYMBOL, buffer);
-                                /* Error */
-                        default:
-                                buffer[buffer_pos++] = c;
-                                return _token_make(l, LEXER_TOK_ERROR, buffer);
-
-                        }
-                        break;
-
-                case LEXER_STATE_INTEGER_BASE16:
-                        switch (c) {
-                        case 'x':
-                        case 'X':
-                                buffer[buffer_pos++] = c;
-                                break;
-                        case '0' ... '9':
-                        case 'a' ... 'f':
-                        case 'A' ... 'F':
-                                buffer[buffer_pos++] = c;
-                                l->state = LEXER_STATE_NUMBER_BASE16;
-                                break;
-                        default:
-                                buffer[buffer_pos++] = c;
-                                return _token_make(l, LEXER_TOK_ERROR, buffer);
-                        }
-                        break;
+        if (token->type != LEXER_TOK_STRING) {
+                (void)memcpy(buffer, &l->line.buffer[token->offset], token->length);
+                buffer[token->length] = '\0';
 
-                case LEXER_STATE_STRING:
-                        if (c != '\"') {
-                                if (c == '\\') {
-                                        l->state = LEXER_STATE_ESCAPE_STRING;
-                                        break;
-                                }
-                                buffer[buffer_pos++] = c;
-                        } else {
-                                /* don't put c in the buffer */
-                                l->state = LEXER_STATE_ZERO;
-                                return _token_make(l, LEXER_TOK_STRING, buffer);
-                        }
-                        break;
-
-                case LEXER_STATE_ESCAPE_STRING:
-                        /* Supports all C escape sequences except for hex and octal */
-                        switch(c) {
-                        case '\n':
-                                /* Ignore escaped line feeds */
-                                break;
-                        case '\\':
-                        case '"':
-                                /* Keep the char and go back to string processing */
-                                buffer[buffer_pos++] = c;
-                                break;
-                        case 'a':
-                                buffer[buffer_pos++] = KEY_BEL;
-                                break;
-                        case 'b':
-                                buffer[buffer_pos++] = KEY_BS;
-                                break;
-                        case 'f':
-                                buffer[buffer_pos++] = KEY_FF;
-                                break;
-                        case 'n':
-                                buffer[buffer_pos++] = KEY_LF;
-                                break;
-                        case 'r':
-                                buffer[buffer_pos++] = KEY_CR;
-                                break;
-                        case 't':
-                                buffer[buffer_pos++] = KEY_HT;
-                                break;
-                        case 'v':
-                                buffer[buffer_pos++] = KEY_VT;
-                                break;
-                        default:
-                                /* Invalid escape sequeence. Keep the sequence
-                                 * and go back to string processing */
-                                buffer[buffer_pos++] = '\\';
-                                _ungetc(l, c);
-                                break;
-                        }
-                        l->state = LEXER_STATE_STRING;
-                        break;
-
-                case LEXER_STATE_NUMBER_PREFIX:
-                        switch(c) {
-                        case 'x':
-                        case 'X':
-                                buffer[buffer_pos++] = c;
-                                break;
-                        case '0' ... '9':
-                        case 'a' ... 'f':
-                        case 'A' ... 'F':
-                                buffer[buffer_pos++] = c;
-                                l->state = LEXER_STATE_NUMBER_BASE16;
-                                break;
-                        default:
-                                /* Error */
-                                buffer[buffer_pos++] = c;
-                                return _token_make(l, LEXER_TOK_ERROR, buffer);
-                        }
-                        break;
+                return token->length;
+        }
 
-                case LEXER_STATE_NUMBER:
-                        switch(c) {
-                        case '\n':
-                        case '\t':
-                        case '\r':
-                        case ' ':
-                                l->state = LEXER_STATE_ZERO;
-                                return _token_make(l, LEXER_TOK_INTEGER, buffer);
-                        case '0' ... '9':
-                                buffer[buffer_pos++] = c;
-                                break;
-                        case '\0':
-                                l->state = LEXER_STATE_ZERO;
-                                return _token_make(l, LEXER_TOK_INTEGER, buffer);
-                        default:
-                                /* Error */
-                                buffer[buffer_pos++] = c;
-                                return _token_make(l, LEXER_TOK_ERROR, buffer);
-                        }
-                        break;
+        size_t length;
+        length = 0;
 
-                case LEXER_STATE_NUMBER_BASE16:
-                        switch(c) {
-                        case '\n':
-                        case '\t':
-                        case '\r':
-                        case ' ':
-                                l->state = LEXER_STATE_ZERO;
-                                return _token_make(l, LEXER_TOK_INTEGER, buffer);
-                        case '0' ... '9':
-                        case 'a' ... 'f':
-                        case 'A' ... 'F':
-                                buffer[buffer_pos++] = c;
-                                break;
-                        case '\0':
-                                l->state = LEXER_STATE_ZERO;
-                                return _token_make(l, LEXER_TOK_INTEGER, buffer);
-                        default:
-                                /* Error */
-                                buffer[buffer_pos++] = c;
-                                return _token_make(l, LEXER_TOK_ERROR, buffer);
-                        }
-                        break;
+        (void)_string_decode(l, token->offset, buffer, &length);
+        buffer[length] = '\0';
 
-                case LEXER_STATE_SYMBOL:
-                        pos = strchr(_symbol_chars, c);
-                        if (pos != NULL) {
-                                buffer[buffer_pos++] = c;
-                        } else {
-                                _ungetc(l, c);
-                                l->state = LEXER_STATE_ZERO;
-                                return _token_make(l, LEXER_TOK_SYMBOL, buffer);
-                        }
-                        break;
-
-                default:
-                        buffer[buffer_pos++] = c;
-                        return _token_make(l, LEXER_TOK_ERROR, buffer);
-                }
-        }
-        /* Acceptance states */
-        switch(l->state) {
-        case LEXER_STATE_ZERO:
-                return _token_make(l, LEXER_TOK_EOF, NULL);
-        case LEXER_STATE_NUMBER:
-                l->state = LEXER_STATE_ZERO;
-                return _token_make(l, LEXER_TOK_INTEGER, buffer);
-        case LEXER_STATE_SYMBOL:
-                l->state = LEXER_STATE_ZERO;
-                return _token_make(l, LEXER_TOK_SYMBOL, buffer);
-        default:
-                return _token_make(l, LEXER_TOK_ERROR, buffer);
-        }
+        return length;
 }
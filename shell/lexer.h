@@ -18,40 +18,33 @@ typedef enum {
         LEXER_TOK_INTEGER,
         LEXER_TOK_STRING,
         LEXER_TOK_SYMBOL,
+        LEXER_TOK_LPAREN,
+        LEXER_TOK_RPAREN,
         LEXER_TOK_EOF
 } token_type_t;
 
 extern const char *token_type_names[];
 
+/* Tokens point back into the line instead of owning a copy, so they're only
+ * valid until the next line is set. A string's length is its length once
+ * unescaped, which lexer_token_string_copy() does */
 typedef struct {
         token_type_t type;
 
-        union {
-                char *string;
-                int integer;
-        } as;
+        size_t offset;
+        size_t length;
+
+        int integer;
 
         size_t column;
 } token_t;
 
-#define LEXER_TOKEN_VAL_AS_STR(t) (t->as.string)
-#define LEXER_TOKEN_VAL_AS_INT(t) (t->as.integer)
-
-typedef enum {
-        LEXER_STATE_ZERO,
-        LEXER_STATE_NUMBER,
-        LEXER_STATE_NUMBER_PREFIX,
-        LEXER_STATE_NUMBER_BASE16,
-        LEXER_STATE_SYMBOL,
-        LEXER_STATE_STRING,
-        LEXER_STATE_ESCAPE_STRING,
-        LEXER_STATE_MINUS,
-        LEXER_STATE_INTEGER_BASE16,
-} lexer_state_t;
+#define LEXER_TOKEN_VAL_AS_STR(l, t) ((l)->line.buffer + (t)->offset)
+#define LEXER_TOKEN_VAL_LENGTH(t)    ((t)->length)
+#define LEXER_TOKEN_VAL_AS_INT(t)    ((t)->integer)
 
 typedef struct {
         line_t line;
-        lexer_state_t state;
         size_t char_no;
 } lexer_t;
 
@@ -60,7 +53,7 @@ void lexer_delete(lexer_t *l);
 
 void lexer_line_set(lexer_t *lexer, line_t line);
 
-token_t *lexer_token_get(lexer_t *l);
-void lexer_token_delete(token_t *tok);
+void lexer_token_get(lexer_t *l, token_t *token);
+size_t lexer_token_string_copy(const lexer_t *l, const token_t *token, char *buffer);
 
 #endif /* !SHELL_LEXER_H */
@@ -1,112 +1,370 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 
+#include "arena.h"
+#include "commands.h"
 #include "env.h"
+#include "eval.h"
 #include "object.h"
 #include "parser.h"
 
 /*
- *    S -> CMD Arg
- *  CMD -> Symbol
- * Arg  -> Symbol Arg | String Arg | Integer Arg | Ɛ */
+ *    S -> Form
+ * Form -> Head Arg
+ * Head -> Symbol
+ *  Arg -> Symbol Arg | String Arg | Integer Arg | ( Form ) Arg | ( ) Arg | Ɛ */
+
+/* Initial size of the per-line arena. It grows to fit the longest line
+ * seen */
+#define PARSER_ARENA_SIZE 4096
+
+/* How deep forms can be nested in parentheses */
+#define PARSER_DEPTH_MAX 64
+
+static const struct {
+        const char *name;
+        ast_operator_t operator;
+        uint32_t argc_min;
+} _operators[] = {
+        { "+",  AST_OPERATOR_ADD, 1 },
+        { "-",  AST_OPERATOR_SUB, 1 },
+        { "*",  AST_OPERATOR_MUL, 1 },
+        { "/",  AST_OPERATOR_DIV, 2 },
+        { "%",  AST_OPERATOR_MOD, 2 },
+        { "&",  AST_OPERATOR_AND, 1 },
+        { "|",  AST_OPERATOR_OR,  1 },
+        { "^",  AST_OPERATOR_XOR, 1 },
+        { "<<", AST_OPERATOR_SHL, 2 },
+        { ">>", AST_OPERATOR_SHR, 2 },
+        { NULL, AST_OPERATOR_NONE, 0 }
+};
+
+static parser_ret_t _rule_form(parser_t *parser, ast_node_t *form, uint32_t depth);
+
+static char *
+_token_string_new(parser_t *parser, const token_t *token)
+{
+        char * const value =
+            arena_alloc(parser->arena, LEXER_TOKEN_VAL_LENGTH(token) + 1);
+
+        (void)lexer_token_string_copy(parser->lexer, token, value);
+
+        return value;
+}
+
+/* Symbols and form names are interned once here, so that looking them up
+ * later doesn't hash them. Nothing ever writes to a symbol */
+static char *
+_token_symbol_new(parser_t *parser, const token_t *token)
+{
+        return (char *)env_intern(_token_string_new(parser, token));
+}
+
+static object_t *
+_object_new(parser_t *parser, object_type_t type)
+{
+        object_t * const object = arena_alloc(parser->arena, sizeof(object_t));
+
+        *object = (object_t) {
+                .type     = type,
+                .as.value = NULL
+        };
 
-static parser_ret_t _rule_arg(parser_t *parser);
+        return object;
+}
+
+static ast_node_t *
+_node_new(parser_t *parser, ast_node_type_t type)
+{
+        ast_node_t * const node = arena_alloc(parser->arena, sizeof(ast_node_t));
+
+        *node = (ast_node_t) {
+                .type     = type,
+                .object   = NULL,
+                .name     = NULL,
+                .operator = AST_OPERATOR_NONE,
+                .head     = NULL,
+                .args     = NULL,
+                .argc     = 0,
+                .next     = NULL
+        };
+
+        return node;
+}
 
+/* Operators are looked for first, then commands, which are static and never
+ * looked for in the environment, and then the environment */
 static parser_ret_t
-_rule_start(parser_t *parser)
+_head_resolve(ast_node_t *form, env_pair_t *pair)
 {
-        parser_ret_t ret;
-        ret = PARSER_RET_EXPECTED_SYMBOL;
+        for (uint32_t i = 0; _operators[i].name != NULL; i++) {
+                if ((strcmp(form->name, _operators[i].name)) == 0) {
+                        form->operator = _operators[i].operator;
+
+                        return PARSER_RET_OK;
+                }
+        }
 
-        token_t * const token = lexer_token_get(parser->lexer);
+        const object_t * const command_obj = commands_object_find(form->name);
+
+        if (command_obj != NULL) {
+                *pair = (env_pair_t) {
+                        .symbol = command_obj->as.command->name,
+                        .value  = (void *)command_obj
+                };
+        } else if (!(env_interned_get(form->name, pair))) {
+                return PARSER_RET_UNDEFINED_SYMBOL;
+        }
+
+        form->head = pair->value;
+
+        return PARSER_RET_OK;
+}
+
+static bool
+_node_is_integer(const ast_node_t *node)
+{
+        return ((node->type == AST_NODE_OBJECT) &&
+                (node->object->type == OBJECT_TYPE_INTEGER));
+}
+
+/* Folds the integers in an operator form. If they're all integers, the form
+ * becomes an integer. Otherwise, when the operator is commutative, the
+ * integers are folded into one that's moved to the end */
+static void
+_form_fold(parser_t *parser, ast_node_t *form)
+{
+        uint32_t values[COMMANDS_ARGS_MAX];
+        uint32_t value_count;
+        value_count = 0;
+
+        for (const ast_node_t *arg = form->args; arg != NULL; arg = arg->next) {
+                if (_node_is_integer(arg)) {
+                        values[value_count] = arg->object->as.integer;
+                        value_count++;
+                }
+        }
+
+        uint32_t result;
+
+        if (value_count == form->argc) {
+                /* Division by zero is left to be reported when evaluated */
+                if (!(eval_operator_apply(form->operator, values, value_count, &result))) {
+                        return;
+                }
+
+                form->type = AST_NODE_OBJECT;
+                form->object = _object_new(parser, OBJECT_TYPE_INTEGER);
+                form->object->as.integer = (int)result;
+                form->args = NULL;
+                form->argc = 0;
+
+                return;
+        }
+
+        switch (form->operator) {
+        case AST_OPERATOR_ADD:
+        case AST_OPERATOR_MUL:
+        case AST_OPERATOR_AND:
+        case AST_OPERATOR_OR:
+        case AST_OPERATOR_XOR:
+                break;
+        default:
+                return;
+        }
 
-        if (token->type == LEXER_TOK_EOF) {
-                ret = PARSER_RET_EOF;
-                goto exit;
+        if (value_count < 2) {
+                return;
         }
 
-        if (token->type == LEXER_TOK_ERROR) {
-                ret = PARSER_RET_SYNTAX_ERROR;
-                goto exit;
+        (void)eval_operator_apply(form->operator, values, value_count, &result);
+
+        ast_node_t **link;
+        link = &form->args;
+
+        ast_node_t *folded;
+        folded = NULL;
+
+        /* Keep the first integer to hold the result, and drop the rest */
+        while (*link != NULL) {
+                ast_node_t * const arg = *link;
+
+                if (!(_node_is_integer(arg))) {
+                        link = &arg->next;
+                } else if (folded == NULL) {
+                        folded = arg;
+                        *link = arg->next;
+                } else {
+                        *link = arg->next;
+                }
         }
 
-        if (token->type == LEXER_TOK_SYMBOL) {
-                const char * const command_name =
-                    LEXER_TOKEN_VAL_AS_STR(token);
+        folded->object->as.integer = (int)result;
+        folded->next = NULL;
+
+        *link = folded;
+
+        form->argc -= value_count - 1;
+}
+
+/* The right recursion in Arg is walked as a loop. A nested form ends at its
+ * closing parenthesis, and the line's form at the end of the line */
+static parser_ret_t
+_rule_form(parser_t *parser, ast_node_t *form, uint32_t depth)
+{
+        ast_node_t **link;
+        link = &form->args;
+
+        while (true) {
+                token_t token;
+
+                lexer_token_get(parser->lexer, &token);
+
+                if (token.type == LEXER_TOK_EOF) {
+                        return (depth == 0) ? PARSER_RET_OK : PARSER_RET_SYNTAX_ERROR;
+                }
+
+                if (token.type == LEXER_TOK_RPAREN) {
+                        if (depth == 0) {
+                                return PARSER_RET_SYNTAX_ERROR;
+                        }
+
+                        break;
+                }
+
+                if (token.type == LEXER_TOK_ERROR) {
+                        return PARSER_RET_SYNTAX_ERROR;
+                }
+
+                if (form->argc == COMMANDS_ARGS_MAX) {
+                        return PARSER_RET_EXCEEDED_ARGS_COUNT;
+                }
 
-                if (!(env_get(command_name, &parser->stream->command_value))) {
-                        ret = PARSER_RET_UNDEFINED_SYMBOL;
-                        goto exit;
+                ast_node_t *arg;
+
+                switch (token.type) {
+                case LEXER_TOK_SYMBOL:
+                        arg = _node_new(parser, AST_NODE_OBJECT);
+                        arg->object = _object_new(parser, OBJECT_TYPE_SYMBOL);
+                        arg->object->as.symbol = _token_symbol_new(parser, &token);
+                        break;
+                case LEXER_TOK_STRING:
+                        arg = _node_new(parser, AST_NODE_OBJECT);
+                        arg->object = _object_new(parser, OBJECT_TYPE_STRING);
+                        arg->object->as.string = _token_string_new(parser, &token);
+                        break;
+                case LEXER_TOK_INTEGER:
+                        arg = _node_new(parser, AST_NODE_OBJECT);
+                        arg->object = _object_new(parser, OBJECT_TYPE_INTEGER);
+                        arg->object->as.integer = LEXER_TOKEN_VAL_AS_INT(&token);
+                        break;
+                default:
+                        if ((depth + 1) == PARSER_DEPTH_MAX) {
+                                return PARSER_RET_SYNTAX_ERROR;
+                        }
+
+                        lexer_token_get(parser->lexer, &token);
+
+                        arg = _node_new(parser, AST_NODE_FORM);
+
+                        if (token.type == LEXER_TOK_RPAREN) {
+                                break;
+                        }
+
+                        if (token.type != LEXER_TOK_SYMBOL) {
+                                return PARSER_RET_EXPECTED_SYMBOL;
+                        }
+
+                        arg->name = _token_symbol_new(parser, &token);
+
+                        /* Unlike the line's, a nested form's head can be
+                         * left unbound. It's reported if it's evaluated, and
+                         * isn't when it's a macro's parameter list */
+                        env_pair_t pair;
+                        (void)_head_resolve(arg, &pair);
+
+                        parser_ret_t ret;
+
+                        if ((ret = _rule_form(parser, arg, depth + 1)) != PARSER_RET_OK) {
+                                return ret;
+                        }
+                        break;
                 }
 
-                ret = _rule_arg(parser);
+                *link = arg;
+                link = &arg->next;
+
+                form->argc++;
+        }
 
-                if (ret == PARSER_RET_EOF) {
-                        ret = PARSER_RET_OK;
-                        goto exit;
+        if (form->operator == AST_OPERATOR_NONE) {
+                return PARSER_RET_OK;
+        }
+
+        for (uint32_t i = 0; _operators[i].name != NULL; i++) {
+                if ((_operators[i].operator == form->operator) &&
+                    (form->argc < _operators[i].argc_min)) {
+                        return PARSER_RET_SYNTAX_ERROR;
                 }
         }
 
-exit:
-        lexer_token_delete(token);
+        _form_fold(parser, form);
 
-        return ret;
+        return PARSER_RET_OK;
 }
 
 static parser_ret_t
-_rule_arg(parser_t *parser)
+_rule_start(parser_t *parser)
 {
-        token_t * const token = lexer_token_get(parser->lexer);
+        token_t token;
 
-        if (token->type == LEXER_TOK_EOF) {
-                lexer_token_delete(token);
+        lexer_token_get(parser->lexer, &token);
+
+        if (token.type == LEXER_TOK_EOF) {
                 return PARSER_RET_EOF;
         }
 
-        if (token->type == LEXER_TOK_ERROR) {
-                lexer_token_delete(token);
+        if (token.type == LEXER_TOK_ERROR) {
                 return PARSER_RET_SYNTAX_ERROR;
         }
 
-        if (parser->stream->argc == COMMANDS_ARGS_MAX) {
-                lexer_token_delete(token);
-                return PARSER_RET_EXCEEDED_ARGS_COUNT;
+        if (token.type != LEXER_TOK_SYMBOL) {
+                return PARSER_RET_EXPECTED_SYMBOL;
         }
 
-        object_t *object;
+        ast_node_t * const form = _node_new(parser, AST_NODE_FORM);
 
-        switch (token->type) {
-        case LEXER_TOK_SYMBOL:
-                object = object_symbol_copy_new(LEXER_TOKEN_VAL_AS_STR(token));
-                break;
-        case LEXER_TOK_STRING:
-                object = object_string_copy_new(LEXER_TOKEN_VAL_AS_STR(token));
-                break;
-        case LEXER_TOK_INTEGER:
-                object = object_integer_new(LEXER_TOKEN_VAL_AS_INT(token));
-                break;
-        default:
-                object = NULL;
-                break;
+        form->name = _token_symbol_new(parser, &token);
+
+        parser_ret_t ret;
+
+        if ((ret = _head_resolve(form, &parser->stream->command_value)) != PARSER_RET_OK) {
+                return ret;
+        }
+
+        if ((ret = _rule_form(parser, form, 0)) != PARSER_RET_OK) {
+                return ret;
         }
 
-        parser->stream->args_obj[parser->stream->argc] = object;
-        parser->stream->argc++;
+        parser->root = form;
 
-        return _rule_arg(parser);
+        return PARSER_RET_OK;
 }
 
+/* Objects live in the arena, so only the slots in use need clearing */
 static void
 _parser_cleanup(parser_t *parser)
 {
-        for (uint32_t i = 0; i < COMMANDS_ARGS_MAX; i++) {
-                object_delete(parser->stream->args_obj[i]);
-
+        for (int i = 0; i < parser->stream->argc; i++) {
                 parser->stream->args_obj[i] = NULL;
         }
 
         parser->stream->argc = 0;
+        parser->root = NULL;
+
+        arena_reset(parser->arena);
 }
 
 static void
@@ -132,11 +390,14 @@ parser_new(void)
 
         *parser = (parser_t) {
                 .stream = malloc(sizeof(parser_stream_t)),
-                .lexer  = lexer_new()
+                .lexer  = lexer_new(),
+                .arena  = arena_new(PARSER_ARENA_SIZE),
+                .root   = NULL
         };
 
         assert(parser->stream != NULL);
         assert(parser->lexer != NULL);
+        assert(parser->arena != NULL);
 
         (void)memset(parser->stream, 0, sizeof(parser_stream_t));
 
@@ -158,6 +419,7 @@ parser_delete(parser_t *parser)
 
         free(parser->stream);
         lexer_delete(parser->lexer);
+        arena_delete(parser->arena);
 
         free(parser);
 }
@@ -9,6 +9,8 @@
 #include <stdint.h>
 
 #include "types.h"
+#include "arena.h"
+#include "ast.h"
 #include "env.h"
 #include "lexer.h"
 
@@ -26,8 +28,18 @@ typedef enum {
 struct parser {
         parser_stream_t *stream;
         lexer_t *lexer;
+
+        /* Argument objects and their strings. Everything in it is released
+         * when the next line is parsed, so a command that wants to keep an
+         * argument has to copy it */
+        arena_t *arena;
+
+        /* The parsed line */
+        ast_node_t *root;
 };
 
+/* Filled in with a command's arguments, as they're evaluated, right before
+ * it's called */
 struct parser_stream {
         env_pair_t command_value;
         object_t *args_obj[COMMANDS_ARGS_MAX];
@@ -1,10 +1,26 @@
 #include <assert.h>
 #include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+/* With readline outside of Windows, lines are read with readline's callback
+ * interface from a loop that waits on the terminal, and on a pipe other
+ * threads and signal handlers write to in order to wake it up */
+#if defined(HAVE_READLINE) && !defined(_WIN32)
+#define SHELL_EVENT_LOOP
+#endif
+
+#if defined(SHELL_EVENT_LOOP)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#endif /* SHELL_EVENT_LOOP */
+
+#include <pthread.h>
 
 #if defined(HAVE_READLINE)
 #include <readline/readline.h>
@@ -18,6 +34,12 @@
 
 #define SHELL_PROMPT_SIZE (16)
 
+#define SHELL_IDLE_TIMEOUT_MIN     (1000)
+#define SHELL_IDLE_TIMEOUT_MAX  (1000000)
+#define SHELL_IDLE_TIMEOUT_DEF   (100000)
+
+#define SHELL_POSTED_MAX 8
+
 void __shell_init(void);
 void __shell_deinit(void);
 void __shell_signal_set(void (*handler)(int));
@@ -28,7 +50,241 @@ static char _prompt[SHELL_PROMPT_SIZE + 1];
 
 static line_t _line;
 
-#if defined(HAVE_READLINE)
+static shell_idle_func_t _idle_func;
+
+static bool _reading;
+
+static volatile sig_atomic_t _interrupted;
+
+/* An interrupt raised from another thread holds until it's cleared */
+static struct {
+        pthread_mutex_t lock;
+        bool raised;
+} _raised = {
+        .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* Functions posted from other threads, to run on the shell's */
+static struct {
+        pthread_mutex_t lock;
+        shell_post_func_t funcs[SHELL_POSTED_MAX];
+        uint32_t count;
+} _posted = {
+        .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+#if defined(SHELL_EVENT_LOOP)
+static struct {
+        /* Read end, then write end */
+        int wakeup_fds[2];
+
+        volatile sig_atomic_t sigint;
+        bool line_ready;
+
+        uint64_t idle_deadline_us;
+} _loop = {
+        .wakeup_fds = { -1, -1 }
+};
+#endif /* SHELL_EVENT_LOOP */
+
+static void
+_interrupt_handler(int n)
+{
+        (void)n;
+
+        _interrupted = 1;
+}
+
+static void
+_line_set(const char *rline)
+{
+        if ((rline != NULL) && (*rline != '\0')) {
+                const size_t rsize = (strlen(rline)) + 1;
+
+                if (rsize > _line.size) {
+                        _line.buffer = realloc(_line.buffer, rsize);
+                        _line.size = rsize;
+                }
+
+                if (_line.buffer == NULL) {
+                        /* XXX: Error */
+                        return;
+                }
+
+                (void)strcpy(_line.buffer, rline);
+                _line.size = rsize;
+        } else {
+                _line.buffer[0] = '\0';
+                _line.size = 0;
+        }
+}
+
+static uint32_t
+_posted_take(shell_post_func_t *funcs)
+{
+        uint32_t count;
+
+        (void)pthread_mutex_lock(&_posted.lock);
+
+        count = _posted.count;
+        (void)memcpy(funcs, _posted.funcs, count * sizeof(shell_post_func_t));
+
+        _posted.count = 0;
+
+        (void)pthread_mutex_unlock(&_posted.lock);
+
+        return count;
+}
+
+#if defined(SHELL_EVENT_LOOP)
+static uint64_t
+_us_get(void)
+{
+        struct timespec ts;
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+}
+
+static void
+_wakeup(void)
+{
+        const char byte = 0;
+
+        /* If the pipe is full, the loop is already due to wake up */
+        (void)write(_loop.wakeup_fds[1], &byte, 1);
+}
+
+/* Only marks the interrupt, and the loop takes care of the prompt */
+static void
+_sigint_handler(int n)
+{
+        (void)n;
+
+        _loop.sigint = 1;
+
+        _wakeup();
+}
+
+static void
+_line_handler(char *rline)
+{
+        /* Nothing should be drawn while the line runs */
+        rl_callback_handler_remove();
+
+        _line_set(rline);
+
+        free(rline);
+
+        _loop.line_ready = true;
+}
+
+/* Runs what was posted with the prompt out of the way, so whatever is
+ * printed goes above it */
+static void
+_posted_print(void)
+{
+        shell_post_func_t funcs[SHELL_POSTED_MAX];
+
+        const uint32_t count = _posted_take(funcs);
+
+        if (count == 0) {
+                return;
+        }
+
+        rl_clear_visible_line();
+
+        for (uint32_t i = 0; i < count; i++) {
+                funcs[i]();
+        }
+
+        (void)fflush(stdout);
+
+        rl_on_new_line();
+        rl_redisplay();
+}
+
+static void
+_idle_run(void)
+{
+        uint32_t timeout;
+        timeout = _idle_func();
+
+        if (timeout < SHELL_IDLE_TIMEOUT_MIN) {
+                timeout = SHELL_IDLE_TIMEOUT_MIN;
+        } else if (timeout > SHELL_IDLE_TIMEOUT_MAX) {
+                timeout = SHELL_IDLE_TIMEOUT_MAX;
+        }
+
+        _loop.idle_deadline_us = _us_get() + timeout;
+}
+
+/* Sleeps until a key is pressed, something is posted, or the idle function
+ * is due */
+static void
+_events_wait(void)
+{
+        struct pollfd fds[] = {
+                {
+                        .fd     = STDIN_FILENO,
+                        .events = POLLIN
+                }, {
+                        .fd     = _loop.wakeup_fds[0],
+                        .events = POLLIN
+                }
+        };
+
+        int timeout_ms;
+        timeout_ms = -1;
+
+        if (_idle_func != NULL) {
+                const uint64_t now_us = _us_get();
+
+                timeout_ms = (_loop.idle_deadline_us > now_us) ?
+                    (int)(((_loop.idle_deadline_us - now_us) + 999) / 1000) : 0;
+        }
+
+        const int ret = poll(fds, 2, timeout_ms);
+
+        if ((ret < 0) && (errno != EINTR)) {
+                return;
+        }
+
+        if ((ret > 0) && ((fds[1].revents & POLLIN) != 0)) {
+                char bytes[64];
+
+                while ((read(_loop.wakeup_fds[0], bytes, sizeof(bytes))) > 0) {
+                }
+        }
+
+        if (_loop.sigint) {
+                _loop.sigint = 0;
+
+                /* Drop what has been typed, and start over on a new line */
+                (void)fputc('\n', stdout);
+                (void)fflush(stdout);
+
+                rl_on_new_line();
+                rl_replace_line("", 0);
+                rl_redisplay();
+        }
+
+        if ((ret > 0) && ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0)) {
+                rl_callback_read_char();
+
+                if (_loop.line_ready) {
+                        return;
+                }
+        }
+
+        _posted_print();
+
+        if ((_idle_func != NULL) && (_us_get() >= _loop.idle_deadline_us)) {
+                _idle_run();
+        }
+}
+#elif defined(HAVE_READLINE)
 static void
 _sigint_handler(int n)
 {
@@ -45,7 +301,30 @@ _sigint_handler(int n)
         rl_replace_line("", 0);
         rl_redisplay();
 }
-#endif /* HAVE_READLINE */
+
+static int
+_event_hook(void)
+{
+        if (_idle_func == NULL) {
+                return 0;
+        }
+
+        uint32_t timeout;
+        timeout = _idle_func();
+
+        if (timeout < SHELL_IDLE_TIMEOUT_MIN) {
+                timeout = SHELL_IDLE_TIMEOUT_MIN;
+        } else if (timeout > SHELL_IDLE_TIMEOUT_MAX) {
+                timeout = SHELL_IDLE_TIMEOUT_MAX;
+        }
+
+        /* Readline calls the event hook every time it waits this long for a
+         * key press */
+        (void)rl_set_keyboard_input_timeout(timeout);
+
+        return 0;
+}
+#endif /* SHELL_EVENT_LOOP */
 
 void
 shell_init(void)
@@ -64,6 +343,21 @@ shell_init(void)
 
         rl_initialize();
         rl_clear_signals();
+
+#if defined(SHELL_EVENT_LOOP)
+        /* Readline is left to handle the terminal alone, and the loop
+         * handles Ctrl-C */
+        rl_catch_signals = 0;
+
+        if ((pipe(_loop.wakeup_fds)) == 0) {
+                for (uint32_t i = 0; i < 2; i++) {
+                        const int flags = fcntl(_loop.wakeup_fds[i], F_GETFL);
+
+                        (void)fcntl(_loop.wakeup_fds[i], F_SETFL, flags | O_NONBLOCK);
+                        (void)fcntl(_loop.wakeup_fds[i], F_SETFD, FD_CLOEXEC);
+                }
+        }
+#endif /* SHELL_EVENT_LOOP */
 }
 
 void
@@ -74,6 +368,16 @@ shell_deinit(void)
                 _line.buffer = NULL;
         }
 
+#if defined(SHELL_EVENT_LOOP)
+        for (uint32_t i = 0; i < 2; i++) {
+                if (_loop.wakeup_fds[i] >= 0) {
+                        (void)close(_loop.wakeup_fds[i]);
+
+                        _loop.wakeup_fds[i] = -1;
+                }
+        }
+#endif /* SHELL_EVENT_LOOP */
+
         __shell_deinit();
 }
 
@@ -96,37 +400,68 @@ shell_line_get(void)
         return _line;
 }
 
+#if defined(SHELL_EVENT_LOOP)
 void
 shell_readline(void)
 {
         __shell_signal_set(_sigint_handler);
 
-        char * const rline = readline(_prompt);
+        _reading = true;
+        _loop.line_ready = false;
 
-        __shell_signal_clear();
+        if (_idle_func != NULL) {
+                _loop.idle_deadline_us = _us_get() + SHELL_IDLE_TIMEOUT_MIN;
+        }
 
-        if ((rline != NULL) && (*rline != '\0')) {
-                const size_t rsize = (strlen(rline)) + 1;
+        rl_callback_handler_install(_prompt, _line_handler);
 
-                if (rsize > _line.size) {
-                        _line.buffer = realloc(_line.buffer, rsize);
-                        _line.size = rsize;
-                }
+        /* Anything posted while the last line ran is printed first */
+        _posted_print();
 
-                if (_line.buffer == NULL) {
-                        /* XXX: Error */
-                        return;
-                }
+        while (!_loop.line_ready) {
+                _events_wait();
+        }
 
-                (void)strcpy(_line.buffer, rline);
-                _line.size = rsize;
+        _reading = false;
 
-                free(rline);
-        } else {
-                _line.buffer[0] = '\0';
-                _line.size = 0;
+        __shell_signal_clear();
+}
+#else
+void
+shell_readline(void)
+{
+        __shell_signal_set(_sigint_handler);
+
+#if !defined(HAVE_READLINE)
+        /* Without an event hook, the best we can do is to run once per
+         * prompt */
+        if (_idle_func != NULL) {
+                (void)_idle_func();
         }
+#endif /* !HAVE_READLINE */
+
+        /* Without an event loop, what was posted waits for the next prompt */
+        shell_post_func_t funcs[SHELL_POSTED_MAX];
+
+        const uint32_t count = _posted_take(funcs);
+
+        for (uint32_t i = 0; i < count; i++) {
+                funcs[i]();
+        }
+
+        _reading = true;
+
+        char * const rline = readline(_prompt);
+
+        _reading = false;
+
+        __shell_signal_clear();
+
+        _line_set(rline);
+
+        free(rline);
 }
+#endif /* SHELL_EVENT_LOOP */
 
 void
 shell_history_add(const line_t *line)
@@ -143,3 +478,128 @@ shell_clear(void)
 
         __shell_clear();
 }
+
+void
+shell_interrupt_begin(void)
+{
+        _interrupted = 0;
+
+        __shell_signal_set(_interrupt_handler);
+}
+
+void
+shell_interrupt_end(void)
+{
+        __shell_signal_clear();
+}
+
+bool
+shell_interrupted(void)
+{
+        if (_interrupted != 0) {
+                return true;
+        }
+
+        (void)pthread_mutex_lock(&_raised.lock);
+
+        const bool raised = _raised.raised;
+
+        (void)pthread_mutex_unlock(&_raised.lock);
+
+        return raised;
+}
+
+void
+shell_interrupt_raise(void)
+{
+        (void)pthread_mutex_lock(&_raised.lock);
+
+        _raised.raised = true;
+
+        (void)pthread_mutex_unlock(&_raised.lock);
+}
+
+void
+shell_interrupt_clear(void)
+{
+        (void)pthread_mutex_lock(&_raised.lock);
+
+        _raised.raised = false;
+
+        (void)pthread_mutex_unlock(&_raised.lock);
+}
+
+void
+shell_idle_set(shell_idle_func_t func)
+{
+        _idle_func = func;
+
+#if defined(SHELL_EVENT_LOOP)
+        if (func != NULL) {
+                _loop.idle_deadline_us = _us_get() + SHELL_IDLE_TIMEOUT_MIN;
+        }
+#elif defined(HAVE_READLINE)
+        if (func != NULL) {
+                rl_event_hook = _event_hook;
+        } else {
+                rl_event_hook = NULL;
+
+                (void)rl_set_keyboard_input_timeout(SHELL_IDLE_TIMEOUT_DEF);
+        }
+#endif /* HAVE_READLINE */
+}
+
+void
+shell_async_write(const char *buffer, size_t size)
+{
+        assert(buffer != NULL);
+
+        if (!_reading) {
+                (void)fwrite(buffer, 1, size, stdout);
+                (void)fflush(stdout);
+
+                return;
+        }
+
+        /* Print above the prompt, then redraw the prompt along with whatever
+         * has been typed so far */
+#if defined(HAVE_READLINE)
+        rl_clear_visible_line();
+#endif /* HAVE_READLINE */
+
+        (void)fwrite(buffer, 1, size, stdout);
+        (void)fflush(stdout);
+
+        rl_on_new_line();
+        rl_redisplay();
+}
+
+void
+shell_post(shell_post_func_t func)
+{
+        assert(func != NULL);
+
+        (void)pthread_mutex_lock(&_posted.lock);
+
+        bool posted;
+        posted = false;
+
+        for (uint32_t i = 0; i < _posted.count; i++) {
+                posted = posted || (_posted.funcs[i] == func);
+        }
+
+        if (!posted) {
+                assert(_posted.count < SHELL_POSTED_MAX);
+
+                _posted.funcs[_posted.count] = func;
+                _posted.count++;
+        }
+
+        (void)pthread_mutex_unlock(&_posted.lock);
+
+#if defined(SHELL_EVENT_LOOP)
+        if (_loop.wakeup_fds[1] >= 0) {
+                _wakeup();
+        }
+#endif /* SHELL_EVENT_LOOP */
+}
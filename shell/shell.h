@@ -1,10 +1,17 @@
 #ifndef SHELL_SHELL_H
 #define SHELL_SHELL_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "line.h"
 
+/* Returns the number of microseconds until it wants to be called again */
+typedef uint32_t (*shell_idle_func_t)(void);
+
+typedef void (*shell_post_func_t)(void);
+
 void shell_init(void);
 void shell_deinit(void);
 
@@ -19,4 +26,23 @@ void shell_history_add(const line_t *line);
 
 void shell_clear(void);
 
+void shell_interrupt_begin(void);
+void shell_interrupt_end(void);
+bool shell_interrupted(void);
+/* Safe to call from any thread. Everything that waits for Ctrl-C is
+ * interrupted, as if it kept being pressed, until the interrupt is cleared */
+void shell_interrupt_raise(void);
+void shell_interrupt_clear(void);
+
+void shell_idle_set(shell_idle_func_t func);
+/* Only from the shell's thread. While a line is being read, the buffer is
+ * written above the prompt */
+void shell_async_write(const char *buffer, size_t size);
+
+/* Safe to call from any thread. The function runs on the shell's thread
+ * while it waits for a line, where what it prints goes above the prompt, or
+ * at the next prompt otherwise. Posting a function already waiting to run
+ * does nothing */
+void shell_post(shell_post_func_t func);
+
 #endif /* SHELL_SHELL_H */
@@ -6,40 +6,224 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
 
 #include <ssusb/ssusb.h>
 
 #include "ssshell.h"
+#include "bytecode.h"
 #include "commands.h"
+#include "daemon.h"
+#include "device.h"
+#include "eval.h"
+#include "jobs.h"
+#include "macro.h"
 #include "shell.h"
 #include "parser.h"
+#include "shadow.h"
+#include "symbols.h"
+
+/* Exit codes when running a script */
+#define SSSHELL_EXIT_FAILURE    1
+#define SSSHELL_EXIT_SYNTAX     2
+#define SSSHELL_EXIT_NOT_FOUND  127
+
+/* Scripts are read this much at a time */
+#define SCRIPT_BLOCK_SIZE       (64 * 1024)
+
+/* Appended to a script's path for its bytecode */
+#define SCRIPT_CACHE_SUFFIX     ".ssc"
+
+/* Commands in a script are separated by newlines or semicolons, except
+ * inside a string. The buffer holds what has been read but not yet run */
+typedef struct {
+        char *buffer;
+        size_t size;
+        size_t capacity;
+
+        /* Start of the next command, and how far it's been scanned */
+        size_t line_start;
+        size_t scan_pos;
+        bool quoted;
+        bool escaped;
+} script_t;
 
 static struct {
         bool running;
+        bool interactive;
         int exit_code;
 } _state;
 
+static void _usage(const char *program);
+
+static int _line_execute(parser_t *parser, const line_t *line);
+
+static void _interactive_run(parser_t *parser);
+static void _script_string_run(parser_t *parser, const char *commands);
+static void _script_fd_run(parser_t *parser, int fd);
+static void _script_file_run(parser_t *parser, int fd, const char *path);
+static int _daemon_commands_run(void *arg, const char *commands);
+
+static const struct option _long_options[] = {
+        { "daemon",  no_argument,       NULL, 'd' },
+        { "connect", no_argument,       NULL, 'C' },
+        { "socket",  required_argument, NULL, 'S' },
+        { "help",    no_argument,       NULL, 'h' },
+        { NULL,      0,                 NULL, 0   }
+};
+
 int
 main(int argc, char *argv[])
 {
-        (void)argc;
-        (void)argv;
+        const char *commands_arg;
+        commands_arg = NULL;
 
-        ssusb_ret_t ret;
-        ret = ssusb_init();
+        const char *script_path;
+        script_path = NULL;
 
-        if (ret != SSUSB_OK) {
-                ssusb_deinit();
+        /* No devices are simulated unless asked for */
+        uint32_t simulated_count;
+        simulated_count = 0;
+
+        bool serving;
+        serving = false;
+
+        bool connecting;
+        connecting = false;
+
+        const char *socket_path;
+        socket_path = NULL;
+
+        char *end;
+
+        int opt;
 
-                return 1;
+        while ((opt = getopt_long(argc, argv, "c:f:s:dCS:h", _long_options, NULL)) != -1) {
+                switch (opt) {
+                case 'c':
+                        commands_arg = optarg;
+                        break;
+                case 'f':
+                        script_path = optarg;
+                        break;
+                case 's':
+                        simulated_count = strtoul(optarg, &end, 0);
+
+                        if ((*end != '\0') || (simulated_count == 0) ||
+                            (simulated_count > DEVICE_COUNT_MAX)) {
+                                (void)fprintf(stderr, "%s: %s: Expected 1 to %u devices\n",
+                                    argv[0], optarg, DEVICE_COUNT_MAX);
+
+                                return SSSHELL_EXIT_SYNTAX;
+                        }
+                        break;
+                case 'd':
+                        serving = true;
+                        break;
+                case 'C':
+                        connecting = true;
+                        break;
+                case 'S':
+                        socket_path = optarg;
+                        break;
+                case 'h':
+                        _usage(argv[0]);
+                        return 0;
+                default:
+                        _usage(argv[0]);
+                        return SSSHELL_EXIT_SYNTAX;
+                }
+        }
+
+        /* The daemon takes its commands from clients, and a client has no
+         * device of its own */
+        if ((optind < argc) || ((commands_arg != NULL) && (script_path != NULL)) ||
+            (serving && connecting) ||
+            (serving && ((commands_arg != NULL) || (script_path != NULL))) ||
+            (connecting && (simulated_count > 0))) {
+                _usage(argv[0]);
+
+                return SSSHELL_EXIT_SYNTAX;
+        }
+
+        if (socket_path == NULL) {
+                socket_path = daemon_socket_path_get();
+        }
+
+        int script_fd;
+        script_fd = -1;
+
+        if (script_path != NULL) {
+                if ((strcmp(script_path, "-")) == 0) {
+                        script_fd = STDIN_FILENO;
+                } else if ((script_fd = open(script_path, O_RDONLY)) < 0) {
+                        (void)fprintf(stderr, "%s: %s: %s\n",
+                            argv[0], script_path, strerror(errno));
+
+                        return SSSHELL_EXIT_FAILURE;
+                }
+        } else if ((commands_arg == NULL) && !(isatty(STDIN_FILENO))) {
+                /* Commands are being piped in */
+                script_fd = STDIN_FILENO;
+        }
+
+        if (connecting) {
+                if ((commands_arg == NULL) && (script_fd < 0)) {
+                        (void)fprintf(stderr, "%s: Commands are expected with -c, -f, or on standard input\n",
+                            argv[0]);
+
+                        return SSSHELL_EXIT_SYNTAX;
+                }
+
+                int exit_code;
+
+                const bool connected = daemon_connect(socket_path, commands_arg, script_fd, &exit_code);
+
+                if ((script_fd >= 0) && (script_fd != STDIN_FILENO)) {
+                        (void)close(script_fd);
+                }
+
+                if (!connected) {
+                        (void)fprintf(stderr, "%s: %s: %s\n",
+                            argv[0], socket_path, strerror(errno));
+
+                        return SSSHELL_EXIT_FAILURE;
+                }
+
+                return exit_code;
+        }
+
+        /* Simulated devices don't need the cart */
+        if (simulated_count == 0) {
+                ssusb_ret_t ret;
+                ret = ssusb_init();
+
+                if (ret != SSUSB_OK) {
+                        ssusb_deinit();
+
+                        return 1;
+                }
         }
 
         _state.running = true;
+        _state.interactive = !serving && (commands_arg == NULL) && (script_fd < 0);
+        _state.exit_code = 0;
 
         env_init();
+        shadow_init();
+        device_init(simulated_count);
         commands_init();
+        macro_init();
+        jobs_init();
         shell_init();
         shell_prompt_set("> ");
 
@@ -49,67 +233,38 @@ main(int argc, char *argv[])
 
         parser_t * const parser = parser_new();
 
-        while (_state.running) {
-                shell_readline();
-
-                const line_t line = shell_line_get();
-                parser_ret_t parser_ret = parse(parser, line);
+        if (serving) {
+                if (!(daemon_serve(socket_path, _daemon_commands_run, parser))) {
+                        (void)fprintf(stderr, "%s: %s: %s\n",
+                            argv[0], socket_path, strerror(errno));
 
-                if (parser_ret == PARSER_RET_EOF) {
-                        continue;
+                        _state.exit_code = SSSHELL_EXIT_FAILURE;
                 }
+        } else if (commands_arg != NULL) {
+                _script_string_run(parser, commands_arg);
+        } else if (script_fd == STDIN_FILENO) {
+                _script_fd_run(parser, script_fd);
+        } else if (script_fd >= 0) {
+                _script_file_run(parser, script_fd, script_path);
 
-                const env_pair_t * const env_pair =
-                    &parser->stream->command_value;
-
-                if (parser_ret != PARSER_RET_OK) {
-                        switch (parser_ret) {
-                        case PARSER_RET_EXPECTED_SYMBOL:
-                                printf("Expected a command\n");
-                                break;
-                        case PARSER_RET_SYNTAX_ERROR:
-                                printf("Syntax error\n");
-                                break;
-                        case PARSER_RET_UNDEFINED_SYMBOL:
-                                printf("Command not found\n");
-                                break;
-                        default:
-                                break;
-                        }
-
-                        continue;
-                }
-
-                const char * const command_name = env_pair->symbol;
-                const object_t * const command_obj = env_pair->value;
-
-                if (command_obj->type != OBJECT_TYPE_COMMAND) {
-                        printf("Expected a command\n");
-                } else {
-                        const command_t * const command = command_obj->as.command;
-
-                        /* If the argument count is -1, it's variadic */
-                        if ((command->arg_count >= 0) &&
-                            (command->arg_count != parser->stream->argc)) {
-                                (void)printf("Mismatch in arguments passed to \"%s\". Expected %i, got %i\n",
-                                    command_name,
-                                    command->arg_count,
-                                    parser->stream->argc);
-                        } else {
-                                command->func(parser);
-                        }
-
-                        shell_history_add(&line);
-                }
+                (void)close(script_fd);
+        } else {
+                _interactive_run(parser);
         }
 
+        jobs_deinit();
         shell_deinit();
-        commands_deinit();
         env_deinit();
+        shadow_deinit();
+        symbols_loaded_set(NULL);
 
         parser_delete(parser);
 
-        ssusb_deinit();
+        device_deinit();
+
+        if (simulated_count == 0) {
+                ssusb_deinit();
+        }
 
         /* if (ret == SSUSB_OK) { */
         /*         if (argc == 2) { */
@@ -133,3 +288,494 @@ ssshell_exit(int exit_code)
         _state.running = false;
         _state.exit_code = exit_code;
 }
+
+static void
+_usage(const char *program)
+{
+        (void)fprintf(stderr,
+            "Usage: %s [-s count] [-c commands | -f script]\n"
+            "       %s -d [-s count] [-S socket]\n"
+            "       %s -C [-S socket] [-c commands | -f script]\n"
+            "\n"
+            "  -c commands          Run commands separated by ';' or newlines, then exit\n"
+            "  -f script            Run the commands in a script (or '-' for stdin), then exit\n"
+            "  -s count             Simulate count devices in memory instead of the USB cart\n"
+            "  -d, --daemon         Keep the device open, and run the commands clients send\n"
+            "  -C, --connect        Send the commands to the daemon instead\n"
+            "  -S, --socket socket  Socket the daemon listens on (default: %s)\n"
+            "\n"
+            "With standard input not a terminal, commands are read from it.\n"
+            "Scripts stop at the first command that fails, and exit with its\n"
+            "status.\n",
+            program, program, program, daemon_socket_path_get());
+}
+
+static int
+_exit_code_get(eval_ret_t eval_ret)
+{
+        switch (eval_ret) {
+        case EVAL_RET_OK:
+                return 0;
+        case EVAL_RET_FAILED:
+                return SSSHELL_EXIT_FAILURE;
+        case EVAL_RET_NOT_FOUND:
+                return SSSHELL_EXIT_NOT_FOUND;
+        default:
+                return SSSHELL_EXIT_SYNTAX;
+        }
+}
+
+/* Returns zero if the line parsed */
+static int
+_line_parse(parser_t *parser, const line_t *line)
+{
+        switch (parse(parser, *line)) {
+        case PARSER_RET_OK:
+        case PARSER_RET_EOF:
+                return 0;
+        case PARSER_RET_EXPECTED_SYMBOL:
+                printf("Expected a command\n");
+                return SSSHELL_EXIT_SYNTAX;
+        case PARSER_RET_UNDEFINED_SYMBOL:
+                printf("Command not found\n");
+                return SSSHELL_EXIT_NOT_FOUND;
+        case PARSER_RET_SYNTAX_ERROR:
+                printf("Syntax error\n");
+                return SSSHELL_EXIT_SYNTAX;
+        default:
+                return SSSHELL_EXIT_SYNTAX;
+        }
+}
+
+/* Whether the form ends with a &, to run in the background */
+static bool
+_form_background(const ast_node_t *form)
+{
+        const ast_node_t *last;
+        last = NULL;
+
+        for (const ast_node_t *arg = form->args; arg != NULL; arg = arg->next) {
+                last = arg;
+        }
+
+        return (last != NULL) &&
+               (last->type == AST_NODE_OBJECT) &&
+               (last->object->type == OBJECT_TYPE_SYMBOL) &&
+               ((strcmp(last->object->as.symbol, "&")) == 0);
+}
+
+/* Returns zero if the command ran and succeeded */
+static int
+_line_execute(parser_t *parser, const line_t *line)
+{
+        const int parse_exit_code = _line_parse(parser, line);
+
+        if ((parse_exit_code != 0) || (parser->root == NULL)) {
+                return parse_exit_code;
+        }
+
+        ast_node_t * const form = parser->root;
+
+        eval_ret_t eval_ret;
+
+        if (!(_form_background(form))) {
+                eval_ret = eval_form(parser, form);
+        } else {
+                /* The & isn't an argument */
+                ast_node_t **link;
+
+                for (link = &form->args; (*link)->next != NULL; link = &(*link)->next) {
+                }
+
+                *link = NULL;
+                form->argc--;
+
+                eval_ret = eval_form_background(parser, form);
+        }
+
+        if (_state.interactive && (eval_ret != EVAL_RET_EXPECTED_COMMAND)) {
+                shell_history_add(line);
+        }
+
+        return _exit_code_get(eval_ret);
+}
+
+static void
+_interactive_run(parser_t *parser)
+{
+        while (_state.running) {
+                shell_readline();
+
+                const line_t line = shell_line_get();
+
+                (void)_line_execute(parser, &line);
+        }
+}
+
+/* Finds the next complete command in the buffer, and terminates it with a
+ * NUL in place. At the end of the script, whatever is left is the last
+ * command */
+static bool
+_script_command_next(script_t *script, bool eof, line_t *line)
+{
+        for (; script->scan_pos < script->size; script->scan_pos++) {
+                const char c = script->buffer[script->scan_pos];
+
+                if (script->escaped) {
+                        script->escaped = false;
+                } else if (script->quoted) {
+                        script->quoted = (c != '\"');
+                        script->escaped = (c == '\\');
+                } else if (c == '\"') {
+                        script->quoted = true;
+                } else if ((c == '\n') || (c == ';')) {
+                        /* The lexer expects the line to end with a NUL */
+                        script->buffer[script->scan_pos] = '\0';
+
+                        line->buffer = &script->buffer[script->line_start];
+                        line->size = script->scan_pos - script->line_start + 1;
+
+                        script->scan_pos++;
+                        script->line_start = script->scan_pos;
+
+                        return true;
+                }
+        }
+
+        if (eof && (script->line_start < script->size)) {
+                /* There's always room for the NUL */
+                script->buffer[script->size] = '\0';
+
+                line->buffer = &script->buffer[script->line_start];
+                line->size = script->size - script->line_start + 1;
+
+                script->line_start = script->size;
+
+                return true;
+        }
+
+        return false;
+}
+
+/* Skip "#!" lines so that scripts can be executable */
+static bool
+_script_line_ignored(const line_t *line)
+{
+        return ((line->buffer[0] == '#') && (line->buffer[1] == '!'));
+}
+
+static void
+_script_lines_run(parser_t *parser, script_t *script, bool eof)
+{
+        line_t line;
+
+        while (_state.running && (_script_command_next(script, eof, &line))) {
+                if (_script_line_ignored(&line)) {
+                        continue;
+                }
+
+                const int exit_code = _line_execute(parser, &line);
+
+                if (exit_code != 0) {
+                        ssshell_exit(exit_code);
+                }
+        }
+}
+
+/* Only a command called with plain arguments fits in an operation. Forms
+ * and commands that take them are evaluated from the parsed line */
+static bool
+_script_form_compilable(const ast_node_t *form)
+{
+        if ((form->head == NULL) ||
+            (form->head->type != OBJECT_TYPE_COMMAND) ||
+            (form->head->as.command->form_func != NULL) ||
+            _form_background(form)) {
+                return false;
+        }
+
+        for (const ast_node_t *arg = form->args; arg != NULL; arg = arg->next) {
+                if (arg->type != AST_NODE_OBJECT) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/* Returns NULL if any command in the script doesn't parse, or can't be
+ * compiled, in which case it's left to run line by line. The script's buffer
+ * is left alone */
+static bytecode_t *
+_script_compile(parser_t *parser, const script_t *script, uint64_t hash)
+{
+        script_t copy = *script;
+
+        copy.buffer = malloc(script->capacity);
+        assert(copy.buffer != NULL);
+
+        (void)memcpy(copy.buffer, script->buffer, script->size);
+
+        bytecode_t *bytecode;
+        bytecode = bytecode_new(hash);
+
+        line_t line;
+
+        while (_script_command_next(&copy, true, &line)) {
+                if (_script_line_ignored(&line)) {
+                        continue;
+                }
+
+                const parser_ret_t parser_ret = parse(parser, line);
+
+                if (parser_ret == PARSER_RET_EOF) {
+                        continue;
+                }
+
+                /* Errors are reported when the script runs line by line */
+                if ((parser_ret != PARSER_RET_OK) ||
+                    !(_script_form_compilable(parser->root))) {
+                        bytecode_delete(bytecode);
+                        bytecode = NULL;
+                        break;
+                }
+
+                object_t *args_obj[COMMANDS_ARGS_MAX];
+                uint32_t argc;
+                argc = 0;
+
+                for (const ast_node_t *arg = parser->root->args; arg != NULL; arg = arg->next) {
+                        args_obj[argc] = arg->object;
+                        argc++;
+                }
+
+                bytecode_op_add(bytecode, parser->root->head->as.command,
+                    args_obj, argc);
+        }
+
+        free(copy.buffer);
+
+        if (bytecode != NULL) {
+                bytecode_link(bytecode);
+        }
+
+        return bytecode;
+}
+
+static void
+_bytecode_run(const bytecode_t *bytecode)
+{
+        /* Commands only look at the stream */
+        parser_stream_t stream;
+        const parser_t parser = {
+                .stream = &stream,
+                .lexer  = NULL,
+                .arena  = NULL
+        };
+
+        for (uint32_t i = 0; _state.running && (i < bytecode->op_count); i++) {
+                const bytecode_op_t * const op = &bytecode->ops[i];
+
+                stream.command_value = (env_pair_t) {
+                        .symbol = op->command->name,
+                        .value  = NULL
+                };
+
+                /* Variables are looked up as the script runs */
+                for (uint32_t j = 0; j < op->argc; j++) {
+                        stream.args_obj[j] =
+                            (object_t *)eval_object_get(&bytecode->objects[op->arg_index + j]);
+                }
+
+                stream.argc = op->argc;
+
+                const int exit_code = _exit_code_get(eval_command_run(&parser, op->command));
+
+                if (exit_code != 0) {
+                        ssshell_exit(exit_code);
+                }
+        }
+}
+
+/* Each client starts out as if it ran on its own, except that it shares
+ * the session. The background jobs it leaves are waited for, as they would
+ * be on exit */
+static int
+_daemon_commands_run(void *arg, const char *commands)
+{
+        parser_t * const parser = arg;
+
+        _state.running = true;
+        _state.exit_code = 0;
+
+        _script_string_run(parser, commands);
+
+        (void)jobs_wait(0);
+
+        return _state.exit_code;
+}
+
+static void
+_script_string_run(parser_t *parser, const char *commands)
+{
+        const size_t size = strlen(commands);
+
+        script_t script = {
+                .buffer     = malloc(size + 1),
+                .size       = size,
+                .capacity   = size + 1,
+                .line_start = 0,
+                .scan_pos   = 0,
+                .quoted     = false,
+                .escaped    = false
+        };
+
+        assert(script.buffer != NULL);
+
+        (void)memcpy(script.buffer, commands, size);
+
+        _script_lines_run(parser, &script, true);
+
+        free(script.buffer);
+}
+
+/* Reads the next block onto the end of the buffer, making room for it
+ * first. Returns the size read, zero at the end, or -1 */
+static ssize_t
+_script_block_read(script_t *script, int fd)
+{
+        if ((script->capacity - script->size) < (SCRIPT_BLOCK_SIZE + 1)) {
+                script->capacity += SCRIPT_BLOCK_SIZE;
+                script->buffer = realloc(script->buffer, script->capacity);
+                assert(script->buffer != NULL);
+        }
+
+        ssize_t read_size;
+
+        do {
+                read_size = read(fd, &script->buffer[script->size], SCRIPT_BLOCK_SIZE);
+        } while ((read_size < 0) && (errno == EINTR));
+
+        if (read_size > 0) {
+                script->size += read_size;
+        }
+
+        return read_size;
+}
+
+static void
+_script_fd_run(parser_t *parser, int fd)
+{
+        script_t script = {
+                .buffer     = malloc(SCRIPT_BLOCK_SIZE + 1),
+                .size       = 0,
+                .capacity   = SCRIPT_BLOCK_SIZE + 1,
+                .line_start = 0,
+                .scan_pos   = 0,
+                .quoted     = false,
+                .escaped    = false
+        };
+
+        assert(script.buffer != NULL);
+
+        while (_state.running) {
+                /* Move the partial command to the front before reading
+                 * more */
+                if (script.line_start > 0) {
+                        script.size -= script.line_start;
+                        script.scan_pos -= script.line_start;
+
+                        (void)memmove(script.buffer,
+                            &script.buffer[script.line_start],
+                            script.size);
+
+                        script.line_start = 0;
+                }
+
+                const ssize_t read_size = _script_block_read(&script, fd);
+
+                if (read_size < 0) {
+                        (void)fprintf(stderr, "%s\n", strerror(errno));
+
+                        ssshell_exit(SSSHELL_EXIT_FAILURE);
+                        break;
+                }
+
+                _script_lines_run(parser, &script, (read_size == 0));
+
+                if (read_size == 0) {
+                        break;
+                }
+        }
+
+        free(script.buffer);
+}
+
+/* A script file is read whole and compiled to bytecode, which is cached
+ * next to it. As long as the script doesn't change, later runs load the
+ * bytecode instead of parsing the script again */
+static void
+_script_file_run(parser_t *parser, int fd, const char *path)
+{
+        struct stat st;
+
+        if (((fstat(fd, &st)) < 0) || !(S_ISREG(st.st_mode))) {
+                _script_fd_run(parser, fd);
+
+                return;
+        }
+
+        script_t script = {
+                .buffer     = malloc(SCRIPT_BLOCK_SIZE + 1),
+                .size       = 0,
+                .capacity   = SCRIPT_BLOCK_SIZE + 1,
+                .line_start = 0,
+                .scan_pos   = 0,
+                .quoted     = false,
+                .escaped    = false
+        };
+
+        assert(script.buffer != NULL);
+
+        ssize_t read_size;
+
+        while ((read_size = _script_block_read(&script, fd)) > 0) {
+        }
+
+        if (read_size < 0) {
+                (void)fprintf(stderr, "%s: %s\n", path, strerror(errno));
+
+                ssshell_exit(SSSHELL_EXIT_FAILURE);
+
+                free(script.buffer);
+
+                return;
+        }
+
+        const size_t cache_path_size = strlen(path) + sizeof(SCRIPT_CACHE_SUFFIX);
+        char * const cache_path = malloc(cache_path_size);
+        assert(cache_path != NULL);
+
+        (void)snprintf(cache_path, cache_path_size, "%s" SCRIPT_CACHE_SUFFIX, path);
+
+        const uint64_t hash = bytecode_hash(script.buffer, script.size);
+
+        bytecode_t *bytecode;
+
+        if ((bytecode = bytecode_load(cache_path, hash)) == NULL) {
+                if ((bytecode = _script_compile(parser, &script, hash)) != NULL) {
+                        /* Not being able to cache it isn't an error */
+                        (void)bytecode_save(bytecode, cache_path);
+                }
+        }
+
+        if (bytecode != NULL) {
+                _bytecode_run(bytecode);
+        } else {
+                _script_lines_run(parser, &script, true);
+        }
+
+        bytecode_delete(bytecode);
+        free(cache_path);
+        free(script.buffer);
+}
@@ -0,0 +1,644 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif /* !_WIN32 */
+
+#include "symbols.h"
+
+#define SYMBOLS_ENTRY_SIZE      16
+
+#define SYMBOLS_STT_NOTYPE      0
+#define SYMBOLS_STT_OBJECT      1
+#define SYMBOLS_STT_FUNC        2
+
+#define SYMBOLS_SHN_UNDEF       0
+#define SYMBOLS_SHN_LORESERVE   0xFF00
+#define SYMBOLS_SHN_ABS         0xFFF1
+
+static struct {
+        symbols_t *loaded;
+
+        dwarf_t *dwarf;
+        bool dwarf_read;
+} _state;
+
+static bool _text_load(symbols_t *symbols, const char *path);
+static void _text_unload(symbols_t *symbols);
+
+static int
+_symbol_compare(const void *a, const void *b)
+{
+        const symbol_t * const symbol_a = a;
+        const symbol_t * const symbol_b = b;
+
+        if (symbol_a->address != symbol_b->address) {
+                return (symbol_a->address < symbol_b->address) ? -1 : 1;
+        }
+
+        /* Of symbols at the same address, the sized one describes it best */
+        if (symbol_a->size != symbol_b->size) {
+                return (symbol_a->size > symbol_b->size) ? -1 : 1;
+        }
+
+        return strcmp(symbol_a->name, symbol_b->name);
+}
+
+static bool
+_symbols_parse(symbols_t *symbols)
+{
+        const elf_t * const elf = symbols->elf;
+
+        const elf_section_t *symtab;
+        symtab = NULL;
+
+        for (uint32_t i = 0; i < elf->section_count; i++) {
+                if (elf->sections[i].type == ELF_SHT_SYMTAB) {
+                        symtab = &elf->sections[i];
+                        break;
+                }
+        }
+
+        if ((symtab == NULL) || (symtab->data == NULL) ||
+            (symtab->link >= elf->section_count)) {
+                return false;
+        }
+
+        const elf_section_t * const strtab = &elf->sections[symtab->link];
+
+        if (strtab->data == NULL) {
+                return false;
+        }
+
+        const uint32_t entry_count = symtab->size / SYMBOLS_ENTRY_SIZE;
+
+        if ((symbols->symbols = malloc(entry_count * sizeof(symbol_t))) == NULL) {
+                return false;
+        }
+
+        for (uint32_t i = 0; i < entry_count; i++) {
+                const uint8_t * const entry = &symtab->data[i * SYMBOLS_ENTRY_SIZE];
+
+                const uint32_t name_offset = elf_u32_get(elf, &entry[0x00]);
+                const uint32_t type = entry[0x0C] & 0x0F;
+                const uint16_t shndx = elf_u16_get(elf, &entry[0x0E]);
+
+                if ((type != SYMBOLS_STT_NOTYPE) && (type != SYMBOLS_STT_OBJECT) &&
+                    (type != SYMBOLS_STT_FUNC)) {
+                        continue;
+                }
+
+                if ((shndx == SYMBOLS_SHN_UNDEF) ||
+                    ((shndx >= SYMBOLS_SHN_LORESERVE) && (shndx != SYMBOLS_SHN_ABS))) {
+                        continue;
+                }
+
+                if ((name_offset == 0) || (name_offset >= strtab->size) ||
+                    ((memchr(&strtab->data[name_offset], '\0', strtab->size - name_offset)) == NULL)) {
+                        continue;
+                }
+
+                const char * const name = (const char *)&strtab->data[name_offset];
+
+                /* Local labels only add noise */
+                if ((name[0] == '$') || ((strncmp(name, ".L", 2)) == 0)) {
+                        continue;
+                }
+
+                symbols->symbols[symbols->count] = (symbol_t) {
+                        .address = elf_u32_get(elf, &entry[0x04]),
+                        .size    = elf_u32_get(elf, &entry[0x08]),
+                        .name    = name
+                };
+
+                symbols->count++;
+        }
+
+        qsort(symbols->symbols, symbols->count, sizeof(symbol_t), _symbol_compare);
+
+        return true;
+}
+
+static bool
+_token_hex_parse(const char *p, const char *end, uint32_t *value)
+{
+        if (((end - p) > 2) && (p[0] == '0') && ((p[1] == 'x') || (p[1] == 'X'))) {
+                p += 2;
+        }
+
+        /* Linker maps print 64-bit addresses on 64-bit hosts */
+        uint64_t result;
+        result = 0;
+
+        if ((p == end) || ((end - p) > 16)) {
+                return false;
+        }
+
+        for (; p < end; p++) {
+                const char c = *p;
+
+                uint32_t digit;
+
+                if ((c >= '0') && (c <= '9')) {
+                        digit = c - '0';
+                } else if ((c >= 'a') && (c <= 'f')) {
+                        digit = c - 'a' + 10;
+                } else if ((c >= 'A') && (c <= 'F')) {
+                        digit = c - 'A' + 10;
+                } else {
+                        return false;
+                }
+
+                result = (result << 4) | digit;
+        }
+
+        if (result > UINT32_MAX) {
+                return false;
+        }
+
+        *value = result;
+
+        return true;
+}
+
+/* Two kinds of map files are understood. Symbol lines from a GNU ld map:
+ *
+ *                 0x0000000006004000                _main
+ *
+ * and nm output:
+ *
+ *   06004000 T _main
+ *
+ * Everything else (section lines, assignments, headers) has a different
+ * number of fields, or fields of the wrong shape, and is skipped. Names are
+ * terminated in place, in the private mapping of the file */
+static bool
+_map_parse(symbols_t *symbols)
+{
+        char * const text = symbols->text;
+        char * const text_end = text + symbols->text_size;
+
+        uint32_t capacity;
+        capacity = 1024;
+
+        if ((symbols->symbols = malloc(capacity * sizeof(symbol_t))) == NULL) {
+                return false;
+        }
+
+        char *line;
+        line = text;
+
+        while (line < text_end) {
+                char *line_end;
+
+                if ((line_end = memchr(line, '\n', text_end - line)) == NULL) {
+                        line_end = text_end;
+                }
+
+                char *fields[4];
+                char *fields_end[4];
+                uint32_t field_count;
+                field_count = 0;
+
+                char *p;
+                p = line;
+
+                while (p < line_end) {
+                        while ((p < line_end) && ((*p == ' ') || (*p == '\t') || (*p == '\r'))) {
+                                p++;
+                        }
+
+                        if (p == line_end) {
+                                break;
+                        }
+
+                        if (field_count == 4) {
+                                field_count++;
+                                break;
+                        }
+
+                        fields[field_count] = p;
+
+                        while ((p < line_end) && (*p != ' ') && (*p != '\t') && (*p != '\r')) {
+                                p++;
+                        }
+
+                        fields_end[field_count] = p;
+                        field_count++;
+                }
+
+                line = line_end + 1;
+
+                uint32_t name_field;
+
+                if ((field_count == 2) && ((fields_end[0] - fields[0]) > 2) &&
+                    ((strncmp(fields[0], "0x", 2)) == 0)) {
+                        name_field = 1;
+                } else if ((field_count == 3) && ((fields_end[1] - fields[1]) == 1) &&
+                           ((strchr("Uuvw", *fields[1])) == NULL)) {
+                        name_field = 2;
+                } else {
+                        continue;
+                }
+
+                uint32_t address;
+
+                if (!(_token_hex_parse(fields[0], fields_end[0], &address))) {
+                        continue;
+                }
+
+                char * const name = fields[name_field];
+                char * const name_end = fields_end[name_field];
+
+                /* A name running into the end of the file has nowhere to
+                 * be terminated */
+                if (name_end == text_end) {
+                        continue;
+                }
+
+                if ((name[0] == '$') || ((strncmp(name, ".L", 2)) == 0) ||
+                    ((memchr(name, '=', name_end - name)) != NULL)) {
+                        continue;
+                }
+
+                *name_end = '\0';
+
+                if (symbols->count == capacity) {
+                        symbol_t * const grown =
+                            realloc(symbols->symbols, (capacity * 2) * sizeof(symbol_t));
+
+                        if (grown == NULL) {
+                                return false;
+                        }
+
+                        symbols->symbols = grown;
+                        capacity *= 2;
+                }
+
+                symbols->symbols[symbols->count] = (symbol_t) {
+                        .address = address,
+                        .size    = 0,
+                        .name    = name
+                };
+
+                symbols->count++;
+        }
+
+        qsort(symbols->symbols, symbols->count, sizeof(symbol_t), _symbol_compare);
+
+        return true;
+}
+
+/* FNV-1a */
+static uint32_t
+_name_hash(const char *name)
+{
+        uint32_t hash;
+        hash = 0x811C9DC5;
+
+        for (; *name != '\0'; name++) {
+                hash = (hash ^ (uint8_t)*name) * 0x01000193;
+        }
+
+        return hash;
+}
+
+static bool
+_index_build(symbols_t *symbols)
+{
+        /* Kept at most half full */
+        uint32_t slot_count;
+        slot_count = 16;
+
+        while (slot_count < (symbols->count * 2)) {
+                slot_count *= 2;
+        }
+
+        if ((symbols->index = calloc(slot_count, sizeof(uint32_t))) == NULL) {
+                return false;
+        }
+
+        symbols->index_mask = slot_count - 1;
+
+        for (uint32_t i = 0; i < symbols->count; i++) {
+                const char * const name = symbols->symbols[i].name;
+
+                uint32_t slot;
+                slot = _name_hash(name) & symbols->index_mask;
+
+                /* Of symbols sharing a name, the one at the lowest address
+                 * wins */
+                while (symbols->index[slot] != 0) {
+                        if ((strcmp(symbols->symbols[symbols->index[slot] - 1].name, name)) == 0) {
+                                break;
+                        }
+
+                        slot = (slot + 1) & symbols->index_mask;
+                }
+
+                if (symbols->index[slot] == 0) {
+                        symbols->index[slot] = i + 1;
+                }
+        }
+
+        return true;
+}
+
+symbols_t *
+symbols_elf_load(const char *path)
+{
+        assert(path != NULL);
+
+        symbols_t * const symbols = calloc(1, sizeof(symbols_t));
+
+        if (symbols == NULL) {
+                return NULL;
+        }
+
+        if ((symbols->elf = elf_open(path)) == NULL) {
+                free(symbols);
+
+                return NULL;
+        }
+
+        if (!(_symbols_parse(symbols)) || !(_index_build(symbols))) {
+                symbols_delete(symbols);
+
+                return NULL;
+        }
+
+        symbols->path = strdup(path);
+
+        return symbols;
+}
+
+symbols_t *
+symbols_map_load(const char *path)
+{
+        assert(path != NULL);
+
+        symbols_t * const symbols = calloc(1, sizeof(symbols_t));
+
+        if (symbols == NULL) {
+                return NULL;
+        }
+
+        if (!(_text_load(symbols, path))) {
+                free(symbols);
+
+                return NULL;
+        }
+
+        if (!(_map_parse(symbols)) || !(_index_build(symbols))) {
+                symbols_delete(symbols);
+
+                return NULL;
+        }
+
+        symbols->path = strdup(path);
+
+        return symbols;
+}
+
+symbols_t *
+symbols_load(const char *path)
+{
+        assert(path != NULL);
+
+        FILE * const fp = fopen(path, "rb");
+
+        if (fp == NULL) {
+                return NULL;
+        }
+
+        char magic[4];
+
+        const bool is_elf = ((fread(magic, 1, sizeof(magic), fp)) == sizeof(magic)) &&
+                            ((memcmp(magic, "\177ELF", sizeof(magic))) == 0);
+
+        (void)fclose(fp);
+
+        return (is_elf) ? symbols_elf_load(path) : symbols_map_load(path);
+}
+
+void
+symbols_delete(symbols_t *symbols)
+{
+        if (symbols == NULL) {
+                return;
+        }
+
+        elf_close(symbols->elf);
+        _text_unload(symbols);
+        free(symbols->path);
+        free(symbols->symbols);
+        free(symbols->index);
+        free(symbols);
+}
+
+const symbol_t *
+symbols_address_find(const symbols_t *symbols, uint32_t address)
+{
+        assert(symbols != NULL);
+
+        /* The last symbol at or below the address */
+        uint32_t low;
+        low = 0;
+        uint32_t high;
+        high = symbols->count;
+
+        while (low < high) {
+                const uint32_t mid = low + ((high - low) / 2);
+
+                if (symbols->symbols[mid].address <= address) {
+                        low = mid + 1;
+                } else {
+                        high = mid;
+                }
+        }
+
+        if (low == 0) {
+                return NULL;
+        }
+
+        /* Prefer the first of the symbols at that address */
+        uint32_t i;
+        i = low - 1;
+
+        while ((i > 0) && (symbols->symbols[i - 1].address == symbols->symbols[i].address)) {
+                i--;
+        }
+
+        const symbol_t * const symbol = &symbols->symbols[i];
+
+        /* Sized symbols only cover their own range. Labels cover everything
+         * up to the next symbol */
+        if ((symbol->size != 0) && ((address - symbol->address) >= symbol->size)) {
+                return NULL;
+        }
+
+        return symbol;
+}
+
+const symbol_t *
+symbols_name_find(const symbols_t *symbols, const char *name)
+{
+        assert(symbols != NULL);
+        assert(name != NULL);
+
+        uint32_t slot;
+        slot = _name_hash(name) & symbols->index_mask;
+
+        while (symbols->index[slot] != 0) {
+                const symbol_t * const symbol = &symbols->symbols[symbols->index[slot] - 1];
+
+                if ((strcmp(symbol->name, name)) == 0) {
+                        return symbol;
+                }
+
+                slot = (slot + 1) & symbols->index_mask;
+        }
+
+        return NULL;
+}
+
+void
+symbols_loaded_set(symbols_t *symbols)
+{
+        if (_state.loaded != symbols) {
+                dwarf_delete(_state.dwarf);
+                symbols_delete(_state.loaded);
+
+                _state.dwarf = NULL;
+                _state.dwarf_read = false;
+        }
+
+        _state.loaded = symbols;
+}
+
+const symbols_t *
+symbols_loaded_get(void)
+{
+        return _state.loaded;
+}
+
+dwarf_t *
+symbols_loaded_dwarf_get(void)
+{
+        if ((_state.loaded == NULL) || (_state.loaded->elf == NULL)) {
+                return NULL;
+        }
+
+        if (!_state.dwarf_read) {
+                _state.dwarf = dwarf_new(_state.loaded->elf);
+                _state.dwarf_read = true;
+        }
+
+        return _state.dwarf;
+}
+
+#if !defined(_WIN32)
+static bool
+_text_load(symbols_t *symbols, const char *path)
+{
+        const int fd = open(path, O_RDONLY);
+
+        if (fd < 0) {
+                return false;
+        }
+
+        struct stat stat_buffer;
+
+        if (((fstat(fd, &stat_buffer)) != 0) || !S_ISREG(stat_buffer.st_mode) ||
+            (stat_buffer.st_size == 0)) {
+                (void)close(fd);
+
+                return false;
+        }
+
+        /* Private and writable, so names can be terminated in place without
+         * touching the file */
+        void * const text = mmap(NULL, stat_buffer.st_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE, fd, 0);
+
+        (void)close(fd);
+
+        if (text == MAP_FAILED) {
+                return false;
+        }
+
+        symbols->text = text;
+        symbols->text_size = stat_buffer.st_size;
+        symbols->mapped = true;
+
+        return true;
+}
+
+static void
+_text_unload(symbols_t *symbols)
+{
+        if (symbols->text == NULL) {
+                return;
+        }
+
+        if (symbols->mapped) {
+                (void)munmap(symbols->text, symbols->text_size);
+        } else {
+                free(symbols->text);
+        }
+
+        symbols->text = NULL;
+}
+#else
+static bool
+_text_load(symbols_t *symbols, const char *path)
+{
+        FILE * const fp = fopen(path, "rb");
+
+        if (fp == NULL) {
+                return false;
+        }
+
+        long size;
+
+        if (((fseek(fp, 0, SEEK_END)) != 0) || ((size = ftell(fp)) <= 0)) {
+                (void)fclose(fp);
+
+                return false;
+        }
+
+        rewind(fp);
+
+        char * const text = malloc(size);
+
+        if ((text == NULL) || ((fread(text, 1, size, fp)) != (size_t)size)) {
+                free(text);
+                (void)fclose(fp);
+
+                return false;
+        }
+
+        (void)fclose(fp);
+
+        symbols->text = text;
+        symbols->text_size = size;
+        symbols->mapped = false;
+
+        return true;
+}
+
+static void
+_text_unload(symbols_t *symbols)
+{
+        free(symbols->text);
+
+        symbols->text = NULL;
+}
+#endif /* !_WIN32 */
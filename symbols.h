@@ -0,0 +1,53 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dwarf.h"
+#include "elf.h"
+
+typedef struct {
+        uint32_t address;
+        uint32_t size;
+        const char *name;
+} symbol_t;
+
+typedef struct {
+        char *path;
+
+        /* Names point into either the ELF image or the map file's text */
+        elf_t *elf;
+        char *text;
+        size_t text_size;
+        bool mapped;
+
+        /* Sorted by address */
+        symbol_t *symbols;
+        uint32_t count;
+
+        /* Open-addressed hash of names. Each slot holds an index into
+         * symbols[] plus one, zero being empty */
+        uint32_t *index;
+        uint32_t index_mask;
+} symbols_t;
+
+symbols_t *symbols_load(const char *path);
+symbols_t *symbols_elf_load(const char *path);
+symbols_t *symbols_map_load(const char *path);
+void symbols_delete(symbols_t *symbols);
+
+const symbol_t *symbols_address_find(const symbols_t *symbols, uint32_t address);
+const symbol_t *symbols_name_find(const symbols_t *symbols, const char *name);
+
+/* The symbols the shell currently knows about. Setting replaces (and
+ * deletes) whatever was loaded before */
+void symbols_loaded_set(symbols_t *symbols);
+const symbols_t *symbols_loaded_get(void);
+
+/* Debug information of the loaded ELF file, read the first time it's asked
+ * for. NULL for map files, or ELF files without any */
+dwarf_t *symbols_loaded_dwarf_get(void);
+
+#endif /* SYMBOLS_H */
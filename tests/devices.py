@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# Drives simulated devices with `ssshell -s`, and checks that `dev all` runs
+# an upload on every device, that `dev use` picks out one device, and that
+# uploads to several devices run at the same time.
+#
+# A simulated device transfers 1MiB/s, so uploading to four devices one after
+# the other would take four times as long as uploading to one.
+#
+# Usage: devices.py <ssshell>
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+DEVICE_COUNT = 4
+
+# Half a second of transfer per device
+IMAGE_SIZE = 512 * 1024
+PATCH_SIZE = 4
+
+# How much longer than one device all of them may take
+CONCURRENCY_SLACK = 1.5
+
+
+def ssshell(path, count, cwd, commands):
+    start = time.monotonic()
+    result = subprocess.run([path, "-s", str(count), "-c", commands],
+                            cwd=cwd, capture_output=True, text=True, timeout=60)
+    elapsed = time.monotonic() - start
+
+    return result, elapsed
+
+
+def fail(message, result=None):
+    print("FAIL: %s" % message)
+
+    if result is not None:
+        print("exit code %i" % result.returncode)
+        print(result.stdout, end="")
+        print(result.stderr, end="")
+
+    sys.exit(1)
+
+
+def compare_commands(device, size, path):
+    return "dev use %u; compare (download *hwram* %u) \"%s\"" % (device, size, path)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("Usage: %s <ssshell>" % sys.argv[0], file=sys.stderr)
+        sys.exit(2)
+
+    path = os.path.abspath(sys.argv[1])
+
+    with tempfile.TemporaryDirectory() as cwd:
+        with open(os.path.join(cwd, "image.bin"), "wb") as f:
+            f.write(os.urandom(IMAGE_SIZE))
+
+        with open(os.path.join(cwd, "patch.bin"), "wb") as f:
+            f.write(os.urandom(PATCH_SIZE))
+
+        upload = "dev all; upload *hwram* \"image.bin\""
+
+        # Every device gets the image, then only the first gets the patch
+        commands = [upload, "dev use 1; upload *hwram* \"patch.bin\""]
+        commands.append(compare_commands(1, PATCH_SIZE, "patch.bin"))
+
+        for device in range(2, DEVICE_COUNT + 1):
+            commands.append(compare_commands(device, IMAGE_SIZE, "image.bin"))
+
+        result, _ = ssshell(path, DEVICE_COUNT, cwd, "; ".join(commands))
+
+        if result.returncode != 0:
+            fail("dev all and dev use", result)
+
+        identical = result.stdout.count("Identical")
+
+        if identical != DEVICE_COUNT:
+            fail("%i of %i devices hold what was uploaded to them" %
+                 (identical, DEVICE_COUNT), result)
+
+        # The patch must not have reached any other device
+        result, _ = ssshell(path, DEVICE_COUNT, cwd,
+                            upload + "; dev use 1; upload *hwram* \"patch.bin\"; " +
+                            compare_commands(2, PATCH_SIZE, "patch.bin"))
+
+        if ("First difference" not in result.stdout) or (result.returncode == 0):
+            fail("dev use 1 uploaded to device 2", result)
+
+        result, one_elapsed = ssshell(path, 1, cwd, upload)
+
+        if result.returncode != 0:
+            fail("upload to one device", result)
+
+        result, all_elapsed = ssshell(path, DEVICE_COUNT, cwd, upload)
+
+        if result.returncode != 0:
+            fail("upload to %i devices" % DEVICE_COUNT, result)
+
+        if all_elapsed > (one_elapsed * CONCURRENCY_SLACK):
+            fail("upload to %i devices took %.2fs, and to one %.2fs" %
+                 (DEVICE_COUNT, all_elapsed, one_elapsed))
+
+        print("upload to %i devices took %.2fs, and to one %.2fs" %
+              (DEVICE_COUNT, all_elapsed, one_elapsed))
+
+
+if __name__ == "__main__":
+    main()
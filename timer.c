@@ -0,0 +1,20 @@
+#include <time.h>
+#include <unistd.h>
+
+#include "timer.h"
+
+uint64_t
+timer_us_get(void)
+{
+        struct timespec ts;
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+void
+timer_sleep(uint32_t us)
+{
+        (void)usleep(us);
+}
@@ -0,0 +1,9 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+uint64_t timer_us_get(void);
+void timer_sleep(uint32_t us);
+
+#endif /* TIMER_H */
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+#
+# Generates the command lookup table: a perfect hash over every command name
+# and alias, taken from the command_t definitions in the given sources.
+#
+# The hash is FNV-1a with a seed mixed into the offset basis. A seed is
+# searched for so that no two names land in the same slot, which leaves one
+# hash and one string compare per lookup. commands.c must compute the hash
+# the same way.
+#
+# Usage: commands-table.py <command.c>... <output.h>
+
+import re
+import sys
+
+FNV_OFFSET_BASIS = 0x811C9DC5
+FNV_PRIME = 0x01000193
+
+SEED_TRIES = 100000
+
+DEFINITION_RE = re.compile(r"const\s+command_t\s+(\w+)\s*=\s*\{(.*?)\};", re.S)
+FIELD_RE = re.compile(r"\.(name|alias)\s*=\s*\"((?:[^\"\\]|\\.)*)\"")
+
+
+def fnv1a(seed, name):
+    value = FNV_OFFSET_BASIS ^ seed
+
+    for byte in name.encode():
+        value = ((value ^ byte) * FNV_PRIME) & 0xFFFFFFFF
+
+    return value
+
+
+def c_unescape(literal):
+    return literal.encode().decode("unicode_escape")
+
+
+def commands_read(paths):
+    keys = []
+
+    for path in paths:
+        with open(path, encoding="utf-8") as f:
+            source = f.read()
+
+        for match in DEFINITION_RE.finditer(source):
+            symbol = match.group(1)
+            fields = dict(FIELD_RE.findall(match.group(2)))
+
+            if "name" not in fields:
+                sys.exit("%s: %s has no name" % (path, symbol))
+
+            keys.append((fields["name"], symbol))
+
+            if fields.get("alias"):
+                keys.append((fields["alias"], symbol))
+
+    names = [c_unescape(name) for name, _ in keys]
+
+    for name in names:
+        if names.count(name) > 1:
+            sys.exit("Command name or alias \"%s\" is used more than once" % name)
+
+    return keys
+
+
+def seed_find(keys):
+    size = 16
+
+    while size < (len(keys) * 2):
+        size *= 2
+
+    while True:
+        for seed in range(SEED_TRIES):
+            slots = set()
+
+            for name, _ in keys:
+                slot = fnv1a(seed, c_unescape(name)) & (size - 1)
+
+                if slot in slots:
+                    break
+
+                slots.add(slot)
+            else:
+                return seed, size
+
+        size *= 2
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit("Usage: %s <command.c>... <output.h>" % sys.argv[0])
+
+    keys = commands_read(sys.argv[1:-1])
+    seed, size = seed_find(keys)
+
+    lines = [
+        "/* Generated by tools/commands-table.py. Do not edit */",
+        "",
+        "#define COMMANDS_HASH_SEED 0x%08Xu" % seed,
+        "#define COMMANDS_HASH_SIZE %u" % size,
+        "",
+    ]
+
+    for symbol in sorted(set(symbol for _, symbol in keys)):
+        lines.append("extern const command_t %s;" % symbol)
+
+    lines += [
+        "",
+        "static const commands_entry_t _commands_table[COMMANDS_HASH_SIZE] = {",
+    ]
+
+    # Names are written out as they were in the source
+    entries = sorted((fnv1a(seed, c_unescape(name)) & (size - 1), name, symbol)
+                     for name, symbol in keys)
+
+    for slot, name, symbol in entries:
+        lines.append("        [%u] = {" % slot)
+        lines.append("                .name   = \"%s\"," % name)
+        lines.append("                .object = {")
+        lines.append("                        .type       = OBJECT_TYPE_COMMAND,")
+        lines.append("                        .as.command = &%s" % symbol)
+        lines.append("                }")
+        lines.append("        },")
+
+    lines += [
+        "};",
+        "",
+    ]
+
+    with open(sys.argv[-1], "w", encoding="utf-8") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+#
+# Generates the SH-2 decode table: one entry per 16-bit opcode, pointing into
+# a table of instruction formats.
+#
+# In operands, %n and %m are the registers in bits 11-8 and 7-4, whatever
+# their role. The other conversions are:
+#
+#   %i  Signed 8-bit immediate
+#   %u  Unsigned 8-bit immediate
+#   %b  4-bit displacement, scaled by 1
+#   %w  4-bit displacement, scaled by 2
+#   %l  4-bit displacement, scaled by 4
+#   %B  8-bit displacement, scaled by 1
+#   %W  8-bit displacement, scaled by 2
+#   %L  8-bit displacement, scaled by 4
+#   %j  8-bit branch target
+#   %J  12-bit branch target
+#   %p  PC-relative word
+#   %P  PC-relative long
+#   %A  PC-relative address (mova)
+#   %o  The opcode itself
+
+import sys
+
+INSNS = [
+    # Data transfer
+    ("1110nnnniiiiiiii", "mov",      "#%i,%n"),
+    ("1001nnnndddddddd", "mov.w",    "%p,%n"),
+    ("1101nnnndddddddd", "mov.l",    "%P,%n"),
+    ("0110nnnnmmmm0011", "mov",      "%m,%n"),
+    ("0010nnnnmmmm0000", "mov.b",    "%m,@%n"),
+    ("0010nnnnmmmm0001", "mov.w",    "%m,@%n"),
+    ("0010nnnnmmmm0010", "mov.l",    "%m,@%n"),
+    ("0110nnnnmmmm0000", "mov.b",    "@%m,%n"),
+    ("0110nnnnmmmm0001", "mov.w",    "@%m,%n"),
+    ("0110nnnnmmmm0010", "mov.l",    "@%m,%n"),
+    ("0010nnnnmmmm0100", "mov.b",    "%m,@-%n"),
+    ("0010nnnnmmmm0101", "mov.w",    "%m,@-%n"),
+    ("0010nnnnmmmm0110", "mov.l",    "%m,@-%n"),
+    ("0110nnnnmmmm0100", "mov.b",    "@%m+,%n"),
+    ("0110nnnnmmmm0101", "mov.w",    "@%m+,%n"),
+    ("0110nnnnmmmm0110", "mov.l",    "@%m+,%n"),
+    ("10000000nnnndddd", "mov.b",    "r0,@(%b,%m)"),
+    ("10000001nnnndddd", "mov.w",    "r0,@(%w,%m)"),
+    ("0001nnnnmmmmdddd", "mov.l",    "%m,@(%l,%n)"),
+    ("10000100mmmmdddd", "mov.b",    "@(%b,%m),r0"),
+    ("10000101mmmmdddd", "mov.w",    "@(%w,%m),r0"),
+    ("0101nnnnmmmmdddd", "mov.l",    "@(%l,%m),%n"),
+    ("0000nnnnmmmm0100", "mov.b",    "%m,@(r0,%n)"),
+    ("0000nnnnmmmm0101", "mov.w",    "%m,@(r0,%n)"),
+    ("0000nnnnmmmm0110", "mov.l",    "%m,@(r0,%n)"),
+    ("0000nnnnmmmm1100", "mov.b",    "@(r0,%m),%n"),
+    ("0000nnnnmmmm1101", "mov.w",    "@(r0,%m),%n"),
+    ("0000nnnnmmmm1110", "mov.l",    "@(r0,%m),%n"),
+    ("11000000dddddddd", "mov.b",    "r0,@(%B,gbr)"),
+    ("11000001dddddddd", "mov.w",    "r0,@(%W,gbr)"),
+    ("11000010dddddddd", "mov.l",    "r0,@(%L,gbr)"),
+    ("11000100dddddddd", "mov.b",    "@(%B,gbr),r0"),
+    ("11000101dddddddd", "mov.w",    "@(%W,gbr),r0"),
+    ("11000110dddddddd", "mov.l",    "@(%L,gbr),r0"),
+    ("11000111dddddddd", "mova",     "%A,r0"),
+    ("0000nnnn00101001", "movt",     "%n"),
+    ("0110nnnnmmmm1000", "swap.b",   "%m,%n"),
+    ("0110nnnnmmmm1001", "swap.w",   "%m,%n"),
+    ("0010nnnnmmmm1101", "xtrct",    "%m,%n"),
+
+    # Arithmetic
+    ("0011nnnnmmmm1100", "add",      "%m,%n"),
+    ("0111nnnniiiiiiii", "add",      "#%i,%n"),
+    ("0011nnnnmmmm1110", "addc",     "%m,%n"),
+    ("0011nnnnmmmm1111", "addv",     "%m,%n"),
+    ("10001000iiiiiiii", "cmp/eq",   "#%i,r0"),
+    ("0011nnnnmmmm0000", "cmp/eq",   "%m,%n"),
+    ("0011nnnnmmmm0010", "cmp/hs",   "%m,%n"),
+    ("0011nnnnmmmm0011", "cmp/ge",   "%m,%n"),
+    ("0011nnnnmmmm0110", "cmp/hi",   "%m,%n"),
+    ("0011nnnnmmmm0111", "cmp/gt",   "%m,%n"),
+    ("0100nnnn00010101", "cmp/pl",   "%n"),
+    ("0100nnnn00010001", "cmp/pz",   "%n"),
+    ("0010nnnnmmmm1100", "cmp/str",  "%m,%n"),
+    ("0011nnnnmmmm0100", "div1",     "%m,%n"),
+    ("0010nnnnmmmm0111", "div0s",    "%m,%n"),
+    ("0000000000011001", "div0u",    ""),
+    ("0011nnnnmmmm1101", "dmuls.l",  "%m,%n"),
+    ("0011nnnnmmmm0101", "dmulu.l",  "%m,%n"),
+    ("0100nnnn00010000", "dt",       "%n"),
+    ("0110nnnnmmmm1110", "exts.b",   "%m,%n"),
+    ("0110nnnnmmmm1111", "exts.w",   "%m,%n"),
+    ("0110nnnnmmmm1100", "extu.b",   "%m,%n"),
+    ("0110nnnnmmmm1101", "extu.w",   "%m,%n"),
+    ("0000nnnnmmmm1111", "mac.l",    "@%m+,@%n+"),
+    ("0100nnnnmmmm1111", "mac.w",    "@%m+,@%n+"),
+    ("0000nnnnmmmm0111", "mul.l",    "%m,%n"),
+    ("0010nnnnmmmm1111", "muls.w",   "%m,%n"),
+    ("0010nnnnmmmm1110", "mulu.w",   "%m,%n"),
+    ("0110nnnnmmmm1011", "neg",      "%m,%n"),
+    ("0110nnnnmmmm1010", "negc",     "%m,%n"),
+    ("0011nnnnmmmm1000", "sub",      "%m,%n"),
+    ("0011nnnnmmmm1010", "subc",     "%m,%n"),
+    ("0011nnnnmmmm1011", "subv",     "%m,%n"),
+
+    # Logic
+    ("0010nnnnmmmm1001", "and",      "%m,%n"),
+    ("11001001iiiiiiii", "and",      "#%u,r0"),
+    ("11001101iiiiiiii", "and.b",    "#%u,@(r0,gbr)"),
+    ("0110nnnnmmmm0111", "not",      "%m,%n"),
+    ("0010nnnnmmmm1011", "or",       "%m,%n"),
+    ("11001011iiiiiiii", "or",       "#%u,r0"),
+    ("11001111iiiiiiii", "or.b",     "#%u,@(r0,gbr)"),
+    ("0100nnnn00011011", "tas.b",    "@%n"),
+    ("0010nnnnmmmm1000", "tst",      "%m,%n"),
+    ("11001000iiiiiiii", "tst",      "#%u,r0"),
+    ("11001100iiiiiiii", "tst.b",    "#%u,@(r0,gbr)"),
+    ("0010nnnnmmmm1010", "xor",      "%m,%n"),
+    ("11001010iiiiiiii", "xor",      "#%u,r0"),
+    ("11001110iiiiiiii", "xor.b",    "#%u,@(r0,gbr)"),
+
+    # Shift
+    ("0100nnnn00000100", "rotl",     "%n"),
+    ("0100nnnn00000101", "rotr",     "%n"),
+    ("0100nnnn00100100", "rotcl",    "%n"),
+    ("0100nnnn00100101", "rotcr",    "%n"),
+    ("0100nnnn00100000", "shal",     "%n"),
+    ("0100nnnn00100001", "shar",     "%n"),
+    ("0100nnnn00000000", "shll",     "%n"),
+    ("0100nnnn00000001", "shlr",     "%n"),
+    ("0100nnnn00001000", "shll2",    "%n"),
+    ("0100nnnn00001001", "shlr2",    "%n"),
+    ("0100nnnn00011000", "shll8",    "%n"),
+    ("0100nnnn00011001", "shlr8",    "%n"),
+    ("0100nnnn00101000", "shll16",   "%n"),
+    ("0100nnnn00101001", "shlr16",   "%n"),
+
+    # Branch
+    ("10001011dddddddd", "bf",       "%j"),
+    ("10001111dddddddd", "bf/s",     "%j"),
+    ("10001001dddddddd", "bt",       "%j"),
+    ("10001101dddddddd", "bt/s",     "%j"),
+    ("1010dddddddddddd", "bra",      "%J"),
+    ("1011dddddddddddd", "bsr",      "%J"),
+    ("0000nnnn00100011", "braf",     "%n"),
+    ("0000nnnn00000011", "bsrf",     "%n"),
+    ("0100nnnn00101011", "jmp",      "@%n"),
+    ("0100nnnn00001011", "jsr",      "@%n"),
+    ("0000000000001011", "rts",      ""),
+
+    # System control
+    ("0000000000101000", "clrmac",   ""),
+    ("0000000000001000", "clrt",     ""),
+    ("0000000000011000", "sett",     ""),
+    ("0000000000001001", "nop",      ""),
+    ("0000000000101011", "rte",      ""),
+    ("0000000000011011", "sleep",    ""),
+    ("0100nnnn00001110", "ldc",      "%n,sr"),
+    ("0100nnnn00011110", "ldc",      "%n,gbr"),
+    ("0100nnnn00101110", "ldc",      "%n,vbr"),
+    ("0100nnnn00000111", "ldc.l",    "@%n+,sr"),
+    ("0100nnnn00010111", "ldc.l",    "@%n+,gbr"),
+    ("0100nnnn00100111", "ldc.l",    "@%n+,vbr"),
+    ("0100nnnn00001010", "lds",      "%n,mach"),
+    ("0100nnnn00011010", "lds",      "%n,macl"),
+    ("0100nnnn00101010", "lds",      "%n,pr"),
+    ("0100nnnn00000110", "lds.l",    "@%n+,mach"),
+    ("0100nnnn00010110", "lds.l",    "@%n+,macl"),
+    ("0100nnnn00100110", "lds.l",    "@%n+,pr"),
+    ("0000nnnn00000010", "stc",      "sr,%n"),
+    ("0000nnnn00010010", "stc",      "gbr,%n"),
+    ("0000nnnn00100010", "stc",      "vbr,%n"),
+    ("0100nnnn00000011", "stc.l",    "sr,@-%n"),
+    ("0100nnnn00010011", "stc.l",    "gbr,@-%n"),
+    ("0100nnnn00100011", "stc.l",    "vbr,@-%n"),
+    ("0000nnnn00001010", "sts",      "mach,%n"),
+    ("0000nnnn00011010", "sts",      "macl,%n"),
+    ("0000nnnn00101010", "sts",      "pr,%n"),
+    ("0100nnnn00000010", "sts.l",    "mach,@-%n"),
+    ("0100nnnn00010010", "sts.l",    "macl,@-%n"),
+    ("0100nnnn00100010", "sts.l",    "pr,@-%n"),
+    ("11000011iiiiiiii", "trapa",    "#%u"),
+]
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(f"usage: {sys.argv[0]} <output>")
+
+    # Entry 0 is for opcodes that aren't instructions
+    formats = [(".word", "%o")]
+    decode = [0] * 0x10000
+
+    for pattern, mnemonic, operands in INSNS:
+        assert len(pattern) == 16, pattern
+
+        value = int("".join(c if c in "01" else "0" for c in pattern), 2)
+        fields = [15 - i for i, c in enumerate(pattern) if c not in "01"]
+
+        formats.append((mnemonic, operands))
+        index = len(formats) - 1
+
+        # Every combination of the field bits
+        for combination in range(1 << len(fields)):
+            opcode = value
+
+            for i, bit in enumerate(fields):
+                if (combination >> i) & 1:
+                    opcode |= 1 << bit
+
+            if decode[opcode] != 0:
+                sys.exit(f"{pattern} overlaps {INSNS[decode[opcode] - 1][0]}")
+
+            decode[opcode] = index
+
+    assert len(formats) <= 256
+
+    with open(sys.argv[1], "w") as f:
+        f.write("/* Generated by tools/sh2-table.py. Do not edit */\n\n")
+
+        f.write("static const sh2_format_t _sh2_formats[] = {\n")
+        for mnemonic, operands in formats:
+            f.write(f"        {{ \"{mnemonic}\", \"{operands}\" }},\n")
+        f.write("};\n\n")
+
+        f.write("static const uint8_t _sh2_decode[0x10000] = {\n")
+        for row in range(0, 0x10000, 16):
+            f.write("        " + ", ".join(f"{i:3}" for i in decode[row:row + 16]) + ",\n")
+        f.write("};\n")
+
+if __name__ == "__main__":
+    main()
@@ -15,4 +15,16 @@ typedef struct parser_stream parser_stream_t;
 struct command;
 typedef struct command command_t;
 
+struct macro;
+typedef struct macro macro_t;
+
+struct buffer;
+typedef struct buffer buffer_t;
+
+struct job;
+typedef struct job job_t;
+
+struct device;
+typedef struct device device_t;
+
 #endif /* TYPESS_H */